@@ -4,5 +4,6 @@
 void sound_play(int id, float volume, float panning, float pitch);
 int sound_playing(unsigned int sound_id);
 void sound_set_volume(float volume);
+void sound_set_rate(float rate);
 
 #endif // _SOUND_H
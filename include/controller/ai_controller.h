@@ -6,4 +6,8 @@ typedef struct controller_t controller;
 void ai_controller_free(controller *ctrl);
 void ai_controller_create(controller *ctrl, int difficulty);
 
+// Makes the AI press punch every n ticks while it has no HAR, so that
+// selection screens keep moving without a human. Pass 0 to disable.
+void ai_controller_set_menu_confirm(controller *ctrl, int ticks);
+
 #endif
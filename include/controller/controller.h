@@ -4,6 +4,7 @@
 #include "game/protos/object.h"
 #include "game/objects/har.h"
 #include "game/utils/serial.h"
+#include "game/utils/checksum.h"
 #include "utils/list.h"
 
 enum {
@@ -30,7 +31,9 @@ enum {
     EVENT_TYPE_ACTION,
     EVENT_TYPE_SYNC,
     EVENT_TYPE_HB,
-    EVENT_TYPE_CLOSE
+    EVENT_TYPE_CLOSE,
+    EVENT_TYPE_CHECKSUM,
+    EVENT_TYPE_DIGEST
 };
 
 typedef struct ctrl_event_t ctrl_event;
@@ -55,6 +58,7 @@ struct controller_t {
     int (*poll_fun)(controller *ctrl, ctrl_event **ev);
     int (*update_fun)(controller *ctrl, serial *state);
     int (*rumble_fun)(controller *ctrl, float magnitude, int duration);
+    int (*checksum_fun)(controller *ctrl, const state_digest *digest);
     int (*har_hook)(controller *ctrl, har_event event);
     void (*controller_hook)(controller *ctrl, int action);
     void *data;
@@ -77,5 +81,7 @@ void controller_clear_hooks(controller *ctrl);
 void controller_free_chain(ctrl_event *ev);
 void controller_set_repeat(controller *ctrl, int repeat);
 int controller_rumble(controller *ctrl, float magnitude, int duration);
+int controller_has_checksum(controller *ctrl);
+int controller_checksum(controller *ctrl, const state_digest *digest);
 
 #endif // _CONTROLLER_H
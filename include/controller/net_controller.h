@@ -2,6 +2,7 @@
 #define _NET_CONTROLLER_H
 
 #include "controller/controller.h"
+#include "controller/net_stats.h"
 #include <SDL.h>
 #include <enet/enet.h>
 
@@ -12,5 +13,11 @@ void net_controller_har_hook(int action, void *cb_data);
 
 int net_controller_ready(controller *ctrl);
 int net_controller_tick_offset(controller *ctrl);
+// Called with the round trip in milliseconds of every heartbeat the peer answers,
+// as soon as the answer is handled
+typedef void (*net_hb_cb)(uint32_t rtt_ms, void *userdata);
+void net_controller_set_hb_cb(controller *ctrl, net_hb_cb cb, void *userdata);
+net_stats* net_controller_get_stats(controller *ctrl);
+void net_controller_sync_applied(controller *ctrl, int ticks_replayed);
 
 #endif // _NET_CONTROLLER_H
@@ -0,0 +1,80 @@
+#ifndef _NET_STATS_H
+#define _NET_STATS_H
+
+#include <stdint.h>
+#include <SDL.h>
+
+#define NET_STATS_CHANNELS 2
+#define NET_STATS_HISTORY 16 // seconds
+
+// Traffic counters for one second of wall clock time
+typedef struct net_stats_second_t {
+    SDL_atomic_t second;
+    SDL_atomic_t bytes_in[NET_STATS_CHANNELS];
+    SDL_atomic_t bytes_out[NET_STATS_CHANNELS];
+    SDL_atomic_t packets_in[NET_STATS_CHANNELS];
+    SDL_atomic_t packets_out[NET_STATS_CHANNELS];
+} net_stats_second;
+
+/*
+ * Netplay statistics. Traffic is recorded by the network thread into a fixed
+ * ring of per-second buckets; the game thread only ever reads those.
+ * Nothing here allocates.
+ */
+typedef struct net_stats_t {
+    uint32_t start;
+    net_stats_second history[NET_STATS_HISTORY];
+    SDL_atomic_t total_bytes_in[NET_STATS_CHANNELS];
+    SDL_atomic_t total_bytes_out[NET_STATS_CHANNELS];
+    SDL_atomic_t total_packets_in[NET_STATS_CHANNELS];
+    SDL_atomic_t total_packets_out[NET_STATS_CHANNELS];
+    SDL_atomic_t wire_bytes_in; // Including ENet protocol overhead
+    SDL_atomic_t wire_bytes_out;
+    SDL_atomic_t loss; // ENet packet loss estimate, in 1/65536ths
+    SDL_atomic_t resends; // Reliable packets sent again after a timeout, over the whole connection
+    unsigned int resend_window; // ENet's own count at the last update; it starts over every 10 s
+    unsigned int resend_epoch; // and when it does, the epoch changes
+    SDL_atomic_t rtt; // ENet round trip time, ms
+
+    // Updated by the game thread only
+    unsigned int syncs;
+    unsigned int ticks_replayed;
+    unsigned int max_replayed;
+} net_stats;
+
+// A consistent copy of the numbers, for display
+typedef struct net_stats_view_t {
+    unsigned int seconds;
+    unsigned int bytes_in[NET_STATS_CHANNELS]; // last full second
+    unsigned int bytes_out[NET_STATS_CHANNELS];
+    unsigned int packets_in[NET_STATS_CHANNELS];
+    unsigned int packets_out[NET_STATS_CHANNELS];
+    unsigned int total_bytes_in[NET_STATS_CHANNELS];
+    unsigned int total_bytes_out[NET_STATS_CHANNELS];
+    unsigned int total_packets_in[NET_STATS_CHANNELS];
+    unsigned int total_packets_out[NET_STATS_CHANNELS];
+    unsigned int wire_bytes_in;
+    unsigned int wire_bytes_out;
+    float loss; // percent
+    unsigned int resends;
+    unsigned int rtt;
+    unsigned int syncs;
+    unsigned int ticks_replayed;
+    unsigned int max_replayed;
+} net_stats_view;
+
+void net_stats_init(net_stats *st);
+void net_stats_packet_in(net_stats *st, int channel, unsigned int bytes);
+void net_stats_packet_out(net_stats *st, int channel, unsigned int bytes);
+void net_stats_link(net_stats *st,
+                    unsigned int wire_in,
+                    unsigned int wire_out,
+                    unsigned int loss,
+                    unsigned int resend_epoch,
+                    unsigned int resends,
+                    unsigned int rtt);
+void net_stats_sync(net_stats *st, int ticks_replayed);
+void net_stats_get(net_stats *st, net_stats_view *view);
+void net_stats_log_summary(net_stats *st);
+
+#endif // _NET_STATS_H
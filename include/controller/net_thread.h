@@ -0,0 +1,48 @@
+#ifndef _NET_THREAD_H
+#define _NET_THREAD_H
+
+#include <SDL.h>
+#include <enet/enet.h>
+#include "utils/spsc_queue.h"
+#include "controller/net_stats.h"
+
+enum {
+    NET_MSG_RECEIVE,
+    NET_MSG_DISCONNECT
+};
+
+// Inbound message, handed from the network thread to the game thread
+typedef struct net_msg_t {
+    int type;
+    int channel;
+    uint32_t arrival; // SDL_GetTicks() when the packet came off the socket
+    ENetPacket *packet; // Owned by the receiver of the message
+} net_msg;
+
+/*
+ * Services an ENet host on a dedicated thread. After net_thread_start, the
+ * host must not be touched from any other thread until net_thread_stop returns.
+ */
+typedef struct net_thread_t {
+    ENetHost *host;
+    ENetPeer *peer;
+    int id;
+    SDL_Thread *thread;
+    SDL_atomic_t run;
+    SDL_atomic_t ticks; // Latest local tick, used to answer heartbeats without involving the game thread
+    SDL_atomic_t disconnected;
+    spsc_queue inbound;
+    spsc_queue outbound;
+    SDL_sem *inbound_space; // free slots in inbound
+    SDL_sem *outbound_space;
+    uint32_t last_link_update;
+    net_stats stats;
+} net_thread;
+
+int net_thread_start(net_thread *nt, ENetHost *host, ENetPeer *peer, int id);
+void net_thread_stop(net_thread *nt);
+int net_thread_send(net_thread *nt, int channel, ENetPacket *packet);
+int net_thread_poll(net_thread *nt, net_msg *msg);
+void net_thread_set_ticks(net_thread *nt, int ticks);
+
+#endif // _NET_THREAD_H
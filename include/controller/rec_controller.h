@@ -3,9 +3,11 @@
 
 #include "controller/controller.h"
 #include "formats/rec.h"
-#include "utils/hashmap.h"
 
-void rec_controller_create(controller *ctrl, int player, sd_rec_file *rec);
+// Plays back one player's moves, decoding the recording as the ticks come in
+int rec_controller_create(controller *ctrl, int player, const char *file);
 void rec_controller_free(controller *ctrl);
+// Rewinds or advances the input stream so playback resumes at the given tick
+void rec_controller_seek(controller *ctrl, int tick);
 
 #endif // _REC_CONTROLLER_H
@@ -4,11 +4,20 @@
 typedef struct engine_init_flags_t {
     unsigned int net_mode;
     unsigned int record;
+    unsigned int headless; // replay driven by a tool; no seek index is built or written
+    unsigned int seed; // for the game state's RNG
+    unsigned int seek_index; // keep the seek index of a played recfile in <rec_file>.idx
     char rec_file[255];
 } engine_init_flags;
 
 int engine_init(); // Init window, audiodevice, etc.
+int engine_init_offscreen(); // Same, but render to memory and leave audio off
 void engine_run(engine_init_flags *init_flags); // Run game
 void engine_close(); // Kill window, audiodev
 
+// For tools and tests that play recordings without main(): sets up the paths and
+// settings too, and says on stderr why it failed
+int engine_init_tool(int offscreen);
+void engine_close_tool();
+
 #endif // _ENGINE_H
@@ -15,6 +15,13 @@ int sd_reader_errno(const sd_reader *reader);
 void sd_reader_close(sd_reader *reader);
 int sd_reader_ok(const sd_reader *reader);
 
+/**
+  * Decompress (zlib) everything from the current position onwards. Reads, skips and
+  * sd_reader_pos() then work on the decompressed data; peeking is not supported.
+  * A stream that is cut short reads fine up to the break.
+  */
+int sd_reader_inflate(sd_reader *reader);
+
 long sd_reader_pos(sd_reader *reader);
 long sd_reader_filesize(const sd_reader *reader);
 int sd_reader_set(sd_reader *reader, long pos);
@@ -15,6 +15,17 @@ sd_writer* sd_writer_open(const char *file);
  */
 int sd_writer_errno(const sd_writer *writer);
 
+/**
+  * Compress (zlib) everything written from here on. The stream is finished when
+  * the file is closed; seeking and fprintf do not go through it.
+  */
+int sd_writer_deflate(sd_writer *writer);
+
+/**
+  * Push buffered data to the file.
+  */
+int sd_writer_flush(sd_writer *writer);
+
 /**
   * Close file.
   */
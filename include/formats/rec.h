@@ -85,9 +85,35 @@ typedef struct {
     int8_t unknown_m;       ///< Unknown \todo: Find out
 
     unsigned int move_count; ///< How many REC event records
+    unsigned int move_capacity; ///< How many REC event records fit in the allocated list
     sd_rec_move *moves; ///< REC event records list
 } sd_rec_file;
 
+/*! \brief REC journal
+ *
+ * Writes a REC file to disk while the match is still going on. The header
+ * is written when the journal is opened, and moves are appended as they
+ * happen. The file is flushed every now and then, so a crash loses at most
+ * the last few moves. The file is a valid REC file at all times.
+ */
+typedef struct {
+    struct sd_writer_t *w;   ///< Output file
+    unsigned int move_count; ///< Moves written so far
+    unsigned int unflushed;  ///< Moves written since the last flush
+    uint32_t flush_tick;     ///< Tick of the move that triggered the last flush
+} sd_rec_journal;
+
+/*! \brief REC move stream
+ *
+ * Reads the moves of a REC file one at a time, without holding the whole file
+ * in memory. Works on both plain and compressed REC files.
+ */
+typedef struct {
+    struct sd_reader_t *r; ///< Input file
+    int compressed;        ///< 1 if the moves are in the compressed format
+    uint32_t last_tick;    ///< Tick of the previous move; compressed ticks are relative to it
+} sd_rec_stream;
+
 /*! \brief Initialize REC file structure
  *
  * Initializes the REC file structure with empty values.
@@ -114,6 +140,10 @@ void sd_rec_free(sd_rec_file *rec);
  * before using this function. Loading to a previously loaded or filled sd_rec_file structure
  * will result in old data and pointers getting lost. This is very likely to cause a memory leak.
  *
+ * A file that ends in the middle of a move record (eg. an interrupted journal) is loaded
+ * without the partial record. Both plain and compressed (see sd_rec_save_compressed())
+ * files are accepted.
+ *
  * \retval SD_FILE_OPEN_ERROR File could not be opened.
  * \retval SD_FILE_PARSE_ERROR File does not contain valid data or has syntax problems.
  * \retval SD_OUT_OF_MEMORY Memory ran out. This struct should now be considered invalid and freed.
@@ -137,6 +167,56 @@ int sd_rec_load(sd_rec_file *rec, const char *filename);
  */
 int sd_rec_save(sd_rec_file *rec, const char *filename);
 
+/*! \brief Save a compressed .REC file
+ *
+ * Saves the REC in the compressed variant of the format. The header is stored as
+ * in a plain file, each move as a tick delta, packed ids and the extra data, and
+ * all of it goes through zlib. sd_rec_load() and sd_rec_stream_open() read these
+ * files transparently; the original game does not.
+ *
+ * \retval SD_FILE_OPEN_ERROR File could not be opened for writing.
+ * \retval SD_INVALID_INPUT Moves are not in tick order, or rec was NULL.
+ * \retval SD_SUCCESS Success.
+ *
+ * \param rec REC struct pointer.
+ * \param filename Name of the REC file to save into.
+ */
+int sd_rec_save_compressed(sd_rec_file *rec, const char *filename);
+
+/*! \brief Open a REC file for streaming
+ *
+ * Loads the header of a plain or compressed REC file into rec, and leaves the
+ * moves to be read with sd_rec_stream_next(). The REC structure must be initialized
+ * with sd_rec_create(); its move list is not touched.
+ *
+ * \retval SD_FILE_OPEN_ERROR File could not be opened.
+ * \retval SD_FILE_PARSE_ERROR File does not contain a valid header.
+ * \retval SD_SUCCESS Success.
+ *
+ * \param stream Stream to open.
+ * \param rec REC struct pointer for the header.
+ * \param filename Name of the REC file.
+ */
+int sd_rec_stream_open(sd_rec_stream *stream, sd_rec_file *rec, const char *filename);
+
+/*! \brief Read the next move
+ *
+ * The move is owned by the caller afterwards, including its extra data.
+ *
+ * \retval SD_FILE_PARSE_ERROR No more moves; the file ended, or ended in a partial move.
+ * \retval SD_SUCCESS Success.
+ *
+ * \param stream Open stream.
+ * \param move Move to fill.
+ */
+int sd_rec_stream_next(sd_rec_stream *stream, sd_rec_move *move);
+
+/*! \brief Close a REC stream
+ *
+ * \param stream Stream to close.
+ */
+void sd_rec_stream_close(sd_rec_stream *stream);
+
 /*! \brief Deletes a REC event record
  *
  * Deletes a REC event record at given position.
@@ -171,6 +251,58 @@ int sd_rec_extra_len(int key);
  */
 int sd_rec_insert_action(sd_rec_file *rec, unsigned int number, const sd_rec_move *move);
 
+/*! \brief Start a REC journal
+ *
+ * Creates the file and writes the header from the given REC structure. Any moves
+ * in the structure are ignored; append them with sd_rec_journal_append().
+ *
+ * \retval SD_FILE_OPEN_ERROR File could not be opened for writing.
+ * \retval SD_INVALID_INPUT Journal, REC or filename was NULL.
+ * \retval SD_SUCCESS Success.
+ *
+ * \param journal Journal struct pointer.
+ * \param rec REC struct pointer with the header data.
+ * \param filename Name of the REC file to write into.
+ */
+int sd_rec_journal_open(sd_rec_journal *journal, const sd_rec_file *rec, const char *filename);
+
+/*! \brief Append a REC event record to a journal
+ *
+ * Writes the move to the end of the file. The file is flushed periodically.
+ *
+ * \retval SD_FILE_WRITE_ERROR Periodic flush failed.
+ * \retval SD_INVALID_INPUT Journal is not open, or move was NULL.
+ * \retval SD_SUCCESS Success.
+ *
+ * \param journal Journal struct pointer.
+ * \param move Move to append
+ */
+int sd_rec_journal_append(sd_rec_journal *journal, const sd_rec_move *move);
+
+/*! \brief Flush a REC journal
+ *
+ * Pushes all appended moves to the file.
+ *
+ * \retval SD_FILE_WRITE_ERROR Flushing failed.
+ * \retval SD_INVALID_INPUT Journal is not open.
+ * \retval SD_SUCCESS Success.
+ *
+ * \param journal Journal struct pointer.
+ */
+int sd_rec_journal_flush(sd_rec_journal *journal);
+
+/*! \brief Close a REC journal
+ *
+ * Flushes and closes the file. The result can be loaded with sd_rec_load().
+ *
+ * \retval SD_FILE_WRITE_ERROR Final flush failed.
+ * \retval SD_INVALID_INPUT Journal is not open.
+ * \retval SD_SUCCESS Success.
+ *
+ * \param journal Journal struct pointer.
+ */
+int sd_rec_journal_close(sd_rec_journal *journal);
+
 #ifdef __cplusplus
 }
 #endif
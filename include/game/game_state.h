@@ -5,6 +5,7 @@
 #include "utils/vector.h"
 #include "utils/random.h"
 #include "game/utils/serial.h"
+#include "game/utils/checksum.h"
 #include "game/game_state_type.h"
 
 typedef struct scene_t scene;
@@ -24,14 +25,23 @@ scene* game_state_get_scene(game_state *gs);
 unsigned int game_state_is_running(game_state *gs);
 unsigned int game_state_is_paused(game_state *gs);
 void game_state_set_paused(game_state *gs, unsigned int paused);
+float game_state_get_playback_speed(game_state *gs);
+// Only recordings can be played back at other speeds. Returns 0 on success.
+int game_state_set_playback_speed(game_state *gs, float speed);
 void game_state_set_next(game_state *gs, unsigned int next_scene_id);
+// Switches scenes right away, without waiting for the next dynamic tick
+int game_load_new(game_state *gs, int scene_id);
 game_player* game_state_get_player(game_state *gs, int player_id);
 int game_state_num_players(game_state *gs);
 void game_state_init_demo(game_state *gs);
 int game_state_ms_per_dyntick(game_state *gs);
 ticktimer* game_state_get_ticktimer(game_state *gs);
 int game_state_serialize(game_state *gs, serial *ser);
+// Returns the number of ticks replayed to catch up with the sender
 int game_state_unserialize(game_state *gs, serial *ser, int rtt);
+void game_state_checksum(game_state *gs, state_digest *d);
+// Jumps a replayed match to the given tick, backwards or forwards. Returns 0 on success.
+int game_state_seek(game_state *gs, int tick);
 
 void _setup_keyboard(game_state *gs, int player_id);
 void _setup_ai(game_state *gs, int player_id);
@@ -49,6 +59,7 @@ unsigned int game_state_get_speed(game_state *gs);
 int game_state_add_object(game_state *gs, object *obj, int layer, int singleton, int persistent);
 void game_state_del_object(game_state *gs, object *obj);
 void game_state_del_animation(game_state *gs, int anim_id);
+void game_state_get_objects(game_state *gs, vector *objs);
 void game_state_get_projectiles(game_state *gs, vector *obj_proj);
 void game_state_clear_hazards_projectiles(game_state *gs);
 
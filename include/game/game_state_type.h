@@ -2,6 +2,7 @@
 #define _GAME_STATE_TYPE_H
 
 #include "utils/vector.h"
+#include "utils/random.h"
 #include "engine.h"
 
 enum {
@@ -24,6 +25,7 @@ enum {
 typedef struct scene_t scene;
 typedef struct game_player_t game_player;
 typedef struct ticktimer_t ticktimer;
+typedef struct keyframe_index_t keyframe_index;
 
 typedef struct game_state_t {
     unsigned int run;
@@ -34,7 +36,9 @@ typedef struct game_state_t {
     unsigned int tick;
     unsigned int int_tick; // never adjusted, used in ping calculation
     unsigned int role;
+    struct random_t rand; // Simulation RNG, private to this game state
     unsigned int speed;
+    float playback_speed; // replay clock multiplier, 0 runs as fast as possible
     engine_init_flags *init_flags;
 
     // For screen shaking
@@ -54,6 +58,7 @@ typedef struct game_state_t {
     scene *sc;
     vector objects;
     game_player *players[2];
+    keyframe_index *keyframes; // Seek points, only set while replaying a recording
 } game_state;
 
 #endif // _GAME_STATE_TYPE_H
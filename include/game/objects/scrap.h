@@ -2,7 +2,9 @@
 #define _SCRAP_H
 
 #include "game/protos/object.h"
+#include "resources/af.h"
 
-int scrap_create(object *obj);
+int scrap_create(object *obj, af *af_data);
+void scrap_bootstrap(object *obj);
 
 #endif // _SCRAP_H
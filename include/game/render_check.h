@@ -0,0 +1,26 @@
+#ifndef _RENDER_CHECK_H
+#define _RENDER_CHECK_H
+
+#define RENDER_CHECK_MAX_TICKS 64
+
+typedef struct render_check_opts_t {
+    const char *dir; // where the golden images are kept
+    const char *rec_file; // recording to play, or NULL to show scene
+    int scene;
+    unsigned int ticks[RENDER_CHECK_MAX_TICKS]; // ascending
+    int tick_count;
+    int tolerance; // largest difference per color channel that still passes
+    int write; // store the frames as the new golden images
+} render_check_opts;
+
+/*
+ * Plays a recording, or shows a scene, on the virtual clock of replay.h and
+ * compares the frames at the given ticks with PNG files in opts->dir. Each file
+ * is named after the recording or scene and the tick. A frame that doesn't match
+ * is written next to its golden image, with ".actual" added to the name.
+ * Needs the video system running, see video_init_offscreen().
+ * Returns 0 if every frame matched.
+ */
+int render_check(const render_check_opts *opts);
+
+#endif // _RENDER_CHECK_H
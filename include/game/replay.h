@@ -0,0 +1,63 @@
+#ifndef _REPLAY_H
+#define _REPLAY_H
+
+#include <stdint.h>
+#include "engine.h"
+#include "game/game_state_type.h"
+#include "utils/vector.h"
+
+// Virtual time that passes per replay_frame() call, the same as a 100fps game loop
+#define REPLAY_FRAME_MS 10
+
+// REC files don't store the seed the match was played with, so every replay
+// starts from this one. That keeps results independent of what ran before.
+#define REPLAY_SEED 0x4F4D4632
+
+/*
+ * Plays a recording back without a window, audio or a wall clock.
+ * The game loop's scheduling of static and dynamic ticks is reproduced on a
+ * virtual clock, so a replay comes out the same no matter how fast it runs.
+ * Each replay owns its game state, so several may run on different threads
+ * once engine_init() has been called.
+ *
+ * Some state is still shared by the whole process, and that is only safe in the
+ * headless build. The settings are only read during a match. The console, the
+ * texture cache and the video state are only used for drawing, and the
+ * headless build draws nothing. Rendering several matches at once in one
+ * process is not supported.
+ */
+typedef struct replay_t {
+    engine_init_flags flags;
+    game_state *gs;
+    int static_wait;
+    int dynamic_wait;
+    unsigned int start_tick;
+    int scene_id; // -1 when playing a recording
+} replay;
+
+typedef struct replay_result_t {
+    unsigned int ticks; // dynamic ticks simulated
+    int32_t score[2];
+    uint32_t hash; // state digest at the end of the match
+} replay_result;
+
+int replay_create(replay *rp, const char *rec_file);
+// Shows a single scene with nobody at the controls, until the scene ends
+int replay_create_scene(replay *rp, int scene_id);
+void replay_free(replay *rp);
+
+// Runs one frame of virtual time. Returns 1 while the match, or the scene, is still on.
+int replay_frame(replay *rp);
+void replay_get_result(replay *rp, replay_result *res);
+
+// Lists the .REC files of a directory by name, in order. Each vector entry is a
+// char[REPLAY_NAME_MAX]; free the vector either way. Returns 1 if the directory
+// can't be read.
+#define REPLAY_NAME_MAX 256
+int replay_scan_dir(vector *names, const char *dir);
+
+// Plays the recording to its end. Returns 0 on success, 1 on a load error or
+// if the match did not finish within max_ticks.
+int replay_run(const char *rec_file, unsigned int max_ticks, replay_result *res);
+
+#endif // _REPLAY_H
@@ -0,0 +1,20 @@
+#ifndef _REPLAY_EXPORT_H
+#define _REPLAY_EXPORT_H
+
+typedef struct replay_export_opts_t {
+    const char *file; // .y4m file, or prefix for numbered PNG files
+    int scale; // integer upscale of the 320x200 frame
+    int fps;
+    int jobs; // 0 picks one per CPU
+} replay_export_opts;
+
+/*
+ * Renders a recording frame by frame and writes it out as video. The match is
+ * driven by a virtual clock, so this runs as fast as the frames can be drawn.
+ * Scaling and encoding are spread over worker threads.
+ * Needs the video system running, see video_init_offscreen().
+ * Returns 0 on success.
+ */
+int replay_export(const char *rec_file, const replay_export_opts *opts);
+
+#endif // _REPLAY_EXPORT_H
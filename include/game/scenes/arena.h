@@ -2,6 +2,7 @@
 #define _ARENA_H
 
 #include "game/protos/scene.h"
+#include "game/utils/serial.h"
 
 enum {
     ARENA_STATE_STARTING,
@@ -12,6 +13,8 @@ enum {
 int arena_create(scene *scene);
 int arena_get_state(scene *scene);
 void arena_set_state(scene *scene, int state);
+void arena_serialize(scene *sc, serial *ser);
+void arena_unserialize(scene *sc, serial *ser);
 palette* arena_get_player_palette(scene *scene, int player);
 void arena_toggle_rein(scene *scene);
 void maybe_install_har_hooks(scene *scene);
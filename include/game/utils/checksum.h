@@ -0,0 +1,64 @@
+#ifndef _CHECKSUM_H
+#define _CHECKSUM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "game/utils/serial.h"
+
+// How many ticks of digests are kept around for comparison
+#define DIGEST_HISTORY 128
+
+typedef struct object_t object;
+typedef struct chr_score_t chr_score;
+
+typedef struct digest_har_t {
+    float pos_x;
+    float pos_y;
+    float vel_x;
+    float vel_y;
+    int32_t direction;
+    int32_t animation;
+    int32_t anim_tick;
+    int32_t state;
+    int32_t executing_move;
+    int32_t health;
+    float endurance;
+    int32_t stun_timer;
+    int32_t stasis_ticks;
+} digest_har;
+
+/*
+ * A small, canonical snapshot of the simulation state at the start of a tick.
+ * Peers exchange the hash every tick; the full field set is only sent when
+ * the hashes disagree, so the other side can produce a field level diff.
+ */
+typedef struct state_digest_t {
+    uint32_t tick;
+    uint32_t seed;
+    int32_t paused;
+    int32_t projectiles;
+    uint32_t projectile_hash;
+    int32_t score[2];
+    digest_har har[2];
+    uint32_t hash;
+} state_digest;
+
+typedef struct digest_ring_t {
+    state_digest entries[DIGEST_HISTORY];
+} digest_ring;
+
+void state_digest_begin(state_digest *d, uint32_t tick, uint32_t seed, int paused);
+void state_digest_har(state_digest *d, int player_id, const object *obj);
+void state_digest_projectile(state_digest *d, const object *obj);
+void state_digest_score(state_digest *d, int player_id, const chr_score *score);
+void state_digest_finish(state_digest *d);
+
+void state_digest_serialize(const state_digest *d, serial *ser);
+void state_digest_unserialize(state_digest *d, serial *ser);
+int state_digest_diff(const state_digest *local, const state_digest *remote, FILE *out);
+
+void digest_ring_clear(digest_ring *ring);
+void digest_ring_push(digest_ring *ring, const state_digest *d);
+const state_digest* digest_ring_get(const digest_ring *ring, uint32_t tick);
+
+#endif // _CHECKSUM_H
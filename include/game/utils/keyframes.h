@@ -0,0 +1,38 @@
+#ifndef _KEYFRAMES_H
+#define _KEYFRAMES_H
+
+#include "game/utils/serial.h"
+#include "utils/vector.h"
+
+// Ticks between keyframes; seeking fast-simulates at most this many ticks
+#define KEYFRAME_INTERVAL 100
+
+typedef struct keyframe_t {
+    int tick;
+    serial state;
+} keyframe;
+
+/*
+ * Full game state snapshots of a recording, taken every KEYFRAME_INTERVAL ticks.
+ * Can be kept in a side file next to the .rec, so later playbacks can seek right away.
+ */
+typedef struct keyframe_index_t {
+    vector frames;
+    long rec_size; // size of the .rec this index belongs to
+    int dirty;
+} keyframe_index;
+
+void keyframe_index_create(keyframe_index *idx, long rec_size);
+void keyframe_index_free(keyframe_index *idx);
+
+// Returns 1 if a keyframe is due for this tick and not taken yet
+int keyframe_index_wants(const keyframe_index *idx, int tick);
+void keyframe_index_add(keyframe_index *idx, int tick, const serial *state);
+
+// Latest keyframe at or before the given tick, or NULL
+const keyframe* keyframe_index_find(const keyframe_index *idx, int tick);
+
+int keyframe_index_load(keyframe_index *idx, const char *filename);
+int keyframe_index_save(keyframe_index *idx, const char *filename);
+
+#endif // _KEYFRAMES_H
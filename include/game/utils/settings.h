@@ -50,6 +50,7 @@ typedef struct settings_video_t {
     int crossfade_on;
     char *scaler;
     int scale_factor;
+    int texture_cache_mb;
 } settings_video;
 
 typedef struct settings_gameplay_t {
@@ -115,6 +116,7 @@ typedef struct settings_network_t {
     char *net_connect_ip;
     int net_connect_port;
     int net_listen_port;
+    int net_stats_overlay;
 } settings_network;
 
 
@@ -0,0 +1,20 @@
+#ifndef _SIM_CLOCK_H
+#define _SIM_CLOCK_H
+
+// Splits the wall clock time of a frame into slices of game time to simulate.
+// Playback speed 0 runs as fast as the frame budget allows.
+typedef struct sim_clock_t {
+    float carry; // game time below a millisecond, kept for the next frame
+    int pending; // game time left to simulate in this frame
+} sim_clock;
+
+void sim_clock_init(sim_clock *clock);
+
+// Starts a frame that lasted dt ms of wall clock time
+void sim_clock_start(sim_clock *clock, int dt, float playback);
+
+// Returns the ms of game time to simulate next, or 0 when the frame is done.
+// Only an unbounded clock keeps going at speed 0; a paused one must not.
+int sim_clock_next(sim_clock *clock, float playback, int unbounded);
+
+#endif // _SIM_CLOCK_H
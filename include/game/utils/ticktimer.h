@@ -14,4 +14,9 @@ void ticktimer_add(ticktimer *tt, int ticks, ticktimer_cb cb, void *userdata);
 void ticktimer_run(ticktimer *tt);
 void ticktimer_close(ticktimer *tt);
 
+// For saving and restoring the pending callbacks
+unsigned int ticktimer_size(ticktimer *tt);
+int ticktimer_get(ticktimer *tt, unsigned int n, ticktimer_cb *cb, int *ticks, void **userdata);
+void ticktimer_clear(ticktimer *tt);
+
 #endif // _TICKTIMER_H
@@ -0,0 +1,23 @@
+#ifndef _BUILTIN_SCALERS_H
+#define _BUILTIN_SCALERS_H
+
+#include "plugins/base_plugin.h"
+#include "plugins/scaler_plugin.h"
+
+/*
+ * Scalers that are compiled in, with the same interface as the scaler plugins.
+ * Frames are split into bands of rows that are scaled on worker threads.
+ *  - "Pixel": nearest neighbour, 2x to 4x
+ *  - "Scale": Scale2x, Scale3x and Scale4x as defined by AdvanceMAME
+ *  - "HQ2x": hq2x, giving the same pixels as the 2x of the HQX plugin
+ */
+int builtin_scalers_count();
+base_plugin* builtin_scalers_get_base(int index);
+// Returns 1 if there is no built-in scaler by that name
+int builtin_scalers_get(scaler_plugin *scaler, const char *name);
+
+// Helper threads used for scaling; -1 for one less than the CPU count, 0 to scale on the calling thread only
+void builtin_scalers_set_threads(int threads);
+void builtin_scalers_close();
+
+#endif // _BUILTIN_SCALERS_H
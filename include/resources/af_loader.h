@@ -5,4 +5,10 @@
 
 int load_af_file(af *a, int id);
 
+// Shared, read-only HAR data. Safe to use from several threads at once.
+int af_cache_init();
+void af_cache_close();
+af* af_cache_acquire(int id);
+void af_cache_release(af *a);
+
 #endif // _AF_LOADER_H
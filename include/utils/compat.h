@@ -8,4 +8,10 @@
 char *strdup(const char *s1);
 #endif
 
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
 #endif // _COMPAT_H
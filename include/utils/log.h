@@ -2,6 +2,7 @@
 #define _LOG_H
 
 #include <stdlib.h>
+#include "utils/compat.h"
 
 #ifdef DEBUGMODE
 #define DEBUG(...) log_print('D', __FUNCTION__, __VA_ARGS__ )
@@ -13,8 +14,9 @@
 #define INFO(...) log_print('I', NULL, __VA_ARGS__ )
 #endif
 
+// The tick shown in log lines is per thread, so concurrent matches don't garble each other's logs
 #define LOGTICK(x) _log_tick = x;
-extern unsigned int _log_tick;
+extern THREAD_LOCAL unsigned int _log_tick;
 
 void log_print(char mode, const char* fn, const char *fmt, ...);
 int log_init(const char *filename);
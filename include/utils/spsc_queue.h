@@ -0,0 +1,24 @@
+#ifndef _SPSC_QUEUE_H
+#define _SPSC_QUEUE_H
+
+#include <SDL.h>
+
+/*
+ * Bounded lock-free queue for exactly one producer thread and one consumer thread.
+ * Memory is allocated once at creation; push and pop never allocate.
+ */
+typedef struct spsc_queue_t {
+    char *data;
+    unsigned int block_size;
+    unsigned int capacity; // Always a power of two
+    SDL_atomic_t head; // Next slot to read, written by the consumer
+    SDL_atomic_t tail; // Next slot to write, written by the producer
+} spsc_queue;
+
+int spsc_queue_create(spsc_queue *q, unsigned int block_size, unsigned int capacity);
+void spsc_queue_free(spsc_queue *q);
+int spsc_queue_push(spsc_queue *q, const void *value);
+int spsc_queue_pop(spsc_queue *q, void *value);
+unsigned int spsc_queue_size(spsc_queue *q);
+
+#endif // _SPSC_QUEUE_H
@@ -0,0 +1,36 @@
+#ifndef _THREAD_POOL_H
+#define _THREAD_POOL_H
+
+#include <SDL.h>
+
+// One part of a job; called once for each index in [0, count)
+typedef void (*thread_pool_job)(void *userdata, int index, int count);
+
+/*
+ * A fixed set of worker threads that split one job at a time between them.
+ * The thread calling thread_pool_run() works on the job as well, and the call
+ * returns once every part is done. Jobs must be run from one thread at a time.
+ */
+typedef struct thread_pool_t {
+    SDL_Thread **threads;
+    int thread_count;
+    SDL_mutex *lock;
+    SDL_cond *start;
+    SDL_cond *done;
+    unsigned int generation; // Bumped for every job
+    int busy; // Workers still on the current job
+    int quit;
+    thread_pool_job job;
+    void *userdata;
+    int count;
+    SDL_atomic_t next; // Next part to hand out
+} thread_pool;
+
+// Starts the given number of helper threads; -1 for one less than the CPU count
+int thread_pool_create(thread_pool *pool, int threads);
+void thread_pool_free(thread_pool *pool);
+void thread_pool_run(thread_pool *pool, thread_pool_job job, void *userdata, int count);
+// Number of threads working on a job, including the caller
+int thread_pool_size(const thread_pool *pool);
+
+#endif // _THREAD_POOL_H
@@ -0,0 +1,36 @@
+#ifndef _ATLAS_H
+#define _ATLAS_H
+
+#include <SDL.h>
+#include "utils/vector.h"
+
+/*
+ * Packs many small images into a few large textures. Images are placed on
+ * shelves, rows of a fixed height, filled left to right. Released areas are
+ * handed out again to images that fit in them, which covers animation frames
+ * that get evicted and come back.
+ */
+typedef struct atlas_t {
+    SDL_Renderer *renderer;
+    int page_w;
+    int page_h;
+    int max_pages;
+    vector pages;
+    vector free_slots;
+    unsigned int used_pixels;
+} atlas;
+
+void atlas_create(atlas *a, SDL_Renderer *renderer, int page_w, int page_h, int max_pages);
+void atlas_free(atlas *a);
+
+// Whether a w*h image fits in a page at all
+int atlas_fits(const atlas *a, int w, int h);
+
+// Finds room for a w*h image. Returns 0 and the page texture and area on success,
+// 1 if the image is too large or all pages are full.
+int atlas_alloc(atlas *a, int w, int h, SDL_Texture **tex, SDL_Rect *rect);
+void atlas_release(atlas *a, SDL_Texture *tex, const SDL_Rect *rect);
+
+int atlas_page_count(const atlas *a);
+
+#endif // _ATLAS_H
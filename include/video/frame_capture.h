@@ -0,0 +1,42 @@
+#ifndef _FRAME_CAPTURE_H
+#define _FRAME_CAPTURE_H
+
+#include <SDL.h>
+#include "video/color.h"
+#include "video/surface.h"
+#include "video/image.h"
+#include "video/screen_palette.h"
+#include "utils/vector.h"
+
+/*
+ * The draw calls of one frame, with copies of the surfaces and palettes they
+ * draw from. Recording a frame is a few memory copies, and the frame can then be
+ * composed on the CPU by another thread while the game goes on, instead of
+ * waiting for the GPU to hand the pixels back.
+ */
+typedef struct frame_capture_t {
+    vector draws;
+    vector palettes;
+    float fade;
+    int target_move_x;
+    int target_move_y;
+} frame_capture;
+
+void frame_capture_create(frame_capture *cap);
+void frame_capture_free(frame_capture *cap);
+
+void frame_capture_draw(frame_capture *cap,
+                        const screen_palette *pal,
+                        surface *sur,
+                        const SDL_Rect *dst,
+                        SDL_BlendMode blend_mode,
+                        int pal_offset,
+                        SDL_RendererFlip flip_mode,
+                        uint8_t opacity,
+                        color color_mod);
+void frame_capture_finish(frame_capture *cap, float fade, int target_move_x, int target_move_y);
+
+// Composes the frame like the offscreen renderer does, and scales it up to w x h
+int frame_capture_compose(frame_capture *cap, image *img, int w, int h);
+
+#endif // _FRAME_CAPTURE_H
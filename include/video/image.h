@@ -26,5 +26,7 @@ void image_filled_rect(image *img, int x, int y, int w, int h, color c);
 int image_write_tga(image *img, const char *filename);
 
 int image_write_png(image *img, const char *filename);
+// Loads any PNG file as RGBA. Returns 1 if there is no such file.
+int image_read_png(image *img, const char *filename);
 
 #endif // _IMAGE_H
@@ -0,0 +1,24 @@
+#ifndef _PALETTE_LUT_H
+#define _PALETTE_LUT_H
+
+#include <stdint.h>
+#include "video/screen_palette.h"
+
+/*
+ * Indexed to RGBA conversion through a 256 entry table of ready made pixels.
+ * The remap table and the palette offset are folded into the table once, so
+ * converting is a single lookup per pixel plus the stencil.
+ */
+typedef struct palette_lut_t {
+    uint32_t px[256]; // RGBA in memory order, alpha left empty
+} palette_lut;
+
+void palette_lut_build(palette_lut *lut, const screen_palette *pal, const char *remap_table, uint8_t pal_offset);
+
+// Writes count RGBA pixels to dst. Pixels are opaque where the stencil is 1.
+void palette_lut_convert(const palette_lut *lut, char *dst, const char *src, const char *stencil, int count);
+
+// Same as above without SIMD. Always gives the same result; used for testing.
+void palette_lut_convert_scalar(const palette_lut *lut, char *dst, const char *src, const char *stencil, int count);
+
+#endif // _PALETTE_LUT_H
@@ -0,0 +1,29 @@
+#ifndef _SCREENSHOT_H
+#define _SCREENSHOT_H
+
+#include "video/image.h"
+#include "video/frame_capture.h"
+
+// Shots waiting to be encoded; anything past this is dropped rather than stalling the game
+#define SCREENSHOT_QUEUE_SIZE 8
+
+/*
+ * Writes screenshots as PNG files on worker threads, so that compressing them
+ * does not hold up the game loop. Recorded frames are also composed there. If no worker could be started, shots are
+ * written right away instead.
+ */
+void screenshot_init();
+// Writes out everything still queued, then stops the workers
+void screenshot_close();
+
+// Queues an image to be written to filename. The image data is taken over in
+// any case, so the caller must not free it. Returns 1 if the queue was full
+// and the shot was dropped.
+int screenshot_save(image *img, const char *filename);
+// Like screenshot_save(), but the frame is composed from its draw calls and scaled
+// to w x h on the worker as well. The frame must be on the heap; it is freed.
+int screenshot_save_frame(frame_capture *frame, int w, int h, const char *filename);
+// Waits until every queued shot has been written
+void screenshot_flush();
+
+#endif // _SCREENSHOT_H
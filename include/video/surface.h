@@ -48,6 +48,13 @@ void surface_to_rgba(surface *sur,
                      screen_palette *pal,
                      char *remap_table,
                      uint8_t pal_offset);
+// Same as above, for a destination whose rows are pitch bytes apart
+void surface_to_rgba_pitch(surface *sur,
+                           char *dst,
+                           int pitch,
+                           screen_palette *pal,
+                           char *remap_table,
+                           uint8_t pal_offset);
 void surface_additive_blit(surface *dst,
                            surface *src,
                            int dst_x, int dst_y,
@@ -6,14 +6,81 @@
 #include "video/screen_palette.h"
 #include "plugins/scaler_plugin.h"
 
+// Default budget for texture memory, standalone textures and atlas pages alike
+#define TCACHE_DEFAULT_BUDGET (64 * 1024 * 1024)
+
+#define TCACHE_HISTORY 256 // frames
+#define TCACHE_MAX_SCENES 32
+
+// Totals since tcache_init()
+typedef struct tcache_stats_t {
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int evictions;
+    unsigned int entries;
+    size_t used_bytes;
+    size_t peak_bytes;
+    size_t budget_bytes;
+    uint64_t upload_bytes;
+    uint64_t convert_us; // surface_to_rgba() and scaling
+    uint64_t upload_us; // locking and unlocking textures
+} tcache_stats;
+
+// What happened during one rendered frame
+typedef struct tcache_frame_stats_t {
+    unsigned int frame;
+    int scene;
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int evictions;
+    unsigned int upload_bytes;
+    unsigned int convert_us;
+    unsigned int upload_us;
+    size_t used_bytes; // at the end of the frame
+} tcache_frame_stats;
+
+// Frames summed up for as long as a scene has been shown, over all its visits
+typedef struct tcache_scene_stats_t {
+    unsigned int frames;
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int evictions;
+    uint64_t upload_bytes;
+    uint64_t convert_us;
+    uint64_t upload_us;
+    size_t peak_bytes;
+    unsigned int worst_us; // slowest frame, convert + upload
+    unsigned int worst_frame;
+} tcache_scene_stats;
+
 void tcache_init(SDL_Renderer *renderer, int scale_factor, scaler_plugin *scaler);
 void tcache_reinit(SDL_Renderer *renderer, int scale_factor, scaler_plugin *scaler);
 void tcache_close();
 void tcache_clear();
+// Returns the texture holding the surface, and in rect the area of it to draw from.
+// Textures are shared between surfaces.
 SDL_Texture* tcache_get(surface *sur,
                         screen_palette *pal,
                         char *remap_table,
-                        uint8_t pal_offset);
-void tcache_tick();
+                        uint8_t pal_offset,
+                        SDL_Rect *rect);
+
+// Least recently used textures are evicted once the budget would be exceeded.
+// Atlas pages may use up to half of it and are only released by tcache_clear().
+void tcache_set_budget(size_t bytes);
+void tcache_get_stats(tcache_stats *stats);
+
+// Statistics from here on are attributed to this scene id
+void tcache_set_scene(int scene_id);
+// Closes the statistics of the current frame into the history ring
+void tcache_frame_end();
+// Copies up to max of the latest frames, oldest first. Returns the number copied.
+int tcache_get_history(tcache_frame_stats *frames, int max);
+// Returns 1 if the scene hasn't been shown yet
+int tcache_get_scene_stats(int scene_id, tcache_scene_stats *stats);
+
+// Called right before texture contents are overwritten or freed, for renderers that queue draws
+typedef void (*tcache_upload_cb)(SDL_Texture *tex, const SDL_Rect *rect, void *userdata);
+void tcache_set_upload_cb(tcache_upload_cb cb, void *userdata);
 
 #endif // _TCACHE_H
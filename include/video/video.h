@@ -5,6 +5,7 @@
 #include "video/surface.h"
 #include "video/image.h"
 #include "video/screen_palette.h"
+#include "video/frame_capture.h"
 #include "resources/palette.h"
 
 #define NATIVE_W 320
@@ -38,7 +39,12 @@ int video_reinit(int window_w,
                  int vsync,
                  const char* scaler_name,
                  int scale_factor);
+// Composes frames in memory on the CPU. No window, GPU or SDL video subsystem
+// is needed; frames are read back with video_get_frame() or video_screenshot().
+int video_init_offscreen();
 void video_reinit_renderer();
+// Call when SDL reports the render targets, or the whole device, were reset
+void video_render_reset(int device_lost);
 void video_get_state(int *w, int *h, int *fs, int *vsync);
 void video_move_target(int x, int y);
 
@@ -92,12 +98,21 @@ void video_render_sprite_flip_scale_opacity_tint(
     color tint);
 
 void video_select_renderer(int renderer);
+void video_set_batching(int enabled);
+void video_get_render_stats(unsigned int *sprites, unsigned int *draw_calls, unsigned int *state_changes);
+void video_set_dirty_rects(int enabled);
+// Share of the last frame that was drawn again, 0-100
+float video_get_redrawn_percent();
 void video_tick();
 void video_render_background(surface *sur);
 void video_render_prepare();
 void video_render_finish();
 void video_close();
+// Last finished frame, NATIVE_W x NATIVE_H RGBA. NULL unless rendering offscreen.
+const char* video_get_frame();
 int video_screenshot(image *img);
+// Records the draw calls of the next frame to cap, up until video_render_finish()
+void video_capture_frame(frame_capture *cap);
 int video_area_capture(surface *sur, int x, int y, int w, int h);
 void video_set_fade(float fade);
 
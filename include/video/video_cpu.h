@@ -0,0 +1,11 @@
+#ifndef _VIDEO_CPU_H
+#define _VIDEO_CPU_H
+
+#include "video/video_state.h"
+
+// Composes frames in memory, for running without a window. Sprites are drawn
+// with the same palette, tint, opacity and blending as the hardware renderer,
+// and the finished frame is left in state->offscreen.
+void video_cpu_init(video_state *state);
+
+#endif // _VIDEO_CPU_H
@@ -10,6 +10,7 @@
 typedef struct video_state_t {
     SDL_Window *window;
     SDL_Renderer *renderer;
+    uint8_t *offscreen; // finished frame when there is no window, NATIVE_W x NATIVE_H RGBA
     int w;
     int h;
     int fs;
@@ -26,6 +27,16 @@ typedef struct video_state_t {
     int cur_renderer;
     SDL_Texture *target;
 
+    // Sprite batching in the hardware renderer, and what the last frame cost
+    int batching;
+    unsigned int stat_sprites;
+    unsigned int stat_draw_calls;
+    unsigned int stat_state_changes;
+
+    // Redraw only the parts of the render target that changed since the last frame
+    int dirty_rects;
+    unsigned int stat_redrawn; // pixels
+
     // Palettes
     palette *base_palette;
     screen_palette *cur_palette;
@@ -11,7 +11,7 @@ struct sink_info_t {
     int (*sink_init_fn)(audio_sink *sink);
     const char* name;
 } const sinks[] = {
-#ifdef USE_OPENAL
+#if defined(USE_OPENAL) && !defined(STANDALONE_SERVER)
     {openal_sink_init, "openal"},
 #endif // USE_OPENAL
 };
@@ -13,11 +13,37 @@
 #include "audio/sources/xmp_source.h"
 #include "audio/sources/vorbis_source.h"
 
+#define SOURCE_NONE 0
+#define SOURCE_DUMB 1
+#define SOURCE_XMP 2
+
+audio_source_freq default_freqs[] = {
+    {0, 1, "none"},
+    {0,0}
+};
+
+audio_source_resampler default_resamplers[] = {
+    {0, 1, "default"},
+    {0,0}
+};
+
 #ifdef STANDALONE_SERVER
-int music_play(const char *filename) { return 0; }
+
+static module_source module_sources[] = {
+    {SOURCE_NONE, "none"},
+    {0,0} // Guard
+};
+
+int music_play(unsigned int id) { return 0; }
+int music_reload() { return 0; }
 void music_set_volume(float volume) {}
 void music_stop() {}
 int music_playing() { return 1; }
+unsigned int music_get_resource() { return 0; }
+module_source* music_get_module_sources() { return module_sources; }
+audio_source_freq* music_module_get_freqs(int id) { return default_freqs; }
+audio_source_resampler* music_module_get_resamplers(int id) { return default_resamplers; }
+
 #else // STANDALONE_SERVER
 
 struct music_override_t {
@@ -27,10 +53,6 @@ struct music_override_t {
 
 #define MUSIC_STREAM_ID 1000
 
-#define SOURCE_NONE 0
-#define SOURCE_DUMB 1
-#define SOURCE_XMP 2
-
 static unsigned int _music_resource_id = 0;
 static float _music_volume = VOLUME_DEFAULT;
 
@@ -45,16 +67,6 @@ static module_source module_sources[] = {
     {0,0} // Guard
 };
 
-audio_source_freq default_freqs[] = {
-    {0, 1, "none"},
-    {0,0}
-};
-
-audio_source_resampler default_resamplers[] = {
-    {0, 1, "default"},
-    {0,0}
-};
-
 module_source* music_get_module_sources() {
     return module_sources;
 }
@@ -7,6 +7,7 @@
 #include "resources/sounds_loader.h"
 
 static float _sound_volume = VOLUME_DEFAULT;
+static float _sound_rate = 1.0f;
 
 #ifdef STANDALONE_SERVER
 void sound_play(int id, float volume, float panning, float pitch) {}
@@ -19,6 +20,14 @@ void sound_play(int id, float volume, float panning, float pitch) {
         return;
     }
 
+    // Off-speed replays pitch the sound with the clock, or drop it when the sink can't
+    if(_sound_rate != 1.0f) {
+        pitch *= _sound_rate;
+        if(pitch < PITCH_MIN || pitch > PITCH_MAX) {
+            return;
+        }
+    }
+
     // If the sound is already playing, stop it.
     if(sink_is_playing(sink, id)) {
         sink_stop(sink, id);
@@ -50,3 +59,7 @@ int sound_playing(unsigned int id) {
 void sound_set_volume(float volume) {
     _sound_volume = volume;
 }
+
+void sound_set_rate(float rate) {
+    _sound_rate = rate;
+}
@@ -4,7 +4,10 @@
 #include "console/console_type.h"
 #include "resources/ids.h"
 #include "video/video.h"
+#include "video/tcache.h"
 #include "audio/music.h"
+#include "controller/net_controller.h"
+#include "game/utils/settings.h"
 
 // utils
 int strtoint(char *input, int *output) {
@@ -191,6 +194,96 @@ int console_cmd_renderer(game_state *gs, int argc, char **argv) {
     return 1;
 }
 
+int console_cmd_drawstats(game_state *gs, int argc, char **argv) {
+    char buf[128];
+    unsigned int sprites, draw_calls, state_changes;
+    int i;
+    if(argc == 2) {
+        if(strtoint(argv[1], &i) && (i == 0 || i == 1)) {
+            video_set_batching(i);
+            console_output_addline(i ? "Sprite batching ON" : "Sprite batching OFF");
+            return 0;
+        }
+        return 1;
+    }
+    if(argc == 3 && strcmp(argv[1], "dirty") == 0) {
+        if(strtoint(argv[2], &i) && (i == 0 || i == 1)) {
+            video_set_dirty_rects(i);
+            console_output_addline(i ? "Dirty rectangles ON" : "Dirty rectangles OFF");
+            return 0;
+        }
+        return 1;
+    }
+    video_get_render_stats(&sprites, &draw_calls, &state_changes);
+    snprintf(buf, sizeof(buf), "last frame: %u sprites, %u draw calls, %u state changes, %.1f%% redrawn",
+             sprites, draw_calls, state_changes, video_get_redrawn_percent());
+    console_output_addline(buf);
+    return 0;
+}
+
+static float hit_rate(unsigned int hits, unsigned int misses) {
+    return (hits + misses) ? hits * 100.0f / (hits + misses) : 0.0f;
+}
+
+int console_cmd_tcstats(game_state *gs, int argc, char **argv) {
+    char buf[128];
+    if(argc == 2 && strcmp(argv[1], "scenes") == 0) {
+        for(int i = 0; i < TCACHE_MAX_SCENES && i < NUMBER_OF_SCENE_TYPES; i++) {
+            tcache_scene_stats s;
+            if(tcache_get_scene_stats(i, &s)) {
+                continue;
+            }
+            snprintf(buf, sizeof(buf), "%s: %u frames, hits %.1f%%, %u evictions, %ukB/frame, peak %ukB",
+                     scene_get_name(i), s.frames, hit_rate(s.hits, s.misses), s.evictions,
+                     (unsigned)(s.upload_bytes / s.frames / 1024), (unsigned)(s.peak_bytes / 1024));
+            console_output_addline(buf);
+            snprintf(buf, sizeof(buf), " convert %.2fms, upload %.2fms per frame, worst %uus at frame %u",
+                     s.convert_us / 1000.0f / s.frames, s.upload_us / 1000.0f / s.frames,
+                     s.worst_us, s.worst_frame);
+            console_output_addline(buf);
+        }
+        return 0;
+    }
+    if(argc == 2 && strcmp(argv[1], "spikes") == 0) {
+        // The slowest frames still in the history, slowest first
+        static tcache_frame_stats frames[TCACHE_HISTORY];
+        int count = tcache_get_history(frames, TCACHE_HISTORY);
+        for(int n = 0; n < 5 && count > 0; n++) {
+            int worst = 0;
+            for(int i = 1; i < count; i++) {
+                if(frames[i].convert_us + frames[i].upload_us > frames[worst].convert_us + frames[worst].upload_us) {
+                    worst = i;
+                }
+            }
+            tcache_frame_stats *f = &frames[worst];
+            snprintf(buf, sizeof(buf), "frame %u (%s): %u misses, %ukB, convert %uus, upload %uus",
+                     f->frame, scene_get_name(f->scene), f->misses, f->upload_bytes / 1024,
+                     f->convert_us, f->upload_us);
+            console_output_addline(buf);
+            frames[worst] = frames[--count];
+        }
+        return 0;
+    }
+    if(argc != 1) {
+        return 1;
+    }
+    tcache_stats t;
+    tcache_get_stats(&t);
+    snprintf(buf, sizeof(buf), "%u hits (%.1f%%), %u misses, %u evictions, %u entries",
+             t.hits, hit_rate(t.hits, t.misses), t.misses, t.evictions, t.entries);
+    console_output_addline(buf);
+    snprintf(buf, sizeof(buf), "%ukB of %ukB resident (peak %ukB), %ukB uploaded",
+             (unsigned)(t.used_bytes / 1024), (unsigned)(t.budget_bytes / 1024),
+             (unsigned)(t.peak_bytes / 1024), (unsigned)(t.upload_bytes / 1024));
+    console_output_addline(buf);
+    tcache_frame_stats f;
+    if(tcache_get_history(&f, 1)) {
+        snprintf(buf, sizeof(buf), "last frame: %u misses, %ukB, convert %uus, upload %uus",
+                 f.misses, f.upload_bytes / 1024, f.convert_us, f.upload_us);
+        console_output_addline(buf);
+    }
+    return 0;
+}
 
 int console_cmd_god(game_state *gs, int argc, char **argv) {
     for(int i = 0;i < game_state_num_players(gs);i++) {
@@ -206,6 +299,85 @@ int console_cmd_god(game_state *gs, int argc, char **argv) {
     return 0;
 }
 
+int console_cmd_netstats(game_state *gs, int argc, char **argv) {
+    char buf[128];
+    if(argc == 2 && strcmp(argv[1], "overlay") == 0) {
+        settings_network *net = &settings_get()->net;
+        net->net_stats_overlay = !net->net_stats_overlay;
+        console_output_addline(net->net_stats_overlay ? "Netstats overlay ON" : "Netstats overlay OFF");
+        return 0;
+    }
+
+    int found = 0;
+    for(int i = 0; i < game_state_num_players(gs); i++) {
+        controller *ctrl = game_player_get_ctrl(game_state_get_player(gs, i));
+        if(ctrl == NULL || ctrl->type != CTRL_TYPE_NETWORK) {
+            continue;
+        }
+        found = 1;
+        net_stats_view v;
+        net_stats_get(net_controller_get_stats(ctrl), &v);
+        snprintf(buf, sizeof(buf), "player %d: rtt %ums, loss %.2f%%, %u resends",
+                 i + 1, v.rtt, v.loss, v.resends);
+        console_output_addline(buf);
+        for(int c = 0; c < NET_STATS_CHANNELS; c++) {
+            snprintf(buf, sizeof(buf), " ch%d in %uB/s %up/s, out %uB/s %up/s",
+                     c, v.bytes_in[c], v.packets_in[c], v.bytes_out[c], v.packets_out[c]);
+            console_output_addline(buf);
+        }
+        snprintf(buf, sizeof(buf), " %u syncs, %u ticks replayed (max %u)",
+                 v.syncs, v.ticks_replayed, v.max_replayed);
+        console_output_addline(buf);
+    }
+    if(!found) {
+        console_output_addline("Not in a network game");
+    }
+    return 0;
+}
+
+int console_cmd_seek(game_state *gs, int argc, char **argv) {
+    char buf[64];
+    int tick;
+    if(argc != 2 || !strtoint(argv[1], &tick)) {
+        return 1;
+    }
+    // +n and -n are relative to the current tick
+    if(argv[1][0] == '+' || argv[1][0] == '-') {
+        tick += gs->tick;
+    }
+    if(game_state_seek(gs, tick)) {
+        console_output_addline("Not replaying a recording");
+        return 0;
+    }
+    snprintf(buf, sizeof(buf), "At tick %u", gs->tick);
+    console_output_addline(buf);
+    return 0;
+}
+
+int console_cmd_replayspeed(game_state *gs, int argc, char **argv) {
+    char buf[64];
+    float speed;
+    if(argc != 2) {
+        return 1;
+    }
+    if(strcmp(argv[1], "max") == 0) {
+        speed = 0.0f;
+    } else if((speed = atof(argv[1])) <= 0.0f) {
+        return 1;
+    }
+    if(game_state_set_playback_speed(gs, speed)) {
+        console_output_addline("Not replaying a recording");
+        return 0;
+    }
+    if(speed == 0.0f) {
+        snprintf(buf, sizeof(buf), "Replaying as fast as possible");
+    } else {
+        snprintf(buf, sizeof(buf), "Replaying at %.2fx", speed);
+    }
+    console_output_addline(buf);
+    return 0;
+}
+
 int console_kreissack(game_state *gs, int argc, char **argv) {
     game_player *p1 = game_state_get_player(gs, 0);
     p1->sp_wins = (2046 ^ (2 << p1->pilot_id));
@@ -252,7 +424,12 @@ void console_init_cmd() {
     console_add_cmd("stun",  &console_cmd_stun,   "Stun the other player");
     console_add_cmd("rein",  &console_cmd_rein,   "R-E-I-N!");
     console_add_cmd("rdr",   &console_cmd_renderer, "Renderer (0=sw,1=hw)");
+    console_add_cmd("drawstats", &console_cmd_drawstats, "Show draw calls of the last frame. usage: drawstats, drawstats 0/1 (sprite batching off/on), drawstats dirty 0/1");
+    console_add_cmd("tcstats", &console_cmd_tcstats, "Show texture cache statistics. usage: tcstats, tcstats scenes, tcstats spikes");
     console_add_cmd("god",   &console_cmd_god,  "Enable god mode");
+    console_add_cmd("netstats", &console_cmd_netstats, "Show netplay statistics. usage: netstats, netstats overlay");
+    console_add_cmd("seek",  &console_cmd_seek,  "Seek a recording. usage: seek 1200, seek +500, seek -1");
+    console_add_cmd("replayspeed", &console_cmd_replayspeed, "Replay speed multiplier. usage: replayspeed 0.25, replayspeed 4, replayspeed max");
     console_add_cmd("kreissack",   &console_kreissack,  "Fight Kreissack");
     console_add_cmd("ez-destruct",  &console_cmd_ez_destruct,  "Punch = destruction, kick = scrap");
 }
@@ -33,6 +33,10 @@ typedef struct ai_t {
     int input_lag; // number of ticks to wait per input
     int input_lag_timer;
 
+    // Confirm presses while there is no HAR to drive (menus); 0 disables
+    int menu_confirm_ticks;
+    int menu_confirm_timer;
+
     // move stats
     af_move *selected_move;
     int move_str_pos;
@@ -213,9 +217,9 @@ int is_valid_move(af_move *move, har *h) {
     return 0;
 }
 
-int maybe(int difficulty) {
+int maybe(struct random_t *r, int difficulty) {
     // make chance of blocking exponentially better as the difficulty inreases
-    int a = rand_int(49);
+    int a = random_int(r, 49);
     int b = difficulty*difficulty;
     /*DEBUG("maybe %d, %d < %d : %s", difficulty, a, b, a < b ? "true" : "false");*/
     if(a < b) {
@@ -234,7 +238,7 @@ int ai_block_har(controller *ctrl, ctrl_event **ev) {
 
     // XXX TODO get maximum move distance from the animation object
     if(fabsf(o_enemy->pos.x - o->pos.x) < 100 && h_enemy->executing_move &&
-       maybe(a->difficulty)) {
+       maybe(&o->gs->rand, a->difficulty)) {
         if(har_is_crouching(h_enemy)) {
             a->cur_act = (o->direction == OBJECT_FACE_RIGHT ? ACT_DOWN|ACT_LEFT : ACT_DOWN|ACT_RIGHT);
             controller_cmd(ctrl, a->cur_act, ev);
@@ -259,7 +263,7 @@ int ai_block_projectile(controller *ctrl, ctrl_event **ev) {
         if(projectile_get_owner(o_prj) == o)  {
             continue;
         }
-        if(o_prj->cur_sprite && maybe(a->difficulty)) {
+        if(o_prj->cur_sprite && maybe(&o->gs->rand, a->difficulty)) {
             vec2i pos_prj = vec2i_add(object_get_pos(o_prj), o_prj->cur_sprite->pos);
             vec2i size_prj = object_get_size(o_prj);
             if (object_get_direction(o_prj) == OBJECT_FACE_LEFT) {
@@ -281,6 +285,11 @@ int ai_controller_poll(controller *ctrl, ctrl_event **ev) {
     ai *a = ctrl->data;
     object *o = ctrl->har;
     if (!o) {
+        if(a->menu_confirm_ticks > 0 && --a->menu_confirm_timer <= 0) {
+            a->menu_confirm_timer = a->menu_confirm_ticks;
+            controller_cmd(ctrl, ACT_PUNCH, ev);
+            return 0;
+        }
         return 1;
     }
     har *h = object_get_userdata(o);
@@ -328,7 +337,7 @@ int ai_controller_poll(controller *ctrl, ctrl_event **ev) {
         int ch = str_at(&a->selected_move->move_string, a->move_str_pos);
         controller_cmd(ctrl, char_to_act(ch, o->direction), ev);
 
-    } else if(rand_int(100) < a->difficulty) {
+    } else if(random_int(&o->gs->rand, 100) < a->difficulty) {
         af_move *selected_move = NULL;
         int top_value = 0;
 
@@ -338,7 +347,7 @@ int ai_controller_poll(controller *ctrl, ctrl_event **ev) {
             if((move = af_get_move(h->af_data, i))) {
                 move_stat *ms = &a->move_stats[i];
                 if(is_valid_move(move, h)) {
-                    int value = ms->value + rand_int(10);
+                    int value = ms->value + random_int(&o->gs->rand, 10);
                     if (ms->min_hit_dist != -1){
                         if (ms->last_dist < ms->max_hit_dist+5 && ms->last_dist > ms->min_hit_dist+5){
                             value += 2;
@@ -350,7 +359,7 @@ int ai_controller_poll(controller *ctrl, ctrl_event **ev) {
                     value -= ms->attempts/2;
                     value -= ms->consecutive*2;
 
-                    if (is_special_move(move) && !maybe(a->difficulty)) {
+                    if (is_special_move(move) && !maybe(&o->gs->rand, a->difficulty)) {
                         DEBUG("skipping special move %s because of difficulty", str_c(&move->move_string));
                         continue;
                     }
@@ -381,8 +390,8 @@ int ai_controller_poll(controller *ctrl, ctrl_event **ev) {
         }
     } else {
         // Change action after 30 ticks
-        if(a->act_timer <= 0 && rand_int(100) > 88){
-            int p = rand_int(100);
+        if(a->act_timer <= 0 && random_int(&o->gs->rand, 100) > 88){
+            int p = random_int(&o->gs->rand, 100);
             if(p > 40){
                 // walk forward
                 a->cur_act = (o->direction == OBJECT_FACE_RIGHT ? ACT_RIGHT : ACT_LEFT);
@@ -404,7 +413,7 @@ int ai_controller_poll(controller *ctrl, ctrl_event **ev) {
         }
 
         // Jump once in a while
-        if(rand_int(100) == 88){
+        if(random_int(&o->gs->rand, 100) == 88){
             if(o->vel.x < 0) {
                 controller_cmd(ctrl, ACT_UP|ACT_LEFT, ev);
             } else if(o->vel.x > 0) {
@@ -425,6 +434,8 @@ void ai_controller_create(controller *ctrl, int difficulty) {
     a->cur_act = 0;
     a->input_lag = 3;
     a->input_lag_timer = a->input_lag;
+    a->menu_confirm_ticks = 0;
+    a->menu_confirm_timer = 0;
     a->selected_move = NULL;
     a->move_str_pos = 0;
     memset(a->move_stats, 0, sizeof(a->move_stats));
@@ -442,4 +453,8 @@ void ai_controller_create(controller *ctrl, int difficulty) {
     ctrl->har_hook = &ai_har_event;
 }
 
-
+void ai_controller_set_menu_confirm(controller *ctrl, int ticks) {
+    ai *a = ctrl->data;
+    a->menu_confirm_ticks = ticks;
+    a->menu_confirm_timer = ticks;
+}
@@ -17,6 +17,7 @@ void controller_init(controller *ctrl) {
     ctrl->update_fun = NULL;
     ctrl->har_hook = NULL;
     ctrl->rumble_fun = NULL;
+    ctrl->checksum_fun = NULL;
     ctrl->rtt = 0;
     ctrl->repeat = 0;
 }
@@ -140,3 +141,14 @@ int controller_rumble(controller *ctrl, float magnitude, int duration) {
     }
     return 0;
 }
+
+int controller_has_checksum(controller *ctrl) {
+    return ctrl->checksum_fun != NULL;
+}
+
+int controller_checksum(controller *ctrl, const state_digest *digest) {
+    if(ctrl->checksum_fun != NULL) {
+        return ctrl->checksum_fun(ctrl, digest);
+    }
+    return 0;
+}
@@ -1,13 +1,33 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #include "controller/net_controller.h"
+#include "controller/net_thread.h"
+#include "resources/pathmanager.h"
 #include "utils/log.h"
 #include "game/utils/serial.h"
+#include "game/utils/checksum.h"
+#include "game/game_state_type.h"
+
+// Checksums are sent to the peer in batches of this many ticks
+#define CHECKSUM_BATCH 8
+// Upper limit for desync dump files written per connection
+#define MAX_DESYNC_DUMPS 8
+// Ticks this far behind the newest one are taken as final: a sync from the server
+// rolls the client back by about half the round trip, which is well short of this
+#define DIGEST_SETTLE_TICKS 32
+// Window for measuring how long a tick takes, used to turn RTT milliseconds into ticks
+#define TICK_RATE_WINDOW 16
 
 typedef struct wtf_t {
     ENetHost *host;
     ENetPeer *peer;
+    net_thread net;
+    float ms_per_tick;
+    uint32_t rate_ms;
+    int rate_tick;
     int id;
     int last_hb;
     int last_action;
@@ -16,7 +36,19 @@ typedef struct wtf_t {
     int rttbuf[100];
     int rttpos;
     int rttfilled;
+    net_hb_cb hb_cb;
+    void *hb_userdata;
     int tick_offset;
+    digest_ring local_digests;
+    digest_ring remote_digests;
+    uint32_t batch_ticks[CHECKSUM_BATCH];
+    uint32_t batch_hashes[CHECKSUM_BATCH];
+    int batch_count;
+    int desynced;
+    int desync_dumps;
+    uint32_t digest_sent_tick;
+    uint32_t newest_tick; // newest tick we have a local digest of
+    uint32_t compared_tick; // ticks up to this one have been compared, UINT32_MAX for none
 } wtf;
 
 // simple standard deviation calculation
@@ -60,30 +92,29 @@ int net_controller_tick_offset(controller *ctrl) {
     return data->tick_offset;
 }
 
+void net_controller_set_hb_cb(controller *ctrl, net_hb_cb cb, void *userdata) {
+    wtf *data = ctrl->data;
+    data->hb_cb = cb;
+    data->hb_userdata = userdata;
+}
+
+net_stats* net_controller_get_stats(controller *ctrl) {
+    wtf *data = ctrl->data;
+    return &data->net.stats;
+}
+
+void net_controller_sync_applied(controller *ctrl, int ticks_replayed) {
+    wtf *data = ctrl->data;
+    net_stats_sync(&data->net.stats, ticks_replayed);
+}
+
 void net_controller_free(controller *ctrl) {
     wtf *data = ctrl->data;
-    ENetEvent event;
-    if (!data->disconnected) {
-        DEBUG("closing connection");
-        enet_peer_disconnect(data->peer, 0);
-
-        while (enet_host_service(data->host, &event, 3000) > 0) {
-            switch (event.type) {
-                case ENET_EVENT_TYPE_RECEIVE:
-                    enet_packet_destroy(event.packet);
-                    break;
-                case ENET_EVENT_TYPE_DISCONNECT:
-                    DEBUG("got disconnect notice");
-                    event.peer->data = NULL;
-                    // peer has acknowledged the disconnect
-                    goto done;
-                    break;
-                default:
-                    break;
-            }
-        }
+    // Stopping the thread also says goodbye to the peer, if it is still there
+    net_thread_stop(&data->net);
+    if(data->peer) {
+        net_stats_log_summary(&data->net.stats);
     }
-done:
     if(data->host) {
         enet_host_destroy(data->host);
         data->host = NULL;
@@ -94,19 +125,232 @@ done:
     }
 }
 
+static void net_controller_send_digest(controller *ctrl, const state_digest *d) {
+    wtf *data = ctrl->data;
+    serial ser;
+    if(!data->peer || data->digest_sent_tick == d->tick) {
+        return;
+    }
+    serial_create(&ser);
+    serial_write_int8(&ser, EVENT_TYPE_DIGEST);
+    state_digest_serialize(d, &ser);
+    ENetPacket *packet = enet_packet_create(ser.data, ser.len, ENET_PACKET_FLAG_RELIABLE);
+    serial_free(&ser);
+    net_thread_send(&data->net, 1, packet);
+    data->digest_sent_tick = d->tick;
+}
+
+// Compare our digest of a tick against the peer's, once both are known
+static void net_controller_compare(controller *ctrl, uint32_t tick) {
+    wtf *data = ctrl->data;
+    const state_digest *local = digest_ring_get(&data->local_digests, tick);
+    const state_digest *remote = digest_ring_get(&data->remote_digests, tick);
+    if(local == NULL || remote == NULL) {
+        return;
+    }
+    if(local->hash == remote->hash) {
+        if(data->desynced) {
+            INFO("Netplay state matches peer again at tick %u", tick);
+            data->desynced = 0;
+        }
+        return;
+    }
+    if(data->desynced) {
+        return;
+    }
+    data->desynced = 1;
+    PERROR("Netplay desync detected at tick %u (local %08x, remote %08x)", tick, local->hash, remote->hash);
+
+    // Ask the peer for a diff by sending it our side of the story
+    net_controller_send_digest(ctrl, local);
+}
+
+// Write both digests and their field level differences to a file for offline analysis
+static void net_controller_dump_desync(controller *ctrl, const state_digest *local, const state_digest *remote) {
+    wtf *data = ctrl->data;
+    char filename[64];
+    char path[512];
+    if(data->desync_dumps >= MAX_DESYNC_DUMPS) {
+        return;
+    }
+    data->desync_dumps++;
+
+    snprintf(filename, sizeof(filename), "desync_%s_%u.txt",
+             (data->id == ROLE_SERVER ? "server" : "client"), local->tick);
+    char *base = pm_get_local_base_dir();
+    snprintf(path, sizeof(path), "%s%s", (base ? base : ""), filename);
+    free(base);
+
+    FILE *f = fopen(path, "w");
+    if(f == NULL) {
+        PERROR("Unable to write desync dump to %s", path);
+        return;
+    }
+    fprintf(f, "Desync at tick %u, role %s\n\n", local->tick, (data->id == ROLE_SERVER ? "server" : "client"));
+    int differ = state_digest_diff(local, remote, f);
+    fclose(f);
+    INFO("%d state fields differ at tick %u, dump written to %s", differ, local->tick, path);
+}
+
+static void net_controller_handle_digest(controller *ctrl, serial *ser) {
+    wtf *data = ctrl->data;
+    state_digest remote;
+    state_digest_unserialize(&remote, ser);
+    const state_digest *local = digest_ring_get(&data->local_digests, remote.tick);
+    if(local == NULL) {
+        DEBUG("peer sent digest for tick %u which is no longer in history", remote.tick);
+        return;
+    }
+    net_controller_dump_desync(ctrl, local, &remote);
+
+    // Make sure the peer gets to dump the same diff
+    net_controller_send_digest(ctrl, local);
+}
+
+// Compare every tick that neither side can roll back anymore. A tick the peer has
+// not sent yet is waited for until it would drop out of the history.
+static void net_controller_compare_settled(controller *ctrl) {
+    wtf *data = ctrl->data;
+    if(data->compared_tick == UINT32_MAX || data->newest_tick < DIGEST_SETTLE_TICKS) {
+        return;
+    }
+    uint32_t settled = data->newest_tick - DIGEST_SETTLE_TICKS;
+    if(data->newest_tick - data->compared_tick > DIGEST_HISTORY) {
+        // Whatever is older is gone from the history anyway
+        data->compared_tick = data->newest_tick - DIGEST_HISTORY;
+    }
+    while(data->compared_tick < settled) {
+        uint32_t tick = data->compared_tick + 1;
+        if(digest_ring_get(&data->local_digests, tick) != NULL
+            && digest_ring_get(&data->remote_digests, tick) == NULL
+            && data->newest_tick - tick < DIGEST_HISTORY - 1) {
+            break;
+        }
+        net_controller_compare(ctrl, tick);
+        data->compared_tick = tick;
+    }
+}
+
+static void net_controller_handle_checksums(controller *ctrl, serial *ser) {
+    wtf *data = ctrl->data;
+    int count = serial_read_int8(ser);
+    state_digest d;
+    memset(&d, 0, sizeof(state_digest));
+    for(int i = 0; i < count; i++) {
+        d.tick = serial_read_int32(ser);
+        d.hash = serial_read_int32(ser);
+        digest_ring_push(&data->remote_digests, &d);
+    }
+    net_controller_compare_settled(ctrl);
+}
+
+static void net_controller_flush_checksums(controller *ctrl) {
+    wtf *data = ctrl->data;
+    serial ser;
+    if(data->batch_count == 0) {
+        return;
+    }
+    if(data->peer) {
+        serial_create(&ser);
+        serial_write_int8(&ser, EVENT_TYPE_CHECKSUM);
+        serial_write_int8(&ser, data->batch_count);
+        for(int i = 0; i < data->batch_count; i++) {
+            serial_write_int32(&ser, data->batch_ticks[i]);
+            serial_write_int32(&ser, data->batch_hashes[i]);
+        }
+        ENetPacket *packet = enet_packet_create(ser.data, ser.len, ENET_PACKET_FLAG_RELIABLE);
+        serial_free(&ser);
+        net_thread_send(&data->net, 0, packet);
+    }
+    data->batch_count = 0;
+}
+
+int net_controller_checksum(controller *ctrl, const state_digest *digest) {
+    wtf *data = ctrl->data;
+    digest_ring_push(&data->local_digests, digest);
+    if(data->compared_tick == UINT32_MAX) {
+        data->compared_tick = digest->tick - 1;
+    }
+    if(data->newest_tick == UINT32_MAX || digest->tick > data->newest_tick) {
+        data->newest_tick = digest->tick;
+    }
+    if(digest->tick <= data->compared_tick) {
+        // A rollback went past the settle window; the peer's hash has to be checked again
+        net_controller_compare(ctrl, digest->tick);
+    }
+    net_controller_compare_settled(ctrl);
+
+    data->batch_ticks[data->batch_count] = digest->tick;
+    data->batch_hashes[data->batch_count] = digest->hash;
+    data->batch_count++;
+    if(data->batch_count >= CHECKSUM_BATCH) {
+        net_controller_flush_checksums(ctrl);
+    }
+    return 0;
+}
+
+// Keep track of how many milliseconds a tick currently takes; this changes with the scene
+static void net_controller_measure_rate(wtf *data, int ticks, uint32_t now) {
+    if(data->rate_tick < 0 || ticks < data->rate_tick) {
+        data->rate_tick = ticks;
+        data->rate_ms = now;
+        return;
+    }
+    if(ticks - data->rate_tick >= TICK_RATE_WINDOW) {
+        float sample = (float)(now - data->rate_ms) / (ticks - data->rate_tick);
+        data->ms_per_tick = data->ms_per_tick * 0.75f + sample * 0.25f;
+        data->rate_tick = ticks;
+        data->rate_ms = now;
+    }
+}
+
+static void net_controller_handle_hb(controller *ctrl, serial *ser, uint32_t arrival, int ticks) {
+    wtf *data = ctrl->data;
+    // Only our own heartbeats come back here; the network thread answers the peer's
+    int id = serial_read_int8(ser);
+    if(id != data->id) {
+        return;
+    }
+    serial_read_int32(ser); // tick the heartbeat was sent at
+    uint32_t sent = serial_read_int32(ser);
+    int peerticks = serial_read_int32(ser);
+
+    if(data->hb_cb != NULL) {
+        data->hb_cb(arrival - sent, data->hb_userdata);
+    }
+
+    // Both timestamps are independent of frame time, convert to ticks for the game
+    float ms_per_tick = data->ms_per_tick > 1.0f ? data->ms_per_tick : 1.0f;
+    int newrtt = (int)((arrival - sent) / ms_per_tick + 0.5f);
+    data->rttbuf[data->rttpos++] = newrtt;
+    if (data->rttpos >= 100) {
+        data->rttpos = 0;
+        data->rttfilled = 1;
+    }
+    if (data->rttfilled == 1) {
+        ctrl->rtt = avg_rtt(data->rttbuf, 100);
+        data->tick_offset = (peerticks + (ctrl->rtt/2)) - ticks;
+        /*DEBUG("I am %d ticks away from server: %d %d", data->tick_offset, ticks, peerticks);*/
+    }
+    data->outstanding_hb = 0;
+    data->last_hb = ticks;
+}
+
 int net_controller_tick(controller *ctrl, int ticks, ctrl_event **ev) {
-    ENetEvent event;
     wtf *data = ctrl->data;
-    ENetHost *host = data->host;
-    ENetPeer *peer = data->peer;
+    net_msg msg;
     serial ser;
-    while (enet_host_service(host, &event, 0) > 0) {
-        switch (event.type) {
-            case ENET_EVENT_TYPE_RECEIVE:
+
+    net_thread_set_ticks(&data->net, ticks);
+    net_controller_measure_rate(data, ticks, SDL_GetTicks());
+
+    while(net_thread_poll(&data->net, &msg) == 0) {
+        switch (msg.type) {
+            case NET_MSG_RECEIVE:
                 serial_create_from(
                     &ser,
-                    (const char*)event.packet->data,
-                    event.packet->dataLength);
+                    (const char*)msg.packet->data,
+                    msg.packet->dataLength);
                 switch(serial_read_int8(&ser)) {
                     case EVENT_TYPE_ACTION:
                         {
@@ -116,57 +360,29 @@ int net_controller_tick(controller *ctrl, int ticks, ctrl_event **ev) {
                         }
                         break;
                     case EVENT_TYPE_HB:
-                        {
-                            // got a tick
-                            int id = serial_read_int8(&ser);
-                            if (id == data->id) {
-                                int start = serial_read_int32(&ser);
-                                int peerticks = serial_read_int32(&ser);
-                                int newrtt = abs(start - ticks);
-                                data->rttbuf[data->rttpos++] = newrtt;
-                                if (data->rttpos >= 100) {
-                                    data->rttpos = 0;
-                                    data->rttfilled = 1;
-                                }
-                                if (data->rttfilled == 1) {
-                                    ctrl->rtt = avg_rtt(data->rttbuf, 100);
-                                    data->tick_offset = (peerticks + (ctrl->rtt/2)) - ticks;
-                                    /*DEBUG("I am %d ticks away from server: %d %d", data->tick_offset, ticks, peerticks);*/
-                                }
-                                data->outstanding_hb = 0;
-                                data->last_hb = ticks;
-                            } else {
-                                // a heartbeat from the peer, bounce it back
-                                ENetPacket *packet;
-                                // write our own ticks into it
-                                if(peer) {
-                                    serial_write_int32(&ser, ticks);
-                                    packet = enet_packet_create(ser.data, ser.len, ENET_PACKET_FLAG_UNSEQUENCED);
-                                    enet_peer_send(peer, 0, packet);
-                                    enet_host_flush(host);
-                                }
-                            }
-                        }
+                        net_controller_handle_hb(ctrl, &ser, msg.arrival, ticks);
                         break;
                     case EVENT_TYPE_SYNC:
                         controller_sync(ctrl, &ser, ev);
                         break;
+                    case EVENT_TYPE_CHECKSUM:
+                        net_controller_handle_checksums(ctrl, &ser);
+                        break;
+                    case EVENT_TYPE_DIGEST:
+                        net_controller_handle_digest(ctrl, &ser);
+                        break;
                     default:
                         // Event type is unknown or we don't care about it
                         break;
                 }
                 serial_free(&ser);
-                enet_packet_destroy(event.packet);
+                enet_packet_destroy(msg.packet);
                 break;
-            case ENET_EVENT_TYPE_DISCONNECT:
+            case NET_MSG_DISCONNECT:
                 DEBUG("peer disconnected!");
                 data->disconnected = 1;
-                event.peer->data = NULL;
                 controller_close(ctrl, ev);
                 return 1; // bail the fuck out
-                break;
-            default:
-                break;
         }
     }
 
@@ -177,17 +393,19 @@ int net_controller_tick(controller *ctrl, int ticks, ctrl_event **ev) {
 
     if ((data->last_hb == -1 || ticks - data->last_hb > tick_interval) || !data->outstanding_hb) {
         data->outstanding_hb = 1;
-        if (peer) {
-            ENetPacket *packet;
-            serial ser;
+        if (data->peer && !data->disconnected) {
+            // Heartbeats are the type, our id and tick, then the send time; the peer
+            // appends its tick when it bounces them. Peers without the send time only
+            // read the first three fields, and append after whatever they got, so the
+            // packet must end where the fields do.
             serial_create(&ser);
             serial_write_int8(&ser, EVENT_TYPE_HB);
             serial_write_int8(&ser, data->id);
             serial_write_int32(&ser, ticks);
-            packet = enet_packet_create(ser.data, ser.len, ENET_PACKET_FLAG_UNSEQUENCED);
+            serial_write_int32(&ser, SDL_GetTicks());
+            ENetPacket *packet = enet_packet_create(ser.data, serial_len(&ser), ENET_PACKET_FLAG_UNSEQUENCED);
             serial_free(&ser);
-            enet_peer_send(peer, 0, packet);
-            enet_host_flush(host);
+            net_thread_send(&data->net, 0, packet);
         } else {
             DEBUG("peer is null~");
             data->disconnected = 1;
@@ -204,7 +422,6 @@ int net_controller_tick(controller *ctrl, int ticks, ctrl_event **ev) {
 int net_controller_update(controller *ctrl, serial *original) {
     wtf *data = ctrl->data;
     ENetPeer *peer = data->peer;
-    ENetHost *host = data->host;
     ENetPacket *packet;
 
     if(peer) {
@@ -214,8 +431,7 @@ int net_controller_update(controller *ctrl, serial *original) {
         serial_write(&ser, original->data, original->len);
         packet = enet_packet_create(ser.data, ser.len, 0);
         serial_free(&ser);
-        enet_peer_send(peer, 1, packet);
-        enet_host_flush(host);
+        net_thread_send(&data->net, 1, packet);
     } else {
         DEBUG("peer is null~");
     }
@@ -227,7 +443,6 @@ void controller_hook(controller *ctrl, int action) {
     serial ser;
     wtf *data = ctrl->data;
     ENetPeer *peer = data->peer;
-    ENetHost *host = data->host;
     ENetPacket *packet;
     if (action == ACT_STOP && data->last_action == ACT_STOP) {
         data->last_action = -1;
@@ -243,8 +458,7 @@ void controller_hook(controller *ctrl, int action) {
         /*sprintf(buf, "k%d", action);*/
         packet = enet_packet_create(ser.data, ser.len, ENET_PACKET_FLAG_RELIABLE);
         serial_free(&ser);
-        enet_peer_send(peer, 1, packet);
-        enet_host_flush (host);
+        net_thread_send(&data->net, 1, packet);
     } else {
         DEBUG("peer is null~");
     }
@@ -255,14 +469,13 @@ void net_controller_har_hook(int action, void *cb_data) {
     wtf *data = ctrl->data;
     serial ser;
     ENetPeer *peer = data->peer;
-    ENetHost *host = data->host;
     ENetPacket *packet;
     if (action == ACT_STOP && data->last_action == ACT_STOP) {
         data->last_action = -1;
         return;
     }
     if (action == ACT_FLUSH) {
-        enet_host_flush(host);
+        // The network thread flushes whenever it drains the send queue
         return;
     }
     data->last_action = action;
@@ -274,8 +487,7 @@ void net_controller_har_hook(int action, void *cb_data) {
         /*sprintf(buf, "k%d", action);*/
         packet = enet_packet_create(ser.data, ser.len, ENET_PACKET_FLAG_RELIABLE);
         serial_free(&ser);
-        enet_peer_send(peer, 1, packet);
-        /*enet_host_flush (host);*/
+        net_thread_send(&data->net, 1, packet);
     } else {
         DEBUG("peer is null~");
     }
@@ -293,11 +505,31 @@ void net_controller_create(controller *ctrl, ENetHost *host, ENetPeer *peer, int
     data->rttpos = 0;
     data->tick_offset = 0;
     data->rttfilled = 0;
+    data->batch_count = 0;
+    data->desynced = 0;
+    data->desync_dumps = 0;
+    data->digest_sent_tick = UINT32_MAX;
+    data->newest_tick = UINT32_MAX;
+    data->compared_tick = UINT32_MAX;
+    data->hb_cb = NULL;
+    data->hb_userdata = NULL;
+    digest_ring_clear(&data->local_digests);
+    digest_ring_clear(&data->remote_digests);
+    data->ms_per_tick = 10.0f;
+    data->rate_tick = -1;
+    data->rate_ms = 0;
     ctrl->data = data;
     ctrl->type = CTRL_TYPE_NETWORK;
     ctrl->tick_fun = &net_controller_tick;
     ctrl->update_fun = &net_controller_update;
     ctrl->controller_hook = &controller_hook;
+    ctrl->checksum_fun = &net_controller_checksum;
+
+    // From here on the host belongs to the network thread
+    if(net_thread_start(&data->net, host, peer, id)) {
+        PERROR("Netplay will not work without the network thread");
+        data->disconnected = 1;
+    }
 }
 
 
@@ -0,0 +1,142 @@
+#include <string.h>
+#include "controller/net_stats.h"
+#include "utils/log.h"
+
+#define LOSS_SCALE 65536.0f
+
+static void bucket_reset(net_stats_second *b, unsigned int second) {
+    for(int c = 0; c < NET_STATS_CHANNELS; c++) {
+        SDL_AtomicSet(&b->bytes_in[c], 0);
+        SDL_AtomicSet(&b->bytes_out[c], 0);
+        SDL_AtomicSet(&b->packets_in[c], 0);
+        SDL_AtomicSet(&b->packets_out[c], 0);
+    }
+    SDL_AtomicSet(&b->second, second);
+}
+
+// Returns the bucket for the current second, recycling the oldest one if needed
+static net_stats_second* bucket_now(net_stats *st) {
+    unsigned int second = (SDL_GetTicks() - st->start) / 1000;
+    net_stats_second *b = &st->history[second % NET_STATS_HISTORY];
+    if((unsigned int)SDL_AtomicGet(&b->second) != second) {
+        bucket_reset(b, second);
+    }
+    return b;
+}
+
+static int clamp_channel(int channel) {
+    if(channel < 0 || channel >= NET_STATS_CHANNELS) {
+        return NET_STATS_CHANNELS - 1;
+    }
+    return channel;
+}
+
+void net_stats_init(net_stats *st) {
+    memset(st, 0, sizeof(net_stats));
+    st->start = SDL_GetTicks();
+    for(int i = 0; i < NET_STATS_HISTORY; i++) {
+        // Mark as unused; no real second will match
+        bucket_reset(&st->history[i], 0xFFFFFFFF);
+    }
+}
+
+void net_stats_packet_in(net_stats *st, int channel, unsigned int bytes) {
+    channel = clamp_channel(channel);
+    net_stats_second *b = bucket_now(st);
+    SDL_AtomicAdd(&b->bytes_in[channel], bytes);
+    SDL_AtomicAdd(&b->packets_in[channel], 1);
+    SDL_AtomicAdd(&st->total_bytes_in[channel], bytes);
+    SDL_AtomicAdd(&st->total_packets_in[channel], 1);
+}
+
+void net_stats_packet_out(net_stats *st, int channel, unsigned int bytes) {
+    channel = clamp_channel(channel);
+    net_stats_second *b = bucket_now(st);
+    SDL_AtomicAdd(&b->bytes_out[channel], bytes);
+    SDL_AtomicAdd(&b->packets_out[channel], 1);
+    SDL_AtomicAdd(&st->total_bytes_out[channel], bytes);
+    SDL_AtomicAdd(&st->total_packets_out[channel], 1);
+}
+
+// ENet counts a reliable packet as lost each time it times out waiting for an
+// ack, and sends it again right then. That count is the number of resends.
+void net_stats_link(net_stats *st,
+                    unsigned int wire_in,
+                    unsigned int wire_out,
+                    unsigned int loss,
+                    unsigned int resend_epoch,
+                    unsigned int resends,
+                    unsigned int rtt) {
+    SDL_AtomicSet(&st->wire_bytes_in, wire_in);
+    SDL_AtomicSet(&st->wire_bytes_out, wire_out);
+    SDL_AtomicSet(&st->loss, loss);
+    // Only the network thread updates this, so reading and adding separately is fine
+    if(resend_epoch == st->resend_epoch && resends >= st->resend_window) {
+        SDL_AtomicAdd(&st->resends, resends - st->resend_window);
+    } else {
+        SDL_AtomicAdd(&st->resends, resends);
+    }
+    st->resend_window = resends;
+    st->resend_epoch = resend_epoch;
+    SDL_AtomicSet(&st->rtt, rtt);
+}
+
+void net_stats_sync(net_stats *st, int ticks_replayed) {
+    st->syncs++;
+    if(ticks_replayed > 0) {
+        st->ticks_replayed += ticks_replayed;
+        if((unsigned int)ticks_replayed > st->max_replayed) {
+            st->max_replayed = ticks_replayed;
+        }
+    }
+}
+
+void net_stats_get(net_stats *st, net_stats_view *view) {
+    memset(view, 0, sizeof(net_stats_view));
+    view->seconds = (SDL_GetTicks() - st->start) / 1000;
+
+    // Rates come from the last second that is complete
+    if(view->seconds > 0) {
+        unsigned int last = view->seconds - 1;
+        net_stats_second *b = &st->history[last % NET_STATS_HISTORY];
+        if((unsigned int)SDL_AtomicGet(&b->second) == last) {
+            for(int c = 0; c < NET_STATS_CHANNELS; c++) {
+                view->bytes_in[c] = SDL_AtomicGet(&b->bytes_in[c]);
+                view->bytes_out[c] = SDL_AtomicGet(&b->bytes_out[c]);
+                view->packets_in[c] = SDL_AtomicGet(&b->packets_in[c]);
+                view->packets_out[c] = SDL_AtomicGet(&b->packets_out[c]);
+            }
+        }
+    }
+    for(int c = 0; c < NET_STATS_CHANNELS; c++) {
+        view->total_bytes_in[c] = SDL_AtomicGet(&st->total_bytes_in[c]);
+        view->total_bytes_out[c] = SDL_AtomicGet(&st->total_bytes_out[c]);
+        view->total_packets_in[c] = SDL_AtomicGet(&st->total_packets_in[c]);
+        view->total_packets_out[c] = SDL_AtomicGet(&st->total_packets_out[c]);
+    }
+    view->wire_bytes_in = SDL_AtomicGet(&st->wire_bytes_in);
+    view->wire_bytes_out = SDL_AtomicGet(&st->wire_bytes_out);
+    view->loss = SDL_AtomicGet(&st->loss) * 100.0f / LOSS_SCALE;
+    view->resends = SDL_AtomicGet(&st->resends);
+    view->rtt = SDL_AtomicGet(&st->rtt);
+    view->syncs = st->syncs;
+    view->ticks_replayed = st->ticks_replayed;
+    view->max_replayed = st->max_replayed;
+}
+
+void net_stats_log_summary(net_stats *st) {
+    net_stats_view v;
+    net_stats_get(st, &v);
+    unsigned int secs = v.seconds > 0 ? v.seconds : 1;
+    INFO("Netplay summary: %u seconds, rtt %u ms, loss %.2f%%, %u resends",
+         v.seconds, v.rtt, v.loss, v.resends);
+    for(int c = 0; c < NET_STATS_CHANNELS; c++) {
+        INFO(" * channel %d: in %u packets / %u bytes (%u B/s), out %u packets / %u bytes (%u B/s)",
+             c,
+             v.total_packets_in[c], v.total_bytes_in[c], v.total_bytes_in[c] / secs,
+             v.total_packets_out[c], v.total_bytes_out[c], v.total_bytes_out[c] / secs);
+    }
+    INFO(" * on the wire: in %u bytes, out %u bytes", v.wire_bytes_in, v.wire_bytes_out);
+    INFO(" * %u sync corrections, %u ticks replayed (max %u)",
+         v.syncs, v.ticks_replayed, v.max_replayed);
+}
@@ -0,0 +1,255 @@
+#include "controller/net_thread.h"
+#include "controller/controller.h"
+#include "game/utils/serial.h"
+#include "utils/log.h"
+
+#define NET_QUEUE_SIZE 1024
+#define NET_SERVICE_TIMEOUT 1 // ms
+#define NET_DISCONNECT_TIMEOUT 3000 // ms
+#define NET_LINK_STATS_INTERVAL 250 // ms
+
+typedef struct net_out_t {
+    int channel;
+    ENetPacket *packet;
+} net_out;
+
+// Heartbeats from the peer are answered right here, so a slow frame on our side
+// doesn't show up in the round trip time the peer measures.
+static int net_thread_bounce_hb(net_thread *nt, ENetPacket *in) {
+    if(in->dataLength < 2 || in->data[0] != EVENT_TYPE_HB || in->data[1] == nt->id) {
+        return 0;
+    }
+    serial ser;
+    serial_create_from(&ser, (const char*)in->data, in->dataLength);
+    serial_write_int32(&ser, SDL_AtomicGet(&nt->ticks));
+    ENetPacket *packet = enet_packet_create(ser.data, serial_len(&ser), ENET_PACKET_FLAG_UNSEQUENCED);
+    serial_free(&ser);
+    net_stats_packet_out(&nt->stats, 0, packet->dataLength);
+    enet_peer_send(nt->peer, 0, packet);
+    enet_host_flush(nt->host);
+    return 1;
+}
+
+static void net_thread_push(net_thread *nt, net_msg *msg) {
+    // Stall the network side rather than lose packets if the game thread falls behind.
+    // net_thread_stop() posts once more, so that this can't wait forever.
+    SDL_SemWait(nt->inbound_space);
+    if(!SDL_AtomicGet(&nt->run) || spsc_queue_push(&nt->inbound, msg)) {
+        if(msg->packet) {
+            enet_packet_destroy(msg->packet);
+        }
+    }
+}
+
+static int net_thread_drain_outbound(net_thread *nt) {
+    net_out out;
+    int sent = 0;
+    while(spsc_queue_pop(&nt->outbound, &out) == 0) {
+        SDL_SemPost(nt->outbound_space);
+        if(nt->peer && !SDL_AtomicGet(&nt->disconnected)) {
+            net_stats_packet_out(&nt->stats, out.channel, out.packet->dataLength);
+            enet_peer_send(nt->peer, out.channel, out.packet);
+            sent++;
+        } else {
+            enet_packet_destroy(out.packet);
+        }
+    }
+    if(sent) {
+        enet_host_flush(nt->host);
+    }
+    return sent;
+}
+
+static void net_thread_disconnect(net_thread *nt) {
+    ENetEvent event;
+    if(SDL_AtomicGet(&nt->disconnected) || nt->peer == NULL) {
+        return;
+    }
+    DEBUG("closing connection");
+    enet_peer_disconnect(nt->peer, 0);
+    while(enet_host_service(nt->host, &event, NET_DISCONNECT_TIMEOUT) > 0) {
+        switch(event.type) {
+            case ENET_EVENT_TYPE_RECEIVE:
+                enet_packet_destroy(event.packet);
+                break;
+            case ENET_EVENT_TYPE_DISCONNECT:
+                DEBUG("got disconnect notice");
+                event.peer->data = NULL;
+                SDL_AtomicSet(&nt->disconnected, 1);
+                return;
+            default:
+                break;
+        }
+    }
+}
+
+// Copy the numbers ENet keeps about the link over to the stats
+static void net_thread_update_link(net_thread *nt) {
+    uint32_t now = SDL_GetTicks();
+    if(nt->peer == NULL || now - nt->last_link_update < NET_LINK_STATS_INTERVAL) {
+        return;
+    }
+    nt->last_link_update = now;
+    net_stats_link(&nt->stats,
+                   nt->host->totalReceivedData,
+                   nt->host->totalSentData,
+                   nt->peer->packetLoss,
+                   nt->peer->packetLossEpoch,
+                   nt->peer->packetsLost,
+                   nt->peer->roundTripTime);
+}
+
+static int net_thread_run(void *userdata) {
+    net_thread *nt = userdata;
+    ENetEvent event;
+    net_msg msg;
+
+    while(SDL_AtomicGet(&nt->run)) {
+        net_thread_drain_outbound(nt);
+        if(SDL_AtomicGet(&nt->disconnected)) {
+            SDL_Delay(NET_SERVICE_TIMEOUT);
+            continue;
+        }
+
+        // Wait a moment for the first event, then empty the host without blocking
+        int timeout = NET_SERVICE_TIMEOUT;
+        while(enet_host_service(nt->host, &event, timeout) > 0) {
+            timeout = 0;
+            switch(event.type) {
+                case ENET_EVENT_TYPE_RECEIVE:
+                    net_stats_packet_in(&nt->stats, event.channelID, event.packet->dataLength);
+                    if(net_thread_bounce_hb(nt, event.packet)) {
+                        enet_packet_destroy(event.packet);
+                        break;
+                    }
+                    msg.type = NET_MSG_RECEIVE;
+                    msg.channel = event.channelID;
+                    msg.arrival = SDL_GetTicks();
+                    msg.packet = event.packet;
+                    net_thread_push(nt, &msg);
+                    break;
+                case ENET_EVENT_TYPE_DISCONNECT:
+                    event.peer->data = NULL;
+                    SDL_AtomicSet(&nt->disconnected, 1);
+                    msg.type = NET_MSG_DISCONNECT;
+                    msg.channel = 0;
+                    msg.arrival = SDL_GetTicks();
+                    msg.packet = NULL;
+                    net_thread_push(nt, &msg);
+                    break;
+                default:
+                    break;
+            }
+            if(SDL_AtomicGet(&nt->disconnected)) {
+                break;
+            }
+        }
+        net_thread_update_link(nt);
+    }
+
+    // Whatever the game thread managed to queue goes out before we say goodbye
+    net_thread_drain_outbound(nt);
+    net_thread_disconnect(nt);
+    return 0;
+}
+
+int net_thread_start(net_thread *nt, ENetHost *host, ENetPeer *peer, int id) {
+    // send, poll and stop go by this, even when starting fails
+    nt->thread = NULL;
+    nt->host = host;
+    nt->peer = peer;
+    nt->id = id;
+    SDL_AtomicSet(&nt->run, 1);
+    SDL_AtomicSet(&nt->ticks, 0);
+    SDL_AtomicSet(&nt->disconnected, 0);
+    nt->last_link_update = 0;
+    net_stats_init(&nt->stats);
+    if(spsc_queue_create(&nt->inbound, sizeof(net_msg), NET_QUEUE_SIZE)) {
+        goto error_0;
+    }
+    if(spsc_queue_create(&nt->outbound, sizeof(net_out), NET_QUEUE_SIZE)) {
+        goto error_1;
+    }
+
+    // Free slots in each queue, so that a full queue can be waited on
+    nt->inbound_space = SDL_CreateSemaphore(nt->inbound.capacity);
+    if(nt->inbound_space == NULL) {
+        PERROR("Unable to create network queue semaphore: %s", SDL_GetError());
+        goto error_2;
+    }
+    nt->outbound_space = SDL_CreateSemaphore(nt->outbound.capacity);
+    if(nt->outbound_space == NULL) {
+        PERROR("Unable to create network queue semaphore: %s", SDL_GetError());
+        goto error_3;
+    }
+
+    nt->thread = SDL_CreateThread(net_thread_run, "openomf_net", nt);
+    if(nt->thread == NULL) {
+        PERROR("Unable to start network thread: %s", SDL_GetError());
+        goto error_4;
+    }
+    return 0;
+
+error_4:
+    SDL_DestroySemaphore(nt->outbound_space);
+error_3:
+    SDL_DestroySemaphore(nt->inbound_space);
+error_2:
+    spsc_queue_free(&nt->outbound);
+error_1:
+    spsc_queue_free(&nt->inbound);
+error_0:
+    return 1;
+}
+
+void net_thread_stop(net_thread *nt) {
+    net_msg msg;
+    net_out out;
+    if(nt->thread == NULL) {
+        return;
+    }
+    SDL_AtomicSet(&nt->run, 0);
+    SDL_SemPost(nt->inbound_space);
+    SDL_WaitThread(nt->thread, NULL);
+    nt->thread = NULL;
+
+    while(spsc_queue_pop(&nt->inbound, &msg) == 0) {
+        if(msg.packet) {
+            enet_packet_destroy(msg.packet);
+        }
+    }
+    while(spsc_queue_pop(&nt->outbound, &out) == 0) {
+        enet_packet_destroy(out.packet);
+    }
+    SDL_DestroySemaphore(nt->inbound_space);
+    SDL_DestroySemaphore(nt->outbound_space);
+    spsc_queue_free(&nt->inbound);
+    spsc_queue_free(&nt->outbound);
+}
+
+int net_thread_send(net_thread *nt, int channel, ENetPacket *packet) {
+    net_out out;
+    out.channel = channel;
+    out.packet = packet;
+    if(nt->thread == NULL) {
+        enet_packet_destroy(packet);
+        return 1;
+    }
+    // Only the network thread frees slots, and it runs until net_thread_stop()
+    SDL_SemWait(nt->outbound_space);
+    spsc_queue_push(&nt->outbound, &out);
+    return 0;
+}
+
+// Returns 0 if a message was received
+int net_thread_poll(net_thread *nt, net_msg *msg) {
+    if(nt->thread == NULL || spsc_queue_pop(&nt->inbound, msg)) {
+        return 1;
+    }
+    SDL_SemPost(nt->inbound_space);
+    return 0;
+}
+
+void net_thread_set_ticks(net_thread *nt, int ticks) {
+    SDL_AtomicSet(&nt->ticks, ticks);
+}
@@ -1,3 +1,4 @@
+#include <stdlib.h>
 #include "controller/rec_controller.h"
 #include "formats/rec.h"
 #include "formats/error.h"
@@ -8,21 +9,78 @@ typedef struct wtf_t {
     int last_tick;
     int last_action;
     int max_tick;
-    hashmap tick_lookup;
+    sd_rec_stream stream;
+    int streaming; // moves are still coming in from the file
+    int read_tick; // tick of the last move read from the file, for either player
+    sd_rec_move *moves; // this player's moves read so far, in tick order
+    unsigned int move_count;
+    unsigned int move_alloc;
+    unsigned int cursor; // first move that has not been played yet
 } wtf;
 
+// Held direction after a move, which is what gets repeated on the ticks in between
+static int rec_controller_direction(const sd_rec_move *move) {
+    int action = 0;
+    if (move->action & SD_ACT_UP) {
+        action |= ACT_UP;
+    }
+    if (move->action & SD_ACT_DOWN) {
+        action |= ACT_DOWN;
+    }
+    if (move->action & SD_ACT_LEFT) {
+        action |= ACT_LEFT;
+    }
+    if (move->action & SD_ACT_RIGHT) {
+        action |= ACT_RIGHT;
+    }
+    return action != 0 ? action : ACT_STOP;
+}
+
+// Reads moves off the file until every move up to and including the tick is known
+static void rec_controller_fill(wtf *data, int tick) {
+    sd_rec_move move;
+    while (data->streaming && data->read_tick <= tick) {
+        if (sd_rec_stream_next(&data->stream, &move) != SD_SUCCESS) {
+            sd_rec_stream_close(&data->stream);
+            data->streaming = 0;
+            break;
+        }
+        free(move.extra_data);
+        move.extra_data = NULL;
+        data->read_tick = move.tick;
+        if ((int)move.tick > data->max_tick) {
+            data->max_tick = move.tick;
+        }
+        if (move.player_id != data->id || move.lookup_id != 2) {
+            continue;
+        }
+        if (data->move_count >= data->move_alloc) {
+            data->move_alloc = data->move_alloc ? data->move_alloc * 2 : 64;
+            data->moves = realloc(data->moves, sizeof(sd_rec_move) * data->move_alloc);
+        }
+        data->moves[data->move_count++] = move;
+    }
+}
+
 int rec_controller_tick(controller *ctrl, int ticks, ctrl_event **ev) {
     wtf *data = ctrl->data;
-    sd_rec_move *move;
-    unsigned int len;
-    if (ticks > data->max_tick) {
+    sd_rec_move *move = NULL;
+    rec_controller_fill(data, ticks);
+    if (!data->streaming && ticks > data->max_tick) {
         DEBUG("closing controller");
         controller_close(ctrl, ev);
         return 0;
     }
 
     if (data->last_tick != ticks) {
-        if (hashmap_iget(&data->tick_lookup, ticks, (void**)(&move), &len) == 0) {
+        // Skip anything the tick counter went past; the last move on a tick wins
+        while (data->cursor < data->move_count && (int)data->moves[data->cursor].tick < ticks) {
+            data->cursor++;
+        }
+        while (data->cursor < data->move_count && (int)data->moves[data->cursor].tick == ticks) {
+            move = &data->moves[data->cursor++];
+        }
+        if (move != NULL) {
             if (move->action == SD_ACT_NONE) {
                 controller_cmd(ctrl, ACT_STOP, ev);
                 data->last_action = ACT_STOP;
@@ -33,28 +91,11 @@ int rec_controller_tick(controller *ctrl, int ticks, ctrl_event **ev) {
                     controller_cmd(ctrl, ACT_KICK, ev);
                 }
 
-                int action = 0;
-                if (move->action & SD_ACT_UP) {
-                    action |= ACT_UP;
-                }
-
-                if (move->action & SD_ACT_DOWN) {
-                    action |= ACT_DOWN;
-                }
-
-                if (move->action & SD_ACT_LEFT) {
-                    action |= ACT_LEFT;
-                }
-
-                if (move->action & SD_ACT_RIGHT) {
-                    action |= ACT_RIGHT;
-                }
-                if (action != 0) {
+                int action = rec_controller_direction(move);
+                if (action != ACT_STOP) {
                     controller_cmd(ctrl, action, ev);
-                    data->last_action = action;
-                } else {
-                    data->last_action = ACT_STOP;
                 }
+                data->last_action = action;
             }
         } else {
             controller_cmd(ctrl, data->last_action, ev);
@@ -64,19 +105,51 @@ int rec_controller_tick(controller *ctrl, int ticks, ctrl_event **ev) {
     return 0;
 }
 
-void rec_controller_create(controller *ctrl, int player, sd_rec_file *rec) {
-    wtf *data = malloc(sizeof(wtf));
+int rec_controller_create(controller *ctrl, int player, const char *file) {
+    wtf *data = calloc(1, sizeof(wtf));
+    sd_rec_file header;
+
+    // Each controller decodes its own copy of the stream, so the file is never held in memory whole
+    sd_rec_create(&header);
+    if (sd_rec_stream_open(&data->stream, &header, file) != SD_SUCCESS) {
+        sd_rec_free(&header);
+        free(data);
+        return 1;
+    }
+    sd_rec_free(&header);
+
+    data->id = player;
     data->last_action = ACT_STOP;
     data->last_tick = 0;
-    hashmap_create(&data->tick_lookup, 9);
-    for(unsigned int i = 0; i < rec->move_count; i++) {
-        if (rec->moves[i].player_id == player && rec->moves[i].lookup_id == 2) {
-            hashmap_iput(&data->tick_lookup, rec->moves[i].tick, &rec->moves[i], sizeof(sd_rec_move));
-        }
-    }
-    data->max_tick = rec->moves[rec->move_count-1].tick;
-    DEBUG("max tick is %d", data->last_tick);
+    data->max_tick = 0;
+    data->read_tick = -1;
+    data->streaming = 1;
     ctrl->data = data;
     ctrl->type = CTRL_TYPE_REC;
     ctrl->dyntick_fun = &rec_controller_tick;
+    return 0;
+}
+
+void rec_controller_seek(controller *ctrl, int tick) {
+    wtf *data = ctrl->data;
+    rec_controller_fill(data, tick);
+    data->last_action = ACT_STOP;
+    // Moves are sorted, so the held direction comes from the last one before the seek point
+    data->cursor = 0;
+    for(; data->cursor < data->move_count && (int)data->moves[data->cursor].tick < tick; data->cursor++) {
+        if (data->moves[data->cursor].action == SD_ACT_NONE) {
+            data->last_action = ACT_STOP;
+        } else {
+            data->last_action = rec_controller_direction(&data->moves[data->cursor]);
+        }
+    }
+    // The move at the seek point itself is handed out on the next tick call
+    data->last_tick = tick - 1;
+}
+
+void rec_controller_free(controller *ctrl) {
+    wtf *data = ctrl->data;
+    sd_rec_stream_close(&data->stream);
+    free(data->moves);
+    free(data);
 }
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <signal.h> // signal()
 #include <SDL.h>
 #include "engine.h"
@@ -7,28 +8,104 @@
 #include "audio/audio.h"
 #include "audio/music.h"
 #include "resources/sounds_loader.h"
+#include "resources/af_loader.h"
 #include "video/surface.h"
 #include "video/video.h"
+#include "video/tcache.h"
+#include "video/screenshot.h"
 #include "resources/languages.h"
 #include "game/game_state.h"
 #include "game/utils/settings.h"
 #include "game/utils/ticktimer.h"
+#include "game/utils/sim_clock.h"
 #include "game/gui/text_render.h"
 #include "console/console.h"
+#include "controller/controller.h"
+#include "resources/pathmanager.h"
+
+// How long one frame may spend simulating a fast replay before it is drawn
+#define SIM_FRAME_BUDGET_MS 15
+
+// Holding F1 down for longer than this takes a screenshot on every frame
+#define SCREENSHOT_BURST_DELAY_MS 400
 
 static int run = 0;
 static int start_timeout = 30;
 #ifndef STANDALONE_SERVER
 static int take_screenshot = 0;
+static int screenshot_held = 0;
+static unsigned int screenshot_pressed = 0;
+static unsigned int screenshot_count = 0;
+static unsigned int screenshot_dropped = 0;
 static int enable_screen_updates = 1;
 static char screenshot_filename[128];
 #endif
 
+#ifndef STANDALONE_SERVER
+// Replay speeds F7/F8 step through; 0 is as fast as possible
+static const float playback_speeds[] = {0.25f, 0.5f, 1.0f, 2.0f, 4.0f, 16.0f, 0.0f};
+#define PLAYBACK_SPEED_COUNT (sizeof(playback_speeds) / sizeof(playback_speeds[0]))
+
+static void engine_step_playback_speed(game_state *gs, int dir) {
+    float cur = game_state_get_playback_speed(gs);
+    int i = 2; // 1x, for speeds set from the console that aren't on the list
+    for(int k = 0; k < (int)PLAYBACK_SPEED_COUNT; k++) {
+        if(playback_speeds[k] == cur) {
+            i = k;
+        }
+    }
+    i += dir;
+    if(i < 0 || i >= (int)PLAYBACK_SPEED_COUNT) {
+        return;
+    }
+    if(game_state_set_playback_speed(gs, playback_speeds[i]) == 0) {
+        DEBUG("Playback speed %.2fx", playback_speeds[i]);
+    }
+}
+
+// The first shot reads the frame back right away. Shots of a burst come from frames
+// recorded as they were drawn, so that the GPU is not stalled on every frame; they
+// are composed on the screenshot workers, along with the PNG encoding.
+static void engine_screenshot(frame_capture *frame) {
+    image img;
+    int ret;
+    if(screenshot_count == 0) {
+        snprintf(screenshot_filename, 128, "screenshot_%u.png", screenshot_pressed);
+    } else {
+        snprintf(screenshot_filename, 128, "screenshot_%u_%03u.png", screenshot_pressed, screenshot_count);
+    }
+    if(frame != NULL) {
+        int w, h, fs, vsync;
+        video_get_state(&w, &h, &fs, &vsync);
+        ret = screenshot_save_frame(frame, w, h, screenshot_filename);
+    } else {
+        if(video_screenshot(&img)) {
+            image_free(&img);
+            return;
+        }
+        ret = screenshot_save(&img, screenshot_filename);
+    }
+    screenshot_count++;
+    if(ret) {
+        screenshot_dropped++;
+    }
+}
+
+static void engine_screenshot_release() {
+    screenshot_held = 0;
+    if(screenshot_count > 1) {
+        DEBUG("Took a burst of %u screenshots, %u of them dropped", screenshot_count, screenshot_dropped);
+    } else if(screenshot_dropped > 0) {
+        DEBUG("Screenshot queue is full, screenshot dropped");
+    }
+}
+#endif
+
 void exit_handler(int s) {
     run = 0;
 }
 
-int engine_init() {
+static int engine_init_common(int offscreen) {
 #ifndef STANDALONE_SERVER
     settings *setting = settings_get();
 
@@ -40,11 +117,19 @@ int engine_init() {
     char *scaler = setting->video.scaler;
     const char *audiosink = setting->sound.sink;
 
-    // Initialize everything.
-    if(video_init(w, h, fs, vsync, scaler, scale_factor)) {
+    // Initialize everything. Offscreen rendering is for exports and checks, which have no use for audio
+    if(offscreen) {
+        if(video_init_offscreen()) {
+            goto exit_0;
+        }
+        audiosink = NULL;
+    } else if(video_init(w, h, fs, vsync, scaler, scale_factor)) {
         goto exit_0;
+    } else {
+        screenshot_init();
     }
-    if(!audio_is_sink_available(audiosink)) {
+    tcache_set_budget((size_t)setting->video.texture_cache_mb * 1024 * 1024);
+    if(audiosink != NULL && !audio_is_sink_available(audiosink)) {
         const char *prev_sink = audiosink;
         audiosink = audio_get_first_sink_name();
         if(audiosink == NULL) {
@@ -58,8 +143,8 @@ int engine_init() {
     }
     sound_set_volume(setting->sound.sound_vol/10.0f);
     music_set_volume(setting->sound.music_vol/10.0f);
-#endif
 
+    // Sounds, texts and fonts are only ever played or shown, so the server skips them
     if(sounds_loader_init()) {
         goto exit_2;
     }
@@ -69,12 +154,16 @@ int engine_init() {
     if(fonts_init()) {
         goto exit_4;
     }
+#endif
     if(altpals_init()) {
         goto exit_5;
     }
     if(console_init()) {
         goto exit_6;
     }
+    if(af_cache_init()) {
+        goto exit_7;
+    }
 
     // Return successfully
     run = 1;
@@ -82,37 +171,75 @@ int engine_init() {
     return 0;
 
     // If something failed, close in correct order
+exit_7:
+    console_close();
 exit_6:
     altpals_close();
 exit_5:
+#ifndef STANDALONE_SERVER
     fonts_close();
 exit_4:
     lang_close();
 exit_3:
     sounds_loader_close();
-
 exit_2:
-#ifndef STANDALONE_SERVER
     audio_close();
-#endif
 
 exit_1:
-#ifndef STANDALONE_SERVER
+    screenshot_close();
     video_close();
-#endif
 
 exit_0:
+#endif
+    return 1;
+}
+
+int engine_init() {
+    return engine_init_common(0);
+}
+
+int engine_init_offscreen() {
+    return engine_init_common(1);
+}
+
+int engine_init_tool(int offscreen) {
+    if(pm_init() != 0) {
+        fprintf(stderr, "%s.\n", pm_get_errormsg());
+        goto error_0;
+    }
+    if(settings_init(pm_get_local_path(CONFIG_PATH))) {
+        fprintf(stderr, "Failed to initialize settings file.\n");
+        goto error_1;
+    }
+    settings_load();
+
+    // Controllers are replaced by the recording; don't let worker threads probe for gamepads
+    settings_get()->keys.ctrl_type1 = CTRL_TYPE_KEYBOARD;
+
+    if(engine_init_common(offscreen)) {
+        fprintf(stderr, "Failed to initialize game engine.\n");
+        goto error_2;
+    }
+    return 0;
+
+error_2:
+    settings_free();
+error_1:
+    pm_free();
+error_0:
     return 1;
 }
 
 void engine_run(engine_init_flags *init_flags) {
-    SDL_Event e;
     int visual_debugger = 0;
     int debugger_proceed = 0;
+#ifndef STANDALONE_SERVER
+    SDL_Event e;
     int debugger_render = 0;
 
     //if mouse_visible_ticks <= 0, hide mouse
     int mouse_visible_ticks = 1000;
+#endif
 
     INFO(" --- BEGIN GAME LOG ---");
 
@@ -155,6 +282,9 @@ void engine_run(engine_init_flags *init_flags) {
     int frame_start = SDL_GetTicks();
     int dynamic_wait = 0;
     int static_wait = 0;
+    int ui_wait = 0;
+    sim_clock clock;
+    sim_clock_init(&clock);
     while(run && game_state_is_running(gs)) {
 
 #ifndef STANDALONE_SERVER
@@ -167,8 +297,12 @@ void engine_run(engine_init_flags *init_flags) {
                     run = 0;
                     break;
                 case SDL_KEYDOWN:
-                    if(e.key.keysym.sym == SDLK_F1) {
+                    if(e.key.keysym.sym == SDLK_F1 && !e.key.repeat) {
                         take_screenshot = 1;
+                        screenshot_held = 1;
+                        screenshot_pressed = SDL_GetTicks();
+                        screenshot_count = 0;
+                        screenshot_dropped = 0;
                     }
                     if(e.key.keysym.sym == SDLK_F5) {
                         visual_debugger = !visual_debugger;
@@ -179,6 +313,17 @@ void engine_run(engine_init_flags *init_flags) {
                     if(e.key.keysym.sym == SDLK_F6) {
                         debugger_render = !debugger_render;
                     }
+                    if(e.key.keysym.sym == SDLK_F7) {
+                        engine_step_playback_speed(gs, -1);
+                    }
+                    if(e.key.keysym.sym == SDLK_F8) {
+                        engine_step_playback_speed(gs, 1);
+                    }
+                    break;
+                case SDL_KEYUP:
+                    if(e.key.keysym.sym == SDLK_F1 && screenshot_held) {
+                        engine_screenshot_release();
+                    }
                     break;
                 case SDL_MOUSEMOTION:
                     mouse_visible_ticks = 1000;
@@ -212,6 +357,14 @@ void engine_run(engine_init_flags *init_flags) {
                             break;
                     }
                     break;
+                case SDL_RENDER_TARGETS_RESET:
+                    DEBUG("RENDER TARGETS RESET");
+                    video_render_reset(0);
+                    break;
+                case SDL_RENDER_DEVICE_RESET:
+                    DEBUG("RENDER DEVICE RESET");
+                    video_render_reset(1);
+                    break;
             }
 
             // Console events
@@ -253,32 +406,51 @@ void engine_run(engine_init_flags *init_flags) {
         // Render scene
         int dt = (SDL_GetTicks() - frame_start);
         frame_start = SDL_GetTicks(); // Reset timer
+
+        // Replays may run the game clock faster or slower than the wall clock
+        float playback = game_state_get_playback_speed(gs);
         if(!visual_debugger) {
-            dynamic_wait += dt;
-            static_wait += dt;
+            sim_clock_start(&clock, dt, playback);
+            ui_wait += dt;
         } else if(debugger_proceed) {
-            dynamic_wait += 20;
-            static_wait += 20;
+            sim_clock_start(&clock, 20, 1.0f);
+            ui_wait += 20;
             debugger_proceed = 0;
+        } else {
+            sim_clock_start(&clock, 0, 1.0f);
         }
-        while(static_wait > 10) {
-            // Static tick for gamestate
-            game_state_static_tick(gs);
-
+        while(ui_wait > 10) {
             // Tick console
             console_tick();
 
             // Tick video (tcache)
             video_tick();
 
-            static_wait -= 10;
+            ui_wait -= 10;
         }
-        while(dynamic_wait > game_state_ms_per_dyntick(gs)) {
-            // Tick scene
-            game_state_dynamic_tick(gs);
 
-            // Handle waiting period leftover time
-            dynamic_wait -= game_state_ms_per_dyntick(gs);
+        // Off-speed replays stop when the frame budget is spent. Rendering then simply
+        // shows the latest tick, and the window keeps handling input at any speed.
+        // A paused visual debugger holds the game even at full speed.
+        unsigned int deadline = SDL_GetTicks() + SIM_FRAME_BUDGET_MS;
+        int step;
+        while(SDL_GetTicks() < deadline
+              && game_state_is_running(gs)
+              && (step = sim_clock_next(&clock, playback, !visual_debugger)) > 0) {
+            dynamic_wait += step;
+            static_wait += step;
+            while(static_wait > 10) {
+                // Static tick for gamestate
+                game_state_static_tick(gs);
+                static_wait -= 10;
+            }
+            while(dynamic_wait > game_state_ms_per_dyntick(gs)) {
+                // Tick scene
+                game_state_dynamic_tick(gs);
+
+                // Handle waiting period leftover time
+                dynamic_wait -= game_state_ms_per_dyntick(gs);
+            }
         }
 
 #ifndef STANDALONE_SERVER
@@ -290,6 +462,16 @@ void engine_run(engine_init_flags *init_flags) {
         // Do the actual video rendering jobs
         if(enable_screen_updates) {
 
+            // If screenshot requested, do it here. Keep going for as long as F1 is held down.
+            frame_capture *frame = NULL;
+            int burst = !take_screenshot && screenshot_held
+                        && SDL_GetTicks() - screenshot_pressed >= SCREENSHOT_BURST_DELAY_MS;
+            if(burst) {
+                frame = malloc(sizeof(frame_capture));
+                frame_capture_create(frame);
+                video_capture_frame(frame);
+            }
+
             video_render_prepare();
             game_state_render(gs);
             if(debugger_render) {
@@ -298,21 +480,8 @@ void engine_run(engine_init_flags *init_flags) {
             console_render();
             video_render_finish();
 
-            // If screenshot requested, do it here.
-            if(take_screenshot) {
-                image img;
-                int failed_screenshot = video_screenshot(&img);
-                if(!failed_screenshot) {
-                    snprintf(screenshot_filename, 128, "screenshot_%u.png", SDL_GetTicks());
-                    int scr_ret = image_write_png(&img, screenshot_filename);
-                    if(scr_ret) {
-                        PERROR("Screenshot write operation failed (%s)", screenshot_filename);
-                    } else {
-                        DEBUG("Got a screenshot: %s", screenshot_filename);
-                    }
-                }
-
-                image_free(&img);
+            if(take_screenshot || burst) {
+                engine_screenshot(frame);
                 take_screenshot = 0;
             }
         } else {
@@ -332,14 +501,22 @@ void engine_run(engine_init_flags *init_flags) {
 }
 
 void engine_close() {
+    af_cache_close();
     console_close();
     altpals_close();
+#ifndef STANDALONE_SERVER
     fonts_close();
     lang_close();
     sounds_loader_close();
-#ifndef STANDALONE_SERVER
     audio_close();
+    screenshot_close();
     video_close();
 #endif
     INFO("Engine deinit successful.");
 }
+
+void engine_close_tool() {
+    engine_close();
+    settings_free();
+    pm_free();
+}
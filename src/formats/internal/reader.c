@@ -4,19 +4,29 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <errno.h>
+#include <zlib.h>
 
 #include "formats/internal/reader.h"
 
+#define SD_INFLATE_CHUNK 4096
+
 struct sd_reader_t {
     FILE *handle;
     long filesize;
     int sd_errno;
+    z_stream *z;  // Set once reads go through inflate
+    char *zbuf;   // Compressed input waiting for inflate
+    long zstart;  // File position where the compressed data begins
+    int zend;     // Compressed stream ended, or was cut short
 };
 
 sd_reader* sd_reader_open(const char *file) {
     sd_reader *reader = malloc(sizeof(const sd_reader));
 
     reader->sd_errno = 0;
+    reader->z = NULL;
+    reader->zbuf = NULL;
+    reader->zend = 0;
 
     // Attempt to open file (note: Binary mode!)
     reader->handle = fopen(file, "rb");
@@ -55,10 +65,61 @@ int sd_reader_errno(const sd_reader *reader) {
 }
 
 void sd_reader_close(sd_reader *reader) {
+    if(reader->z) {
+        inflateEnd(reader->z);
+        free(reader->z);
+        free(reader->zbuf);
+    }
     fclose(reader->handle);
     free(reader);
 }
 
+int sd_reader_inflate(sd_reader *reader) {
+    if(reader->z) {
+        return 1;
+    }
+    reader->z = calloc(1, sizeof(z_stream));
+    if(inflateInit(reader->z) != Z_OK) {
+        free(reader->z);
+        reader->z = NULL;
+        return 0;
+    }
+    reader->zbuf = malloc(SD_INFLATE_CHUNK);
+    reader->zstart = ftell(reader->handle);
+    reader->zend = 0;
+    return 1;
+}
+
+// Fills buf from the compressed stream, pulling more of the file in as needed
+static int sd_inflate_buf(sd_reader *reader, char *buf, int len) {
+    z_stream *z = reader->z;
+    z->next_out = (Bytef*)buf;
+    z->avail_out = len;
+    while(z->avail_out > 0) {
+        if(reader->zend) {
+            return 0;
+        }
+        if(z->avail_in == 0) {
+            z->avail_in = fread(reader->zbuf, 1, SD_INFLATE_CHUNK, reader->handle);
+            z->next_in = (Bytef*)reader->zbuf;
+            if(z->avail_in == 0) {
+                // Compressed data was cut short; what came before it is still good
+                reader->zend = 1;
+                return 0;
+            }
+        }
+        int ret = inflate(z, Z_NO_FLUSH);
+        if(ret == Z_STREAM_END) {
+            reader->zend = 1;
+        } else if(ret != Z_OK && ret != Z_BUF_ERROR) {
+            reader->sd_errno = ret;
+            reader->zend = 1;
+            return 0;
+        }
+    }
+    return 1;
+}
+
 int sd_reader_set(sd_reader *reader, long offset) {
     if (fseek(reader->handle, offset, SEEK_SET) != 0) {
         reader->sd_errno = errno;
@@ -68,6 +129,9 @@ int sd_reader_set(sd_reader *reader, long offset) {
 }
 
 int sd_reader_ok(const sd_reader *reader) {
+    if(reader->z) {
+        return !reader->zend;
+    }
     if(feof(reader->handle)) {
         return 0;
     }
@@ -75,6 +139,9 @@ int sd_reader_ok(const sd_reader *reader) {
 }
 
 long sd_reader_pos(sd_reader *reader) {
+    if(reader->z) {
+        return reader->zstart + reader->z->total_out;
+    }
     long res = ftell(reader->handle);
     if (res == -1) {
         reader->sd_errno = errno;
@@ -83,6 +150,9 @@ long sd_reader_pos(sd_reader *reader) {
 }
 
 int sd_read_buf(sd_reader *reader, char *buf, int len) {
+    if(reader->z) {
+        return sd_inflate_buf(reader, buf, len);
+    }
     if(fread(buf, 1, len, reader->handle) != len) {
         reader->sd_errno = ferror(reader->handle);
         return 0;
@@ -91,6 +161,10 @@ int sd_read_buf(sd_reader *reader, char *buf, int len) {
 }
 
 int sd_peek_buf(sd_reader *reader, char *buf, int len) {
+    // Inflated data can't be rewound
+    if(reader->z) {
+        return 1;
+    }
     if(sd_read_buf(reader, buf, len)) {
         return 0;
     }
@@ -193,6 +267,17 @@ int sd_match(sd_reader *reader, char *buf, unsigned int nbytes) {
 }
 
 void sd_skip(sd_reader *reader, unsigned int nbytes) {
+    if(reader->z) {
+        char tmp[256];
+        while(nbytes > 0) {
+            unsigned int n = (nbytes < sizeof(tmp)) ? nbytes : sizeof(tmp);
+            if(!sd_inflate_buf(reader, tmp, n)) {
+                return;
+            }
+            nbytes -= n;
+        }
+        return;
+    }
     if (fseek(reader->handle, nbytes, SEEK_CUR) == -1) {
         reader->sd_errno = errno;
     }
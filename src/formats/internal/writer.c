@@ -4,12 +4,17 @@
 #include <stdarg.h>
 #include <stdint.h>
 #include <errno.h>
+#include <zlib.h>
 
 #include "formats/internal/writer.h"
 
+#define SD_DEFLATE_CHUNK 4096
+
 struct sd_writer_t {
     FILE *handle;
     int sd_errno;
+    z_stream *z; // Set once writes go through deflate
+    char *zbuf;  // Compressed output on its way to the file
 };
 
 sd_writer* sd_writer_open(const char *file) {
@@ -17,6 +22,8 @@ sd_writer* sd_writer_open(const char *file) {
 
     writer->handle = fopen(file, "wb");
     writer->sd_errno = 0;
+    writer->z = NULL;
+    writer->zbuf = NULL;
     if(!writer->handle) {
         free(writer);
         return 0;
@@ -29,7 +36,59 @@ int sd_writer_errno(const sd_writer *writer) {
     return writer->sd_errno;
 }
 
+// Runs deflate over whatever input is pending and writes out all of its output
+static int sd_deflate_run(sd_writer *writer, int flush) {
+    z_stream *z = writer->z;
+    do {
+        z->next_out = (Bytef*)writer->zbuf;
+        z->avail_out = SD_DEFLATE_CHUNK;
+        int ret = deflate(z, flush);
+        if(ret == Z_STREAM_ERROR) {
+            writer->sd_errno = ret;
+            return 0;
+        }
+        size_t have = SD_DEFLATE_CHUNK - z->avail_out;
+        if(have > 0 && fwrite(writer->zbuf, 1, have, writer->handle) != have) {
+            writer->sd_errno = ferror(writer->handle);
+            return 0;
+        }
+    } while(z->avail_out == 0);
+    return 1;
+}
+
+int sd_writer_deflate(sd_writer *writer) {
+    if(writer->z) {
+        return 1;
+    }
+    writer->z = calloc(1, sizeof(z_stream));
+    if(deflateInit(writer->z, Z_BEST_COMPRESSION) != Z_OK) {
+        free(writer->z);
+        writer->z = NULL;
+        return 0;
+    }
+    writer->zbuf = malloc(SD_DEFLATE_CHUNK);
+    return 1;
+}
+
+int sd_writer_flush(sd_writer *writer) {
+    // A sync flush makes everything so far decodable without ending the stream
+    if(writer->z && !sd_deflate_run(writer, Z_SYNC_FLUSH)) {
+        return 1;
+    }
+    if(fflush(writer->handle) != 0) {
+        writer->sd_errno = errno;
+        return 1;
+    }
+    return 0;
+}
+
 void sd_writer_close(sd_writer *writer) {
+    if(writer->z) {
+        sd_deflate_run(writer, Z_FINISH);
+        deflateEnd(writer->z);
+        free(writer->z);
+        free(writer->zbuf);
+    }
     fclose(writer->handle);
     free(writer);
 }
@@ -55,6 +114,11 @@ int sd_writer_seek_end(const sd_writer *writer, long offset) {
 }
 
 int sd_write_buf(sd_writer *writer, const char *buf, int len) {
+    if(writer->z) {
+        writer->z->next_in = (Bytef*)buf;
+        writer->z->avail_in = len;
+        return sd_deflate_run(writer, Z_NO_FLUSH);
+    }
     if(fwrite(buf, 1, len, writer->handle) != len) {
         writer->sd_errno = ferror(writer->handle);
         return 0;
@@ -106,8 +170,7 @@ void sd_write_fill(sd_writer *writer, char content, int len) {
     memset(buffer, content, 1024);
     while(left > 0) {
         now = (left > 1024) ? 1024 : left;
-        if (fwrite(buffer, 1, now, writer->handle) != now) {
-            writer->sd_errno = ferror(writer->handle);
+        if(!sd_write_buf(writer, buffer, now)) {
             return;
         }
         left -= now;
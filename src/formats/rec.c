@@ -21,6 +21,30 @@ int sd_rec_extra_len(int key) {
     return 0;
 }
 
+// Tick, lookup id and player id; the part of a move record that is always there
+#define SD_REC_MOVE_HEADER 6
+// Journal is flushed after this many moves, or this many ticks, whichever comes first
+#define SD_REC_FLUSH_MOVES 64
+#define SD_REC_FLUSH_TICKS 100
+
+// Makes room for at least count moves. Grows geometrically, so appends are amortised O(1).
+static int sd_rec_reserve(sd_rec_file *rec, unsigned int count) {
+    if(count <= rec->move_capacity) {
+        return SD_SUCCESS;
+    }
+    unsigned int capacity = rec->move_capacity ? rec->move_capacity : 64;
+    while(capacity < count) {
+        capacity *= 2;
+    }
+    sd_rec_move *moves = realloc(rec->moves, capacity * sizeof(sd_rec_move));
+    if(moves == NULL) {
+        return SD_OUT_OF_MEMORY;
+    }
+    rec->moves = moves;
+    rec->move_capacity = capacity;
+    return SD_SUCCESS;
+}
+
 int sd_rec_create(sd_rec_file *rec) {
     if(rec == NULL) {
         return SD_INVALID_INPUT;
@@ -43,27 +67,65 @@ void sd_rec_free(sd_rec_file *rec) {
     }
 }
 
-int sd_rec_load(sd_rec_file *rec, const char *file) {
-    int ret = SD_FILE_PARSE_ERROR;
-    if(rec == NULL || file == NULL) {
-        return SD_INVALID_INPUT;
-    }
+// Compressed files start with this, then a version byte. Real REC files start with
+// the pilot record, so this can't be mistaken for one.
+#define SD_REC_COMPRESSED_MAGIC "RECZ"
+#define SD_REC_COMPRESSED_VERSION 1
 
-    sd_reader *r = sd_reader_open(file);
-    if(!r) {
-        return SD_FILE_OPEN_ERROR;
+static void sd_rec_parse_action(sd_rec_move *move, uint8_t action) {
+    move->raw_action = action;
+    move->action = SD_ACT_NONE;
+    if(action & 1) {
+        move->action |= SD_ACT_PUNCH;
     }
+    if(action & 2) {
+        move->action |= SD_ACT_KICK;
+    }
+    switch(action & 0xF0) {
+        case 16: move->action |= SD_ACT_UP; break;
+        case 32: move->action |= (SD_ACT_UP|SD_ACT_RIGHT); break;
+        case 48: move->action |= SD_ACT_RIGHT; break;
+        case 64: move->action |= (SD_ACT_DOWN|SD_ACT_RIGHT); break;
+        case 80: move->action |= SD_ACT_DOWN; break;
+        case 96: move->action |= (SD_ACT_DOWN|SD_ACT_LEFT); break;
+        case 112: move->action |= SD_ACT_LEFT; break;
+        case 128: move->action |= (SD_ACT_UP|SD_ACT_LEFT); break;
+    }
+}
 
-    // Make sure we have at least this much data
-    if(sd_reader_filesize(r) < 1224) {
-        goto error_0;
+// Action key and the unknown bytes after it. Returns 0 if the data ran out.
+static int sd_rec_load_extra(sd_reader *r, sd_rec_move *move) {
+    int extra_length = sd_rec_extra_len(move->lookup_id);
+    if(extra_length <= 0) {
+        return 1;
     }
+    uint8_t action;
+    if(!sd_read_buf(r, (char*)&action, 1)) {
+        return 0;
+    }
+    sd_rec_parse_action(move, action);
+
+    // We already read the action key, so minus one.
+    int unknown_len = extra_length - 1;
+    if(unknown_len > 0) {
+        move->extra_data = malloc(unknown_len);
+        if(!sd_read_buf(r, move->extra_data, unknown_len)) {
+            free(move->extra_data);
+            move->extra_data = NULL;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int sd_rec_load_header(sd_reader *r, sd_rec_file *rec) {
+    int ret;
 
     // Read pilot data
     for(int i = 0; i < 2; i++) {
         // Read pilot data
         sd_pilot_create(&rec->pilots[i].info);
-        if((ret = sd_pilot_load(r, &rec->pilots[i].info)) != SD_SUCCESS) { goto error_0; }
+        if((ret = sd_pilot_load(r, &rec->pilots[i].info)) != SD_SUCCESS) { return ret; }
         rec->pilots[i].unknown_a = sd_read_ubyte(r);
         rec->pilots[i].unknown_b = sd_read_uword(r);
         sd_palette_create(&rec->pilots[i].pal);
@@ -73,7 +135,7 @@ int sd_rec_load(sd_rec_file *rec, const char *file) {
         if(rec->pilots[i].has_photo) {
             ret = sd_sprite_load(r, &rec->pilots[i].photo);
             if (ret != SD_SUCCESS) {
-                goto error_0;
+                return ret;
             }
         }
     }
@@ -106,58 +168,42 @@ int sd_rec_load(sd_rec_file *rec, const char *file) {
     rec->unknown_l =  (in >> 22) & 0x03; // 00000000 11000000 00000000 00000000 (2)
     rec->hyper_mode = (in >> 24) & 0x01; // 00000001 00000000 00000000 00000000 (1)
     rec->unknown_m = sd_read_byte(r);
+    return SD_SUCCESS;
+}
 
-    // Allocate enough space for the record blocks
-    // This will be reduced later when we know the ACTUAL count
-    size_t rsize = sd_reader_filesize(r) - sd_reader_pos(r);
-    rec->move_count = rsize / 7;
-    rec->moves = calloc(rec->move_count, sizeof(sd_rec_move));
+int sd_rec_stream_open(sd_rec_stream *stream, sd_rec_file *rec, const char *file) {
+    int ret = SD_FILE_PARSE_ERROR;
+    if(stream == NULL || rec == NULL || file == NULL) {
+        return SD_INVALID_INPUT;
+    }
+    memset(stream, 0, sizeof(sd_rec_stream));
 
-    // Read blocks
-    for(int i = 0; i < rec->move_count; i++) {
-        rec->moves[i].tick = sd_read_udword(r);
-        rec->moves[i].lookup_id = sd_read_ubyte(r);
-        rec->moves[i].player_id = sd_read_ubyte(r);
-        int extra_length = sd_rec_extra_len(rec->moves[i].lookup_id);
-        if(extra_length > 0) {
-            uint8_t action = sd_read_ubyte(r);
-            rec->moves[i].raw_action = action;
-
-            // Parse real action key
-            rec->moves[i].action = SD_ACT_NONE;
-            if(action & 1) {
-                rec->moves[i].action |= SD_ACT_PUNCH;
-            }
-            if(action & 2) {
-                rec->moves[i].action |= SD_ACT_KICK;
-            }
-            switch(action & 0xF0) {
-                case 16: rec->moves[i].action |= SD_ACT_UP; break;
-                case 32: rec->moves[i].action |= (SD_ACT_UP|SD_ACT_RIGHT); break;
-                case 48: rec->moves[i].action |= SD_ACT_RIGHT; break;
-                case 64: rec->moves[i].action |= (SD_ACT_DOWN|SD_ACT_RIGHT); break;
-                case 80: rec->moves[i].action |= SD_ACT_DOWN; break;
-                case 96: rec->moves[i].action |= (SD_ACT_DOWN|SD_ACT_LEFT); break;
-                case 112: rec->moves[i].action |= SD_ACT_LEFT; break;
-                case 128: rec->moves[i].action |= (SD_ACT_UP|SD_ACT_LEFT); break;
-            }
+    sd_reader *r = sd_reader_open(file);
+    if(!r) {
+        return SD_FILE_OPEN_ERROR;
+    }
 
-            // We already read the action key, so minus one.
-            int unknown_len = extra_length - 1;
-            if(unknown_len > 0) {
-                rec->moves[i].extra_data = malloc(unknown_len);
-                sd_read_buf(r, rec->moves[i].extra_data, unknown_len);
-                rec->move_count--;
-            }
+    // Compressed files have a magic; everything after it goes through inflate
+    char magic[5];
+    if(sd_read_buf(r, magic, 5)
+        && memcmp(magic, SD_REC_COMPRESSED_MAGIC, 4) == 0
+        && magic[4] == SD_REC_COMPRESSED_VERSION) {
+        if(!sd_reader_inflate(r)) {
+            goto error_0;
+        }
+        stream->compressed = 1;
+    } else {
+        // Make sure we have at least this much data
+        if(sd_reader_filesize(r) < 1224) {
+            goto error_0;
         }
+        sd_reader_set(r, 0);
     }
 
-    // Okay, not reduce the allocated memory to match what we actually need
-    // Realloc should keep our old data intact
-    rec->moves = realloc(rec->moves, rec->move_count * sizeof(sd_rec_move));
-
-    // Close & return
-    sd_reader_close(r);
+    if((ret = sd_rec_load_header(r, rec)) != SD_SUCCESS) {
+        goto error_0;
+    }
+    stream->r = r;
     return SD_SUCCESS;
 
 error_0:
@@ -165,17 +211,94 @@ error_0:
     return ret;
 }
 
-int sd_rec_save(sd_rec_file *rec, const char *file) {
-    sd_writer *w;
+// Plain moves are a fixed 6 byte header and the extra data. A file that was cut
+// short may end in a partial record; that one is dropped.
+static int sd_rec_stream_next_plain(sd_rec_stream *stream, sd_rec_move *move) {
+    sd_reader *r = stream->r;
+    long left = sd_reader_filesize(r) - sd_reader_pos(r);
+    if(left < SD_REC_MOVE_HEADER) {
+        return SD_FILE_PARSE_ERROR;
+    }
+    move->tick = sd_read_udword(r);
+    move->lookup_id = sd_read_ubyte(r);
+    move->player_id = sd_read_ubyte(r);
+    if(left - SD_REC_MOVE_HEADER < sd_rec_extra_len(move->lookup_id)) {
+        return SD_FILE_PARSE_ERROR;
+    }
+    return sd_rec_load_extra(r, move) ? SD_SUCCESS : SD_FILE_PARSE_ERROR;
+}
 
-    if(rec == NULL || file == NULL) {
+// Compressed moves store the tick as a varint delta from the previous move, and
+// the lookup and player ids packed in one byte.
+static int sd_rec_stream_next_packed(sd_rec_stream *stream, sd_rec_move *move) {
+    sd_reader *r = stream->r;
+    uint32_t delta = 0;
+    uint8_t b;
+    for(int shift = 0; ; shift += 7) {
+        if(shift > 28 || !sd_read_buf(r, (char*)&b, 1)) {
+            return SD_FILE_PARSE_ERROR;
+        }
+        delta |= (uint32_t)(b & 0x7F) << shift;
+        if(!(b & 0x80)) {
+            break;
+        }
+    }
+    if(!sd_read_buf(r, (char*)&b, 1)) {
+        return SD_FILE_PARSE_ERROR;
+    }
+    move->tick = stream->last_tick + delta;
+    move->lookup_id = b & 0x7F;
+    move->player_id = b >> 7;
+    if(!sd_rec_load_extra(r, move)) {
+        return SD_FILE_PARSE_ERROR;
+    }
+    stream->last_tick = move->tick;
+    return SD_SUCCESS;
+}
+
+int sd_rec_stream_next(sd_rec_stream *stream, sd_rec_move *move) {
+    if(stream == NULL || stream->r == NULL || move == NULL) {
         return SD_INVALID_INPUT;
     }
+    memset(move, 0, sizeof(sd_rec_move));
+    if(stream->compressed) {
+        return sd_rec_stream_next_packed(stream, move);
+    }
+    return sd_rec_stream_next_plain(stream, move);
+}
 
-    if(!(w = sd_writer_open(file))) {
-        return SD_FILE_OPEN_ERROR;
+void sd_rec_stream_close(sd_rec_stream *stream) {
+    if(stream == NULL || stream->r == NULL) {
+        return;
+    }
+    sd_reader_close(stream->r);
+    stream->r = NULL;
+}
+
+int sd_rec_load(sd_rec_file *rec, const char *file) {
+    sd_rec_stream stream;
+    sd_rec_move move;
+    int ret;
+
+    if((ret = sd_rec_stream_open(&stream, rec, file)) != SD_SUCCESS) {
+        return ret;
+    }
+
+    // Read move records until the data runs out
+    while(sd_rec_stream_next(&stream, &move) == SD_SUCCESS) {
+        if((ret = sd_rec_reserve(rec, rec->move_count + 1)) != SD_SUCCESS) {
+            free(move.extra_data);
+            sd_rec_stream_close(&stream);
+            return ret;
+        }
+        rec->moves[rec->move_count++] = move;
     }
 
+    sd_rec_stream_close(&stream);
+    return SD_SUCCESS;
+}
+
+static void sd_rec_save_header(sd_writer *w, const sd_rec_file *rec) {
     // Write pilots, palettes, etc.
     for(int i = 0; i < 2; i++) {
         sd_pilot_save(w, &rec->pilots[i].info);
@@ -217,40 +340,104 @@ int sd_rec_save(sd_rec_file *rec, const char *file) {
     out |= (rec->hyper_mode & 0x1) << 24;
     sd_write_udword(w, out);
     sd_write_byte(w, rec->unknown_m);
+}
 
-    // Move records
+static void sd_rec_save_extra(sd_writer *w, const sd_rec_move *move) {
+    int extra_length = sd_rec_extra_len(move->lookup_id);
+    if(extra_length > 0) {
+        // Write action information
+        uint8_t raw_action = 0;
+        switch(move->action & SD_MOVE_MASK) {
+            case (SD_ACT_UP): raw_action = 16; break;
+            case (SD_ACT_UP|SD_ACT_RIGHT): raw_action = 32; break;
+            case (SD_ACT_RIGHT): raw_action = 48; break;
+            case (SD_ACT_DOWN|SD_ACT_RIGHT): raw_action = 64; break;
+            case (SD_ACT_DOWN): raw_action = 80; break;
+            case (SD_ACT_DOWN|SD_ACT_LEFT): raw_action = 96; break;
+            case (SD_ACT_LEFT): raw_action = 112; break;
+            case (SD_ACT_UP|SD_ACT_LEFT): raw_action = 128; break;
+        }
+        if(move->action & SD_ACT_PUNCH)
+            raw_action |= 1;
+        if(move->action & SD_ACT_KICK)
+            raw_action |= 2;
+        sd_write_ubyte(w, raw_action);
+
+        // If there is more extra data, write it
+        int unknown_len = extra_length - 1;
+        if(unknown_len > 0) {
+            sd_write_buf(w, move->extra_data, unknown_len);
+        }
+    }
+}
+
+static void sd_rec_save_move(sd_writer *w, const sd_rec_move *move) {
+    sd_write_udword(w, move->tick);
+    sd_write_ubyte(w, move->lookup_id);
+    sd_write_ubyte(w, move->player_id);
+    sd_rec_save_extra(w, move);
+}
+
+static void sd_rec_save_packed_move(sd_writer *w, const sd_rec_move *move, uint32_t last_tick) {
+    // Moves are in tick order, so the delta is small and usually fits one byte
+    uint32_t delta = move->tick - last_tick;
+    while(delta >= 0x80) {
+        sd_write_ubyte(w, (delta & 0x7F) | 0x80);
+        delta >>= 7;
+    }
+    sd_write_ubyte(w, delta);
+    sd_write_ubyte(w, (move->lookup_id & 0x7F) | ((move->player_id & 1) << 7));
+    sd_rec_save_extra(w, move);
+}
+
+int sd_rec_save(sd_rec_file *rec, const char *file) {
+    sd_writer *w;
+
+    if(rec == NULL || file == NULL) {
+        return SD_INVALID_INPUT;
+    }
+
+    if(!(w = sd_writer_open(file))) {
+        return SD_FILE_OPEN_ERROR;
+    }
+
+    sd_rec_save_header(w, rec);
     for(int i = 0; i < rec->move_count; i++) {
-        sd_write_udword(w, rec->moves[i].tick);
-        sd_write_ubyte(w, rec->moves[i].lookup_id);
-        sd_write_ubyte(w, rec->moves[i].player_id);
-
-        int extra_length = sd_rec_extra_len(rec->moves[i].lookup_id);
-        if(extra_length > 0) {
-            // Write action information
-            uint8_t raw_action = 0;
-            switch(rec->moves[i].action & SD_MOVE_MASK) {
-                case (SD_ACT_UP): raw_action = 16; break;
-                case (SD_ACT_UP|SD_ACT_RIGHT): raw_action = 32; break;
-                case (SD_ACT_RIGHT): raw_action = 48; break;
-                case (SD_ACT_DOWN|SD_ACT_RIGHT): raw_action = 64; break;
-                case (SD_ACT_DOWN): raw_action = 80; break;
-                case (SD_ACT_DOWN|SD_ACT_LEFT): raw_action = 96; break;
-                case (SD_ACT_LEFT): raw_action = 112; break;
-                case (SD_ACT_UP|SD_ACT_LEFT): raw_action = 128; break;
-            }
-            if(rec->moves[i].action & SD_ACT_PUNCH)
-                raw_action |= 1;
-            if(rec->moves[i].action & SD_ACT_KICK)
-                raw_action |= 2;
-            sd_write_ubyte(w, raw_action);
-
-            // If there is more extra data, write it
-            int unknown_len = extra_length - 1;
-            if(unknown_len > 0) {
-                sd_write_buf(w, rec->moves[i].extra_data, unknown_len);
-            }
+        sd_rec_save_move(w, &rec->moves[i]);
+    }
+
+    sd_writer_close(w);
+    return SD_SUCCESS;
+}
+
+int sd_rec_save_compressed(sd_rec_file *rec, const char *file) {
+    sd_writer *w;
+
+    if(rec == NULL || file == NULL) {
+        return SD_INVALID_INPUT;
+    }
+    for(int i = 1; i < rec->move_count; i++) {
+        if(rec->moves[i].tick < rec->moves[i-1].tick) {
+            return SD_INVALID_INPUT;
         }
-   }
+    }
+
+    if(!(w = sd_writer_open(file))) {
+        return SD_FILE_OPEN_ERROR;
+    }
+
+    sd_write_buf(w, SD_REC_COMPRESSED_MAGIC, 4);
+    sd_write_ubyte(w, SD_REC_COMPRESSED_VERSION);
+    if(!sd_writer_deflate(w)) {
+        sd_writer_close(w);
+        return SD_OUT_OF_MEMORY;
+    }
+    sd_rec_save_header(w, rec);
+    uint32_t last_tick = 0;
+    for(int i = 0; i < rec->move_count; i++) {
+        sd_rec_save_packed_move(w, &rec->moves[i], last_tick);
+        last_tick = rec->moves[i].tick;
+    }
 
     sd_writer_close(w);
     return SD_SUCCESS;
@@ -269,13 +456,8 @@ int sd_rec_delete_action(sd_rec_file *rec, unsigned int number) {
             (rec->move_count - number - 1) * sizeof(sd_rec_move));
     }
 
-    // Resize to save memory
+    // The allocation is kept around for later inserts
     rec->move_count--;
-    rec->moves = realloc(rec->moves, rec->move_count * sizeof(sd_rec_move));
-
-    if(rec->moves == NULL) {
-        return SD_OUT_OF_MEMORY;
-    }
     return SD_SUCCESS;
 }
 
@@ -288,9 +470,9 @@ int sd_rec_insert_action(sd_rec_file *rec, unsigned int number, const sd_rec_mov
     }
 
     // Resize
-    rec->moves = realloc(rec->moves, (rec->move_count+1) * sizeof(sd_rec_move));
-    if(rec->moves == NULL) {
-        return SD_OUT_OF_MEMORY;
+    int ret = sd_rec_reserve(rec, rec->move_count + 1);
+    if(ret != SD_SUCCESS) {
+        return ret;
     }
 
     // Only move if we are inserting, not appending
@@ -310,3 +492,52 @@ int sd_rec_insert_action(sd_rec_file *rec, unsigned int number, const sd_rec_mov
     rec->move_count++;
     return SD_SUCCESS;
 }
+
+int sd_rec_journal_open(sd_rec_journal *journal, const sd_rec_file *rec, const char *file) {
+    if(journal == NULL || rec == NULL || file == NULL) {
+        return SD_INVALID_INPUT;
+    }
+    memset(journal, 0, sizeof(sd_rec_journal));
+    if(!(journal->w = sd_writer_open(file))) {
+        return SD_FILE_OPEN_ERROR;
+    }
+
+    // Header goes out right away, so the file is a valid REC from the start
+    sd_rec_save_header(journal->w, rec);
+    return sd_rec_journal_flush(journal);
+}
+
+int sd_rec_journal_append(sd_rec_journal *journal, const sd_rec_move *move) {
+    if(journal == NULL || journal->w == NULL || move == NULL) {
+        return SD_INVALID_INPUT;
+    }
+    sd_rec_save_move(journal->w, move);
+    journal->move_count++;
+    journal->unflushed++;
+    if(journal->unflushed >= SD_REC_FLUSH_MOVES || move->tick - journal->flush_tick >= SD_REC_FLUSH_TICKS) {
+        journal->flush_tick = move->tick;
+        return sd_rec_journal_flush(journal);
+    }
+    return SD_SUCCESS;
+}
+
+int sd_rec_journal_flush(sd_rec_journal *journal) {
+    if(journal == NULL || journal->w == NULL) {
+        return SD_INVALID_INPUT;
+    }
+    journal->unflushed = 0;
+    if(sd_writer_flush(journal->w) != 0) {
+        return SD_FILE_WRITE_ERROR;
+    }
+    return SD_SUCCESS;
+}
+
+int sd_rec_journal_close(sd_rec_journal *journal) {
+    if(journal == NULL || journal->w == NULL) {
+        return SD_INVALID_INPUT;
+    }
+    int ret = sd_rec_journal_flush(journal);
+    sd_writer_close(journal->w);
+    journal->w = NULL;
+    return ret;
+}
@@ -73,8 +73,8 @@ const char *scene_type_names[] = {
     "SCENE_SCOREBOARD",
 };
 
-int rand_arena() {
-   return SCENE_ARENA0 + rand_int(5);
+int rand_arena(struct random_t *rand) {
+   return SCENE_ARENA0 + random_int(rand, 5);
 }
 
 const char* ai_difficulty_get_name(unsigned int id) {
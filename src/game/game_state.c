@@ -6,7 +6,11 @@
 #include "controller/rec_controller.h"
 #include "utils/log.h"
 #include "utils/miscmath.h"
+#include "audio/sound.h"
+#include "audio/music.h"
 #include "game/utils/serial.h"
+#include "game/utils/checksum.h"
+#include "game/utils/keyframes.h"
 #include "resources/ids.h"
 #include "resources/pilots.h"
 #include "console/console.h"
@@ -41,7 +45,8 @@ enum {
     TICK_STATIC,
 };
 
-void _setup_rec_controller(game_state *gs, int player_id, sd_rec_file *rec);
+int _setup_rec_controller(game_state *gs, int player_id, const char *file);
+static void game_state_restore(game_state *gs, serial *ser);
 
 // How long the scene waits after order to move to another scene
 // Used for crossfades
@@ -54,6 +59,21 @@ typedef struct {
     object *obj;
 } render_obj;
 
+static long game_state_file_size(const char *filename) {
+    FILE *f = fopen(filename, "rb");
+    if(f == NULL) {
+        return 0;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+static void game_state_keyframe_path(game_state *gs, char *buf, size_t len) {
+    snprintf(buf, len, "%s.idx", gs->init_flags->rec_file);
+}
+
 int game_state_create(game_state *gs, engine_init_flags *init_flags) {
     gs->run = 1;
     gs->paused = 0;
@@ -63,9 +83,14 @@ int game_state_create(game_state *gs, engine_init_flags *init_flags) {
     gs->next_requires_refresh = 0;
     gs->net_mode = init_flags->net_mode;
     gs->speed = settings_get()->gameplay.speed + 5;
+    gs->playback_speed = 1.0f;
     gs->init_flags = init_flags;
+    gs->keyframes = NULL;
     vector_create(&gs->objects, sizeof(render_obj));
 
+    // Every game state runs its own RNG, so several of them can share a process
+    random_seed(&gs->rand, init_flags->seed);
+
     // For screen shake
     gs->screen_shake_horizontal = 0;
     gs->screen_shake_vertical = 0;
@@ -88,18 +113,24 @@ int game_state_create(game_state *gs, engine_init_flags *init_flags) {
     reconfigure_controller(gs);
     int nscene;
     if (strlen(init_flags->rec_file) > 0 && init_flags->record == 0) {
+        // Only the header is needed here; the controllers stream the moves themselves
         sd_rec_file rec;
+        sd_rec_stream stream;
         sd_rec_create(&rec);
-        int ret = sd_rec_load(&rec, init_flags->rec_file);
+        int ret = sd_rec_stream_open(&stream, &rec, init_flags->rec_file);
         if(ret != SD_SUCCESS) {
             PERROR("Unable to load recording %s.", init_flags->rec_file);
+            sd_rec_free(&rec);
             goto error_0;
         }
+        sd_rec_stream_close(&stream);
 
         nscene = SCENE_ARENA0 + rec.arena_id;
         DEBUG("playing recording file %s", init_flags->rec_file);
+        tcache_set_scene(nscene);
         if(scene_create(gs->sc, gs, nscene)) {
             PERROR("Error while loading scene %d.", nscene);
+            sd_rec_free(&rec);
             goto error_0;
         }
 
@@ -112,16 +143,33 @@ int game_state_create(game_state *gs, engine_init_flags *init_flags) {
             gs->players[i]->pilot_id = rec.pilots[i].info.pilot_id;
         }
 
+        sd_rec_free(&rec);
+
         // XXX use playback controller once it exista
-        _setup_rec_controller(gs, 0, &rec);
-        _setup_rec_controller(gs, 1, &rec);
+        if(_setup_rec_controller(gs, 0, init_flags->rec_file)
+            || _setup_rec_controller(gs, 1, init_flags->rec_file)) {
+            PERROR("Unable to open recording %s for playback.", init_flags->rec_file);
+            goto error_1;
+        }
         if(arena_create(gs->sc)) {
             PERROR("Error while creating arena scene.");
             goto error_1;
         }
+
+        // Keyframes are built as we go. A kept index from an earlier playback makes seeking instant.
+        if(!init_flags->headless) {
+            gs->keyframes = malloc(sizeof(keyframe_index));
+            keyframe_index_create(gs->keyframes, game_state_file_size(init_flags->rec_file));
+            if(init_flags->seek_index) {
+                char idx_path[300];
+                game_state_keyframe_path(gs, idx_path, sizeof(idx_path));
+                keyframe_index_load(gs->keyframes, idx_path);
+            }
+        }
     } else {
         // Select correct starting scene and load resources
          nscene = (init_flags->net_mode == NET_MODE_NONE ? SCENE_OPENOMF : SCENE_MENU);
+        tcache_set_scene(nscene);
         if(scene_create(gs->sc, gs, nscene)) {
             PERROR("Error while loading scene %d.", nscene);
             goto error_0;
@@ -151,7 +199,9 @@ int game_state_create(game_state *gs, engine_init_flags *init_flags) {
 error_1:
     scene_free(gs->sc);
 error_0:
+    // Left so that game_state_free() can still release the rest
     free(gs->sc);
+    gs->sc = NULL;
     vector_free(&gs->objects);
     return 1;
 }
@@ -241,6 +291,15 @@ void game_state_del_object(game_state *gs, object *target) {
     }
 }
 
+void game_state_get_objects(game_state *gs, vector *objs) {
+    iterator it;
+    render_obj *robj;
+    vector_iter_begin(&gs->objects, &it);
+    while((robj = iter_next(&it)) != NULL) {
+        vector_append(objs, &robj->obj);
+    }
+}
+
 void game_state_get_projectiles(game_state *gs, vector *obj_proj) {
     iterator it;
     render_obj *robj;
@@ -289,6 +348,33 @@ void game_state_set_paused(game_state *gs, unsigned int paused) {
     gs->paused = paused;
 }
 
+float game_state_get_playback_speed(game_state *gs) {
+    return gs->playback_speed;
+}
+
+static void game_state_apply_playback_speed(game_state *gs, float speed) {
+    gs->playback_speed = speed;
+
+    // Effects follow the clock in pitch while they can; music only makes sense at 1x
+    sound_set_rate(speed);
+    music_set_volume(speed == 1.0f ? settings_get()->sound.music_vol/10.0f : 0.0f);
+}
+
+// Sound rate and music volume are global, so they must not outlive the replay or scene
+static void game_state_reset_playback_speed(game_state *gs) {
+    if(gs->playback_speed != 1.0f) {
+        game_state_apply_playback_speed(gs, 1.0f);
+    }
+}
+
+int game_state_set_playback_speed(game_state *gs, float speed) {
+    if(strlen(gs->init_flags->rec_file) == 0 || gs->init_flags->record || speed < 0.0f) {
+        return 1;
+    }
+    game_state_apply_playback_speed(gs, speed);
+    return 0;
+}
+
 // Return 0 if event was handled here
 int game_state_handle_event(game_state *gs, SDL_Event *event) {
     if(scene_event(gs->sc, event) == 0) {
@@ -402,9 +488,11 @@ int game_load_new(game_state *gs, int scene_id) {
     // Free old scene
     scene_free(gs->sc);
     free(gs->sc);
+    game_state_reset_playback_speed(gs);
 
     // Clear up old video cache objects
     tcache_clear();
+    tcache_set_scene(scene_id);
 
     // Remove old objects
     render_obj *robj;
@@ -512,6 +600,7 @@ error_1:
     scene_free(gs->sc);
 error_0:
     free(gs->sc);
+    gs->sc = NULL;
     return 1;
 }
 
@@ -628,6 +717,123 @@ void game_state_static_tick(game_state *gs) {
     game_state_call_tick(gs, TICK_STATIC);
 }
 
+void game_state_checksum(game_state *gs, state_digest *d) {
+    state_digest_begin(d, gs->tick, random_get_seed(&gs->rand), gs->paused);
+    for(int i = 0; i < 2; i++) {
+        game_player *gp = game_state_get_player(gs, i);
+        state_digest_har(d, i, gp->har);
+        state_digest_score(d, i, game_player_get_score(gp));
+    }
+
+    iterator it;
+    render_obj *robj;
+    vector_iter_begin(&gs->objects, &it);
+    while((robj = iter_next(&it)) != NULL) {
+        if(robj->obj->group == GROUP_PROJECTILE) {
+            state_digest_projectile(d, robj->obj);
+        }
+    }
+    state_digest_finish(d);
+}
+
+// Hand the state digest of the current tick to any controller that wants it (netplay)
+static void game_state_record_checksum(game_state *gs) {
+    if(gs->sc == NULL || !is_arena(gs->sc->id)) {
+        return;
+    }
+    int wanted = 0;
+    for(int i = 0; i < game_state_num_players(gs); i++) {
+        controller *c = game_player_get_ctrl(game_state_get_player(gs, i));
+        if(c && controller_has_checksum(c)) {
+            wanted = 1;
+        }
+    }
+    if(!wanted) {
+        return;
+    }
+
+    state_digest d;
+    game_state_checksum(gs, &d);
+    for(int i = 0; i < game_state_num_players(gs); i++) {
+        controller *c = game_player_get_ctrl(game_state_get_player(gs, i));
+        if(c) {
+            controller_checksum(c, &d);
+        }
+    }
+}
+
+// Objects that have a serializer but are left out of the netplay snapshot, eg. scrap
+static int game_state_is_keyframe_object(game_state *gs, object *obj) {
+    return obj->serialize != NULL
+        && obj->group != GROUP_PROJECTILE
+        && obj != game_state_get_player(gs, 0)->har
+        && obj != game_state_get_player(gs, 1)->har;
+}
+
+// A keyframe is the netplay snapshot, plus what it leaves out: scrap and the arena's own state
+static void game_state_keyframe_serialize(game_state *gs, serial *ser) {
+    game_state_serialize(gs, ser);
+
+    iterator it;
+    render_obj *robj;
+    serial objects;
+    serial_create(&objects);
+    uint16_t count = 0;
+    vector_iter_begin(&gs->objects, &it);
+    while((robj = iter_next(&it)) != NULL) {
+        if(game_state_is_keyframe_object(gs, robj->obj)) {
+            serial_write_int8(&objects, robj->layer);
+            object_serialize(robj->obj, &objects);
+            count++;
+        }
+    }
+    serial_write_int16(ser, count);
+    serial_write(ser, objects.data, serial_len(&objects));
+    serial_free(&objects);
+
+    arena_serialize(gs->sc, ser);
+}
+
+static void game_state_keyframe_restore(game_state *gs, serial *ser) {
+    game_state_restore(gs, ser);
+
+    iterator it;
+    render_obj *robj;
+    vector_iter_begin(&gs->objects, &it);
+    while((robj = iter_next(&it)) != NULL) {
+        if(game_state_is_keyframe_object(gs, robj->obj)) {
+            object_free(robj->obj);
+            free(robj->obj);
+            vector_delete(&gs->objects, &it);
+        }
+    }
+    int count = (uint16_t)serial_read_int16(ser);
+    for(int i = 0; i < count; i++) {
+        object *obj = malloc(sizeof(object));
+        int layer = serial_read_int8(ser);
+        object_create(obj, gs, vec2i_create(0, 0), vec2f_create(0,0));
+        object_unserialize(obj, ser, gs);
+        game_state_add_object(gs, obj, layer, 0, 0);
+    }
+
+    arena_unserialize(gs->sc, ser);
+}
+
+// Snapshot the arena every KEYFRAME_INTERVAL ticks while replaying, for seeking
+static void game_state_capture_keyframe(game_state *gs) {
+    if(gs->keyframes == NULL || gs->sc == NULL || !is_arena(gs->sc->id)) {
+        return;
+    }
+    if(!keyframe_index_wants(gs->keyframes, gs->tick)) {
+        return;
+    }
+    serial ser;
+    serial_create(&ser);
+    game_state_keyframe_serialize(gs, &ser);
+    keyframe_index_add(gs->keyframes, gs->tick, &ser);
+    serial_free(&ser);
+}
+
 // This function is called when the game speed requires it
 void game_state_dynamic_tick(game_state *gs) {
     // We want to load another scene
@@ -704,6 +910,9 @@ void game_state_dynamic_tick(game_state *gs) {
         // Increment tick
         gs->tick++;
         LOGTICK(gs->tick);
+
+        game_state_record_checksum(gs);
+        game_state_capture_keyframe(gs);
     }
 
     // Free extra controller events
@@ -789,13 +998,17 @@ int _setup_joystick(game_state *gs, int player_id, const char *joyname, int offs
     return res;
 }
 
-void _setup_rec_controller(game_state *gs, int player_id, sd_rec_file *rec) {
+int _setup_rec_controller(game_state *gs, int player_id, const char *file) {
     controller *ctrl = malloc(sizeof(controller));
     game_player *player = game_state_get_player(gs, player_id);
     controller_init(ctrl);
 
-    rec_controller_create(ctrl, player_id, rec);
+    if(rec_controller_create(ctrl, player_id, file)) {
+        free(ctrl);
+        return 1;
+    }
     game_player_set_ctrl(player, ctrl);
+    return 0;
 }
 
 void reconfigure_controller(game_state *gs) {
@@ -825,8 +1038,8 @@ void game_state_init_demo(game_state *gs) {
         game_player_set_selectable(player, 1);
 
         // select random pilot and har
-        player->pilot_id = rand_int(10);
-        player->har_id = rand_int(11);
+        player->pilot_id = random_int(&gs->rand, 10);
+        player->har_id = random_int(&gs->rand, 11);
         chr_score_reset(&player->score, 1);
 
         // set proper color
@@ -853,9 +1066,23 @@ void game_state_free(game_state **_gs) {
     }
     vector_free(&gs->objects);
 
-    // Free scene
-    scene_free(gs->sc);
-    free(gs->sc);
+    // Free scene. There is none if loading one failed.
+    if(gs->sc != NULL) {
+        scene_free(gs->sc);
+        free(gs->sc);
+    }
+    game_state_reset_playback_speed(gs);
+
+    // Keep the keyframes built during this playback for the next one, if asked to
+    if(gs->keyframes != NULL) {
+        if(gs->keyframes->dirty && gs->init_flags->seek_index) {
+            char idx_path[300];
+            game_state_keyframe_path(gs, idx_path, sizeof(idx_path));
+            keyframe_index_save(gs->keyframes, idx_path);
+        }
+        keyframe_index_free(gs->keyframes);
+        free(gs->keyframes);
+    }
 
     // Free players
     for(int i = 0; i < 2; i++) {
@@ -883,7 +1110,7 @@ int game_state_ms_per_dyntick(game_state *gs) {
 int game_state_serialize(game_state *gs, serial *ser) {
     // serialize tick time and random seed, so client can reply state from this point
     serial_write_int32(ser, game_state_get_tick(gs));
-    serial_write_int32(ser, rand_get_seed());
+    serial_write_int32(ser, random_get_seed(&gs->rand));
     serial_write_int32(ser, game_state_is_paused(gs));
 
     object *har[2];
@@ -919,13 +1146,10 @@ int game_state_serialize(game_state *gs, serial *ser) {
     return 0;
 }
 
-int game_state_unserialize(game_state *gs, serial *ser, int rtt) {
-#ifdef DEBUGMODE
-    int oldtick = gs->tick;
-#endif
+// Puts the HARs, projectiles and scores back to the state of a game_state_serialize() snapshot
+static void game_state_restore(game_state *gs, serial *ser) {
     gs->tick = serial_read_int32(ser);
-    int endtick = gs->tick + ceil(rtt / 2.0f);
-    rand_seed(serial_read_int32(ser));
+    random_seed(&gs->rand, serial_read_int32(ser));
     game_state_set_paused(gs, serial_read_int32(ser));
 
     for(int i = 0; i < 2; i++) {
@@ -982,6 +1206,18 @@ int game_state_unserialize(game_state *gs, serial *ser, int rtt) {
 
     chr_score_unserialize(game_player_get_score(game_state_get_player(gs, 0)), ser);
     chr_score_unserialize(game_player_get_score(game_state_get_player(gs, 1)), ser);
+}
+
+int game_state_unserialize(game_state *gs, serial *ser, int rtt) {
+#ifdef DEBUGMODE
+    int oldtick = gs->tick;
+#endif
+    game_state_restore(gs, ser);
+    int endtick = gs->tick + ceil(rtt / 2.0f);
+    int replayed = 0;
+
+    // Digests of the corrected state replace the stale ones
+    game_state_record_checksum(gs);
 
     // tick things back to the current time
     DEBUG("replaying %d ticks", endtick - gs->tick);
@@ -992,8 +1228,48 @@ int game_state_unserialize(game_state *gs, serial *ser, int rtt) {
         game_state_call_collide(gs);
         game_state_call_tick(gs, TICK_DYNAMIC);
         gs->tick++;
+        game_state_record_checksum(gs);
+        replayed++;
     }
     DEBUG("replay done");
 
+    return replayed;
+}
+
+int game_state_seek(game_state *gs, int tick) {
+    if(gs->keyframes == NULL || gs->init_flags->record || !is_arena(gs->sc->id)) {
+        return 1;
+    }
+    if(tick < 0) {
+        tick = 0;
+    }
+
+    // Going forwards from where we are is cheaper than restoring, unless a keyframe is closer
+    const keyframe *kf = keyframe_index_find(gs->keyframes, tick);
+    if(tick < (int)gs->tick || (kf != NULL && kf->tick > (int)gs->tick)) {
+        if(kf == NULL) {
+            DEBUG("No keyframe at or before tick %d", tick);
+            return 1;
+        }
+        serial ser;
+        serial_copy(&ser, &kf->state);
+        serial_read_reset(&ser);
+        game_state_keyframe_restore(gs, &ser);
+        serial_free(&ser);
+    }
+
+    // Replay inputs from the restored tick onwards
+    for(int i = 0; i < game_state_num_players(gs); i++) {
+        controller *c = game_player_get_ctrl(game_state_get_player(gs, i));
+        if(c && c->type == CTRL_TYPE_REC) {
+            rec_controller_seek(c, gs->tick);
+        }
+    }
+    int paused = gs->paused;
+    gs->paused = 0;
+    while((int)gs->tick < tick && gs->run && is_arena(gs->sc->id)) {
+        game_state_dynamic_tick(gs);
+    }
+    gs->paused = paused;
     return 0;
 }
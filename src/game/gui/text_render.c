@@ -255,6 +255,9 @@ void font_render_char_shadowed(const font *font, char ch, int x, int y, color c,
 
     // Get font face
     sur = vector_get(&font->surfaces, code);
+    if(sur == NULL || *sur == NULL) {
+        return;
+    }
 
     // Handle shadows if necessary
     if(shadow_flags & TEXT_SHADOW_RIGHT)
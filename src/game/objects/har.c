@@ -394,9 +394,9 @@ void cb_har_spawn_object(object *parent, int id, vec2i pos, vec2f vel, uint8_t f
 }
 
 void har_floor_landing_effects(object *obj) {
-    int amount = rand_int(2) + 1;
+    int amount = random_int(&obj->gs->rand, 2) + 1;
     for(int i = 0; i < amount; i++) {
-        int variance = rand_int(20) - 10;
+        int variance = random_int(&obj->gs->rand, 20) - 10;
         vec2i coord = vec2i_create(obj->pos.x + variance + i*10, obj->pos.y);
         object *dust = malloc(sizeof(object));
         object_create(dust, obj->gs, coord, vec2f_create(0,0));
@@ -607,7 +607,7 @@ void har_spawn_oil(object *obj, vec2i pos, int amount, float gravity, int layer)
     // burning oil
     for(int i = 0; i < amount; i++) {
         // Calculate velocity etc.
-        float rv = rand_int(100) / 100.0f - 0.5;
+        float rv = random_int(&obj->gs->rand, 100) / 100.0f - 0.5;
         float velx = (5 * cos(90 + i-(amount) / 2 + rv)) * object_get_direction(obj);
         float vely = -12 * sin(i / amount + rv);
 
@@ -624,7 +624,7 @@ void har_spawn_oil(object *obj, vec2i pos, int amount, float gravity, int layer)
         object_set_gravity(scrap, gravity);
         object_set_layers(scrap, LAYER_SCRAP);
         object_dynamic_tick(scrap);
-        scrap_create(scrap);
+        scrap_create(scrap, h->af_data);
         game_state_add_object(obj->gs, scrap, layer, 0, 0);
     }
 }
@@ -659,7 +659,7 @@ void har_spawn_scrap(object *obj, vec2i pos, int amount) {
     }
     for(int i = 0; i < scrap_amount; i++) {
         // Calculate velocity etc.
-        float rv = rand_int(100) / 100.0f - 0.5;
+        float rv = random_int(&obj->gs->rand, 100) / 100.0f - 0.5;
         float velx = (5 * cos(90 + i-(scrap_amount) / 2 + rv)) * object_get_direction(obj);
         float vely = -12 * sin(i / scrap_amount + rv);
 
@@ -675,7 +675,7 @@ void har_spawn_scrap(object *obj, vec2i pos, int amount) {
 
         // Create the object
         object *scrap = malloc(sizeof(object));
-        int anim_no = rand_int(3) + ANIM_SCRAP_METAL;
+        int anim_no = random_int(&obj->gs->rand, 3) + ANIM_SCRAP_METAL;
         object_create(scrap, obj->gs, pos, vec2f_create(velx, vely));
         object_set_animation(scrap, &af_get_move(h->af_data, anim_no)->ani);
         object_set_stl(scrap, object_get_stl(obj));
@@ -684,7 +684,7 @@ void har_spawn_scrap(object *obj, vec2i pos, int amount) {
         object_set_layers(scrap, LAYER_SCRAP);
         object_dynamic_tick(scrap);
         object_set_shadow(scrap, 1);
-        scrap_create(scrap);
+        scrap_create(scrap, h->af_data);
         game_state_add_object(obj->gs, scrap, RENDER_LAYER_TOP, 0, 0);
     }
 }
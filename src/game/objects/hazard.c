@@ -34,7 +34,7 @@ void hazard_tick(object *obj) {
             float mag;
             int limit = 10;
             do {
-                obj->orbit_dest = vec2f_create(rand_float()*320.0f, rand_float()*200.0f);
+                obj->orbit_dest = vec2f_create(random_float(&obj->gs->rand)*320.0f, random_float(&obj->gs->rand)*200.0f);
                 obj->orbit_dest_dir = vec2f_sub(obj->orbit_dest, obj->orbit_pos);
                 mag = sqrtf(obj->orbit_dest_dir.x*obj->orbit_dest_dir.x + obj->orbit_dest_dir.y*obj->orbit_dest_dir.y);
                 limit--;
@@ -101,6 +101,18 @@ int hazard_serialize(object *obj, serial *ser) {
     /*DEBUG("serializing hazard");*/
     // Specialization
     serial_write_int8(ser, SPECID_HAZARD);
+
+    // Where the orb is flying to
+    serial_write_int8(ser, obj->orbit);
+    serial_write_float(ser, obj->orbit_tick);
+    serial_write_float(ser, obj->orbit_dest.x);
+    serial_write_float(ser, obj->orbit_dest.y);
+    serial_write_float(ser, obj->orbit_dest_dir.x);
+    serial_write_float(ser, obj->orbit_dest_dir.y);
+    serial_write_float(ser, obj->orbit_pos.x);
+    serial_write_float(ser, obj->orbit_pos.y);
+    serial_write_float(ser, obj->orbit_pos_vary.x);
+    serial_write_float(ser, obj->orbit_pos_vary.y);
     return 0;
 }
 
@@ -110,6 +122,17 @@ int hazard_unserialize(object *obj, serial *ser, int animation_id, game_state *g
     object_set_userdata(obj, bk_data);
     object_set_stl(obj, bk_data->sound_translation_table);
     object_set_animation(obj, &bk_get_info(bk_data, animation_id)->ani);
+
+    obj->orbit = serial_read_int8(ser);
+    obj->orbit_tick = serial_read_float(ser);
+    obj->orbit_dest.x = serial_read_float(ser);
+    obj->orbit_dest.y = serial_read_float(ser);
+    obj->orbit_dest_dir.x = serial_read_float(ser);
+    obj->orbit_dest_dir.y = serial_read_float(ser);
+    obj->orbit_pos.x = serial_read_float(ser);
+    obj->orbit_pos.y = serial_read_float(ser);
+    obj->orbit_pos_vary.x = serial_read_float(ser);
+    obj->orbit_pos_vary.y = serial_read_float(ser);
     return 0;
 }
 
@@ -1,6 +1,11 @@
 #include <stdlib.h>
 #include "game/objects/scrap.h"
 #include "game/objects/arena_constraints.h"
+#include "game/objects/har.h"
+#include "game/protos/object_specializer.h"
+#include "game/game_player.h"
+#include "game/game_state.h"
+#include "utils/log.h"
 
 #define SCRAP_KEEPALIVE 220
 #define IS_ZERO(n) (n < 0.1 && n > -0.1)
@@ -47,8 +52,47 @@ void scrap_move(object *obj) {
     }
 }
 
-int scrap_create(object *obj) {
+int scrap_serialize(object *obj, serial *ser) {
+    af *af_data = object_get_userdata(obj);
+    serial_write_int8(ser, SPECID_SCRAP);
+    serial_write_int8(ser, af_data->id);
+    serial_write_int8(ser, object_get_shadow(obj));
+    serial_write_int8(ser, object_is_rewind_tag_disabled(obj));
+    return 0;
+}
+
+int scrap_unserialize(object *obj, serial *ser, int animation_id, game_state *gs) {
+    uint8_t har_id = serial_read_int8(ser);
+    int shadow = serial_read_int8(ser);
+    int disabled = serial_read_int8(ser);
+
+    // Scrap comes from one of the HARs, and looks like it
+    for(int i = 0; i < 2; i++) {
+        object *o = game_player_get_har(game_state_get_player(gs, i));
+        har *h = object_get_userdata(o);
+        if(h->af_data->id == har_id) {
+            object_set_animation(obj, &af_get_move(h->af_data, animation_id)->ani);
+            object_set_stl(obj, object_get_stl(o));
+            object_set_shadow(obj, shadow);
+            object_disable_rewind_tag(obj, disabled);
+            scrap_create(obj, h->af_data);
+            return 0;
+        }
+    }
+    DEBUG("COULD NOT FIND HAR ID %d", har_id);
+    return 1;
+}
+
+void scrap_bootstrap(object *obj) {
+    object_set_serialize_cb(obj, scrap_serialize);
+    object_set_unserialize_cb(obj, scrap_unserialize);
+}
+
+int scrap_create(object *obj, af *af_data) {
+    // The animations belong to the HAR's af, which outlives the HAR object itself
+    object_set_userdata(obj, af_data);
     object_set_move_cb(obj, scrap_move);
+    scrap_bootstrap(obj);
 
     return 0;
 }
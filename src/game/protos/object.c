@@ -66,7 +66,7 @@ void object_create(object *obj, game_state *gs, vec2i pos, vec2f vel) {
 
     obj->custom_str = NULL;
 
-    random_seed(&obj->rand_state, rand_intmax());
+    random_seed(&obj->rand_state, gs ? random_intmax(&gs->rand) : rand_intmax());
 
     // For enabling hit on the current and the next n-1 frames
     obj->hit_frames = 0;
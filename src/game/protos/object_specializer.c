@@ -3,6 +3,7 @@
 #include "game/objects/har.h"
 #include "game/objects/projectile.h"
 #include "game/objects/hazard.h"
+#include "game/objects/scrap.h"
 #include "utils/log.h"
 
 int object_auto_specialize(object *obj, int specialization_id) {
@@ -19,6 +20,10 @@ int object_auto_specialize(object *obj, int specialization_id) {
             //DEBUG("Object is specialized as a hazard");
             hazard_bootstrap(obj);
             return 0;
+        case SPECID_SCRAP:
+            //DEBUG("Object is specialized as scrap");
+            scrap_bootstrap(obj);
+            return 0;
         default:
             DEBUG("Object is specialized as %d", specialization_id);
             return 1;
@@ -54,42 +54,22 @@ int scene_create(scene *scene, game_state *gs, int scene_id) {
     return 0;
 }
 
-void har_fix_sprite_coords(animation *ani, int fix_x, int fix_y) {
-    iterator it;
-    sprite *s;
-    // Fix sprite positions
-    vector_iter_begin(&ani->sprites, &it);
-    while((s = iter_next(&it)) != NULL) {
-        s->pos.x += fix_x;
-        s->pos.y += fix_y;
-    }
-    // Fix collisions coordinates
-    collision_coord *c;
-    vector_iter_begin(&ani->collision_coords, &it);
-    while((c = iter_next(&it)) != NULL) {
-        c->pos.x += fix_x;
-        c->pos.y += fix_y;
-    }
-}
-
 int scene_load_har(scene *scene, int player_id, int har_id) {
     if(scene->af_data[player_id]) {
-        af_free(scene->af_data[player_id]);
-        free(scene->af_data[player_id]);
+        af_cache_release(scene->af_data[player_id]);
+        scene->af_data[player_id] = NULL;
     }
-    scene->af_data[player_id] = malloc(sizeof(af));
 
+    // HAR data is shared between all scenes (and game states) using it
     int resource_id = har_to_resource(har_id);
-    if(load_af_file(scene->af_data[player_id], resource_id)) {
+    scene->af_data[player_id] = af_cache_acquire(resource_id);
+    if(scene->af_data[player_id] == NULL) {
         PERROR("Unable to load HAR %s (%s)!",
             har_get_name(har_id),
             get_resource_name(resource_id));
         return 1;
     }
 
-    // Fix some coordinates on jump sprites
-    har_fix_sprite_coords(&af_get_move(scene->af_data[player_id], ANIM_JUMPING)->ani, 0, -50);
-
     DEBUG("Loaded HAR %s (%s).",
         har_get_name(har_id),
         get_resource_name(resource_id));
@@ -228,14 +208,8 @@ void scene_free(scene *scene) {
         scene->free(scene);
     }
     bk_free(&scene->bk_data);
-    if (scene->af_data[0]) {
-        af_free(scene->af_data[0]);
-        free(scene->af_data[0]);
-    }
-    if (scene->af_data[1]) {
-        af_free(scene->af_data[1]);
-        free(scene->af_data[1]);
-    }
+    af_cache_release(scene->af_data[0]);
+    af_cache_release(scene->af_data[1]);
     ticktimer_close(&scene->tick_timer);
 }
 
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "game/render_check.h"
+#include "game/replay.h"
+#include "game/game_state.h"
+#include "video/video.h"
+#include "video/image.h"
+#include "utils/log.h"
+#include "utils/random.h"
+
+// Recording file name without its directory and extension, or the scene number
+static void render_check_name(const render_check_opts *opts, char *buf, size_t len) {
+    if(opts->rec_file == NULL) {
+        snprintf(buf, len, "scene%d", opts->scene);
+        return;
+    }
+    const char *base = strrchr(opts->rec_file, '/');
+    const char *bslash = strrchr(opts->rec_file, '\\');
+    if(bslash != NULL && (base == NULL || bslash > base)) {
+        base = bslash;
+    }
+    base = (base != NULL) ? base + 1 : opts->rec_file;
+    snprintf(buf, len, "%s", base);
+    char *ext = strrchr(buf, '.');
+    if(ext != NULL && ext != buf) {
+        *ext = 0;
+    }
+}
+
+// Returns the number of pixels that are off by more than the tolerance
+static int render_check_compare(const image *golden, const char *frame, int tolerance, int *max_delta) {
+    int bad = 0;
+    *max_delta = 0;
+    for(int i = 0; i < NATIVE_W * NATIVE_H; i++) {
+        int worst = 0;
+        for(int c = 0; c < 4; c++) {
+            int delta = abs((uint8_t)golden->data[i * 4 + c] - (uint8_t)frame[i * 4 + c]);
+            if(delta > worst) {
+                worst = delta;
+            }
+        }
+        if(worst > *max_delta) {
+            *max_delta = worst;
+        }
+        if(worst > tolerance) {
+            bad++;
+        }
+    }
+    return bad;
+}
+
+static int render_check_frame(const render_check_opts *opts, const char *name, unsigned int tick) {
+    char path[512];
+    image frame;
+    image golden;
+    int max_delta;
+
+    frame.w = NATIVE_W;
+    frame.h = NATIVE_H;
+    frame.data = (char*)video_get_frame();
+    if(frame.data == NULL) {
+        PERROR("Golden images need the offscreen renderer");
+        return 1;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s-%u.png", opts->dir, name, tick);
+    if(opts->write) {
+        if(image_write_png(&frame, path)) {
+            return 1;
+        }
+        printf("%s: written\n", path);
+        return 0;
+    }
+    if(image_read_png(&golden, path)) {
+        printf("%s: missing\n", path);
+        return 1;
+    }
+    if(golden.w != NATIVE_W || golden.h != NATIVE_H) {
+        printf("%s: wrong size %ux%u\n", path, golden.w, golden.h);
+        image_free(&golden);
+        return 1;
+    }
+    int bad = render_check_compare(&golden, frame.data, opts->tolerance, &max_delta);
+    image_free(&golden);
+    if(bad == 0) {
+        printf("%s: pass\n", path);
+        return 0;
+    }
+    printf("%s: FAIL, %d pixels differ (by up to %d)\n", path, bad, max_delta);
+    snprintf(path, sizeof(path), "%s/%s-%u.actual.png", opts->dir, name, tick);
+    image_write_png(&frame, path);
+    return 1;
+}
+
+int render_check(const render_check_opts *opts) {
+    replay rp;
+    char name[256];
+    int failed = 0;
+    int next = 0;
+
+    render_check_name(opts, name, sizeof(name));
+
+    // The game state gets REPLAY_SEED; objects made before there is one draw from the global RNG
+    rand_seed(REPLAY_SEED);
+    if(opts->rec_file != NULL ? replay_create(&rp, opts->rec_file) : replay_create_scene(&rp, opts->scene)) {
+        return 1;
+    }
+
+    // A frame is checked as soon as the game has got to its tick; the clock is
+    // virtual, so that always happens at the same point
+    int running = 1;
+    while(next < opts->tick_count) {
+        unsigned int tick = rp.gs->tick - rp.start_tick;
+        if(tick >= opts->ticks[next]) {
+            video_render_prepare();
+            game_state_render(rp.gs);
+            video_render_finish();
+            failed += render_check_frame(opts, name, opts->ticks[next]);
+            next++;
+            continue;
+        }
+        if(!running) {
+            break;
+        }
+        running = replay_frame(&rp);
+        video_tick();
+    }
+    for(; next < opts->tick_count; next++) {
+        printf("%s-%u: not reached, the %s ended at tick %u\n",
+               name, opts->ticks[next], (opts->rec_file != NULL) ? "match" : "scene",
+               rp.gs->tick - rp.start_tick);
+        failed++;
+    }
+    replay_free(&rp);
+
+    INFO("Checked %d frames of %s against %s, %d failed", opts->tick_count, name, opts->dir, failed);
+    return failed > 0;
+}
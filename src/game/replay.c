@@ -0,0 +1,150 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h> // strcasecmp
+#include "game/replay.h"
+#include "game/game_state.h"
+#include "game/game_player.h"
+#include "game/utils/checksum.h"
+#include "resources/ids.h"
+#include "utils/log.h"
+#include "utils/list.h"
+#include "utils/scandir.h"
+
+int replay_create(replay *rp, const char *rec_file) {
+    memset(rp, 0, sizeof(replay));
+    rp->scene_id = -1;
+    rp->flags.net_mode = NET_MODE_NONE;
+    rp->flags.record = 0;
+    rp->flags.headless = 1;
+    rp->flags.seed = REPLAY_SEED;
+    strncpy(rp->flags.rec_file, rec_file, sizeof(rp->flags.rec_file) - 1);
+
+    rp->gs = calloc(1, sizeof(game_state));
+    if(game_state_create(rp->gs, &rp->flags)) {
+        game_state_free(&rp->gs);
+        return 1;
+    }
+    rp->start_tick = rp->gs->tick;
+    return 0;
+}
+
+int replay_create_scene(replay *rp, int scene_id) {
+    memset(rp, 0, sizeof(replay));
+    rp->scene_id = scene_id;
+    rp->flags.net_mode = NET_MODE_NONE;
+    rp->flags.headless = 1;
+    rp->flags.seed = REPLAY_SEED;
+
+    rp->gs = calloc(1, sizeof(game_state));
+    if(game_state_create(rp->gs, &rp->flags)) {
+        game_state_free(&rp->gs);
+        return 1;
+    }
+    if(game_load_new(rp->gs, scene_id)) {
+        game_state_free(&rp->gs);
+        return 1;
+    }
+    rp->start_tick = rp->gs->tick;
+    return 0;
+}
+
+void replay_free(replay *rp) {
+    if(rp->gs != NULL) {
+        game_state_free(&rp->gs);
+    }
+}
+
+static int replay_in_match(replay *rp) {
+    game_state *gs = rp->gs;
+    if(!game_state_is_running(gs) || gs->next_id != gs->this_id) {
+        return 0;
+    }
+    return rp->scene_id >= 0 || is_arena(gs->this_id);
+}
+
+int replay_frame(replay *rp) {
+    game_state *gs = rp->gs;
+    if(!replay_in_match(rp)) {
+        return 0;
+    }
+
+    // Same scheduling as engine_run(), with a fixed frame time instead of SDL_GetTicks()
+    game_state_tick_controllers(gs);
+    rp->static_wait += REPLAY_FRAME_MS;
+    rp->dynamic_wait += REPLAY_FRAME_MS;
+    while(rp->static_wait > 10) {
+        game_state_static_tick(gs);
+        rp->static_wait -= 10;
+    }
+    while(rp->dynamic_wait > game_state_ms_per_dyntick(gs)) {
+        game_state_dynamic_tick(gs);
+        rp->dynamic_wait -= game_state_ms_per_dyntick(gs);
+        if(!replay_in_match(rp)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void replay_get_result(replay *rp, replay_result *res) {
+    state_digest d;
+    game_state_checksum(rp->gs, &d);
+    res->ticks = rp->gs->tick - rp->start_tick;
+    for(int i = 0; i < 2; i++) {
+        res->score[i] = d.score[i];
+    }
+    res->hash = d.hash;
+}
+
+int replay_run(const char *rec_file, unsigned int max_ticks, replay_result *res) {
+    replay rp;
+    if(replay_create(&rp, rec_file)) {
+        return 1;
+    }
+    while(replay_frame(&rp)) {
+        if(rp.gs->tick - rp.start_tick > max_ticks) {
+            PERROR("Recording %s did not finish in %u ticks", rec_file, max_ticks);
+            replay_free(&rp);
+            return 1;
+        }
+    }
+    replay_get_result(&rp, res);
+    replay_free(&rp);
+    return 0;
+}
+
+static int replay_is_rec_file(const char *name) {
+    size_t len = strlen(name);
+    return len > 4 && strcasecmp(name + len - 4, ".rec") == 0;
+}
+
+static int replay_name_cmp(const void *a, const void *b) {
+    return strcmp((const char*)a, (const char*)b);
+}
+
+int replay_scan_dir(vector *names, const char *dir) {
+    list dirlist;
+    iterator it;
+    char *name;
+    char entry[REPLAY_NAME_MAX];
+
+    vector_create(names, REPLAY_NAME_MAX);
+    list_create(&dirlist);
+    if(scan_directory(&dirlist, dir)) {
+        list_free(&dirlist);
+        return 1;
+    }
+    list_iter_begin(&dirlist, &it);
+    while((name = iter_next(&it)) != NULL) {
+        if(replay_is_rec_file(name)) {
+            snprintf(entry, sizeof(entry), "%s", name);
+            vector_append(names, entry);
+        }
+    }
+    list_free(&dirlist);
+
+    // Directory order is arbitrary; keep results comparable between runs
+    vector_sort(names, replay_name_cmp);
+    return 0;
+}
@@ -0,0 +1,306 @@
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "game/replay_export.h"
+#include "game/replay.h"
+#include "game/game_state.h"
+#include "video/video.h"
+#include "video/image.h"
+#include "utils/log.h"
+
+enum {
+    SLOT_FREE = 0,
+    SLOT_QUEUED,
+    SLOT_BUSY,
+    SLOT_DONE
+};
+
+typedef struct export_slot_t {
+    int state;
+    int failed;
+    unsigned int frame;
+    char *rgba; // native frame as read back from the renderer
+    char *scaled;
+    char *yuv; // planar 4:2:0, only for Y4M output
+} export_slot;
+
+typedef struct exporter_t {
+    const replay_export_opts *opts;
+    int y4m;
+    FILE *out;
+    int w;
+    int h;
+    export_slot *slots;
+    int slot_count;
+    SDL_mutex *lock;
+    SDL_cond *cond;
+    int workers; // threads that actually started
+    int quit;
+    unsigned int next_write;
+    int failed;
+} exporter;
+
+static int has_suffix(const char *str, const char *suffix) {
+    size_t len = strlen(str);
+    size_t slen = strlen(suffix);
+    return len >= slen && strcmp(str + len - slen, suffix) == 0;
+}
+
+static void scale_nearest(const char *src, char *dst, int scale) {
+    const uint32_t *in = (const uint32_t*)src;
+    uint32_t *out = (uint32_t*)dst;
+    int w = NATIVE_W * scale;
+    for(int y = 0; y < NATIVE_H; y++) {
+        const uint32_t *row = in + y * NATIVE_W;
+        uint32_t *first = out + y * scale * w;
+        for(int x = 0; x < w; x++) {
+            first[x] = row[x / scale];
+        }
+        for(int k = 1; k < scale; k++) {
+            memcpy(first + k * w, first, w * 4);
+        }
+    }
+}
+
+// BT.601 limited range, which is what players assume for Y4M without further tags
+static void rgba_to_i420(const char *src, char *dst, int w, int h) {
+    const uint8_t *in = (const uint8_t*)src;
+    uint8_t *yp = (uint8_t*)dst;
+    uint8_t *up = yp + w * h;
+    uint8_t *vp = up + (w / 2) * (h / 2);
+    for(int i = 0; i < w * h; i++) {
+        int r = in[i * 4 + 0], g = in[i * 4 + 1], b = in[i * 4 + 2];
+        yp[i] = 16 + ((66 * r + 129 * g + 25 * b + 128) >> 8);
+    }
+    for(int y = 0; y < h; y += 2) {
+        for(int x = 0; x < w; x += 2) {
+            int r = 0, g = 0, b = 0;
+            for(int k = 0; k < 4; k++) {
+                const uint8_t *p = in + ((y + k / 2) * w + x + k % 2) * 4;
+                r += p[0];
+                g += p[1];
+                b += p[2];
+            }
+            r /= 4;
+            g /= 4;
+            b /= 4;
+            int c = (y / 2) * (w / 2) + x / 2;
+            up[c] = 128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8);
+            vp[c] = 128 + ((112 * r - 94 * g - 18 * b + 128) >> 8);
+        }
+    }
+}
+
+static void export_encode(exporter *ex, export_slot *slot) {
+    if(ex->opts->scale > 1) {
+        scale_nearest(slot->rgba, slot->scaled, ex->opts->scale);
+    } else {
+        memcpy(slot->scaled, slot->rgba, NATIVE_W * NATIVE_H * 4);
+    }
+
+    slot->failed = 0;
+    if(ex->y4m) {
+        rgba_to_i420(slot->scaled, slot->yuv, ex->w, ex->h);
+    } else {
+        // Every frame is its own file, so there is nothing to keep in order
+        char path[512];
+        image img;
+        img.w = ex->w;
+        img.h = ex->h;
+        img.data = slot->scaled;
+        snprintf(path, sizeof(path), "%s%06u.png", ex->opts->file, slot->frame);
+        slot->failed = image_write_png(&img, path);
+    }
+}
+
+static int export_worker(void *userdata) {
+    exporter *ex = userdata;
+    SDL_LockMutex(ex->lock);
+    while(1) {
+        // Oldest frame first, so the writer is held up as little as possible
+        export_slot *next = NULL;
+        for(int i = 0; i < ex->slot_count; i++) {
+            export_slot *slot = &ex->slots[i];
+            if(slot->state == SLOT_QUEUED && (next == NULL || slot->frame < next->frame)) {
+                next = slot;
+            }
+        }
+        if(next != NULL) {
+            next->state = SLOT_BUSY;
+            SDL_UnlockMutex(ex->lock);
+            export_encode(ex, next);
+            SDL_LockMutex(ex->lock);
+            next->state = SLOT_DONE;
+            SDL_CondBroadcast(ex->cond);
+            continue;
+        }
+        if(ex->quit) {
+            break;
+        }
+        SDL_CondWait(ex->cond, ex->lock);
+    }
+    SDL_UnlockMutex(ex->lock);
+    return 0;
+}
+
+// Writes out the next frame in order if it is ready. Called with the lock held.
+static int export_write_next(exporter *ex) {
+    export_slot *slot = &ex->slots[ex->next_write % ex->slot_count];
+    if(slot->state != SLOT_DONE || slot->frame != ex->next_write) {
+        return 0;
+    }
+    SDL_UnlockMutex(ex->lock);
+    if(ex->y4m) {
+        size_t len = ex->w * ex->h * 3 / 2;
+        if(fputs("FRAME\n", ex->out) < 0 || fwrite(slot->yuv, 1, len, ex->out) != len) {
+            slot->failed = 1;
+        }
+    }
+    if(slot->failed) {
+        ex->failed = 1;
+    }
+    SDL_LockMutex(ex->lock);
+    slot->state = SLOT_FREE;
+    ex->next_write++;
+    return 1;
+}
+
+static void export_submit(exporter *ex, unsigned int frame, const image *img) {
+    export_slot *slot = &ex->slots[frame % ex->slot_count];
+    SDL_LockMutex(ex->lock);
+    while(slot->state != SLOT_FREE) {
+        if(!export_write_next(ex)) {
+            SDL_CondWait(ex->cond, ex->lock);
+        }
+    }
+    memcpy(slot->rgba, img->data, NATIVE_W * NATIVE_H * 4);
+    slot->frame = frame;
+    if(ex->workers == 0) {
+        // Nobody else would ever pick the frame up
+        slot->state = SLOT_BUSY;
+        SDL_UnlockMutex(ex->lock);
+        export_encode(ex, slot);
+        SDL_LockMutex(ex->lock);
+        slot->state = SLOT_DONE;
+        export_write_next(ex);
+    } else {
+        slot->state = SLOT_QUEUED;
+        SDL_CondSignal(ex->cond);
+    }
+    SDL_UnlockMutex(ex->lock);
+}
+
+static void export_drain(exporter *ex, unsigned int frames) {
+    SDL_LockMutex(ex->lock);
+    while(ex->next_write < frames) {
+        if(!export_write_next(ex)) {
+            SDL_CondWait(ex->cond, ex->lock);
+        }
+    }
+    ex->quit = 1;
+    SDL_CondBroadcast(ex->cond);
+    SDL_UnlockMutex(ex->lock);
+}
+
+static int export_render_frame(replay *rp, image *img) {
+    video_render_prepare();
+    game_state_render(rp->gs);
+    video_render_finish();
+    return video_screenshot(img);
+}
+
+int replay_export(const char *rec_file, const replay_export_opts *opts) {
+    exporter ex;
+    replay rp;
+    int ret = 1;
+
+    memset(&ex, 0, sizeof(exporter));
+    ex.opts = opts;
+    ex.y4m = has_suffix(opts->file, ".y4m");
+    ex.w = NATIVE_W * opts->scale;
+    ex.h = NATIVE_H * opts->scale;
+
+    if(ex.y4m) {
+        ex.out = fopen(opts->file, "wb");
+        if(ex.out == NULL) {
+            PERROR("Unable to open %s for writing", opts->file);
+            goto exit_0;
+        }
+        fprintf(ex.out, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", ex.w, ex.h, opts->fps);
+    }
+    if(replay_create(&rp, rec_file)) {
+        goto exit_1;
+    }
+
+    // Frames in flight are capped, so a slow disk can't make memory use grow without bound
+    int jobs = (opts->jobs > 0) ? opts->jobs : SDL_GetCPUCount();
+    ex.slot_count = jobs * 2;
+    ex.slots = calloc(ex.slot_count, sizeof(export_slot));
+    for(int i = 0; i < ex.slot_count; i++) {
+        ex.slots[i].rgba = malloc(NATIVE_W * NATIVE_H * 4);
+        ex.slots[i].scaled = malloc(ex.w * ex.h * 4);
+        ex.slots[i].yuv = ex.y4m ? malloc(ex.w * ex.h * 3 / 2) : NULL;
+    }
+    ex.lock = SDL_CreateMutex();
+    ex.cond = SDL_CreateCond();
+    SDL_Thread **threads = calloc(jobs, sizeof(SDL_Thread*));
+    for(int i = 0; i < jobs; i++) {
+        threads[i] = SDL_CreateThread(export_worker, "replay_export", &ex);
+        if(threads[i] != NULL) {
+            ex.workers++;
+        }
+    }
+    if(ex.workers == 0) {
+        PERROR("Unable to start export threads: %s; encoding on the main thread", SDL_GetError());
+    }
+
+    // Output frame n shows the match at n/fps seconds of game time
+    uint64_t start = SDL_GetPerformanceCounter();
+    uint64_t sim_ms = 0;
+    unsigned int frame = 0;
+    int running = 1;
+    image img;
+    while(running && !ex.failed) {
+        while(running && sim_ms * opts->fps < (uint64_t)frame * 1000) {
+            running = replay_frame(&rp);
+            video_tick();
+            sim_ms += REPLAY_FRAME_MS;
+        }
+        if(export_render_frame(&rp, &img)) {
+            image_free(&img);
+            ex.failed = 1;
+            break;
+        }
+        export_submit(&ex, frame++, &img);
+        image_free(&img);
+    }
+    export_drain(&ex, frame);
+
+    for(int i = 0; i < jobs; i++) {
+        if(threads[i] != NULL) {
+            SDL_WaitThread(threads[i], NULL);
+        }
+    }
+    free(threads);
+    double secs = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+    INFO("Exported %u frames (%.1fs of video) in %.1fs on %d threads",
+         frame, (double)frame / opts->fps, secs, (ex.workers > 0) ? ex.workers : 1);
+    ret = ex.failed;
+
+    SDL_DestroyCond(ex.cond);
+    SDL_DestroyMutex(ex.lock);
+    for(int i = 0; i < ex.slot_count; i++) {
+        free(ex.slots[i].rgba);
+        free(ex.slots[i].scaled);
+        free(ex.slots[i].yuv);
+    }
+    free(ex.slots);
+    replay_free(&rp);
+exit_1:
+    if(ex.out != NULL) {
+        fclose(ex.out);
+    }
+exit_0:
+    return ret;
+}
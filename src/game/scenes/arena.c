@@ -21,6 +21,7 @@
 #include "game/utils/score.h"
 #include "game/game_player.h"
 #include "game/game_state.h"
+#include "game/common_defines.h"
 #include "game/utils/ticktimer.h"
 #include "game/gui/text_render.h"
 #include "resources/languages.h"
@@ -44,6 +45,15 @@
 #define HAR1_START_POS 110
 #define HAR2_START_POS 211
 
+// Bk animations played by the announcer
+enum {
+    ANNOUNCE_ROUND = 6,
+    ANNOUNCE_NUMBER,
+    ANNOUNCE_YOULOSE,
+    ANNOUNCE_YOUWIN,
+    ANNOUNCE_FIGHT
+};
+
 typedef struct arena_local_t {
     guiframe *game_menu;
 
@@ -66,12 +76,15 @@ typedef struct arena_local_t {
 
     int rein_enabled;
 
-    sd_rec_file *rec;
+    sd_rec_journal *rec;
     int rec_last[2];
 } arena_local;
 
 void arena_maybe_sync(scene *scene, int need_sync);
 void write_rec_move(scene *scene, game_player *player, int action);
+void scene_ready_anim_done(object *parent);
+void scene_youwin_anim_done(object *parent);
+void scene_youlose_anim_done(object *parent);
 
 // -------- Local callbacks --------
 
@@ -104,31 +117,61 @@ void arena_speed_slide(component *c, void *userdata, int pos) {
     game_state_set_speed(sc->gs, pos + 5);
 }
 
+// Puts one of the announcer animations on screen
+static object* arena_announce(scene *sc, int id) {
+    arena_local *local = scene_get_userdata(sc);
+    animation *ani = &bk_get_info(&sc->bk_data, id)->ani;
+    object *obj = malloc(sizeof(object));
+    int layer = RENDER_LAYER_TOP;
+    object_create(obj, sc->gs, ani->start_pos, vec2f_create(0,0));
+    object_set_stl(obj, bk_get_stl(&sc->bk_data));
+    object_set_animation(obj, ani);
+    switch(id) {
+        case ANNOUNCE_ROUND:
+            object_set_finish_cb(obj, scene_ready_anim_done);
+            break;
+        case ANNOUNCE_NUMBER:
+            object_select_sprite(obj, local->round);
+            object_set_sprite_override(obj, 1);
+            break;
+        case ANNOUNCE_YOULOSE:
+            object_set_finish_cb(obj, scene_youlose_anim_done);
+            layer = RENDER_LAYER_MIDDLE;
+            break;
+        case ANNOUNCE_YOUWIN:
+            object_set_finish_cb(obj, scene_youwin_anim_done);
+            layer = RENDER_LAYER_MIDDLE;
+            break;
+    }
+    game_state_add_object(sc->gs, obj, layer, 0, 0);
+    return obj;
+}
+
+// Returns the announcer animation the object is playing, or -1
+static int arena_announce_id(scene *sc, object *obj) {
+    for(int id = ANNOUNCE_ROUND; id <= ANNOUNCE_FIGHT; id++) {
+        if(obj->cur_animation == &bk_get_info(&sc->bk_data, id)->ani) {
+            return id;
+        }
+    }
+    return -1;
+}
+
 void scene_fight_anim_done(void *userdata) {
-    object *parent = userdata;
-    scene *scene = game_state_get_scene(parent->gs);
+    game_state *gs = userdata;
+    scene *scene = game_state_get_scene(gs);
     arena_local *arena = scene_get_userdata(scene);
 
     // This will release HARs for action
     arena->state = ARENA_STATE_FIGHTING;
-
-    // Custom object finisher callback requires that we
-    // mark object as finished manually, if necessary.
-    //parent->animation_state.finished = 1;
 }
 
 void scene_fight_anim_start(void *userdata) {
     // Start FIGHT animation
     game_state *gs = userdata;
     scene *scene = game_state_get_scene(gs);
-    animation *fight_ani = &bk_get_info(&scene->bk_data, 10)->ani;
-    object *fight = malloc(sizeof(object));
-    object_create(fight, gs, fight_ani->start_pos, vec2f_create(0,0));
-    object_set_stl(fight, bk_get_stl(&scene->bk_data));
-    object_set_animation(fight, fight_ani);
-    //object_set_finish_cb(fight, scene_fight_anim_done);
-    game_state_add_object(gs, fight, RENDER_LAYER_TOP, 0, 0);
-    ticktimer_add(&scene->tick_timer, 24, scene_fight_anim_done, fight);
+    arena_announce(scene, ANNOUNCE_FIGHT);
+    ticktimer_add(&scene->tick_timer, 24, scene_fight_anim_done, gs);
 }
 
 void scene_ready_anim_done(object *parent) {
@@ -147,16 +190,9 @@ void scene_youwin_anim_done(object *parent) {
 }
 
 void scene_youwin_anim_start(void *userdata) {
-    // Start FIGHT animation
+    // Start YOU WIN animation
     game_state *gs = userdata;
-    scene *scene = game_state_get_scene(gs);
-    animation *youwin_ani = &bk_get_info(&scene->bk_data, 9)->ani;
-    object *youwin = malloc(sizeof(object));
-    object_create(youwin, gs, youwin_ani->start_pos, vec2f_create(0,0));
-    object_set_stl(youwin, bk_get_stl(&scene->bk_data));
-    object_set_animation(youwin, youwin_ani);
-    object_set_finish_cb(youwin, scene_youwin_anim_done);
-    game_state_add_object(gs, youwin, RENDER_LAYER_MIDDLE, 0, 0);
+    arena_announce(game_state_get_scene(gs), ANNOUNCE_YOUWIN);
 
     // This will release HARs for action
     /*arena->state = ARENA_STATE_ENDING;*/
@@ -169,16 +205,9 @@ void scene_youlose_anim_done(object *parent) {
 }
 
 void scene_youlose_anim_start(void *userdata) {
-    // Start FIGHT animation
+    // Start YOU LOSE animation
     game_state *gs = userdata;
-    scene *scene = game_state_get_scene(gs);
-    animation *youlose_ani = &bk_get_info(&scene->bk_data, 8)->ani;
-    object *youlose = malloc(sizeof(object));
-    object_create(youlose, gs, youlose_ani->start_pos, vec2f_create(0,0));
-    object_set_stl(youlose, bk_get_stl(&scene->bk_data));
-    object_set_animation(youlose, youlose_ani);
-    object_set_finish_cb(youlose, scene_youlose_anim_done);
-    game_state_add_object(gs, youlose, RENDER_LAYER_MIDDLE, 0, 0);
+    arena_announce(game_state_get_scene(gs), ANNOUNCE_YOULOSE);
 
     // This will release HARs for action
     /*arena->state = ARENA_STATE_ENDING;*/
@@ -245,7 +274,7 @@ void arena_end(scene *sc) {
     // Switch scene
     if (is_demoplay(sc)) {
         do {
-            next_id = rand_arena();
+            next_id = rand_arena(&gs->rand);
         } while(next_id == sc->id);
         game_state_set_next(gs, next_id);
     }
@@ -291,24 +320,9 @@ void arena_reset(scene *sc) {
     }
 
     sc->bk_data.sound_translation_table[3] = 23 + local->round; // NUMBER
-    // ROUND animation
-    animation *round_ani = &bk_get_info(&sc->bk_data, 6)->ani;
-    object *round = malloc(sizeof(object));
-    object_create(round, sc->gs, round_ani->start_pos, vec2f_create(0,0));
-    object_set_stl(round, sc->bk_data.sound_translation_table);
-    object_set_animation(round, round_ani);
-    object_set_finish_cb(round, scene_ready_anim_done);
-    game_state_add_object(sc->gs, round, RENDER_LAYER_TOP, 0, 0);
-
-    // Round number
-    animation *number_ani = &bk_get_info(&sc->bk_data, 7)->ani;
-    object *number = malloc(sizeof(object));
-    object_create(number, sc->gs, number_ani->start_pos, vec2f_create(0,0));
-    object_set_stl(number, sc->bk_data.sound_translation_table);
-    object_set_animation(number, number_ani);
-    object_select_sprite(number, local->round);
-    object_set_sprite_override(number, 1);
-    game_state_add_object(sc->gs, number, RENDER_LAYER_TOP, 0, 0);
+    // ROUND animation, and the round number
+    arena_announce(sc, ANNOUNCE_ROUND);
+    arena_announce(sc, ANNOUNCE_NUMBER);
 }
 
 void arena_maybe_sync(scene *scene, int need_sync) {
@@ -471,10 +485,10 @@ void arena_har_hit_wall_hook(int player_id, int wall, scene *scene) {
         DEBUG("hit dusty wall %d", wall);
         h->state = STATE_WALLDAMAGE;
 
-        int amount = rand_int(2) + 3;
+        int amount = random_int(&scene->gs->rand, 2) + 3;
         for(int i = 0; i < amount; i++) {
-            int variance = rand_int(20) - 10;
-            int anim_no = rand_int(2) + 24;
+            int variance = random_int(&scene->gs->rand, 20) - 10;
+            int anim_no = random_int(&scene->gs->rand, 2) + 24;
             DEBUG("XXX anim = %d, variance = %d", anim_no, variance);
             int pos_y = o_har->pos.y - object_get_size(o_har).y + variance + i*25;
             vec2i coord = vec2i_create(o_har->pos.x, pos_y);
@@ -706,8 +720,7 @@ void arena_free(scene *scene) {
 
     if (local->rec) {
         write_rec_move(scene, game_state_get_player(scene->gs, 0), ACT_STOP);
-        sd_rec_save(local->rec, scene->gs->init_flags->rec_file);
-        sd_rec_free(local->rec);
+        sd_rec_journal_close(local->rec);
         free(local->rec);
     }
 
@@ -735,7 +748,10 @@ void arena_free(scene *scene) {
         component_free(local->endurance_bars[i]);
     }
 
-    settings_save();
+    // Replays run by the tools don't change the settings, and may run on several threads
+    if(!scene->gs->init_flags->headless) {
+        settings_save();
+    }
 
     free(local);
 }
@@ -788,7 +804,7 @@ void write_rec_move(scene *scene, game_player *player, int action) {
 
     int ret;
 
-    if ((ret = sd_rec_insert_action(local->rec, local->rec->move_count, &move)) != SD_SUCCESS) {
+    if ((ret = sd_rec_journal_append(local->rec, &move)) != SD_SUCCESS) {
         DEBUG("recoding move failed %d", ret);
     }
 }
@@ -837,7 +853,10 @@ int arena_handle_events(scene *scene, game_player *player, ctrl_event *i) {
                 }
             } else if (i->type == EVENT_TYPE_SYNC) {
                 DEBUG("sync");
-                game_state_unserialize(scene->gs, i->event_data.ser, player->ctrl->rtt);
+                int replayed = game_state_unserialize(scene->gs, i->event_data.ser, player->ctrl->rtt);
+                if(player->ctrl->type == CTRL_TYPE_NETWORK) {
+                    net_controller_sync_applied(player->ctrl, replayed);
+                }
                 maybe_install_har_hooks(scene);
             } else if (i->type == EVENT_TYPE_CLOSE) {
                 if (player->ctrl->type == CTRL_TYPE_REC) {
@@ -867,7 +886,7 @@ void arena_spawn_hazard(scene *scene) {
     while((pair = iter_next(&it)) != NULL) {
         bk_info *info = (bk_info*)pair->val;
         if(info->probability > 1) {
-            if (rand_int(info->probability) == 1) {
+            if (random_int(&scene->gs->rand, info->probability) == 1) {
                 // TODO don't spawn it if we already have this animation running
                 object *obj = malloc(sizeof(object));
                 object_create(obj, scene->gs, info->ani.start_pos, vec2f_create(0,0));
@@ -890,7 +909,7 @@ void arena_spawn_hazard(scene *scene) {
                         // the different plane formations.
                         // Pick one, rather than always use the first
 
-                        int r = rand_int(info->ani.extra_string_count);
+                        int r = random_int(&scene->gs->rand, info->ani.extra_string_count);
                         if (r > 0) {
                             str *s = vector_get(&info->ani.extra_strings, r);
                             object_set_custom_string(obj, str_c(s));
@@ -977,13 +996,13 @@ void arena_dynamic_tick(scene *scene, int paused) {
 
         // Pour some rein!
         if(local->rein_enabled) {
-            if(rand_float() > 0.65f) {
-                vec2i pos = vec2i_create(rand_int(NATIVE_W), -10);
+            if(random_float(&scene->gs->rand) > 0.65f) {
+                vec2i pos = vec2i_create(random_int(&scene->gs->rand, NATIVE_W), -10);
                 for(int harnum = 0;harnum < game_state_num_players(gs);harnum++) {
                     object *h_obj = game_state_get_player(gs, harnum)->har;
                     har *h = object_get_userdata(h_obj);
                     // Calculate velocity etc.
-                    float rv = rand_float() - 0.5f;
+                    float rv = random_float(&scene->gs->rand) - 0.5f;
                     float velx = rv;
                     float vely = -12 * sin(0 / 2 + rv);
 
@@ -993,7 +1012,7 @@ void arena_dynamic_tick(scene *scene, int paused) {
 
                     // Create the object
                     object *scrap = malloc(sizeof(object));
-                    int anim_no = rand_int(3) + ANIM_SCRAP_METAL;
+                    int anim_no = random_int(&scene->gs->rand, 3) + ANIM_SCRAP_METAL;
                     object_create(scrap, gs, pos, vec2f_create(velx, vely));
                     object_set_animation(scrap, &af_get_move(h->af_data, anim_no)->ani);
                     object_set_gravity(scrap, 0.4f);
@@ -1001,7 +1020,7 @@ void arena_dynamic_tick(scene *scene, int paused) {
                     object_set_layers(scrap, LAYER_SCRAP);
                     object_set_shadow(scrap, 1);
                     object_dynamic_tick(scrap);
-                    scrap_create(scrap);
+                    scrap_create(scrap, h->af_data);
                     game_state_add_object(gs, scrap, RENDER_LAYER_TOP, 0, 0);
                 }
             }
@@ -1044,6 +1063,23 @@ int arena_event(scene *scene, SDL_Event *e) {
     return 0;
 }
 
+// Live netplay numbers under the ping display, see the "netstats" console command
+static void arena_render_net_stats(controller *ctrl, int right) {
+    net_stats_view v;
+    char lines[4][40];
+    net_stats_get(net_controller_get_stats(ctrl), &v);
+    snprintf(lines[0], 40, "in %uB/s %up/s",
+             v.bytes_in[0] + v.bytes_in[1], v.packets_in[0] + v.packets_in[1]);
+    snprintf(lines[1], 40, "out %uB/s %up/s",
+             v.bytes_out[0] + v.bytes_out[1], v.packets_out[0] + v.packets_out[1]);
+    snprintf(lines[2], 40, "loss %.1f%% resent %u", v.loss, v.resends);
+    snprintf(lines[3], 40, "sync %u rp %u", v.syncs, v.ticks_replayed);
+    for(int i = 0; i < 4; i++) {
+        int x = right ? 315 - (strlen(lines[i]) * font_small.w) : 5;
+        font_render(&font_small, lines[i], x, 48 + i * 8, TEXT_COLOR);
+    }
+}
+
 void arena_render_overlay(scene *scene) {
     arena_local *local = scene_get_userdata(scene);
 
@@ -1055,7 +1091,7 @@ void arena_render_overlay(scene *scene) {
 #ifdef DEBUGMODE
     snprintf(buf, 40, "%u", game_state_get_tick(scene->gs));
     font_render(&font_small, buf, 160, 0, TEXT_COLOR);
-    snprintf(buf, 40, "%u", rand_get_seed());
+    snprintf(buf, 40, "%u", random_get_seed(&scene->gs->rand));
     font_render(&font_small, buf, 130, 8, TEXT_COLOR);
 #endif
     for(int i = 0; i < 2; i++) {
@@ -1111,6 +1147,13 @@ void arena_render_overlay(scene *scene) {
             snprintf(buf, 40, "ping %u", player[1]->ctrl->rtt);
             font_render(&font_small, buf, 315-(strlen(buf)*font_small.w), 40, TEXT_COLOR);
         }
+        if (settings_get()->net.net_stats_overlay) {
+            for (int i = 0; i < 2; i++) {
+                if (player[i]->ctrl->type == CTRL_TYPE_NETWORK) {
+                    arena_render_net_stats(player[i]->ctrl, i);
+                }
+            }
+        }
 
         for (int i = 0; i < 2; i++) {
             for (int j = 0; j < 4; j++) {
@@ -1128,6 +1171,112 @@ void arena_render_overlay(scene *scene) {
     }
 }
 
+// The round, the announcer and its timers: the parts of the arena that the netplay
+// snapshot leaves out, but a replay keyframe needs
+void arena_serialize(scene *sc, serial *ser) {
+    arena_local *local = scene_get_userdata(sc);
+    serial_write_int8(ser, local->state);
+    serial_write_int32(ser, local->ending_ticks);
+    serial_write_int8(ser, local->round);
+    serial_write_int8(ser, local->over);
+    for(int i = 0; i < 2; i++) {
+        serial_write_int8(ser, game_player_get_score(game_state_get_player(sc->gs, i))->rounds);
+    }
+
+    iterator it;
+    object **obj;
+    vector objs;
+    serial announcer;
+    vector_create(&objs, sizeof(object*));
+    game_state_get_objects(sc->gs, &objs);
+    serial_create(&announcer);
+    uint8_t count = 0;
+    vector_iter_begin(&objs, &it);
+    while((obj = iter_next(&it)) != NULL) {
+        int id = arena_announce_id(sc, *obj);
+        if(id >= 0) {
+            serial_write_int8(&announcer, id);
+            serial_write_int16(&announcer, (*obj)->animation_state.current_tick);
+            serial_write_int16(&announcer, (*obj)->animation_state.previous_tick);
+            serial_write_int8(&announcer, (*obj)->animation_state.finished);
+            count++;
+        }
+    }
+    serial_write_int8(ser, count);
+    serial_write(ser, announcer.data, serial_len(&announcer));
+    serial_free(&announcer);
+    vector_free(&objs);
+
+    ticktimer_cb cb;
+    int ticks;
+    void *userdata;
+    serial timers;
+    serial_create(&timers);
+    count = 0;
+    for(unsigned int i = 0; i < ticktimer_size(&sc->tick_timer); i++) {
+        ticktimer_get(&sc->tick_timer, i, &cb, &ticks, &userdata);
+        if(cb == scene_fight_anim_start || cb == scene_fight_anim_done) {
+            serial_write_int8(&timers, cb == scene_fight_anim_done);
+            serial_write_int32(&timers, ticks);
+            count++;
+        } else {
+            DEBUG("Unknown arena timer is not serialized");
+        }
+    }
+    serial_write_int8(ser, count);
+    serial_write(ser, timers.data, serial_len(&timers));
+    serial_free(&timers);
+}
+
+void arena_unserialize(scene *sc, serial *ser) {
+    arena_local *local = scene_get_userdata(sc);
+
+    // Whatever the announcer is doing now makes way for the saved state
+    iterator it;
+    object **obj;
+    vector objs;
+    vector_create(&objs, sizeof(object*));
+    game_state_get_objects(sc->gs, &objs);
+    vector_iter_begin(&objs, &it);
+    while((obj = iter_next(&it)) != NULL) {
+        if(arena_announce_id(sc, *obj) >= 0) {
+            game_state_del_object(sc->gs, *obj);
+        }
+    }
+    vector_free(&objs);
+    ticktimer_clear(&sc->tick_timer);
+
+    local->state = serial_read_int8(ser);
+    local->ending_ticks = serial_read_int32(ser);
+    local->round = serial_read_int8(ser);
+    local->over = serial_read_int8(ser);
+    sc->bk_data.sound_translation_table[3] = 23 + local->round; // NUMBER
+    for(int i = 0; i < 2; i++) {
+        chr_score *score = game_player_get_score(game_state_get_player(sc->gs, i));
+        score->rounds = serial_read_int8(ser);
+        for(int j = 0; j < 4; j++) {
+            if(local->player_rounds[i][j]) {
+                object_select_sprite(local->player_rounds[i][j], j < score->rounds ? 0 : 1);
+            }
+        }
+    }
+
+    int count = serial_read_int8(ser);
+    for(int i = 0; i < count; i++) {
+        object *announce = arena_announce(sc, serial_read_int8(ser));
+        announce->animation_state.current_tick = (uint16_t)serial_read_int16(ser);
+        announce->animation_state.previous_tick = (uint16_t)serial_read_int16(ser);
+        announce->animation_state.finished = serial_read_int8(ser);
+    }
+
+    count = serial_read_int8(ser);
+    for(int i = 0; i < count; i++) {
+        int done = serial_read_int8(ser);
+        int ticks = serial_read_int32(ser);
+        ticktimer_add(&sc->tick_timer, ticks, done ? scene_fight_anim_done : scene_fight_anim_start, sc->gs);
+    }
+}
+
 int arena_get_state(scene *scene) {
     arena_local *local = scene_get_userdata(scene);
     return local->state;
@@ -1405,20 +1554,35 @@ int arena_create(scene *scene) {
 
     // initalize recording, if enabled
     if (scene->gs->init_flags->record == 1) {
-        local->rec = malloc(sizeof(sd_rec_file));
-        sd_rec_create(local->rec);
+        sd_rec_file header;
+        sd_rec_create(&header);
         for(int i = 0; i < 2; i++) {
             // Declare some vars
             game_player *player = game_state_get_player(scene->gs, i);
             DEBUG("player %d using har %d", i, player->har_id);
-            local->rec->pilots[i].info.har_id = (unsigned char)player->har_id;
-            local->rec->pilots[i].info.pilot_id = player->pilot_id;
-            local->rec->pilots[i].info.color_1 = player->colors[2];
-            local->rec->pilots[i].info.color_2 = player->colors[1];
-            local->rec->pilots[i].info.color_3 = player->colors[0];
-            memcpy(local->rec->pilots[i].info.name, lang_get(player->pilot_id+20), 18);
+            header.pilots[i].info.har_id = (unsigned char)player->har_id;
+            header.pilots[i].info.pilot_id = player->pilot_id;
+            header.pilots[i].info.color_1 = player->colors[2];
+            header.pilots[i].info.color_2 = player->colors[1];
+            header.pilots[i].info.color_3 = player->colors[0];
+#ifdef STANDALONE_SERVER
+            // No language file on the server
+            const char *name = pilot_get_name(player->pilot_id);
+            strncpy(header.pilots[i].info.name, (name != NULL) ? name : "", 18);
+#else
+            memcpy(header.pilots[i].info.name, lang_get(player->pilot_id+20), 18);
+#endif
+        }
+        header.arena_id = scene->id - SCENE_ARENA0;
+
+        // Moves are streamed to disk as they happen
+        local->rec = malloc(sizeof(sd_rec_journal));
+        if(sd_rec_journal_open(local->rec, &header, scene->gs->init_flags->rec_file) != SD_SUCCESS) {
+            PERROR("Unable to open %s for recording", scene->gs->init_flags->rec_file);
+            free(local->rec);
+            local->rec = NULL;
         }
-        local->rec->arena_id = scene->id - SCENE_ARENA0;
+        sd_rec_free(&header);
     } else{
         local->rec = NULL;
     }
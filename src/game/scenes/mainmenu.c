@@ -128,8 +128,11 @@ int mainmenu_create(scene *scene) {
         component_action(guiframe_find(local->frame, NETWORK_LISTEN_BUTTON_ID), ACT_PUNCH);
     }
 
-    // clear it, so this only happens the first time
+#ifndef STANDALONE_SERVER
+    // clear it, so this only happens the first time.
+    // A dedicated server keeps it, and goes back to listening after every game.
     scene->gs->net_mode = NET_MODE_NONE;
+#endif
 
     // prev_key is used to prevent multiple clicks while key is down
     local->prev_key[0] = local->prev_key[1] = ACT_PUNCH;
@@ -7,6 +7,7 @@
 #include "game/utils/settings.h"
 #include "game/protos/scene.h"
 #include "game/game_state.h"
+#include "controller/ai_controller.h"
 #include "utils/log.h"
 
 typedef struct {
@@ -42,7 +43,6 @@ void menu_listen_tick(component *c) {
 
             DEBUG("client connected!");
             controller *player1_ctrl, *player2_ctrl;
-            keyboard_keys *keys;
             game_player *p1 = game_state_get_player(gs, 0);
             game_player *p2 = game_state_get_player(gs, 1);
 
@@ -61,9 +61,14 @@ void menu_listen_tick(component *c) {
             controller_init(player2_ctrl);
             player2_ctrl->har = p2->har;
 
+#ifdef STANDALONE_SERVER
+            // Player 1 controller -- the house player on a dedicated server
+            ai_controller_create(player1_ctrl, AI_DIFFICULTY_CHAMPION);
+            ai_controller_set_menu_confirm(player1_ctrl, 50);
+#else
             // Player 1 controller -- Keyboard
             settings_keyboard *k = &settings_get()->keys;
-            keys = malloc(sizeof(keyboard_keys));
+            keyboard_keys *keys = malloc(sizeof(keyboard_keys));
             keys->jump_up = SDL_GetScancodeFromName(k->key1_jump_up);
             keys->jump_right = SDL_GetScancodeFromName(k->key1_jump_right);
             keys->walk_right = SDL_GetScancodeFromName(k->key1_walk_right);
@@ -76,6 +81,7 @@ void menu_listen_tick(component *c) {
             keys->kick = SDL_GetScancodeFromName(k->key1_kick);
             keys->escape = SDL_GetScancodeFromName(k->key1_escape);
             keyboard_create(player1_ctrl, keys, 0);
+#endif
             game_player_set_ctrl(p1, player1_ctrl);
 
             // Player 2 controller -- Network
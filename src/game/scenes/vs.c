@@ -47,14 +47,14 @@ int vs_is_singleplayer(scene *scene) {
     return 0;
 }
 
-vec2i spawn_position(int index, int scientist) {
+vec2i spawn_position(struct random_t *rand, int index, int scientist) {
     switch (index) {
         case 0:
             // top left gantry
             if (scientist) {
                 return vec2i_create(90,80);
             }
-            switch (rand_int(3)) {
+            switch (random_int(rand, 3)) {
                 case 0:
                     // middle
                     return vec2i_create(90,80);
@@ -71,7 +71,7 @@ vec2i spawn_position(int index, int scientist) {
             if (scientist) {
                 return vec2i_create(230,80);
             }
-            switch (rand_int(3)) {
+            switch (random_int(rand, 3)) {
                 case 0:
                     // middle
                     return vec2i_create(230,80);
@@ -363,7 +363,7 @@ int vs_create(scene *scene) {
 	local->arena = 0;
     } else {
         // pick a random arena for 1 player mode
-        local->arena = rand_int(5); // srand was done in melee
+        local->arena = random_int(&scene->gs->rand, 5);
     }
 
     // Arena
@@ -376,8 +376,8 @@ int vs_create(scene *scene) {
 
 
     // SCIENTIST
-    int scientistpos = rand_int(4);
-    vec2i scientistcoord = spawn_position(scientistpos, 1);
+    int scientistpos = random_int(&scene->gs->rand, 4);
+    vec2i scientistcoord = spawn_position(&scene->gs->rand, scientistpos, 1);
     if (scientistpos % 2) {
         scientistcoord.x += 50;
     } else {
@@ -392,16 +392,16 @@ int vs_create(scene *scene) {
     game_state_add_object(scene->gs, o_scientist, RENDER_LAYER_MIDDLE, 0, 0);
 
     // WELDER
-    int welderpos = rand_int(6);
+    int welderpos = random_int(&scene->gs->rand, 6);
     // welder can't be on the same gantry or the same *side* as the scientist
     // he also can't be on the same 'level'
     // but he has 10 possible starting positions
     while ((welderpos % 2)  == (scientistpos % 2) || (scientistpos < 2 && welderpos < 2) || (scientistpos > 1 && welderpos > 1 && welderpos < 4)) {
-        welderpos = rand_int(6);
+        welderpos = random_int(&scene->gs->rand, 6);
     }
     object *o_welder = malloc(sizeof(object));
     ani = &bk_get_info(&scene->bk_data, 7)->ani;
-    object_create(o_welder, scene->gs, spawn_position(welderpos, 0), vec2f_create(0, 0));
+    object_create(o_welder, scene->gs, spawn_position(&scene->gs->rand, welderpos, 0), vec2f_create(0, 0));
     object_set_animation(o_welder, ani);
     object_select_sprite(o_welder, 0);
     object_set_spawn_cb(o_welder, cb_vs_spawn_object, (void*)scene);
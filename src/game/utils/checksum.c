@@ -0,0 +1,202 @@
+#include <string.h>
+#include <stddef.h>
+#include "game/utils/checksum.h"
+#include "game/utils/score.h"
+#include "game/protos/object.h"
+#include "game/objects/har.h"
+
+#define FNV_OFFSET 2166136261U
+#define FNV_PRIME 16777619U
+
+enum {
+    FIELD_INT,
+    FIELD_UINT,
+    FIELD_FLOAT
+};
+
+typedef struct digest_field_t {
+    const char *name;
+    size_t offset;
+    int type;
+} digest_field;
+
+#define DF(name, member, type) { name, offsetof(state_digest, member), type }
+#define DF_HAR(p, member, type) DF("har" #p "." #member, har[p].member, type)
+#define DF_HARS(member, type) DF_HAR(0, member, type), DF_HAR(1, member, type)
+
+// Every field is 32 bits wide; this table drives hashing, the wire format and diffing.
+static const digest_field fields[] = {
+    DF("tick", tick, FIELD_UINT),
+    DF("seed", seed, FIELD_UINT),
+    DF("paused", paused, FIELD_INT),
+    DF("projectiles", projectiles, FIELD_INT),
+    DF("projectile_hash", projectile_hash, FIELD_UINT),
+    DF("score0", score[0], FIELD_INT),
+    DF("score1", score[1], FIELD_INT),
+    DF_HARS(pos_x, FIELD_FLOAT),
+    DF_HARS(pos_y, FIELD_FLOAT),
+    DF_HARS(vel_x, FIELD_FLOAT),
+    DF_HARS(vel_y, FIELD_FLOAT),
+    DF_HARS(direction, FIELD_INT),
+    DF_HARS(animation, FIELD_INT),
+    DF_HARS(anim_tick, FIELD_INT),
+    DF_HARS(state, FIELD_INT),
+    DF_HARS(executing_move, FIELD_INT),
+    DF_HARS(health, FIELD_INT),
+    DF_HARS(endurance, FIELD_FLOAT),
+    DF_HARS(stun_timer, FIELD_INT),
+    DF_HARS(stasis_ticks, FIELD_INT),
+};
+#define FIELD_COUNT (sizeof(fields) / sizeof(digest_field))
+
+static uint32_t field_get(const state_digest *d, const digest_field *f) {
+    uint32_t v;
+    memcpy(&v, (const char*)d + f->offset, sizeof(uint32_t));
+    return v;
+}
+
+static void field_set(state_digest *d, const digest_field *f, uint32_t v) {
+    memcpy((char*)d + f->offset, &v, sizeof(uint32_t));
+}
+
+static uint32_t fnv_mix(uint32_t hash, uint32_t v) {
+    for(int i = 0; i < 4; i++) {
+        hash ^= (v >> (i * 8)) & 0xFF;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static uint32_t float_bits(float f) {
+    uint32_t v;
+    memcpy(&v, &f, sizeof(uint32_t));
+    return v;
+}
+
+void state_digest_begin(state_digest *d, uint32_t tick, uint32_t seed, int paused) {
+    memset(d, 0, sizeof(state_digest));
+    d->tick = tick;
+    d->seed = seed;
+    d->paused = paused;
+    d->projectile_hash = FNV_OFFSET;
+}
+
+void state_digest_har(state_digest *d, int player_id, const object *obj) {
+    digest_har *dh = &d->har[player_id];
+    if(obj == NULL) {
+        return;
+    }
+    dh->pos_x = obj->pos.x;
+    dh->pos_y = obj->pos.y;
+    dh->vel_x = obj->vel.x;
+    dh->vel_y = obj->vel.y;
+    dh->direction = obj->direction;
+    dh->animation = obj->cur_animation ? obj->cur_animation->id : -1;
+    dh->anim_tick = obj->animation_state.current_tick;
+
+    const har *h = object_get_userdata(obj);
+    if(h == NULL) {
+        return;
+    }
+    dh->state = h->state;
+    dh->executing_move = h->executing_move;
+    dh->health = h->health;
+    dh->endurance = h->endurance;
+    dh->stun_timer = h->stun_timer;
+    dh->stasis_ticks = h->in_stasis_ticks;
+}
+
+void state_digest_projectile(state_digest *d, const object *obj) {
+    // Projectiles are folded in order; both peers keep them in the same order.
+    uint32_t hash = d->projectile_hash;
+    hash = fnv_mix(hash, float_bits(obj->pos.x));
+    hash = fnv_mix(hash, float_bits(obj->pos.y));
+    hash = fnv_mix(hash, float_bits(obj->vel.x));
+    hash = fnv_mix(hash, float_bits(obj->vel.y));
+    hash = fnv_mix(hash, obj->cur_animation ? obj->cur_animation->id : 0xFFFFFFFF);
+    hash = fnv_mix(hash, obj->animation_state.current_tick);
+    d->projectile_hash = hash;
+    d->projectiles++;
+}
+
+void state_digest_score(state_digest *d, int player_id, const chr_score *score) {
+    d->score[player_id] = score->score;
+}
+
+void state_digest_finish(state_digest *d) {
+    uint32_t hash = FNV_OFFSET;
+    for(unsigned i = 0; i < FIELD_COUNT; i++) {
+        hash = fnv_mix(hash, field_get(d, &fields[i]));
+    }
+    d->hash = hash;
+}
+
+void state_digest_serialize(const state_digest *d, serial *ser) {
+    for(unsigned i = 0; i < FIELD_COUNT; i++) {
+        serial_write_int32(ser, field_get(d, &fields[i]));
+    }
+    serial_write_int32(ser, d->hash);
+}
+
+void state_digest_unserialize(state_digest *d, serial *ser) {
+    memset(d, 0, sizeof(state_digest));
+    for(unsigned i = 0; i < FIELD_COUNT; i++) {
+        field_set(d, &fields[i], serial_read_int32(ser));
+    }
+    d->hash = serial_read_int32(ser);
+}
+
+static void field_print(FILE *out, const state_digest *d, const digest_field *f) {
+    uint32_t v = field_get(d, f);
+    switch(f->type) {
+        case FIELD_INT: fprintf(out, "%16d", (int32_t)v); break;
+        case FIELD_UINT: fprintf(out, "%16u", v); break;
+        case FIELD_FLOAT: {
+                float fv;
+                memcpy(&fv, &v, sizeof(float));
+                fprintf(out, "%16.6f", fv);
+            }
+            break;
+    }
+}
+
+int state_digest_diff(const state_digest *local, const state_digest *remote, FILE *out) {
+    int differ = 0;
+    if(out) {
+        fprintf(out, "%-24s %16s %16s\n", "field", "local", "remote");
+    }
+    for(unsigned i = 0; i < FIELD_COUNT; i++) {
+        const digest_field *f = &fields[i];
+        int mismatch = (field_get(local, f) != field_get(remote, f));
+        differ += mismatch;
+        if(out) {
+            fprintf(out, "%-24s ", f->name);
+            field_print(out, local, f);
+            fprintf(out, " ");
+            field_print(out, remote, f);
+            fprintf(out, "%s\n", mismatch ? "  <--" : "");
+        }
+    }
+    if(out) {
+        fprintf(out, "%-24s %16x %16x\n", "hash", local->hash, remote->hash);
+    }
+    return differ;
+}
+
+void digest_ring_clear(digest_ring *ring) {
+    for(int i = 0; i < DIGEST_HISTORY; i++) {
+        ring->entries[i].tick = UINT32_MAX;
+    }
+}
+
+void digest_ring_push(digest_ring *ring, const state_digest *d) {
+    ring->entries[d->tick % DIGEST_HISTORY] = *d;
+}
+
+const state_digest* digest_ring_get(const digest_ring *ring, uint32_t tick) {
+    const state_digest *d = &ring->entries[tick % DIGEST_HISTORY];
+    if(d->tick != tick) {
+        return NULL;
+    }
+    return d;
+}
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "game/utils/keyframes.h"
+#include "utils/log.h"
+
+#define KEYFRAME_MAGIC 0x4F4B4649 // "OKFI"
+#define KEYFRAME_VERSION 2
+
+void keyframe_index_create(keyframe_index *idx, long rec_size) {
+    vector_create(&idx->frames, sizeof(keyframe));
+    idx->rec_size = rec_size;
+    idx->dirty = 0;
+}
+
+static void keyframe_index_clear(keyframe_index *idx) {
+    iterator it;
+    keyframe *kf;
+    vector_iter_begin(&idx->frames, &it);
+    while((kf = iter_next(&it)) != NULL) {
+        serial_free(&kf->state);
+    }
+    vector_clear(&idx->frames);
+}
+
+void keyframe_index_free(keyframe_index *idx) {
+    keyframe_index_clear(idx);
+    vector_free(&idx->frames);
+}
+
+static keyframe* keyframe_index_last(const keyframe_index *idx) {
+    unsigned int size = vector_size(&idx->frames);
+    if(size == 0) {
+        return NULL;
+    }
+    return vector_get(&idx->frames, size - 1);
+}
+
+int keyframe_index_wants(const keyframe_index *idx, int tick) {
+    // The first arena tick is always kept, so every point of the match can be reached.
+    // Frames are only ever appended, so the list stays sorted by tick
+    keyframe *last = keyframe_index_last(idx);
+    if(last == NULL) {
+        return 1;
+    }
+    return (tick % KEYFRAME_INTERVAL == 0 && tick > last->tick);
+}
+
+void keyframe_index_add(keyframe_index *idx, int tick, const serial *state) {
+    keyframe kf;
+    kf.tick = tick;
+    serial_copy(&kf.state, state);
+    vector_append(&idx->frames, &kf);
+    idx->dirty = 1;
+}
+
+const keyframe* keyframe_index_find(const keyframe_index *idx, int tick) {
+    int lo = 0;
+    int hi = (int)vector_size(&idx->frames) - 1;
+    const keyframe *found = NULL;
+    while(lo <= hi) {
+        int mid = (lo + hi) / 2;
+        const keyframe *kf = vector_get(&idx->frames, mid);
+        if(kf->tick <= tick) {
+            found = kf;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return found;
+}
+
+int keyframe_index_load(keyframe_index *idx, const char *filename) {
+    FILE *f = fopen(filename, "rb");
+    if(f == NULL) {
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if(size < 16) {
+        goto error_0;
+    }
+    char *buf = malloc(size);
+    if(fread(buf, 1, size, f) != (size_t)size) {
+        goto error_1;
+    }
+
+    serial ser;
+    serial_create_from(&ser, buf, size);
+    if(serial_read_int32(&ser) != KEYFRAME_MAGIC
+        || serial_read_int32(&ser) != KEYFRAME_VERSION
+        || serial_read_int32(&ser) != KEYFRAME_INTERVAL
+        || serial_read_int32(&ser) != (int32_t)idx->rec_size) {
+        DEBUG("Keyframe index %s is stale, ignoring it", filename);
+        goto error_2;
+    }
+    int count = serial_read_int32(&ser);
+    for(int i = 0; i < count; i++) {
+        int tick = serial_read_int32(&ser);
+        int len = serial_read_int32(&ser);
+        if(len < 0 || ser.rpos + len > serial_len(&ser)) {
+            DEBUG("Keyframe index %s is cut short, ignoring it", filename);
+            goto error_3;
+        }
+        keyframe kf;
+        kf.tick = tick;
+        serial_create_from(&kf.state, ser.data + ser.rpos, len);
+        ser.rpos += len;
+        vector_append(&idx->frames, &kf);
+    }
+    DEBUG("Loaded %d keyframes from %s", count, filename);
+
+    serial_free(&ser);
+    free(buf);
+    fclose(f);
+    return 0;
+
+error_3:
+    // Frames read before the damage are dropped too; they get built again during playback
+    keyframe_index_clear(idx);
+error_2:
+    serial_free(&ser);
+error_1:
+    free(buf);
+error_0:
+    fclose(f);
+    return 1;
+}
+
+int keyframe_index_save(keyframe_index *idx, const char *filename) {
+    serial ser;
+    serial_create(&ser);
+    serial_write_int32(&ser, KEYFRAME_MAGIC);
+    serial_write_int32(&ser, KEYFRAME_VERSION);
+    serial_write_int32(&ser, KEYFRAME_INTERVAL);
+    serial_write_int32(&ser, idx->rec_size);
+    serial_write_int32(&ser, vector_size(&idx->frames));
+
+    iterator it;
+    keyframe *kf;
+    vector_iter_begin(&idx->frames, &it);
+    while((kf = iter_next(&it)) != NULL) {
+        serial_write_int32(&ser, kf->tick);
+        serial_write_int32(&ser, serial_len(&kf->state));
+        serial_write(&ser, kf->state.data, serial_len(&kf->state));
+    }
+
+    int ret = 1;
+    FILE *f = fopen(filename, "wb");
+    if(f != NULL) {
+        if(fwrite(ser.data, 1, serial_len(&ser), f) == serial_len(&ser)) {
+            ret = 0;
+            idx->dirty = 0;
+        }
+        fclose(f);
+    }
+    if(ret) {
+        PERROR("Unable to write keyframe index %s", filename);
+    }
+    serial_free(&ser);
+    return ret;
+}
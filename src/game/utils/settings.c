@@ -56,6 +56,7 @@ const field f_video[] = {
     F_BOOL(settings_video, crossfade_on,     1),
     F_STRING(settings_video, scaler, "Nearest"),
     F_INT(settings_video,  scale_factor,     1),
+    F_INT(settings_video,  texture_cache_mb, 64),
 };
 
 const field f_sound[] = {
@@ -142,7 +143,8 @@ const field f_keyboard[] = {
 const field f_net[] = {
     F_STRING(settings_network, net_connect_ip,   "localhost"),
     F_INT(settings_network,    net_connect_port, 2097),
-    F_INT(settings_network,    net_listen_port, 2097)
+    F_INT(settings_network,    net_listen_port, 2097),
+    F_BOOL(settings_network,   net_stats_overlay, 0)
 };
 
 // Map struct to field
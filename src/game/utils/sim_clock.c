@@ -0,0 +1,32 @@
+#include "game/utils/sim_clock.h"
+
+#define SIM_SLICE_MS 10
+
+void sim_clock_init(sim_clock *clock) {
+    clock->carry = 0.0f;
+    clock->pending = 0;
+}
+
+void sim_clock_start(sim_clock *clock, int dt, float playback) {
+    clock->pending = 0;
+    if(playback > 0.0f) {
+        clock->carry += dt * playback;
+        clock->pending = (int)clock->carry;
+        clock->carry -= clock->pending;
+    }
+}
+
+int sim_clock_next(sim_clock *clock, float playback, int unbounded) {
+    int endless = (playback == 0.0f && unbounded);
+    if(clock->pending <= 0 && !endless) {
+        return 0;
+    }
+
+    // Off-speed replays advance in slices, so static and dynamic ticks interleave like at 1x
+    int step = (playback == 1.0f) ? clock->pending : SIM_SLICE_MS;
+    if(!endless && step > clock->pending) {
+        step = clock->pending;
+    }
+    clock->pending = (step < clock->pending) ? clock->pending - step : 0;
+    return step;
+}
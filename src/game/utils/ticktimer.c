@@ -37,3 +37,22 @@ void ticktimer_run(ticktimer *tt) {
         }
     }
 }
+
+unsigned int ticktimer_size(ticktimer *tt) {
+    return vector_size(&tt->units);
+}
+
+int ticktimer_get(ticktimer *tt, unsigned int n, ticktimer_cb *cb, int *ticks, void **userdata) {
+    ticktimer_unit *unit = vector_get(&tt->units, n);
+    if(unit == NULL) {
+        return 1;
+    }
+    *cb = unit->callback;
+    *ticks = unit->ticks;
+    *userdata = unit->userdata;
+    return 0;
+}
+
+void ticktimer_clear(ticktimer *tt) {
+    vector_clear(&tt->units);
+}
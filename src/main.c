@@ -1,3 +1,4 @@
+#include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 #include <time.h>
@@ -5,7 +6,7 @@
 #include <stdio.h>
 #include <SDL.h>
 #include <argtable2.h>
-#ifdef USE_DUMB
+#if defined(USE_DUMB) && !defined(STANDALONE_SERVER)
 #include <dumb.h>
 #endif
 #include <enet/enet.h>
@@ -14,6 +15,9 @@
 #include "utils/random.h"
 #include "utils/msgbox.h"
 #include "game/game_state.h"
+#include "game/replay.h"
+#include "game/replay_export.h"
+#include "game/render_check.h"
 #include "game/utils/settings.h"
 #include "resources/pathmanager.h"
 #include "resources/ids.h"
@@ -36,6 +40,9 @@ int main(int argc, char *argv[]) {
     engine_init_flags init_flags;
     init_flags.net_mode = NET_MODE_NONE;
     init_flags.record = 0;
+    init_flags.headless = 0;
+    init_flags.seed = 0;
+    init_flags.seek_index = 0;
     memset(init_flags.rec_file, 0, 255);
     int ret = 0;
 
@@ -53,9 +60,24 @@ int main(int argc, char *argv[]) {
     struct arg_int *port = arg_int0("p", "port", "<port>","Port to connect or listen (default: 2097)");
     struct arg_file *play = arg_file0("P", "play", "<file>", "Play an existing recfile");
     struct arg_file *rec = arg_file0("R", "rec", "<file>", "Record a new recfile");
+    struct arg_lit *seek_index = arg_lit0(NULL, "seek-index", "Keep a seek index of the --play recfile in <file>.idx, for seeking at once next time");
+    struct arg_file *export = arg_file0("E", "export", "<file>", "Render the --play recfile to a .y4m video, or to PNG files with this prefix");
+    struct arg_int *export_scale = arg_int0(NULL, "export-scale", "<factor>", "Export frame scale (default: 1)");
+    struct arg_int *export_fps = arg_int0(NULL, "export-fps", "<fps>", "Export frame rate (default: 50)");
+    struct arg_int *export_jobs = arg_int0(NULL, "export-jobs", "<number>", "Export encoding threads (default: one per CPU)");
+    struct arg_file *golden = arg_file0(NULL, "golden", "<dir>", "Compare frames of the --play recfile, or of --golden-scene, with PNG files in this directory");
+    struct arg_int *golden_scene = arg_int0(NULL, "golden-scene", "<id>", "Scene to check when there is no recfile");
+    struct arg_str *golden_ticks = arg_str0(NULL, "golden-ticks", "<list>", "Comma separated ticks to check (default: 100)");
+    struct arg_int *golden_tolerance = arg_int0(NULL, "golden-tolerance", "<value>", "Allowed difference per color channel (default: 0)");
+    struct arg_lit *golden_write = arg_lit0(NULL, "golden-write", "Store the frames as the new golden images");
     struct arg_end *end = arg_end(30);
-    void* argtable[] = {help, vers, listen, connect, port, play, rec, end};
+    void* argtable[] = {help, vers, listen, connect, port, play, rec, seek_index, export, export_scale, export_fps, export_jobs,
+                        golden, golden_scene, golden_ticks, golden_tolerance, golden_write, end};
+#ifdef STANDALONE_SERVER
+    const char* progname = "openomf_server";
+#else
     const char* progname = "openomf";
+#endif
 
     // Make sure everything got allocated
     if(arg_nullcheck(argtable) != 0) {
@@ -107,12 +129,75 @@ int main(int argc, char *argv[]) {
     }
     else if(play->count > 0) {
         strncpy(init_flags.rec_file, play->filename[0], 254);
+        init_flags.seek_index = (seek_index->count > 0);
     }
     else if(rec->count > 0) {
         init_flags.record = 1;
         strncpy(init_flags.rec_file, rec->filename[0], 254);
     }
 
+    // Exports render a recording without a window
+    replay_export_opts export_opts;
+    int exporting = (export->count > 0);
+    if(exporting) {
+        if(play->count <= 0) {
+            fprintf(stderr, "--export needs a recfile to play (--play).\n");
+            goto exit_0;
+        }
+        export_opts.file = export->filename[0];
+        export_opts.scale = (export_scale->count > 0) ? export_scale->ival[0] : 1;
+        export_opts.fps = (export_fps->count > 0) ? export_fps->ival[0] : 50;
+        export_opts.jobs = (export_jobs->count > 0) ? export_jobs->ival[0] : 0;
+        if(export_opts.scale < 1 || export_opts.scale > 8 || export_opts.fps < 1 || export_opts.fps > 100) {
+            fprintf(stderr, "Export scale must be 1-8 and frame rate 1-100.\n");
+            goto exit_0;
+        }
+    }
+
+    // Golden image checks render without a window as well
+    render_check_opts check_opts;
+    int checking = (golden->count > 0);
+    if(checking) {
+        if(play->count <= 0 && golden_scene->count <= 0) {
+            fprintf(stderr, "--golden needs a recfile to play (--play) or a scene (--golden-scene).\n");
+            goto exit_0;
+        }
+        memset(&check_opts, 0, sizeof(check_opts));
+        check_opts.dir = golden->filename[0];
+        check_opts.rec_file = (play->count > 0) ? init_flags.rec_file : NULL;
+        check_opts.scene = (golden_scene->count > 0) ? golden_scene->ival[0] : 0;
+        check_opts.tolerance = (golden_tolerance->count > 0) ? golden_tolerance->ival[0] : 0;
+        check_opts.write = (golden_write->count > 0);
+        const char *list = (golden_ticks->count > 0) ? golden_ticks->sval[0] : "100";
+        char *next;
+        while(*list != 0 && check_opts.tick_count < RENDER_CHECK_MAX_TICKS) {
+            unsigned long tick = strtoul(list, &next, 10);
+            if(next == list || (*next != ',' && *next != 0)
+               || (check_opts.tick_count > 0 && tick <= check_opts.ticks[check_opts.tick_count - 1])) {
+                fprintf(stderr, "--golden-ticks must be a list of ascending numbers.\n");
+                goto exit_0;
+            }
+            check_opts.ticks[check_opts.tick_count++] = tick;
+            list = (*next == ',') ? next + 1 : next;
+        }
+    }
+
+#ifdef STANDALONE_SERVER
+    // The dedicated server always hosts. Recording is allowed, playback is not.
+    if(init_flags.net_mode != NET_MODE_SERVER) {
+        init_flags.net_mode = NET_MODE_SERVER;
+        listen_port = 2097;
+        if(port->count > 0) {
+            listen_port = port->ival[0] & 0xFFFF;
+        }
+    }
+    if(!init_flags.record) {
+        memset(init_flags.rec_file, 0, 255);
+    }
+    exporting = 0;
+    checking = 0;
+#endif
+
     // Init log
 #if defined(DEBUGMODE) || defined(STANDALONE_SERVER)
     if(log_init(0)) {
@@ -139,6 +224,12 @@ int main(int argc, char *argv[]) {
 
     // Random seed
     rand_seed(time(NULL));
+    init_flags.seed = rand_intmax();
+
+    // Matches that are recorded, or played back, use the same seed as the replay tools
+    if(strlen(init_flags.rec_file) > 0) {
+        init_flags.seed = REPLAY_SEED;
+    }
 
     // Init config
     if(settings_init(pm_get_local_path(CONFIG_PATH))) {
@@ -172,7 +263,9 @@ int main(int argc, char *argv[]) {
     // Init SDL2
     unsigned int sdl_flags = SDL_INIT_TIMER;
 #ifndef STANDALONE_SERVER
-    sdl_flags |= SDL_INIT_VIDEO;
+    if(!exporting && !checking) {
+        sdl_flags |= SDL_INIT_VIDEO;
+    }
 #endif
     if(SDL_Init(sdl_flags)) {
         err_msgbox("SDL2 Initialization failed: %s", SDL_GetError());
@@ -184,6 +277,26 @@ int main(int argc, char *argv[]) {
     INFO("Running on platform: %s", SDL_GetPlatform());
 
 #ifndef STANDALONE_SERVER
+    if(exporting) {
+        // Nothing to play on; go straight to rendering
+        if(engine_init_offscreen()) {
+            err_msgbox("Failed to initialize game engine.");
+            goto exit_3;
+        }
+        ret = replay_export(init_flags.rec_file, &export_opts);
+        engine_close();
+        goto exit_3;
+    }
+    if(checking) {
+        if(engine_init_offscreen()) {
+            err_msgbox("Failed to initialize game engine.");
+            goto exit_3;
+        }
+        ret = render_check(&check_opts);
+        engine_close();
+        goto exit_3;
+    }
+
     if(SDL_InitSubSystem(SDL_INIT_JOYSTICK|SDL_INIT_GAMECONTROLLER|SDL_INIT_HAPTIC)) {
         err_msgbox("SDL2 Initialization failed: %s", SDL_GetError());
         goto exit_2;
@@ -255,7 +368,7 @@ exit_4:
 exit_3:
     SDL_Quit();
 exit_2:
-#ifdef USE_DUMB
+#if defined(USE_DUMB) && !defined(STANDALONE_SERVER)
     dumb_exit();
 #endif
     settings_save();
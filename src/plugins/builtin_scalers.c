@@ -0,0 +1,587 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "plugins/builtin_scalers.h"
+#include "utils/thread_pool.h"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define SCALER_SSE2
+#include <emmintrin.h>
+#endif
+
+// Below this many source pixels, waking up the workers costs more than it saves
+#define MIN_THREADED_PIXELS (64 * 64)
+#define MIN_BAND_ROWS 8
+
+typedef void (*scale_rows_func)(const uint32_t *in, uint32_t *out, int w, int h, int y0, int y1);
+
+typedef struct scale_job_t {
+    scale_rows_func rows;
+    const uint32_t *in;
+    uint32_t *out;
+    int w;
+    int h;
+} scale_job;
+
+static thread_pool pool;
+static int pool_threads = -1;
+static int pool_running = 0;
+
+// Scale4x runs Scale2x twice; this holds the image in between
+static uint32_t *scale4x_tmp = NULL;
+static size_t scale4x_tmp_size = 0;
+
+// Pixels outside the image repeat the edge
+static inline uint32_t px_at(const uint32_t *in, int w, int h, int x, int y) {
+    x = (x < 0) ? 0 : ((x >= w) ? w - 1 : x);
+    y = (y < 0) ? 0 : ((y >= h) ? h - 1 : y);
+    return in[y * w + x];
+}
+
+// Nearest neighbour -----------------------------------------------------------
+
+static inline void nearest_row(const uint32_t *src, uint32_t *dst, int w, int f) {
+    int x = 0;
+#ifdef SCALER_SSE2
+    if(f == 2) {
+        for(; x + 4 <= w; x += 4) {
+            __m128i p = _mm_loadu_si128((const __m128i*)(src + x));
+            _mm_storeu_si128((__m128i*)(dst + x * 2), _mm_unpacklo_epi32(p, p));
+            _mm_storeu_si128((__m128i*)(dst + x * 2 + 4), _mm_unpackhi_epi32(p, p));
+        }
+    } else if(f == 3) {
+        for(; x + 4 <= w; x += 4) {
+            __m128i p = _mm_loadu_si128((const __m128i*)(src + x));
+            _mm_storeu_si128((__m128i*)(dst + x * 3), _mm_shuffle_epi32(p, _MM_SHUFFLE(1, 0, 0, 0)));
+            _mm_storeu_si128((__m128i*)(dst + x * 3 + 4), _mm_shuffle_epi32(p, _MM_SHUFFLE(2, 2, 1, 1)));
+            _mm_storeu_si128((__m128i*)(dst + x * 3 + 8), _mm_shuffle_epi32(p, _MM_SHUFFLE(3, 3, 3, 2)));
+        }
+    } else if(f == 4) {
+        for(; x + 4 <= w; x += 4) {
+            __m128i p = _mm_loadu_si128((const __m128i*)(src + x));
+            __m128i lo = _mm_unpacklo_epi32(p, p);
+            __m128i hi = _mm_unpackhi_epi32(p, p);
+            _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_unpacklo_epi64(lo, lo));
+            _mm_storeu_si128((__m128i*)(dst + x * 4 + 4), _mm_unpackhi_epi64(lo, lo));
+            _mm_storeu_si128((__m128i*)(dst + x * 4 + 8), _mm_unpacklo_epi64(hi, hi));
+            _mm_storeu_si128((__m128i*)(dst + x * 4 + 12), _mm_unpackhi_epi64(hi, hi));
+        }
+    }
+#endif
+    for(; x < w; x++) {
+        for(int k = 0; k < f; k++) {
+            dst[x * f + k] = src[x];
+        }
+    }
+}
+
+static inline void nearest_rows(const uint32_t *in, uint32_t *out, int w, int f, int y0, int y1) {
+    int ow = w * f;
+    for(int y = y0; y < y1; y++) {
+        uint32_t *dst = out + (size_t)y * f * ow;
+        nearest_row(in + y * w, dst, w, f);
+        for(int r = 1; r < f; r++) {
+            memcpy(dst + r * ow, dst, ow * 4);
+        }
+    }
+}
+
+static void nearest2x_rows(const uint32_t *in, uint32_t *out, int w, int h, int y0, int y1) {
+    nearest_rows(in, out, w, 2, y0, y1);
+}
+
+static void nearest3x_rows(const uint32_t *in, uint32_t *out, int w, int h, int y0, int y1) {
+    nearest_rows(in, out, w, 3, y0, y1);
+}
+
+static void nearest4x_rows(const uint32_t *in, uint32_t *out, int w, int h, int y0, int y1) {
+    nearest_rows(in, out, w, 4, y0, y1);
+}
+
+// Scale2x ---------------------------------------------------------------------
+//
+//   B        E0 E1
+// D E F  ->  E2 E3
+//   H
+
+static inline void scale2x_px(const uint32_t *in, uint32_t *d0, uint32_t *d1, int w, int h, int x, int y) {
+    uint32_t B = px_at(in, w, h, x, y - 1);
+    uint32_t D = px_at(in, w, h, x - 1, y);
+    uint32_t E = in[y * w + x];
+    uint32_t F = px_at(in, w, h, x + 1, y);
+    uint32_t H = px_at(in, w, h, x, y + 1);
+    if(B != H && D != F) {
+        d0[x * 2] = (D == B) ? D : E;
+        d0[x * 2 + 1] = (B == F) ? F : E;
+        d1[x * 2] = (D == H) ? D : E;
+        d1[x * 2 + 1] = (H == F) ? F : E;
+    } else {
+        d0[x * 2] = E;
+        d0[x * 2 + 1] = E;
+        d1[x * 2] = E;
+        d1[x * 2 + 1] = E;
+    }
+}
+
+#ifdef SCALER_SSE2
+static inline __m128i select_px(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+#endif
+
+static void scale2x_rows(const uint32_t *in, uint32_t *out, int w, int h, int y0, int y1) {
+    int ow = w * 2;
+    for(int y = y0; y < y1; y++) {
+        uint32_t *d0 = out + (size_t)y * 2 * ow;
+        uint32_t *d1 = d0 + ow;
+        int x = 0;
+        scale2x_px(in, d0, d1, w, h, x++, y);
+#ifdef SCALER_SSE2
+        const uint32_t *up = in + ((y > 0) ? y - 1 : y) * w;
+        const uint32_t *row = in + y * w;
+        const uint32_t *dn = in + ((y < h - 1) ? y + 1 : y) * w;
+        const __m128i ones = _mm_set1_epi32(-1);
+        for(; x + 5 <= w; x += 4) {
+            __m128i B = _mm_loadu_si128((const __m128i*)(up + x));
+            __m128i D = _mm_loadu_si128((const __m128i*)(row + x - 1));
+            __m128i E = _mm_loadu_si128((const __m128i*)(row + x));
+            __m128i F = _mm_loadu_si128((const __m128i*)(row + x + 1));
+            __m128i H = _mm_loadu_si128((const __m128i*)(dn + x));
+            __m128i cond = _mm_andnot_si128(_mm_cmpeq_epi32(B, H), _mm_xor_si128(_mm_cmpeq_epi32(D, F), ones));
+            __m128i e0 = select_px(_mm_and_si128(cond, _mm_cmpeq_epi32(D, B)), D, E);
+            __m128i e1 = select_px(_mm_and_si128(cond, _mm_cmpeq_epi32(B, F)), F, E);
+            __m128i e2 = select_px(_mm_and_si128(cond, _mm_cmpeq_epi32(D, H)), D, E);
+            __m128i e3 = select_px(_mm_and_si128(cond, _mm_cmpeq_epi32(H, F)), F, E);
+            _mm_storeu_si128((__m128i*)(d0 + x * 2), _mm_unpacklo_epi32(e0, e1));
+            _mm_storeu_si128((__m128i*)(d0 + x * 2 + 4), _mm_unpackhi_epi32(e0, e1));
+            _mm_storeu_si128((__m128i*)(d1 + x * 2), _mm_unpacklo_epi32(e2, e3));
+            _mm_storeu_si128((__m128i*)(d1 + x * 2 + 4), _mm_unpackhi_epi32(e2, e3));
+        }
+#endif
+        for(; x < w; x++) {
+            scale2x_px(in, d0, d1, w, h, x, y);
+        }
+    }
+}
+
+// Scale3x ---------------------------------------------------------------------
+//
+// A B C      E0 E1 E2
+// D E F  ->  E3 E4 E5
+// G H I      E6 E7 E8
+
+static void scale3x_rows(const uint32_t *in, uint32_t *out, int w, int h, int y0, int y1) {
+    int ow = w * 3;
+    for(int y = y0; y < y1; y++) {
+        uint32_t *d0 = out + (size_t)y * 3 * ow;
+        uint32_t *d1 = d0 + ow;
+        uint32_t *d2 = d1 + ow;
+        for(int x = 0; x < w; x++) {
+            uint32_t A = px_at(in, w, h, x - 1, y - 1);
+            uint32_t B = px_at(in, w, h, x, y - 1);
+            uint32_t C = px_at(in, w, h, x + 1, y - 1);
+            uint32_t D = px_at(in, w, h, x - 1, y);
+            uint32_t E = in[y * w + x];
+            uint32_t F = px_at(in, w, h, x + 1, y);
+            uint32_t G = px_at(in, w, h, x - 1, y + 1);
+            uint32_t H = px_at(in, w, h, x, y + 1);
+            uint32_t I = px_at(in, w, h, x + 1, y + 1);
+            uint32_t *p0 = d0 + x * 3;
+            uint32_t *p1 = d1 + x * 3;
+            uint32_t *p2 = d2 + x * 3;
+            if(B != H && D != F) {
+                p0[0] = (D == B) ? D : E;
+                p0[1] = ((D == B && E != C) || (B == F && E != A)) ? B : E;
+                p0[2] = (B == F) ? F : E;
+                p1[0] = ((D == B && E != G) || (D == H && E != A)) ? D : E;
+                p1[1] = E;
+                p1[2] = ((B == F && E != I) || (H == F && E != C)) ? F : E;
+                p2[0] = (D == H) ? D : E;
+                p2[1] = ((D == H && E != I) || (H == F && E != G)) ? H : E;
+                p2[2] = (H == F) ? F : E;
+            } else {
+                p0[0] = p0[1] = p0[2] = E;
+                p1[0] = p1[1] = p1[2] = E;
+                p2[0] = p2[1] = p2[2] = E;
+            }
+        }
+    }
+}
+
+// HQ2x ------------------------------------------------------------------------
+//
+// Maxim Stepin's hq2x, giving the same pixels as libhqx that the HQX plugin is
+// built on. Each output pixel is picked by which of the eight neighbours look
+// different from the centre in YUV. The 256 cases of the original tables are
+// written as the pattern conditions of FFmpeg's hqx filter, for the top left
+// pixel; the other three mirror the neighbourhood.
+//
+// 0 1 2      00 01
+// 3 4 5  ->  10 11
+// 6 7 8
+
+#define HQX_TR_Y 48
+#define HQX_TR_U 7
+#define HQX_TR_V 6
+
+// Same arithmetic as the libhqx lookup table, which leaves its very last
+// entry, 0xFFFFFF, at zero
+static inline uint32_t hqx_yuv(uint32_t c) {
+    uint32_t r = (c >> 16) & 0xFF;
+    uint32_t g = (c >> 8) & 0xFF;
+    uint32_t b = c & 0xFF;
+    if((c & 0xFFFFFF) == 0xFFFFFF) {
+        return 0;
+    }
+    uint32_t y = (uint32_t)(0.299 * r + 0.587 * g + 0.114 * b);
+    uint32_t u = (uint32_t)(int)(-0.169 * r - 0.331 * g + 0.5 * b) + 128;
+    uint32_t v = (uint32_t)(int)(0.5 * r - 0.419 * g - 0.081 * b) + 128;
+    return (y << 16) + (u << 8) + v;
+}
+
+static inline int hqx_yuv_diff(uint32_t a, uint32_t b) {
+    return abs((int)(a >> 16) - (int)(b >> 16)) > HQX_TR_Y
+        || abs((int)((a >> 8) & 0xFF) - (int)((b >> 8) & 0xFF)) > HQX_TR_U
+        || abs((int)(a & 0xFF) - (int)(b & 0xFF)) > HQX_TR_V;
+}
+
+// (c1 * w1 + c2 * w2) >> s for every channel
+static inline uint32_t hqx_interp2(uint32_t c1, int w1, uint32_t c2, int w2, int s) {
+    return (((((c1 & 0xFF00FF00) >> 8) * w1 + ((c2 & 0xFF00FF00) >> 8) * w2) << (8 - s)) & 0xFF00FF00)
+         | ((((c1 & 0x00FF00FF) * w1 + (c2 & 0x00FF00FF) * w2) >> s) & 0x00FF00FF);
+}
+
+static inline uint32_t hqx_interp3(uint32_t c1, int w1, uint32_t c2, int w2, uint32_t c3, int w3, int s) {
+    return (((((c1 & 0xFF00FF00) >> 8) * w1 + ((c2 & 0xFF00FF00) >> 8) * w2
+              + ((c3 & 0xFF00FF00) >> 8) * w3) << (8 - s)) & 0xFF00FF00)
+         | ((((c1 & 0x00FF00FF) * w1 + (c2 & 0x00FF00FF) * w2 + (c3 & 0x00FF00FF) * w3) >> s) & 0x00FF00FF);
+}
+
+// Bit n of a pattern is set if neighbour n differs from the centre, with the
+// centre itself left out: neighbours 5 to 8 are bits 4 to 7
+#define HQX_BIT(n) (((n) > 4) ? (n) - 1 : (n))
+#define HQX_P(m, r) ((pat & (m)) == (r))
+
+// Top left pixel, with the neighbourhood seen through the mirroring in p
+static inline uint32_t hq2x_px(const uint32_t *w, const uint32_t *yuv, int k, const int *p) {
+    int pat = 0;
+    for(int n = 0; n < 9; n++) {
+        if(n != 4) {
+            pat |= ((k >> HQX_BIT(p[n])) & 1) << HQX_BIT(n);
+        }
+    }
+    uint32_t w0 = w[p[0]], w1 = w[p[1]], w3 = w[p[3]], w4 = w[4];
+    uint32_t y1 = yuv[p[1]], y3 = yuv[p[3]], y5 = yuv[p[5]], y7 = yuv[p[7]];
+
+    if((HQX_P(0xbf, 0x37) || HQX_P(0xdb, 0x13)) && hqx_yuv_diff(y1, y5))
+        return hqx_interp2(w4, 3, w3, 1, 2);
+    if((HQX_P(0xdb, 0x49) || HQX_P(0xef, 0x6d)) && hqx_yuv_diff(y7, y3))
+        return hqx_interp2(w4, 3, w1, 1, 2);
+    if((HQX_P(0x0b, 0x0b) || HQX_P(0xfe, 0x4a) || HQX_P(0xfe, 0x1a)) && hqx_yuv_diff(y3, y1))
+        return w4;
+    if((HQX_P(0x6f, 0x2a) || HQX_P(0x5b, 0x0a) || HQX_P(0xbf, 0x3a) || HQX_P(0xdf, 0x5a)
+        || HQX_P(0x9f, 0x8a) || HQX_P(0xcf, 0x8a) || HQX_P(0xef, 0x4e) || HQX_P(0x3f, 0x0e)
+        || HQX_P(0xfb, 0x5a) || HQX_P(0xbb, 0x8a) || HQX_P(0x7f, 0x5a) || HQX_P(0xaf, 0x8a)
+        || HQX_P(0xeb, 0x8a)) && hqx_yuv_diff(y3, y1))
+        return hqx_interp2(w4, 3, w0, 1, 2);
+    if(HQX_P(0x0b, 0x08))
+        return hqx_interp3(w4, 2, w0, 1, w1, 1, 2);
+    if(HQX_P(0x0b, 0x02))
+        return hqx_interp3(w4, 2, w0, 1, w3, 1, 2);
+    if(HQX_P(0x2f, 0x2f))
+        return hqx_interp3(w4, 14, w3, 1, w1, 1, 4);
+    if(HQX_P(0xbf, 0x37) || HQX_P(0xdb, 0x13))
+        return hqx_interp3(w4, 5, w1, 2, w3, 1, 3);
+    if(HQX_P(0xdb, 0x49) || HQX_P(0xef, 0x6d))
+        return hqx_interp3(w4, 5, w3, 2, w1, 1, 3);
+    if(HQX_P(0x1b, 0x03) || HQX_P(0x4f, 0x43) || HQX_P(0x8b, 0x83) || HQX_P(0x6b, 0x43))
+        return hqx_interp2(w4, 3, w3, 1, 2);
+    if(HQX_P(0x4b, 0x09) || HQX_P(0x8b, 0x89) || HQX_P(0x1f, 0x19) || HQX_P(0x3b, 0x19))
+        return hqx_interp2(w4, 3, w1, 1, 2);
+    if(HQX_P(0x7e, 0x2a) || HQX_P(0xef, 0xab) || HQX_P(0xbf, 0x8f) || HQX_P(0x7e, 0x0e))
+        return hqx_interp3(w4, 2, w3, 3, w1, 3, 3);
+    if(HQX_P(0xfb, 0x6a) || HQX_P(0x6f, 0x6e) || HQX_P(0x3f, 0x3e) || HQX_P(0xfb, 0xfa)
+       || HQX_P(0xdf, 0xde) || HQX_P(0xdf, 0x1e))
+        return hqx_interp2(w4, 3, w0, 1, 2);
+    if(HQX_P(0x0a, 0x00) || HQX_P(0x4f, 0x4b) || HQX_P(0x9f, 0x1b) || HQX_P(0x2f, 0x0b)
+       || HQX_P(0xbe, 0x0a) || HQX_P(0xee, 0x0a) || HQX_P(0x7e, 0x0a) || HQX_P(0xeb, 0x4b)
+       || HQX_P(0x3b, 0x1b))
+        return hqx_interp3(w4, 2, w3, 1, w1, 1, 2);
+    return hqx_interp3(w4, 6, w3, 1, w1, 1, 3);
+}
+
+static const int hq2x_mirror[4][9] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8},
+    {2, 1, 0, 5, 4, 3, 8, 7, 6},
+    {6, 7, 8, 3, 4, 5, 0, 1, 2},
+    {8, 7, 6, 5, 4, 3, 2, 1, 0},
+};
+
+// Copies a row with its edge pixels repeated on both sides, along with their YUV
+static void hqx_load_row(const uint32_t *in, int w, int h, int y, uint32_t *px, uint32_t *yuv) {
+    y = (y < 0) ? 0 : ((y >= h) ? h - 1 : y);
+    memcpy(px + 1, in + y * w, w * 4);
+    px[0] = px[1];
+    px[w + 1] = px[w];
+    for(int x = 0; x < w + 2; x++) {
+        yuv[x] = hqx_yuv(px[x]);
+    }
+}
+
+#ifdef SCALER_SSE2
+// Mask of the lanes where n differs from the centre c, like hqx_yuv_diff() but
+// only for pixels that are not equal to begin with
+static inline __m128i hqx_diff4(__m128i c, __m128i cy, __m128i n, __m128i ny) {
+    const __m128i lo = _mm_set1_epi32(0xFF);
+    __m128i dy = _mm_sub_epi32(_mm_srli_epi32(cy, 16), _mm_srli_epi32(ny, 16));
+    __m128i du = _mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(cy, 8), lo), _mm_and_si128(_mm_srli_epi32(ny, 8), lo));
+    __m128i dv = _mm_sub_epi32(_mm_and_si128(cy, lo), _mm_and_si128(ny, lo));
+    __m128i zero = _mm_setzero_si128();
+    __m128i ty = _mm_set1_epi32(HQX_TR_Y);
+    __m128i tu = _mm_set1_epi32(HQX_TR_U);
+    __m128i tv = _mm_set1_epi32(HQX_TR_V);
+    __m128i diff = _mm_or_si128(_mm_cmpgt_epi32(dy, ty), _mm_cmpgt_epi32(_mm_sub_epi32(zero, dy), ty));
+    diff = _mm_or_si128(diff, _mm_or_si128(_mm_cmpgt_epi32(du, tu), _mm_cmpgt_epi32(_mm_sub_epi32(zero, du), tu)));
+    diff = _mm_or_si128(diff, _mm_or_si128(_mm_cmpgt_epi32(dv, tv), _mm_cmpgt_epi32(_mm_sub_epi32(zero, dv), tv)));
+    return _mm_andnot_si128(_mm_cmpeq_epi32(c, n), diff);
+}
+#endif
+
+static void hq2x_rows(const uint32_t *in, uint32_t *out, int w, int h, int y0, int y1) {
+    int ow = w * 2;
+    int stride = w + 2;
+    uint32_t *buf = malloc((size_t)stride * 6 * sizeof(uint32_t) + (size_t)w * sizeof(int));
+    uint32_t *px[3] = {buf, buf + stride, buf + stride * 2};
+    uint32_t *yuv[3] = {buf + stride * 3, buf + stride * 4, buf + stride * 5};
+    int *pats = (int*)(buf + stride * 6);
+
+    for(int r = 0; r < 3; r++) {
+        hqx_load_row(in, w, h, y0 - 1 + r, px[r], yuv[r]);
+    }
+    for(int y = y0; y < y1; y++) {
+        if(y > y0) {
+            uint32_t *tp = px[0], *ty = yuv[0];
+            px[0] = px[1]; px[1] = px[2]; px[2] = tp;
+            yuv[0] = yuv[1]; yuv[1] = yuv[2]; yuv[2] = ty;
+            hqx_load_row(in, w, h, y + 1, px[2], yuv[2]);
+        }
+
+        // Which neighbours differ from each pixel of the row
+        int x = 0;
+#ifdef SCALER_SSE2
+        for(; x + 4 <= w; x += 4) {
+            __m128i c = _mm_loadu_si128((const __m128i*)(px[1] + x + 1));
+            __m128i cy = _mm_loadu_si128((const __m128i*)(yuv[1] + x + 1));
+            __m128i pat = _mm_setzero_si128();
+            for(int n = 0; n < 9; n++) {
+                if(n == 4) {
+                    continue;
+                }
+                int r = n / 3;
+                int dx = n % 3;
+                __m128i np = _mm_loadu_si128((const __m128i*)(px[r] + x + dx));
+                __m128i ny = _mm_loadu_si128((const __m128i*)(yuv[r] + x + dx));
+                __m128i bit = _mm_set1_epi32(1 << HQX_BIT(n));
+                pat = _mm_or_si128(pat, _mm_and_si128(hqx_diff4(c, cy, np, ny), bit));
+            }
+            _mm_storeu_si128((__m128i*)(pats + x), pat);
+        }
+#endif
+        for(; x < w; x++) {
+            uint32_t c = px[1][x + 1];
+            uint32_t cy = yuv[1][x + 1];
+            int pat = 0;
+            for(int n = 0; n < 9; n++) {
+                if(n == 4) {
+                    continue;
+                }
+                uint32_t np = px[n / 3][x + n % 3];
+                if(np != c && hqx_yuv_diff(cy, yuv[n / 3][x + n % 3])) {
+                    pat |= 1 << HQX_BIT(n);
+                }
+            }
+            pats[x] = pat;
+        }
+
+        uint32_t *d0 = out + (size_t)y * 2 * ow;
+        uint32_t *d1 = d0 + ow;
+        for(x = 0; x < w; x++) {
+            uint32_t wn[9], yn[9];
+            for(int n = 0; n < 9; n++) {
+                wn[n] = px[n / 3][x + n % 3];
+                yn[n] = yuv[n / 3][x + n % 3];
+            }
+            // Flat areas are the common case in pixel art
+            if(pats[x] == 0 && wn[1] == wn[4] && wn[3] == wn[4]
+               && wn[5] == wn[4] && wn[7] == wn[4]) {
+                d0[x * 2] = d0[x * 2 + 1] = d1[x * 2] = d1[x * 2 + 1] = wn[4];
+                continue;
+            }
+            d0[x * 2] = hq2x_px(wn, yn, pats[x], hq2x_mirror[0]);
+            d0[x * 2 + 1] = hq2x_px(wn, yn, pats[x], hq2x_mirror[1]);
+            d1[x * 2] = hq2x_px(wn, yn, pats[x], hq2x_mirror[2]);
+            d1[x * 2 + 1] = hq2x_px(wn, yn, pats[x], hq2x_mirror[3]);
+        }
+    }
+    free(buf);
+}
+
+// Banding ---------------------------------------------------------------------
+
+static void scale_band(void *userdata, int index, int count) {
+    scale_job *job = userdata;
+    int y0 = job->h * index / count;
+    int y1 = job->h * (index + 1) / count;
+    job->rows(job->in, job->out, job->w, job->h, y0, y1);
+}
+
+static void scale_run(scale_rows_func rows, const uint32_t *in, uint32_t *out, int w, int h) {
+    scale_job job = {rows, in, out, w, h};
+    if(w * h < MIN_THREADED_PIXELS || pool_threads == 0) {
+        rows(in, out, w, h, 0, h);
+        return;
+    }
+    if(!pool_running) {
+        if(thread_pool_create(&pool, pool_threads)) {
+            rows(in, out, w, h, 0, h);
+            return;
+        }
+        pool_running = 1;
+    }
+    int bands = thread_pool_size(&pool);
+    if(bands > h / MIN_BAND_ROWS) {
+        bands = h / MIN_BAND_ROWS;
+    }
+    thread_pool_run(&pool, scale_band, &job, (bands > 0) ? bands : 1);
+}
+
+// Plugin interface ------------------------------------------------------------
+
+static int factors[] = {2, 3, 4};
+static int hq2x_factors[] = {2};
+
+static const char* get_author() { return "OpenOMF project"; }
+static const char* get_license() { return "MIT"; }
+static const char* get_type() { return "scaler"; }
+static const char* get_version() { return "1.0"; }
+static const char* pixel_get_name() { return "Pixel"; }
+static const char* scale_get_name() { return "Scale"; }
+static const char* hq2x_get_name() { return "HQ2x"; }
+
+static int is_factor_available(int factor) {
+    return factor >= 2 && factor <= 4;
+}
+
+static int get_factors_list(int **list) {
+    *list = factors;
+    return sizeof(factors) / sizeof(factors[0]);
+}
+
+static int hq2x_is_factor_available(int factor) {
+    return factor == 2;
+}
+
+static int hq2x_get_factors_list(int **list) {
+    *list = hq2x_factors;
+    return sizeof(hq2x_factors) / sizeof(hq2x_factors[0]);
+}
+
+static int get_color_format() {
+    return 0;
+}
+
+static int pixel_scale(const char *in, char *out, int w, int h, int factor) {
+    static const scale_rows_func rows[] = {nearest2x_rows, nearest3x_rows, nearest4x_rows};
+    if(!is_factor_available(factor)) {
+        return 1;
+    }
+    scale_run(rows[factor - 2], (const uint32_t*)in, (uint32_t*)out, w, h);
+    return 0;
+}
+
+static int scale_scale(const char *in, char *out, int w, int h, int factor) {
+    switch(factor) {
+        case 2:
+            scale_run(scale2x_rows, (const uint32_t*)in, (uint32_t*)out, w, h);
+            return 0;
+        case 3:
+            scale_run(scale3x_rows, (const uint32_t*)in, (uint32_t*)out, w, h);
+            return 0;
+        case 4: {
+            size_t need = (size_t)w * h * 4;
+            if(need > scale4x_tmp_size) {
+                free(scale4x_tmp);
+                scale4x_tmp = malloc(need * sizeof(uint32_t));
+                scale4x_tmp_size = need;
+            }
+            scale_run(scale2x_rows, (const uint32_t*)in, scale4x_tmp, w, h);
+            scale_run(scale2x_rows, scale4x_tmp, (uint32_t*)out, w * 2, h * 2);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int hq2x_scale(const char *in, char *out, int w, int h, int factor) {
+    if(!hq2x_is_factor_available(factor)) {
+        return 1;
+    }
+    scale_run(hq2x_rows, (const uint32_t*)in, (uint32_t*)out, w, h);
+    return 0;
+}
+
+typedef struct builtin_scaler_t {
+    base_plugin base;
+    int (*is_factor_available)(int factor);
+    int (*get_factors_list)(int **list);
+    int (*scale)(const char *in, char *out, int w, int h, int factor);
+} builtin_scaler;
+
+static builtin_scaler scalers[] = {
+    {{NULL, pixel_get_name, get_author, get_license, get_type, get_version},
+     is_factor_available, get_factors_list, pixel_scale},
+    {{NULL, scale_get_name, get_author, get_license, get_type, get_version},
+     is_factor_available, get_factors_list, scale_scale},
+    {{NULL, hq2x_get_name, get_author, get_license, get_type, get_version},
+     hq2x_is_factor_available, hq2x_get_factors_list, hq2x_scale},
+};
+
+int builtin_scalers_count() {
+    return sizeof(scalers) / sizeof(scalers[0]);
+}
+
+base_plugin* builtin_scalers_get_base(int index) {
+    return &scalers[index].base;
+}
+
+int builtin_scalers_get(scaler_plugin *scaler, const char *name) {
+    for(int i = 0; i < builtin_scalers_count(); i++) {
+        if(strcmp(scalers[i].base.get_name(), name) == 0) {
+            scaler->base = &scalers[i].base;
+            scaler->is_factor_available = scalers[i].is_factor_available;
+            scaler->get_factors_list = scalers[i].get_factors_list;
+            scaler->get_color_format = get_color_format;
+            scaler->scale = scalers[i].scale;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void builtin_scalers_set_threads(int threads) {
+    if(pool_running) {
+        thread_pool_free(&pool);
+        pool_running = 0;
+    }
+    pool_threads = threads;
+}
+
+void builtin_scalers_close() {
+    if(pool_running) {
+        thread_pool_free(&pool);
+        pool_running = 0;
+    }
+    free(scale4x_tmp);
+    scale4x_tmp = NULL;
+    scale4x_tmp_size = 0;
+}
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "plugins/plugins.h"
+#include "plugins/builtin_scalers.h"
 #include "resources/pathmanager.h"
 #include "utils/scandir.h"
 #include "utils/list.h"
@@ -89,6 +90,15 @@ void plugins_init() {
             if(_plugins[_plugins_count].get_version == NULL) {
                 DEBUG("Plugin get_version handle not found; your plugin is old.");
             }
+            if(strcmp(_plugins[_plugins_count].get_type(), "scaler") == 0) {
+                scaler_plugin builtin;
+                if(builtin_scalers_get(&builtin, _plugins[_plugins_count].get_name()) == 0) {
+                    INFO("Scaler plugin %s is built in, skipping %s", _plugins[_plugins_count].get_name(), plugin_file);
+                    SDL_UnloadObject(handle);
+                    _plugins[_plugins_count].handle = NULL;
+                    continue;
+                }
+            }
 #ifdef DEBUGMODE
             // Print some debug information
             base_plugin *tmp = &_plugins[_plugins_count];
@@ -113,6 +123,10 @@ void plugins_init() {
 }
 
 int plugins_get_scaler(scaler_plugin *scaler, const char* name) {
+    if(builtin_scalers_get(scaler, name) == 0) {
+        return 0;
+    }
+
     // Search for a scaler with given name
     for(int i = 0; i < PLUGIN_MAX_COUNT; i++) {
         if(_plugins[i].handle != NULL
@@ -133,6 +147,13 @@ int plugins_get_scaler(scaler_plugin *scaler, const char* name) {
 int plugins_get_list_by_type(list *tlist, const char* type) {
     // Search for a scaler with given type
     int count = 0;
+    if(strcmp(type, "scaler") == 0) {
+        for(int i = 0; i < builtin_scalers_count(); i++) {
+            void *ptr = builtin_scalers_get_base(i);
+            list_append(tlist, &ptr, sizeof(base_plugin*));
+            count++;
+        }
+    }
     for(int i = 0; i < PLUGIN_MAX_COUNT; i++) {
         if(_plugins[i].handle != NULL
            && strcmp(_plugins[i].get_type(), type) == 0)
@@ -146,6 +167,7 @@ int plugins_get_list_by_type(list *tlist, const char* type) {
 }
 
 void plugins_close() {
+    builtin_scalers_close();
     for(int i = 0; i < PLUGIN_MAX_COUNT; i++) {
         if(_plugins[i].handle != NULL) {
             SDL_UnloadObject(_plugins[i].handle);
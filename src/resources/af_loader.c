@@ -1,7 +1,21 @@
+#include <stdlib.h>
+#include <SDL.h>
 #include "resources/af_loader.h"
 #include "resources/pathmanager.h"
+#include "resources/ids.h"
 #include "formats/af.h"
 #include "formats/error.h"
+#include "utils/log.h"
+
+#define AF_CACHE_SIZE (AF_NOVA - AF_JAGUAR + 1)
+
+typedef struct af_cache_entry_t {
+    af *data;
+    int refs;
+} af_cache_entry;
+
+static af_cache_entry af_cache[AF_CACHE_SIZE];
+static SDL_mutex *af_cache_lock = NULL;
 
 int load_af_file(af *a, int id) {
     // Get directory + filename
@@ -22,3 +36,105 @@ int load_af_file(af *a, int id) {
     sd_af_free(&tmp);
     return 0;
 }
+
+static void har_fix_sprite_coords(animation *ani, int fix_x, int fix_y) {
+    iterator it;
+    sprite *s;
+    // Fix sprite positions
+    vector_iter_begin(&ani->sprites, &it);
+    while((s = iter_next(&it)) != NULL) {
+        s->pos.x += fix_x;
+        s->pos.y += fix_y;
+    }
+    // Fix collisions coordinates
+    collision_coord *c;
+    vector_iter_begin(&ani->collision_coords, &it);
+    while((c = iter_next(&it)) != NULL) {
+        c->pos.x += fix_x;
+        c->pos.y += fix_y;
+    }
+}
+
+int af_cache_init() {
+    for(int i = 0; i < AF_CACHE_SIZE; i++) {
+        af_cache[i].data = NULL;
+        af_cache[i].refs = 0;
+    }
+    af_cache_lock = SDL_CreateMutex();
+    if(af_cache_lock == NULL) {
+        PERROR("Unable to create HAR cache lock: %s", SDL_GetError());
+        return 1;
+    }
+    return 0;
+}
+
+void af_cache_close() {
+    for(int i = 0; i < AF_CACHE_SIZE; i++) {
+        if(af_cache[i].refs > 0) {
+            DEBUG("HAR %d still has %d references at cache close", i, af_cache[i].refs);
+        }
+        if(af_cache[i].data) {
+            af_free(af_cache[i].data);
+            free(af_cache[i].data);
+            af_cache[i].data = NULL;
+        }
+        af_cache[i].refs = 0;
+    }
+    if(af_cache_lock) {
+        SDL_DestroyMutex(af_cache_lock);
+        af_cache_lock = NULL;
+    }
+}
+
+/*
+ * Returns the HAR data for the given resource ID, loading it on first use.
+ * The returned data is shared and must not be modified.
+ */
+af* af_cache_acquire(int id) {
+    if(id < AF_JAGUAR || id > AF_NOVA) {
+        return NULL;
+    }
+    af_cache_entry *entry = &af_cache[id - AF_JAGUAR];
+    af *ret = NULL;
+
+    if(af_cache_lock) {
+        SDL_LockMutex(af_cache_lock);
+    }
+    if(entry->data == NULL) {
+        af *a = malloc(sizeof(af));
+        if(load_af_file(a, id)) {
+            free(a);
+            goto exit_0;
+        }
+        // Fix some coordinates on jump sprites
+        har_fix_sprite_coords(&af_get_move(a, ANIM_JUMPING)->ani, 0, -50);
+        entry->data = a;
+    }
+    entry->refs++;
+    ret = entry->data;
+
+exit_0:
+    if(af_cache_lock) {
+        SDL_UnlockMutex(af_cache_lock);
+    }
+    return ret;
+}
+
+void af_cache_release(af *a) {
+    if(a == NULL) {
+        return;
+    }
+    if(af_cache_lock) {
+        SDL_LockMutex(af_cache_lock);
+    }
+    // Data stays loaded for the next match; it is only freed at af_cache_close
+    for(int i = 0; i < AF_CACHE_SIZE; i++) {
+        if(af_cache[i].data == a && af_cache[i].refs > 0) {
+            af_cache[i].refs--;
+            break;
+        }
+    }
+    if(af_cache_lock) {
+        SDL_UnlockMutex(af_cache_lock);
+    }
+}
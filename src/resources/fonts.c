@@ -7,8 +7,10 @@
 #include "resources/fonts.h"
 #include "resources/pathmanager.h"
 
-font font_small;
-font font_large;
+// Sizes are set up front, so that text can be laid out without the glyphs. The
+// server never loads them.
+font font_small = {FONT_SMALL, 6, 6};
+font font_large = {FONT_BIG, 8, 8};
 static int fonts_loaded = 0;
 
 void font_create(font *f) {
@@ -46,5 +46,10 @@ void lang_close() {
 }
 
 const char* lang_get(unsigned int id) {
+#ifdef STANDALONE_SERVER
+    // The server loads no language file, and never shows any text
+    return "";
+#else
     return (const char*)array_get(&language_strings, id);
+#endif
 }
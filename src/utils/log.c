@@ -2,8 +2,10 @@
 #include <stdarg.h>
 #include "utils/log.h"
 
+#define LOG_LINE_MAX 2048
+
 FILE *handle = 0;
-unsigned int _log_tick = 0;
+THREAD_LOCAL unsigned int _log_tick = 0;
 
 int log_init(const char *filename) {
     if(handle)
@@ -29,15 +31,21 @@ void log_close() {
 void log_print(char mode, const char *fn, const char *fmt, ...) {
     if(handle == 0)
         return;
+    // Format the whole line first, so lines from different threads don't interleave
+    char line[LOG_LINE_MAX];
+    int len;
     if(fn != NULL) {
-        fprintf(handle, "[%7u][%c] %s(): ", _log_tick, mode, fn);
+        len = snprintf(line, sizeof(line), "[%7u][%c] %s(): ", _log_tick, mode, fn);
     } else {
-        fprintf(handle, "[%7u][%c] ", _log_tick, mode);
+        len = snprintf(line, sizeof(line), "[%7u][%c] ", _log_tick, mode);
+    }
+    if(len < 0 || len >= (int)sizeof(line)) {
+        len = 0;
     }
     va_list args;
     va_start(args, fmt);
-    vfprintf(handle, fmt, args);
+    vsnprintf(line + len, sizeof(line) - len, fmt, args);
     va_end(args);
-    fprintf(handle, "\n");
+    fprintf(handle, "%s\n", line);
     fflush(handle);
 }
@@ -0,0 +1,56 @@
+#include <stdlib.h>
+#include <string.h>
+#include "utils/spsc_queue.h"
+
+int spsc_queue_create(spsc_queue *q, unsigned int block_size, unsigned int capacity) {
+    unsigned int size = 1;
+    while(size < capacity) {
+        size <<= 1;
+    }
+    q->data = malloc(size * block_size);
+    if(q->data == NULL) {
+        return 1;
+    }
+    q->block_size = block_size;
+    q->capacity = size;
+    SDL_AtomicSet(&q->head, 0);
+    SDL_AtomicSet(&q->tail, 0);
+    return 0;
+}
+
+void spsc_queue_free(spsc_queue *q) {
+    free(q->data);
+    q->data = NULL;
+    q->capacity = 0;
+}
+
+// Returns 1 if the queue is full
+int spsc_queue_push(spsc_queue *q, const void *value) {
+    unsigned int tail = SDL_AtomicGet(&q->tail);
+    unsigned int head = SDL_AtomicGet(&q->head);
+    if(tail - head >= q->capacity) {
+        return 1;
+    }
+    memcpy(q->data + (tail & (q->capacity - 1)) * q->block_size, value, q->block_size);
+    // Slot contents must be visible before the consumer sees the new tail
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&q->tail, tail + 1);
+    return 0;
+}
+
+// Returns 1 if the queue is empty
+int spsc_queue_pop(spsc_queue *q, void *value) {
+    unsigned int head = SDL_AtomicGet(&q->head);
+    unsigned int tail = SDL_AtomicGet(&q->tail);
+    if(head == tail) {
+        return 1;
+    }
+    SDL_MemoryBarrierAcquire();
+    memcpy(value, q->data + (head & (q->capacity - 1)) * q->block_size, q->block_size);
+    SDL_AtomicSet(&q->head, head + 1);
+    return 0;
+}
+
+unsigned int spsc_queue_size(spsc_queue *q) {
+    return (unsigned int)SDL_AtomicGet(&q->tail) - (unsigned int)SDL_AtomicGet(&q->head);
+}
@@ -0,0 +1,127 @@
+#include <stdlib.h>
+#include "utils/thread_pool.h"
+
+static void thread_pool_work(thread_pool *pool) {
+    int i;
+    while((i = SDL_AtomicAdd(&pool->next, 1)) < pool->count) {
+        pool->job(pool->userdata, i, pool->count);
+    }
+}
+
+static int thread_pool_worker(void *userdata) {
+    thread_pool *pool = userdata;
+    unsigned int seen = 0;
+    SDL_LockMutex(pool->lock);
+    while(1) {
+        while(pool->generation == seen && !pool->quit) {
+            SDL_CondWait(pool->start, pool->lock);
+        }
+        if(pool->quit) {
+            break;
+        }
+        seen = pool->generation;
+        SDL_UnlockMutex(pool->lock);
+
+        thread_pool_work(pool);
+
+        // The job is only over once every worker is out of it, so none can
+        // wake up late and pick up parts of the next one with stale arguments
+        SDL_LockMutex(pool->lock);
+        if(--pool->busy == 0) {
+            SDL_CondBroadcast(pool->done);
+        }
+    }
+    SDL_UnlockMutex(pool->lock);
+    return 0;
+}
+
+int thread_pool_create(thread_pool *pool, int threads) {
+    if(threads < 0) {
+        threads = SDL_GetCPUCount() - 1;
+    }
+    pool->threads = NULL;
+    pool->thread_count = 0;
+    pool->generation = 0;
+    pool->busy = 0;
+    pool->quit = 0;
+    pool->job = NULL;
+    pool->userdata = NULL;
+    pool->count = 0;
+    SDL_AtomicSet(&pool->next, 0);
+    pool->lock = SDL_CreateMutex();
+    pool->start = SDL_CreateCond();
+    pool->done = SDL_CreateCond();
+    if(pool->lock == NULL || pool->start == NULL || pool->done == NULL) {
+        thread_pool_free(pool);
+        return 1;
+    }
+    if(threads > 0) {
+        pool->threads = calloc(threads, sizeof(SDL_Thread*));
+        for(int i = 0; i < threads; i++) {
+            pool->threads[i] = SDL_CreateThread(thread_pool_worker, "thread_pool", pool);
+            if(pool->threads[i] == NULL) {
+                break;
+            }
+            pool->thread_count++;
+        }
+    }
+    return 0;
+}
+
+void thread_pool_free(thread_pool *pool) {
+    if(pool->lock != NULL) {
+        SDL_LockMutex(pool->lock);
+        pool->quit = 1;
+        SDL_CondBroadcast(pool->start);
+        SDL_UnlockMutex(pool->lock);
+    }
+    for(int i = 0; i < pool->thread_count; i++) {
+        SDL_WaitThread(pool->threads[i], NULL);
+    }
+    free(pool->threads);
+    pool->threads = NULL;
+    pool->thread_count = 0;
+    if(pool->done != NULL) {
+        SDL_DestroyCond(pool->done);
+        pool->done = NULL;
+    }
+    if(pool->start != NULL) {
+        SDL_DestroyCond(pool->start);
+        pool->start = NULL;
+    }
+    if(pool->lock != NULL) {
+        SDL_DestroyMutex(pool->lock);
+        pool->lock = NULL;
+    }
+}
+
+void thread_pool_run(thread_pool *pool, thread_pool_job job, void *userdata, int count) {
+    if(pool->thread_count == 0 || count <= 1) {
+        for(int i = 0; i < count; i++) {
+            job(userdata, i, count);
+        }
+        return;
+    }
+
+    SDL_LockMutex(pool->lock);
+    pool->job = job;
+    pool->userdata = userdata;
+    pool->count = count;
+    SDL_AtomicSet(&pool->next, 0);
+    pool->busy = pool->thread_count;
+    pool->generation++;
+    SDL_CondBroadcast(pool->start);
+    SDL_UnlockMutex(pool->lock);
+
+    thread_pool_work(pool);
+
+    SDL_LockMutex(pool->lock);
+    while(pool->busy > 0) {
+        SDL_CondWait(pool->done, pool->lock);
+    }
+    SDL_UnlockMutex(pool->lock);
+}
+
+int thread_pool_size(const thread_pool *pool) {
+    return pool->thread_count + 1;
+}
@@ -0,0 +1,174 @@
+#include <stdlib.h>
+#include "video/atlas.h"
+#include "utils/log.h"
+
+// Gap between images, so nothing bleeds over if a texture ever gets filtered
+#define ATLAS_PADDING 1
+
+typedef struct atlas_shelf_t {
+    int y;
+    int h;
+    int x; // first free column
+} atlas_shelf;
+
+typedef struct atlas_page_t {
+    SDL_Texture *tex;
+    vector shelves;
+    int next_y; // top of the free area below the last shelf
+} atlas_page;
+
+typedef struct atlas_slot_t {
+    SDL_Texture *tex;
+    SDL_Rect rect;
+} atlas_slot;
+
+void atlas_create(atlas *a, SDL_Renderer *renderer, int page_w, int page_h, int max_pages) {
+    a->renderer = renderer;
+    a->page_w = page_w;
+    a->page_h = page_h;
+    a->max_pages = max_pages;
+    a->used_pixels = 0;
+    vector_create(&a->pages, sizeof(atlas_page));
+    vector_create(&a->free_slots, sizeof(atlas_slot));
+}
+
+void atlas_free(atlas *a) {
+    iterator it;
+    atlas_page *page;
+    vector_iter_begin(&a->pages, &it);
+    while((page = iter_next(&it)) != NULL) {
+        SDL_DestroyTexture(page->tex);
+        vector_free(&page->shelves);
+    }
+    vector_free(&a->pages);
+    vector_free(&a->free_slots);
+}
+
+// Takes the smallest released slot the image fits in. What is left of a larger slot
+// stays unused until the pages are freed.
+static int atlas_reuse_slot(atlas *a, int w, int h, SDL_Texture **tex, SDL_Rect *rect) {
+    iterator it;
+    atlas_slot *slot;
+    atlas_slot *best = NULL;
+    vector_iter_begin(&a->free_slots, &it);
+    while((slot = iter_next(&it)) != NULL) {
+        if(slot->rect.w >= w && slot->rect.h >= h
+            && (best == NULL || slot->rect.w * slot->rect.h < best->rect.w * best->rect.h)) {
+            best = slot;
+        }
+    }
+    if(best == NULL) {
+        return 1;
+    }
+    *tex = best->tex;
+    rect->x = best->rect.x;
+    rect->y = best->rect.y;
+    rect->w = w;
+    rect->h = h;
+    vector_iter_begin(&a->free_slots, &it);
+    while((slot = iter_next(&it)) != best) {}
+    vector_delete(&a->free_slots, &it);
+    return 0;
+}
+
+static int atlas_page_alloc(atlas *a, atlas_page *page, int w, int h, SDL_Rect *rect) {
+    int pw = w + ATLAS_PADDING;
+    int ph = h + ATLAS_PADDING;
+
+    // Tightest existing shelf that still has room
+    atlas_shelf *best = NULL;
+    iterator it;
+    atlas_shelf *shelf;
+    vector_iter_begin(&page->shelves, &it);
+    while((shelf = iter_next(&it)) != NULL) {
+        if(shelf->h >= ph && shelf->x + pw <= a->page_w && (best == NULL || shelf->h < best->h)) {
+            best = shelf;
+        }
+    }
+
+    // Open a new shelf, unless the best one fits snugly enough already
+    if((best == NULL || best->h > ph * 2) && page->next_y + ph <= a->page_h && pw <= a->page_w) {
+        atlas_shelf new_shelf;
+        new_shelf.y = page->next_y;
+        new_shelf.h = ph;
+        new_shelf.x = 0;
+        page->next_y += ph;
+        vector_append(&page->shelves, &new_shelf);
+        best = vector_get(&page->shelves, vector_size(&page->shelves) - 1);
+    }
+    if(best == NULL) {
+        return 1;
+    }
+
+    rect->x = best->x;
+    rect->y = best->y;
+    rect->w = w;
+    rect->h = h;
+    best->x += pw;
+    return 0;
+}
+
+static atlas_page* atlas_add_page(atlas *a) {
+    atlas_page page;
+    page.tex = SDL_CreateTexture(a->renderer,
+                                 SDL_PIXELFORMAT_ABGR8888,
+                                 SDL_TEXTUREACCESS_STREAMING,
+                                 a->page_w,
+                                 a->page_h);
+    if(page.tex == NULL) {
+        PERROR("Unable to create atlas page: %s", SDL_GetError());
+        return NULL;
+    }
+    SDL_SetTextureBlendMode(page.tex, SDL_BLENDMODE_BLEND);
+    vector_create(&page.shelves, sizeof(atlas_shelf));
+    page.next_y = 0;
+    vector_append(&a->pages, &page);
+    DEBUG("Atlas page %d created (%dx%d)", vector_size(&a->pages), a->page_w, a->page_h);
+    return vector_get(&a->pages, vector_size(&a->pages) - 1);
+}
+
+int atlas_fits(const atlas *a, int w, int h) {
+    return w + ATLAS_PADDING <= a->page_w && h + ATLAS_PADDING <= a->page_h;
+}
+
+int atlas_alloc(atlas *a, int w, int h, SDL_Texture **tex, SDL_Rect *rect) {
+    if(!atlas_fits(a, w, h)) {
+        return 1;
+    }
+    if(atlas_reuse_slot(a, w, h, tex, rect) == 0) {
+        a->used_pixels += w * h;
+        return 0;
+    }
+
+    iterator it;
+    atlas_page *page;
+    vector_iter_begin(&a->pages, &it);
+    while((page = iter_next(&it)) != NULL) {
+        if(atlas_page_alloc(a, page, w, h, rect) == 0) {
+            goto found;
+        }
+    }
+    if((int)vector_size(&a->pages) >= a->max_pages || (page = atlas_add_page(a)) == NULL) {
+        return 1;
+    }
+    if(atlas_page_alloc(a, page, w, h, rect) != 0) {
+        return 1;
+    }
+
+found:
+    *tex = page->tex;
+    a->used_pixels += w * h;
+    return 0;
+}
+
+void atlas_release(atlas *a, SDL_Texture *tex, const SDL_Rect *rect) {
+    atlas_slot slot;
+    slot.tex = tex;
+    slot.rect = *rect;
+    vector_append(&a->free_slots, &slot);
+    a->used_pixels -= rect->w * rect->h;
+}
+
+int atlas_page_count(const atlas *a) {
+    return vector_size(&a->pages);
+}
@@ -0,0 +1,111 @@
+#include <stdlib.h>
+#include <string.h>
+#include "video/frame_capture.h"
+#include "video/video.h"
+#include "video/video_state.h"
+#include "video/video_cpu.h"
+#include "utils/iterator.h"
+
+typedef struct frame_draw_t {
+    surface sur;
+    SDL_Rect dst;
+    SDL_BlendMode blend_mode;
+    int pal_offset;
+    SDL_RendererFlip flip_mode;
+    uint8_t opacity;
+    color color_mod;
+    unsigned int pal; // index to palettes
+} frame_draw;
+
+void frame_capture_create(frame_capture *cap) {
+    vector_create(&cap->draws, sizeof(frame_draw));
+    vector_create(&cap->palettes, sizeof(screen_palette));
+    cap->fade = 1.0f;
+    cap->target_move_x = 0;
+    cap->target_move_y = 0;
+}
+
+void frame_capture_free(frame_capture *cap) {
+    iterator it;
+    frame_draw *d;
+    vector_iter_begin(&cap->draws, &it);
+    while((d = iter_next(&it)) != NULL) {
+        surface_free(&d->sur);
+    }
+    vector_free(&cap->draws);
+    vector_free(&cap->palettes);
+}
+
+void frame_capture_draw(frame_capture *cap,
+                        const screen_palette *pal,
+                        surface *sur,
+                        const SDL_Rect *dst,
+                        SDL_BlendMode blend_mode,
+                        int pal_offset,
+                        SDL_RendererFlip flip_mode,
+                        uint8_t opacity,
+                        color color_mod) {
+
+    // Scenes change the palette halfway through a frame, so keep a copy
+    // every time it differs from the one the last sprite was drawn with
+    unsigned int count = vector_size(&cap->palettes);
+    if(count == 0 || memcmp(((screen_palette*)vector_get(&cap->palettes, count - 1))->data,
+                            pal->data, sizeof(pal->data)) != 0) {
+        vector_append(&cap->palettes, pal);
+        count++;
+    }
+
+    frame_draw d;
+    surface_copy(&d.sur, sur);
+    d.dst = *dst;
+    d.blend_mode = blend_mode;
+    d.pal_offset = pal_offset;
+    d.flip_mode = flip_mode;
+    d.opacity = opacity;
+    d.color_mod = color_mod;
+    d.pal = count - 1;
+    vector_append(&cap->draws, &d);
+}
+
+void frame_capture_finish(frame_capture *cap, float fade, int target_move_x, int target_move_y) {
+    cap->fade = fade;
+    cap->target_move_x = target_move_x;
+    cap->target_move_y = target_move_y;
+}
+
+int frame_capture_compose(frame_capture *cap, image *img, int w, int h) {
+    video_state state;
+    iterator it;
+    frame_draw *d;
+
+    // A renderer of our own, so that this can run on any thread
+    memset(&state, 0, sizeof(video_state));
+    state.fade = cap->fade;
+    state.target_move_x = cap->target_move_x;
+    state.target_move_y = cap->target_move_y;
+    state.offscreen = calloc(1, NATIVE_W * NATIVE_H * 4);
+    video_cpu_init(&state);
+
+    state.cb.render_prepare(&state);
+    vector_iter_begin(&cap->draws, &it);
+    while((d = iter_next(&it)) != NULL) {
+        state.cur_palette = vector_get(&cap->palettes, d->pal);
+        state.cb.render_fsot(&state, &d->sur, &d->dst, d->blend_mode, d->pal_offset,
+                             d->flip_mode, d->opacity, d->color_mod);
+    }
+    state.cb.render_finish(&state);
+
+    // Nearest neighbour, like the window does without a scaler
+    image_create(img, w, h);
+    for(int y = 0; y < h; y++) {
+        const uint8_t *src = state.offscreen + (y * NATIVE_H / h) * NATIVE_W * 4;
+        char *dst = img->data + y * w * 4;
+        for(int x = 0; x < w; x++) {
+            memcpy(dst + x * 4, src + (x * NATIVE_W / w) * 4, 4);
+        }
+    }
+
+    state.cb.render_close(&state);
+    free(state.offscreen);
+    return 0;
+}
@@ -159,3 +159,21 @@ int image_write_png(image *img, const char *filename) {
     }
     return 0;
 }
+
+int image_read_png(image *img, const char *filename) {
+    png_image in;
+    memset(&in, 0, sizeof(in));
+    in.version = PNG_IMAGE_VERSION;
+    if(!png_image_begin_read_from_file(&in, filename)) {
+        return 1;
+    }
+    in.format = PNG_FORMAT_RGBA;
+    image_create(img, in.width, in.height);
+    if(!png_image_finish_read(&in, NULL, img->data, img->w * 4, NULL)) {
+        PERROR("Unable to read PNG file: %s", in.message);
+        png_image_free(&in);
+        image_free(img);
+        return 1;
+    }
+    return 0;
+}
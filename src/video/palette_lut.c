@@ -0,0 +1,98 @@
+#include <string.h>
+#include "video/palette_lut.h"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define LUT_SSE2
+#include <emmintrin.h>
+#if (defined(__x86_64__) || defined(__i386__)) && (!defined(__clang__) || __clang_major__ >= 4)
+#define LUT_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+static uint32_t lut_pixel(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    uint8_t bytes[4] = {r, g, b, a};
+    uint32_t px;
+    memcpy(&px, bytes, 4);
+    return px;
+}
+
+void palette_lut_build(palette_lut *lut, const screen_palette *pal, const char *remap_table, uint8_t pal_offset) {
+    for(int i = 0; i < 256; i++) {
+        uint8_t idx = (remap_table != NULL) ? (uint8_t)remap_table[i] : (uint8_t)i;
+        // Offset only applies to the HAR colors; see surface_to_rgba()
+        if(idx < 48) {
+            idx += pal_offset;
+        }
+        lut->px[i] = lut_pixel(pal->data[idx][0], pal->data[idx][1], pal->data[idx][2], 0);
+    }
+}
+
+void palette_lut_convert_scalar(const palette_lut *lut, char *dst, const char *src, const char *stencil, int count) {
+    uint32_t alpha = lut_pixel(0, 0, 0, 0xFF);
+    for(int i = 0; i < count; i++) {
+        // Branchless; stencils of sprite edges don't predict well
+        uint32_t opaque = 0u - (uint32_t)(stencil[i] == 1);
+        uint32_t px = lut->px[(uint8_t)src[i]] | (alpha & opaque);
+        memcpy(dst + i * 4, &px, 4);
+    }
+}
+
+#ifdef LUT_AVX2
+__attribute__((target("avx2")))
+static int convert_avx2(const palette_lut *lut, char *dst, const char *src, const char *stencil, int count) {
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+    int i = 0;
+    for(; i + 8 <= count; i += 8) {
+        __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+        __m256i st = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(stencil + i)));
+        __m256i px = _mm256_i32gather_epi32((const int*)lut->px, idx, 4);
+        px = _mm256_or_si256(px, _mm256_and_si256(_mm256_cmpeq_epi32(st, one), alpha));
+        _mm256_storeu_si256((__m256i*)(dst + i * 4), px);
+    }
+    return i;
+}
+#endif
+
+#ifdef LUT_SSE2
+// No gathers here; the lookups stay scalar and the stencil is expanded 16 pixels at a time
+static int convert_sse2(const palette_lut *lut, char *dst, const char *src, const char *stencil, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    const uint8_t *s = (const uint8_t*)src;
+    const uint32_t *px = lut->px;
+    int i = 0;
+    for(; i + 16 <= count; i += 16) {
+        __m128i m = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(stencil + i)), one);
+        __m128i m_lo = _mm_unpacklo_epi8(zero, m);
+        __m128i m_hi = _mm_unpackhi_epi8(zero, m);
+        __m128i a[4] = {
+            _mm_unpacklo_epi16(zero, m_lo),
+            _mm_unpackhi_epi16(zero, m_lo),
+            _mm_unpacklo_epi16(zero, m_hi),
+            _mm_unpackhi_epi16(zero, m_hi)
+        };
+        for(int k = 0; k < 4; k++) {
+            const uint8_t *q = s + i + k * 4;
+            __m128i p = _mm_set_epi32(px[q[3]], px[q[2]], px[q[1]], px[q[0]]);
+            _mm_storeu_si128((__m128i*)(dst + (i + k * 4) * 4), _mm_or_si128(p, a[k]));
+        }
+    }
+    return i;
+}
+#endif
+
+void palette_lut_convert(const palette_lut *lut, char *dst, const char *src, const char *stencil, int count) {
+    int done = 0;
+#if defined(LUT_AVX2)
+    if(__builtin_cpu_supports("avx2")) {
+        done = convert_avx2(lut, dst, src, stencil, count);
+    } else {
+        done = convert_sse2(lut, dst, src, stencil, count);
+    }
+#elif defined(LUT_SSE2)
+    done = convert_sse2(lut, dst, src, stencil, count);
+#endif
+    palette_lut_convert_scalar(lut, dst + done * 4, src + done, stencil + done, count - done);
+}
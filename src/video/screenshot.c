@@ -0,0 +1,169 @@
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "video/screenshot.h"
+#include "utils/log.h"
+
+#define SCREENSHOT_MAX_THREADS 2
+
+typedef struct screenshot_job_t {
+    image img;
+    frame_capture *frame; // composed into img first, if set
+    char filename[128];
+} screenshot_job;
+
+typedef struct screenshot_queue_t {
+    screenshot_job jobs[SCREENSHOT_QUEUE_SIZE];
+    int head;
+    int count;
+    int busy; // taken off the queue, but not written yet
+    int quit;
+    SDL_mutex *lock;
+    SDL_cond *cond;
+    SDL_Thread *threads[SCREENSHOT_MAX_THREADS];
+    int thread_count;
+} screenshot_queue;
+
+static screenshot_queue queue;
+
+static void screenshot_write(screenshot_job *job) {
+    if(job->frame != NULL) {
+        frame_capture_compose(job->frame, &job->img, job->img.w, job->img.h);
+        frame_capture_free(job->frame);
+        free(job->frame);
+    }
+    if(image_write_png(&job->img, job->filename)) {
+        PERROR("Screenshot write operation failed (%s)", job->filename);
+    } else {
+        DEBUG("Got a screenshot: %s", job->filename);
+    }
+    image_free(&job->img);
+}
+
+static int screenshot_worker(void *userdata) {
+    screenshot_job job;
+    SDL_LockMutex(queue.lock);
+    while(1) {
+        if(queue.count > 0) {
+            job = queue.jobs[queue.head];
+            queue.head = (queue.head + 1) % SCREENSHOT_QUEUE_SIZE;
+            queue.count--;
+            queue.busy++;
+            SDL_UnlockMutex(queue.lock);
+            screenshot_write(&job);
+            SDL_LockMutex(queue.lock);
+            queue.busy--;
+            SDL_CondBroadcast(queue.cond);
+            continue;
+        }
+        if(queue.quit) {
+            break;
+        }
+        SDL_CondWait(queue.cond, queue.lock);
+    }
+    SDL_UnlockMutex(queue.lock);
+    return 0;
+}
+
+void screenshot_init() {
+    memset(&queue, 0, sizeof(screenshot_queue));
+    queue.lock = SDL_CreateMutex();
+    queue.cond = SDL_CreateCond();
+    if(queue.lock == NULL || queue.cond == NULL) {
+        PERROR("Unable to create screenshot queue: %s", SDL_GetError());
+        return;
+    }
+
+    // Leave the game loop a core of its own
+    int threads = SDL_GetCPUCount() - 1;
+    if(threads < 1) {
+        threads = 1;
+    } else if(threads > SCREENSHOT_MAX_THREADS) {
+        threads = SCREENSHOT_MAX_THREADS;
+    }
+    for(int i = 0; i < threads; i++) {
+        queue.threads[i] = SDL_CreateThread(screenshot_worker, "screenshot", NULL);
+        if(queue.threads[i] == NULL) {
+            PERROR("Unable to start screenshot thread: %s", SDL_GetError());
+            break;
+        }
+        queue.thread_count++;
+    }
+}
+
+void screenshot_flush() {
+    if(queue.thread_count == 0) {
+        return;
+    }
+    SDL_LockMutex(queue.lock);
+    while(queue.count > 0 || queue.busy > 0) {
+        SDL_CondWait(queue.cond, queue.lock);
+    }
+    SDL_UnlockMutex(queue.lock);
+}
+
+void screenshot_close() {
+    if(queue.thread_count > 0) {
+        SDL_LockMutex(queue.lock);
+        queue.quit = 1;
+        SDL_CondBroadcast(queue.cond);
+        SDL_UnlockMutex(queue.lock);
+        for(int i = 0; i < queue.thread_count; i++) {
+            SDL_WaitThread(queue.threads[i], NULL);
+        }
+    }
+    if(queue.cond != NULL) {
+        SDL_DestroyCond(queue.cond);
+    }
+    if(queue.lock != NULL) {
+        SDL_DestroyMutex(queue.lock);
+    }
+    memset(&queue, 0, sizeof(screenshot_queue));
+}
+
+static void screenshot_drop(screenshot_job *job) {
+    if(job->frame != NULL) {
+        frame_capture_free(job->frame);
+        free(job->frame);
+    }
+    image_free(&job->img);
+}
+
+static int screenshot_queue_job(screenshot_job *job) {
+    if(queue.thread_count == 0) {
+        screenshot_write(job);
+        return 0;
+    }
+
+    SDL_LockMutex(queue.lock);
+    if(queue.count == SCREENSHOT_QUEUE_SIZE) {
+        SDL_UnlockMutex(queue.lock);
+        screenshot_drop(job);
+        return 1;
+    }
+    queue.jobs[(queue.head + queue.count) % SCREENSHOT_QUEUE_SIZE] = *job;
+    queue.count++;
+    SDL_CondSignal(queue.cond);
+    SDL_UnlockMutex(queue.lock);
+    return 0;
+}
+
+int screenshot_save(image *img, const char *filename) {
+    screenshot_job job;
+    job.img = *img;
+    job.frame = NULL;
+    snprintf(job.filename, sizeof(job.filename), "%s", filename);
+    img->data = NULL;
+    return screenshot_queue_job(&job);
+}
+
+int screenshot_save_frame(frame_capture *frame, int w, int h, const char *filename) {
+    screenshot_job job;
+    memset(&job.img, 0, sizeof(image));
+    job.img.w = w;
+    job.img.h = h;
+    job.frame = frame;
+    snprintf(job.filename, sizeof(job.filename), "%s", filename);
+    return screenshot_queue_job(&job);
+}
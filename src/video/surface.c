@@ -2,6 +2,13 @@
 #include <string.h>
 #include <utils/log.h>
 #include "video/surface.h"
+#include "video/palette_lut.h"
+#include "utils/miscmath.h"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define SURFACE_SSE2
+#include <emmintrin.h>
+#endif
 
 void surface_create(surface *sur, int type, int w, int h) {
     if(type == SURFACE_TYPE_RGBA) {
@@ -104,6 +111,35 @@ void surface_copy(surface *dst, surface *src) {
     }
 }
 
+// Copies one row of pixels the way a pixel by pixel loop from left to right would,
+// which matters when a surface is copied onto itself
+static void surface_copy_span(char *dst, const char *src, int len) {
+    if(dst > src && dst < src + len) {
+        for(int i = 0; i < len; i++) {
+            dst[i] = src[i];
+        }
+    } else {
+        memmove(dst, src, len);
+    }
+}
+
+// Copies len pixels from src, going right, to dst, going left
+static void surface_mirror_span(char *dst, const char *src, int len, int bytes) {
+    for(int i = 0; i < len; i++) {
+        memcpy(dst - i * bytes, src + i * bytes, bytes);
+    }
+}
+
+// Narrows a w x h blit to (x, y) down to the columns [x0, x1) and rows [y0, y1)
+// that land on dst. Returns 0 if nothing does.
+static int surface_clip(const surface *dst, int x, int y, int w, int h, int *x0, int *x1, int *y0, int *y1) {
+    *x0 = max2(0, -x);
+    *x1 = min2(w, dst->w - x);
+    *y0 = max2(0, -y);
+    *y1 = min2(h, dst->h - y);
+    return *x0 < *x1 && *y0 < *y1;
+}
+
 // Copies a an area of old surface to an entirely new surface
 void surface_sub(surface *dst,
                  surface *src,
@@ -117,25 +153,39 @@ void surface_sub(surface *dst,
         return;
     }
 
+    // Only copy what is inside both surfaces. When mirroring, column x goes to column w - 1 - x.
+    int x0 = max2(0, -src_x);
+    int x1 = min2(w, src->w - src_x);
+    int y0 = max3(0, -src_y, -dst_y);
+    int y1 = min2(min2(h, src->h - src_y), dst->h - dst_y);
+    if(method == SUB_METHOD_MIRROR) {
+        x0 = max2(x0, dst_x + w - dst->w);
+        x1 = min2(x1, dst_x + w);
+    } else {
+        x0 = max2(x0, -dst_x);
+        x1 = min2(x1, dst->w - dst_x);
+    }
+    if(x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
     // Copy!
     int bytes = (src->type == SURFACE_TYPE_RGBA) ? 4 : 1;
-    int src_offset,dst_offset;
-    for(int y = 0; y < h; y++) {
-        for(int x = 0; x < w; x++) {
-            src_offset = (src_x + x + (src_y + y) * src->w) * bytes;
-            switch(method) {
-                case SUB_METHOD_MIRROR:
-                    dst_offset = (dst_x + (w - x - 1) + (dst_y + y) * dst->w) * bytes;
-                    break;
-                default:
-                    dst_offset = (dst_x + x + (dst_y + y) * dst->w) * bytes;
-                    break;
-            }
-            for(int m = 0; m < bytes; m++) {
-                dst->data[dst_offset + m] = src->data[src_offset + m];
+    int len = x1 - x0;
+    for(int y = y0; y < y1; y++) {
+        int src_offset = src_x + x0 + (src_y + y) * src->w;
+        int dst_offset;
+        if(method == SUB_METHOD_MIRROR) {
+            dst_offset = dst_x + (w - x0 - 1) + (dst_y + y) * dst->w;
+            surface_mirror_span(dst->data + dst_offset * bytes, src->data + src_offset * bytes, len, bytes);
+            if(bytes == 1) {
+                surface_mirror_span(dst->stencil + dst_offset, src->stencil + src_offset, len, 1);
             }
+        } else {
+            dst_offset = dst_x + x0 + (dst_y + y) * dst->w;
+            surface_copy_span(dst->data + dst_offset * bytes, src->data + src_offset * bytes, len * bytes);
             if(bytes == 1) {
-                dst->stencil[dst_offset] = src->stencil[src_offset];
+                surface_copy_span(dst->stencil + dst_offset, src->stencil + src_offset, len);
             }
         }
     }
@@ -152,29 +202,29 @@ void surface_additive_blit(surface *dst,
         return;
     }
 
-    int src_offset,dst_offset;
-    uint8_t src_index, dst_index;
-    for(int y = 0; y < src->h; y++) {
-        for(int x = 0; x < src->w; x++) {
-            // If pixel offscreen, skip
-            if(dst_x + x >= dst->w
-                || dst_y + y >= dst->h
-                || dst_x + x < 0
-                || dst_y + y < 0) continue;
-
-            // Calculate pixel offsets
-            src_offset = ((flip & SDL_FLIP_HORIZONTAL) ? src->w - x : x) +
-                         ((flip & SDL_FLIP_VERTICAL) ? src->h - y : y) * src->w;
-            dst_offset = dst_x + x + (dst_y + y) * dst->w;
+    int x0, x1, y0, y1;
+    if(!surface_clip(dst, dst_x, dst_y, src->w, src->h, &x0, &x1, &y0, &y1)) {
+        return;
+    }
 
+    // Flipped additive blits have always sampled one pixel further along than alpha blits.
+    // That stays, but samples that would fall past the end of the source are skipped.
+    int hflip = (flip & SDL_FLIP_HORIZONTAL) != 0;
+    int step = hflip ? -1 : 1;
+    for(int y = y0; y < y1; y++) {
+        int row = (flip & SDL_FLIP_VERTICAL) ? src->h - y : y;
+        if(row >= src->h) {
+            continue;
+        }
+        int first = (hflip && row == src->h - 1 && x0 == 0) ? 1 : x0;
+        const uint8_t *s = (const uint8_t*)src->data + row * src->w + (hflip ? src->w - first : first);
+        int dst_offset = dst_x + first + (dst_y + y) * dst->w;
+        uint8_t *d = (uint8_t*)dst->data + dst_offset;
+        const char *stencil = dst->stencil + dst_offset;
+        for(int x = first; x < x1; x++, s += step, d++, stencil++) {
             // Do blit, if pixel is visible on stencil
-            if(dst->stencil[dst_offset] == 1) {
-                if(src->data[src_offset] == 0)
-                    continue;
-
-                src_index = src->data[src_offset]+3;
-                dst_index = dst->data[dst_offset];
-                dst->data[dst_offset] = remap_pal->remaps[src_index][dst_index];
+            if(*stencil == 1 && *s != 0) {
+                *d = remap_pal->remaps[(uint8_t)(*s + 3)][*d];
             }
         }
     }
@@ -207,6 +257,54 @@ void surface_rgba_blit(surface *dst, const surface *src, int dst_x, int dst_y) {
         }
     }}
 
+// Copies the pixels that are opaque on the source stencil
+static void surface_alpha_span(char *dst, char *dst_stencil, const char *src, const char *src_stencil, int len) {
+    int i = 0;
+#ifdef SURFACE_SSE2
+    const __m128i one = _mm_set1_epi8(1);
+    for(; i + 16 <= len; i += 16) {
+        __m128i mask = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(src_stencil + i)), one);
+        int bits = _mm_movemask_epi8(mask);
+        if(bits == 0) {
+            continue;
+        }
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        if(bits == 0xFFFF) {
+            _mm_storeu_si128((__m128i*)(dst + i), s);
+            _mm_storeu_si128((__m128i*)(dst_stencil + i), one);
+            continue;
+        }
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i ds = _mm_loadu_si128((const __m128i*)(dst_stencil + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_and_si128(mask, s), _mm_andnot_si128(mask, d)));
+        _mm_storeu_si128((__m128i*)(dst_stencil + i), _mm_or_si128(_mm_and_si128(mask, one), _mm_andnot_si128(mask, ds)));
+    }
+#endif
+    // Opaque runs are copied in one go
+    while(i < len) {
+        if(src_stencil[i] != 1) {
+            i++;
+            continue;
+        }
+        int start = i;
+        while(i < len && src_stencil[i] == 1) {
+            i++;
+        }
+        memcpy(dst + start, src + start, i - start);
+        memset(dst_stencil + start, 1, i - start);
+    }
+}
+
+// Same as above, with src and src_stencil pointing at the rightmost pixel of a horizontally flipped span
+static void surface_alpha_span_flipped(char *dst, char *dst_stencil, const char *src, const char *src_stencil, int len) {
+    for(int i = 0; i < len; i++) {
+        if(src_stencil[-i] == 1) {
+            dst[i] = src[-i];
+            dst_stencil[i] = 1;
+        }
+    }
+}
+
 void surface_alpha_blit(surface *dst,
                         surface *src,
                         int dst_x, int dst_y,
@@ -217,25 +315,22 @@ void surface_alpha_blit(surface *dst,
         return;
     }
 
-    int src_offset,dst_offset;
-    for(int y = 0; y < src->h; y++) {
-        for(int x = 0; x < src->w; x++) {
-            // If pixel offscreen, skip
-            if(dst_x + x >= dst->w
-                || dst_y + y >= dst->h
-                || dst_x + x < 0
-                || dst_y + y < 0) continue;
-
-            // Calculate offsets
-            src_offset = ((flip & SDL_FLIP_HORIZONTAL) ? src->w - 1 - x : x) +
-                         ((flip & SDL_FLIP_VERTICAL) ? src->h - 1 - y : y) * src->w;
-            dst_offset = dst_x + x + (dst_y + y) * dst->w;
+    int x0, x1, y0, y1;
+    if(!surface_clip(dst, dst_x, dst_y, src->w, src->h, &x0, &x1, &y0, &y1)) {
+        return;
+    }
 
-            // If pixel is visible on stencil, do blit
-            if(src->stencil[src_offset] == 1) {
-                dst->data[dst_offset] = src->data[src_offset];
-                dst->stencil[dst_offset] = 1;
-            }
+    for(int y = y0; y < y1; y++) {
+        int row = (flip & SDL_FLIP_VERTICAL) ? src->h - 1 - y : y;
+        int dst_offset = dst_x + x0 + (dst_y + y) * dst->w;
+        if(flip & SDL_FLIP_HORIZONTAL) {
+            int src_offset = src->w - 1 - x0 + row * src->w;
+            surface_alpha_span_flipped(dst->data + dst_offset, dst->stencil + dst_offset,
+                                       src->data + src_offset, src->stencil + src_offset, x1 - x0);
+        } else {
+            int src_offset = x0 + row * src->w;
+            surface_alpha_span(dst->data + dst_offset, dst->stencil + dst_offset,
+                               src->data + src_offset, src->stencil + src_offset, x1 - x0);
         }
     }
 }
@@ -264,30 +359,39 @@ void surface_to_rgba(surface *sur,
                      screen_palette *pal,
                      char *remap_table,
                      uint8_t pal_offset) {
+    surface_to_rgba_pitch(sur, dst, sur->w * 4, pal, remap_table, pal_offset);
+}
 
+void surface_to_rgba_pitch(surface *sur,
+                           char *dst,
+                           int pitch,
+                           screen_palette *pal,
+                           char *remap_table,
+                           uint8_t pal_offset) {
+    int row = sur->w * 4;
     if(sur->type == SURFACE_TYPE_RGBA) {
-        memcpy(dst, sur->data, sur->w * sur->h * 4);
-    } else {
-        int n = 0;
-        uint8_t idx = 0;
-        for(int i = 0; i < sur->w * sur->h; i++) {
-            n = i * 4;
-            if(remap_table != NULL) {
-                idx = (uint8_t)remap_table[(uint8_t)sur->data[i]];
-            } else {
-                idx = (uint8_t)sur->data[i];
+        if(pitch == row) {
+            memcpy(dst, sur->data, row * sur->h);
+        } else {
+            for(int y = 0; y < sur->h; y++) {
+                memcpy(dst + y * pitch, sur->data + y * row, row);
             }
-            // TODO: This is kind of a hack. Since the pal_offset
-            // is only ever used for player 2 har, we can safely
-            // make some assumptions. therefore, only apply offset,
-            // if the color we are handling is between 0 and 48 (har colors).
-            if(idx < 48) {
-                idx += pal_offset;
+        }
+    } else {
+        // TODO: This is kind of a hack. Since the pal_offset
+        // is only ever used for player 2 har, we can safely
+        // make some assumptions. therefore, only apply offset,
+        // if the color we are handling is between 0 and 48 (har colors).
+        // palette_lut_build() takes care of that, as well as the remapping.
+        palette_lut lut;
+        palette_lut_build(&lut, pal, remap_table, pal_offset);
+        if(pitch == row) {
+            palette_lut_convert(&lut, dst, sur->data, sur->stencil, sur->w * sur->h);
+        } else {
+            for(int y = 0; y < sur->h; y++) {
+                int offset = y * sur->w;
+                palette_lut_convert(&lut, dst + y * pitch, sur->data + offset, sur->stencil + offset, sur->w);
             }
-            *(dst + n + 0) = pal->data[idx][0];
-            *(dst + n + 1) = pal->data[idx][1];
-            *(dst + n + 2) = pal->data[idx][2];
-            *(dst + n + 3) = (sur->stencil[i] == 1) ? 0xFF : 0;
         }
     }
 }
@@ -302,7 +406,7 @@ int surface_to_texture(surface *src,
     void *pixels;
     int pitch;
     if(SDL_LockTexture(tex, NULL, &pixels, &pitch) == 0) {
-        surface_to_rgba(src, pixels, pal, remap_table, pal_offset);
+        surface_to_rgba_pitch(src, pixels, pitch, pal, remap_table, pal_offset);
         SDL_UnlockTexture(tex);
         return 0;
     }
@@ -1,9 +1,13 @@
 #include <stdlib.h>
+#include <string.h>
 #include "video/tcache.h"
+#include "video/atlas.h"
 #include "utils/hashmap.h"
 #include "utils/log.h"
 
-#define CACHE_LIFETIME 300
+#define ATLAS_PAGE_SIZE 2048
+#define ATLAS_MAX_PAGES 8
+#define TCACHE_MIN_BUDGET (4 * 1024 * 1024)
 
 typedef struct tcache_entry_key_t {
     surface *c_surface;
@@ -12,20 +16,53 @@ typedef struct tcache_entry_key_t {
     uint8_t c_pal_offset;
 } tcache_entry_key;
 
-typedef struct tcache_entry_value_t {
+typedef struct tcache_entry_value_t tcache_entry_value;
+struct tcache_entry_value_t {
     SDL_Texture *tex;
-    unsigned int age;
+    SDL_Rect rect; // area of tex holding the surface
+    uint8_t in_atlas;
     unsigned int pal_version;
-} tcache_entry_value;
+    size_t bytes; // 0 in the atlas, where the page is what takes up memory
+    unsigned int used_frame;
+    tcache_entry_key key; // for removing the entry when it gets evicted
+    tcache_entry_value *prev; // LRU list, most recently used first
+    tcache_entry_value *next;
+};
 
 typedef struct tcache_t {
     hashmap entries;
+    atlas atlas;
+    int page_w;
+    int page_h;
+    tcache_entry_value *lru_head;
+    tcache_entry_value *lru_tail;
+    size_t used_bytes; // standalone textures and whole atlas pages
+    size_t peak_bytes;
+    size_t budget_bytes;
     unsigned int hits;
     unsigned int misses;
-    unsigned int old_frees;
+    unsigned int evictions;
+    uint64_t upload_bytes;
+    uint64_t convert_ticks; // surface_to_rgba() and scaling
+    uint64_t upload_ticks; // locking and unlocking textures
+    char *convert_buf; // scratch buffers for scaling, grown as needed
+    size_t convert_size;
+    char *scale_buf;
+    size_t scale_size;
+
+    // Live statistics. Counters above are snapshotted at the end of every frame,
+    // and the difference goes to the history ring and to the current scene.
+    tcache_stats last;
+    unsigned int frame;
+    int scene;
+    tcache_frame_stats history[TCACHE_HISTORY];
+    tcache_scene_stats scenes[TCACHE_MAX_SCENES];
+
     uint8_t scale_factor;
     scaler_plugin *scaler;
     SDL_Renderer *renderer;
+    tcache_upload_cb upload_cb;
+    void *upload_userdata;
 } tcache;
 
 static tcache *cache = NULL;
@@ -47,15 +84,163 @@ tcache_entry_value* tcache_get_entry(tcache_entry_key *key) {
     return val;
 }
 
+static void tcache_lru_unlink(tcache_entry_value *entry) {
+    if(entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    } else {
+        cache->lru_head = entry->next;
+    }
+    if(entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    } else {
+        cache->lru_tail = entry->prev;
+    }
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+static void tcache_lru_push(tcache_entry_value *entry) {
+    entry->used_frame = cache->frame;
+    entry->prev = NULL;
+    entry->next = cache->lru_head;
+    if(cache->lru_head != NULL) {
+        cache->lru_head->prev = entry;
+    } else {
+        cache->lru_tail = entry;
+    }
+    cache->lru_head = entry;
+}
+
+static void tcache_evict(tcache_entry_value *entry) {
+    // A queued draw may still read from the texture, so let the renderer flush first
+    if(cache->upload_cb != NULL) {
+        cache->upload_cb(entry->tex, &entry->rect, cache->upload_userdata);
+    }
+    if(entry->in_atlas) {
+        atlas_release(&cache->atlas, entry->tex, &entry->rect);
+    } else {
+        SDL_DestroyTexture(entry->tex);
+    }
+    tcache_lru_unlink(entry);
+    cache->used_bytes -= entry->bytes;
+    cache->evictions++;
+
+    // The value goes away with the pair, so copy the key out first. Padding is part of
+    // the hashed bytes too, hence memcpy instead of assignment.
+    tcache_entry_key key;
+    memcpy(&key, &entry->key, sizeof(tcache_entry_key));
+    hashmap_del(&cache->entries, (void*)&key, sizeof(tcache_entry_key));
+}
+
+// Drops least recently used textures until the given amount of bytes fits in the budget.
+// Atlas pages stay until the next tcache_clear() and don't count here; their slots are
+// given back when the pages run full, see tcache_atlas_alloc().
+static void tcache_make_room(size_t bytes) {
+    tcache_entry_value *entry = cache->lru_tail;
+    while(entry != NULL && cache->used_bytes + bytes > cache->budget_bytes) {
+        tcache_entry_value *prev = entry->prev;
+        if(!entry->in_atlas) {
+            tcache_evict(entry);
+        }
+        entry = prev;
+    }
+}
+
+static int tcache_atlas_alloc(int w, int h, SDL_Texture **tex, SDL_Rect *rect) {
+    if(!atlas_fits(&cache->atlas, w, h)) {
+        return 1;
+    }
+    if(atlas_alloc(&cache->atlas, w, h, tex, rect) == 0) {
+        return 0;
+    }
+
+    // All pages are full. Give back the slots of images that were not drawn this frame,
+    // oldest first, until one of them takes the new image.
+    tcache_entry_value *entry = cache->lru_tail;
+    while(entry != NULL && entry->used_frame != cache->frame) {
+        tcache_entry_value *prev = entry->prev;
+        if(entry->in_atlas) {
+            tcache_evict(entry);
+            if(atlas_alloc(&cache->atlas, w, h, tex, rect) == 0) {
+                return 0;
+            }
+        }
+        entry = prev;
+    }
+    return 1;
+}
+
+static size_t tcache_page_bytes() {
+    return (size_t)cache->page_w * cache->page_h * 4;
+}
+
+// Atlas pages may take up half of the budget; the rest is for textures that don't fit them
+static void tcache_limit_pages() {
+    size_t pages = cache->budget_bytes / 2 / tcache_page_bytes();
+    cache->atlas.max_pages = (pages < ATLAS_MAX_PAGES) ? (int)pages : ATLAS_MAX_PAGES;
+}
+
+static void tcache_grow(size_t bytes) {
+    cache->used_bytes += bytes;
+    if(cache->used_bytes > cache->peak_bytes) {
+        cache->peak_bytes = cache->used_bytes;
+    }
+}
+
+static char* tcache_scratch(char **buf, size_t *size, size_t need) {
+    if(need > *size) {
+        free(*buf);
+        *buf = malloc(need);
+        *size = need;
+    }
+    return *buf;
+}
+
+static void tcache_atlas_create() {
+    SDL_RendererInfo info;
+    cache->page_w = ATLAS_PAGE_SIZE;
+    cache->page_h = ATLAS_PAGE_SIZE;
+    if(SDL_GetRendererInfo(cache->renderer, &info) == 0) {
+        if(info.max_texture_width > 0 && info.max_texture_width < cache->page_w) {
+            cache->page_w = info.max_texture_width;
+        }
+        if(info.max_texture_height > 0 && info.max_texture_height < cache->page_h) {
+            cache->page_h = info.max_texture_height;
+        }
+    }
+    atlas_create(&cache->atlas, cache->renderer, cache->page_w, cache->page_h, ATLAS_MAX_PAGES);
+    tcache_limit_pages();
+}
+
 void tcache_init(SDL_Renderer *renderer, int scale_factor, scaler_plugin *scaler) {
     cache = malloc(sizeof(tcache));
     hashmap_create(&cache->entries, 6);
     cache->renderer = renderer;
     cache->scaler = scaler;
     cache->scale_factor = scale_factor;
+    cache->budget_bytes = TCACHE_DEFAULT_BUDGET;
+    tcache_atlas_create();
+    cache->upload_cb = NULL;
+    cache->upload_userdata = NULL;
+    cache->lru_head = NULL;
+    cache->lru_tail = NULL;
+    cache->used_bytes = 0;
+    cache->peak_bytes = 0;
     cache->hits = 0;
-    cache->old_frees = 0;
+    cache->evictions = 0;
     cache->misses = 0;
+    cache->upload_bytes = 0;
+    cache->convert_ticks = 0;
+    cache->upload_ticks = 0;
+    cache->convert_buf = NULL;
+    cache->convert_size = 0;
+    cache->scale_buf = NULL;
+    cache->scale_size = 0;
+    memset(&cache->last, 0, sizeof(tcache_stats));
+    memset(cache->history, 0, sizeof(cache->history));
+    memset(cache->scenes, 0, sizeof(cache->scenes));
+    cache->frame = 0;
+    cache->scene = 0;
     DEBUG("Texture cache initialized.");
 }
 
@@ -72,40 +257,135 @@ void tcache_clear() {
     hashmap_pair *pair;
     while((pair = iter_next(&it)) != NULL) {
         tcache_entry_value *entry = pair->val;
-        SDL_DestroyTexture(entry->tex);
+        if(!entry->in_atlas) {
+            SDL_DestroyTexture(entry->tex);
+        }
     }
     hashmap_clear(&cache->entries);
+    cache->lru_head = NULL;
+    cache->lru_tail = NULL;
+    cache->used_bytes = 0;
+
+    // Scenes are cleared on load, so each one packs its own sprites into fresh pages.
+    // The pages are also gone before a renderer they belong to gets destroyed.
+    atlas_free(&cache->atlas);
+    tcache_atlas_create();
 }
 
-void tcache_tick() {
-    iterator it;
-    hashmap_iter_begin(&cache->entries, &it);
-    hashmap_pair *pair;
-    while((pair = iter_next(&it)) != NULL) {
-        tcache_entry_value *entry = pair->val;
-        entry->age++;
-        if(entry->age > CACHE_LIFETIME) {
-            SDL_DestroyTexture(entry->tex);
-            hashmap_delete(&cache->entries, &it);
-            cache->old_frees++;
-        }
+void tcache_set_budget(size_t bytes) {
+    if(bytes < TCACHE_MIN_BUDGET) {
+        bytes = TCACHE_MIN_BUDGET;
     }
+    cache->budget_bytes = bytes;
+    tcache_limit_pages();
+    tcache_make_room(0);
+}
+
+static uint64_t ticks_to_us(uint64_t ticks) {
+    return ticks * 1000000 / SDL_GetPerformanceFrequency();
+}
+
+void tcache_get_stats(tcache_stats *stats) {
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->evictions = cache->evictions;
+    stats->entries = hashmap_size(&cache->entries);
+    stats->used_bytes = cache->used_bytes;
+    stats->peak_bytes = cache->peak_bytes;
+    stats->budget_bytes = cache->budget_bytes;
+    stats->upload_bytes = cache->upload_bytes;
+    stats->convert_us = ticks_to_us(cache->convert_ticks);
+    stats->upload_us = ticks_to_us(cache->upload_ticks);
+}
+
+void tcache_set_scene(int scene_id) {
+    if(scene_id < 0 || scene_id >= TCACHE_MAX_SCENES) {
+        scene_id = 0;
+    }
+    cache->scene = scene_id;
+}
+
+void tcache_frame_end() {
+    tcache_stats now;
+    tcache_get_stats(&now);
+
+    tcache_frame_stats *f = &cache->history[cache->frame % TCACHE_HISTORY];
+    f->frame = cache->frame;
+    f->scene = cache->scene;
+    f->hits = now.hits - cache->last.hits;
+    f->misses = now.misses - cache->last.misses;
+    f->evictions = now.evictions - cache->last.evictions;
+    f->upload_bytes = now.upload_bytes - cache->last.upload_bytes;
+    f->convert_us = now.convert_us - cache->last.convert_us;
+    f->upload_us = now.upload_us - cache->last.upload_us;
+    f->used_bytes = now.used_bytes;
+
+    tcache_scene_stats *s = &cache->scenes[cache->scene];
+    s->frames++;
+    s->hits += f->hits;
+    s->misses += f->misses;
+    s->evictions += f->evictions;
+    s->upload_bytes += f->upload_bytes;
+    s->convert_us += f->convert_us;
+    s->upload_us += f->upload_us;
+    if(f->used_bytes > s->peak_bytes) {
+        s->peak_bytes = f->used_bytes;
+    }
+    if(f->convert_us + f->upload_us > s->worst_us) {
+        s->worst_us = f->convert_us + f->upload_us;
+        s->worst_frame = f->frame;
+    }
+
+    cache->last = now;
+    cache->frame++;
+}
+
+int tcache_get_history(tcache_frame_stats *frames, int max) {
+    int count = (cache->frame < TCACHE_HISTORY) ? (int)cache->frame : TCACHE_HISTORY;
+    if(count > max) {
+        count = max;
+    }
+    // Oldest first
+    for(int i = 0; i < count; i++) {
+        frames[i] = cache->history[(cache->frame - count + i) % TCACHE_HISTORY];
+    }
+    return count;
+}
+
+int tcache_get_scene_stats(int scene_id, tcache_scene_stats *stats) {
+    if(scene_id < 0 || scene_id >= TCACHE_MAX_SCENES || cache->scenes[scene_id].frames == 0) {
+        return 1;
+    }
+    *stats = cache->scenes[scene_id];
+    return 0;
+}
+
+void tcache_set_upload_cb(tcache_upload_cb cb, void *userdata) {
+    cache->upload_cb = cb;
+    cache->upload_userdata = userdata;
 }
 
 void tcache_close() {
+    unsigned int lookups = cache->hits + cache->misses;
     DEBUG("Texture cache:");
-    DEBUG(" * Misses:    %d", cache->misses);
-    DEBUG(" * Hits:      %d", cache->hits);
-    DEBUG(" * Old frees: %d", cache->old_frees);
+    DEBUG(" * Misses:    %u", cache->misses);
+    DEBUG(" * Hits:      %u (%.1f%%)", cache->hits, lookups ? cache->hits * 100.0f / lookups : 0.0f);
+    DEBUG(" * Evictions: %u", cache->evictions);
+    DEBUG(" * Peak size: %u of %u kB", (unsigned)(cache->peak_bytes / 1024), (unsigned)(cache->budget_bytes / 1024));
+    DEBUG(" * Atlas:     %d pages of %dx%d", atlas_page_count(&cache->atlas), cache->page_w, cache->page_h);
     tcache_clear();
+    atlas_free(&cache->atlas);
     hashmap_free(&cache->entries);
+    free(cache->convert_buf);
+    free(cache->scale_buf);
     free(cache);
 }
 
 SDL_Texture* tcache_get(surface *sur,
                         screen_palette *pal,
                         char *remap_table,
-                        uint8_t pal_offset) {
+                        uint8_t pal_offset,
+                        SDL_Rect *rect) {
     if(sur == NULL) {
         DEBUG("Invalid surface requested from tcache: surface is NULL.");
         return NULL;
@@ -129,8 +409,10 @@ SDL_Texture* tcache_get(surface *sur,
     // If surface is cacheable and hasn't changed, just return here.
     tcache_entry_value *val = tcache_get_entry(&key);
     if(val != NULL && (val->pal_version == pal->version || sur->type == SURFACE_TYPE_RGBA) && !sur->force_refresh) {
-        val->age = 0;
+        tcache_lru_unlink(val);
+        tcache_lru_push(val);
         cache->hits++;
+        *rect = val->rect;
         return val->tex;
     }
 
@@ -139,44 +421,87 @@ SDL_Texture* tcache_get(surface *sur,
 
     // If there was no fitting surface tex in the cache at all,
     // then we need to create one
+    // Surfaces go into an atlas page if there's room; only oversized ones get a texture of their own
     if(val == NULL) {
         tcache_entry_value new_entry;
-        new_entry.age = 0;
+        int w = sur->w * cache->scale_factor;
+        int h = sur->h * cache->scale_factor;
+        memcpy(&new_entry.key, &key, sizeof(tcache_entry_key));
         new_entry.pal_version = pal->version;
-        new_entry.tex = SDL_CreateTexture(cache->renderer,
-                                          SDL_PIXELFORMAT_ABGR8888,
-                                          SDL_TEXTUREACCESS_STREAMING,
-                                          sur->w * cache->scale_factor,
-                                          sur->h * cache->scale_factor);
-        SDL_SetTextureBlendMode(new_entry.tex, SDL_BLENDMODE_BLEND);
+        int pages = atlas_page_count(&cache->atlas);
+        new_entry.in_atlas = (tcache_atlas_alloc(w, h, &new_entry.tex, &new_entry.rect) == 0);
+        if(new_entry.in_atlas) {
+            new_entry.bytes = 0;
+            if(atlas_page_count(&cache->atlas) > pages) {
+                tcache_make_room(tcache_page_bytes());
+                tcache_grow(tcache_page_bytes());
+            }
+        } else {
+            new_entry.bytes = (size_t)w * h * 4;
+            tcache_make_room(new_entry.bytes);
+            new_entry.tex = SDL_CreateTexture(cache->renderer,
+                                              SDL_PIXELFORMAT_ABGR8888,
+                                              SDL_TEXTUREACCESS_STREAMING,
+                                              w, h);
+            SDL_SetTextureBlendMode(new_entry.tex, SDL_BLENDMODE_BLEND);
+            new_entry.rect.x = 0;
+            new_entry.rect.y = 0;
+            new_entry.rect.w = w;
+            new_entry.rect.h = h;
+        }
         val = tcache_add_entry(&key, &new_entry);
+        tcache_lru_push(val);
+        tcache_grow(val->bytes);
+    } else {
+        tcache_lru_unlink(val);
+        tcache_lru_push(val);
     }
 
     // We have a texture either from the cache, or we just created one.
     // Either one, it needs to be updated. Let's do it now.
     // Also, scale surface if necessary
+    if(cache->upload_cb != NULL) {
+        cache->upload_cb(val->tex, &val->rect, cache->upload_userdata);
+    }
+    // Pixels are written straight into the locked texture, honoring its pitch.
+    // Only scaling needs intermediate buffers, and those are kept between calls.
+    void *pixels;
+    int pitch;
+    uint64_t lock_start = SDL_GetPerformanceCounter();
+    if(SDL_LockTexture(val->tex, &val->rect, &pixels, &pitch) != 0) {
+        PERROR("Failed to lock texture for writing: %s", SDL_GetError());
+        *rect = val->rect;
+        return val->tex;
+    }
+    uint64_t convert_start = SDL_GetPerformanceCounter();
     if(cache->scale_factor > 1) {
-        char *raw = malloc(sur->w * sur->h * 4);
-        surface scaled;
-        surface_create(&scaled,
-                       SURFACE_TYPE_RGBA,
-                       sur->w * cache->scale_factor,
-                       sur->h * cache->scale_factor);
-
+        int row = val->rect.w * 4;
+        char *raw = tcache_scratch(&cache->convert_buf, &cache->convert_size, (size_t)sur->w * sur->h * 4);
         surface_to_rgba(sur, raw, pal, remap_table, pal_offset);
-        scaler_scale(cache->scaler, raw, scaled.data, sur->w, sur->h, cache->scale_factor);
-        surface_to_texture(&scaled, val->tex, pal, remap_table, pal_offset);
-        surface_free(&scaled);
-        free(raw);
+        if(pitch == row) {
+            scaler_scale(cache->scaler, raw, pixels, sur->w, sur->h, cache->scale_factor);
+        } else {
+            char *scaled = tcache_scratch(&cache->scale_buf, &cache->scale_size, (size_t)row * val->rect.h);
+            scaler_scale(cache->scaler, raw, scaled, sur->w, sur->h, cache->scale_factor);
+            for(int y = 0; y < val->rect.h; y++) {
+                memcpy((char*)pixels + y * pitch, scaled + y * row, row);
+            }
+        }
     } else {
-        surface_to_texture(sur, val->tex, pal, remap_table, pal_offset);
+        surface_to_rgba_pitch(sur, pixels, pitch, pal, remap_table, pal_offset);
     }
+    uint64_t unlock_start = SDL_GetPerformanceCounter();
+    SDL_UnlockTexture(val->tex);
+    uint64_t unlock_end = SDL_GetPerformanceCounter();
+    cache->convert_ticks += unlock_start - convert_start;
+    cache->upload_ticks += (convert_start - lock_start) + (unlock_end - unlock_start);
+    cache->upload_bytes += (uint64_t)val->rect.w * val->rect.h * 4;
 
-    // Set correct age and palette version
-    val->age = 0;
+    // Set correct palette version
     val->pal_version = pal->version;
 
     // Do some statistics stuff
     cache->misses++;
+    *rect = val->rect;
     return val->tex;
 }
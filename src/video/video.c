@@ -12,9 +12,11 @@
 #include "video/video_state.h"
 #include "video/video_hw.h"
 #include "video/video_soft.h"
+#include "video/video_cpu.h"
 #include "plugins/plugins.h"
 
 static video_state state;
+static frame_capture *capture = NULL;
 
 
 void clear_render_target() {
@@ -63,6 +65,9 @@ int video_init(int window_w,
     state.vsync = vsync;
     state.fade = 1.0f;
     state.target = NULL;
+    state.offscreen = NULL;
+    state.batching = 1;
+    state.dirty_rects = 1;
     state.target_move_x = 0;
     state.target_move_y = 0;
 
@@ -158,10 +163,64 @@ int video_init(int window_w,
     return 0;
 }
 
+static void init_renderer(int renderer) {
+    state.cur_renderer = renderer;
+    if(state.offscreen != NULL) {
+        video_cpu_init(&state);
+        DEBUG("Switched to offscreen renderer.");
+        return;
+    }
+    switch(renderer) {
+        case VIDEO_RENDERER_QUIRKS:
+            video_soft_init(&state);
+            break;
+        case VIDEO_RENDERER_HW:
+            video_hw_init(&state);
+            break;
+    }
+}
+
+int video_init_offscreen() {
+    state.w = NATIVE_W;
+    state.h = NATIVE_H;
+    state.fs = 0;
+    state.vsync = 0;
+    state.fade = 1.0f;
+    state.target = NULL;
+    state.target_move_x = 0;
+    state.target_move_y = 0;
+    state.window = NULL;
+    state.batching = 1;
+    state.dirty_rects = 0;
+
+    // Frames are scaled afterwards by whoever reads them back
+    memset(state.scaler_name, 0, sizeof(state.scaler_name));
+    scaler_init(&state.scaler);
+    state.scale_factor = 1;
+
+    // Clear palettes
+    state.cur_palette = calloc(1, sizeof(screen_palette));
+    state.base_palette = calloc(1, sizeof(palette));
+    state.cur_palette->version = 1;
+
+    // No SDL renderer at all; frames are composed in memory
+    state.renderer = NULL;
+    state.offscreen = calloc(1, NATIVE_W * NATIVE_H * 4);
+
+    // Nothing is ever cached, but scenes still report to the cache
+    tcache_init(NULL, state.scale_factor, &state.scaler);
+    init_renderer(VIDEO_RENDERER_HW);
+    INFO("Video Init OK (offscreen)");
+    return 0;
+}
+
 void video_reinit_renderer() {
     // Clear old texture cache entries
     tcache_clear();
 
+    // The software renderer keeps a texture of its own; it has to go with the renderer
+    state.cb.render_close(&state);
+
     // Kill old renderer
     SDL_DestroyRenderer(state.renderer);
 
@@ -178,6 +237,17 @@ void video_reinit_renderer() {
 
      // Reset rendertarget
     reset_targets();
+    init_renderer(state.cur_renderer);
+}
+
+void video_render_reset(int device_lost) {
+    // All textures went with the device, so start over with a new renderer
+    if(device_lost) {
+        video_reinit_renderer();
+        return;
+    }
+    // Only the contents of the render target are gone
+    state.cb.render_reinit(&state);
 }
 
 int video_reinit(int window_w,
@@ -277,24 +347,48 @@ void video_select_renderer(int renderer) {
     if(renderer == state.cur_renderer) {
         return;
     }
-    state.cb.render_close(&state);
-    state.cur_renderer = renderer;
-    switch(renderer) {
-        case VIDEO_RENDERER_QUIRKS:
-            video_soft_init(&state);
-            break;
-        case VIDEO_RENDERER_HW:
-            video_hw_init(&state);
-            break;
+
+    // Offscreen frames are always drawn the same way; keep the frame contents as well
+    if(state.offscreen != NULL) {
+        state.cur_renderer = renderer;
+        return;
     }
+    state.cb.render_close(&state);
+    init_renderer(renderer);
+}
+
+void video_set_batching(int enabled) {
+    state.batching = enabled;
+}
+
+void video_get_render_stats(unsigned int *sprites, unsigned int *draw_calls, unsigned int *state_changes) {
+    *sprites = state.stat_sprites;
+    *draw_calls = state.stat_draw_calls;
+    *state_changes = state.stat_state_changes;
+}
+
+void video_set_dirty_rects(int enabled) {
+    state.dirty_rects = enabled;
+}
+
+float video_get_redrawn_percent() {
+    return state.stat_redrawn * 100.0f / (NATIVE_W * state.scale_factor * NATIVE_H * state.scale_factor);
 }
 
 void video_set_fade(float fade) {
     state.fade = fade;
 }
 
+const char* video_get_frame() {
+    return (const char*)state.offscreen;
+}
+
 int video_screenshot(image *img) {
     image_create(img, state.w, state.h);
+    if(state.offscreen != NULL) {
+        memcpy(img->data, state.offscreen, NATIVE_W * NATIVE_H * 4);
+        return 0;
+    }
     int ret = SDL_RenderReadPixels(state.renderer, NULL, SDL_PIXELFORMAT_ABGR8888, img->data, img->w * 4);
     if(ret != 0) {
         PERROR("Unable to read pixels from rendertarget: %s", SDL_GetError());
@@ -303,6 +397,10 @@ int video_screenshot(image *img) {
     return 0;
 }
 
+void video_capture_frame(frame_capture *cap) {
+    capture = cap;
+}
+
 int video_area_capture(surface *sur, int x, int y, int w, int h) {
     float scale_x = (float)state.w / NATIVE_W;
     float scale_y = (float)state.h / NATIVE_H;
@@ -317,6 +415,14 @@ int video_area_capture(surface *sur, int x, int y, int w, int h) {
     // Create a new surface
     surface_create(sur, SURFACE_TYPE_RGBA, r.w, r.h);
 
+    // Offscreen frames are native size, so no scaling either
+    if(state.offscreen != NULL) {
+        for(int y = 0; y < r.h; y++) {
+            memcpy(sur->data + y * r.w * 4, state.offscreen + ((r.y + y) * NATIVE_W + r.x) * 4, r.w * 4);
+        }
+        return 0;
+    }
+
     // Read pixels
     int ret = SDL_RenderReadPixels(state.renderer, &r, SDL_PIXELFORMAT_ABGR8888, sur->data, sur->w * 4);
     if(ret != 0) {
@@ -357,14 +463,40 @@ screen_palette* video_get_pal_ref() {
 void video_render_prepare() {
     // Reset palette
     memcpy(state.cur_palette->data, state.base_palette->data, 768);
-    SDL_SetRenderTarget(state.renderer, state.target);
+    if(state.renderer != NULL) {
+        SDL_SetRenderTarget(state.renderer, state.target);
+    }
+    state.stat_sprites = 0;
+    state.stat_draw_calls = 0;
+    state.stat_state_changes = 0;
+    state.stat_redrawn = NATIVE_W * state.scale_factor * NATIVE_H * state.scale_factor;
     state.cb.render_prepare(&state);
 }
 
 void video_render_background(surface *sur) {
+    if(capture != NULL) {
+        SDL_Rect dst = {0, 0, NATIVE_W, NATIVE_H};
+        frame_capture_draw(capture, state.cur_palette, sur, &dst, SDL_BLENDMODE_NONE, 0,
+                           SDL_FLIP_NONE, 0xFF, color_create(0xFF, 0xFF, 0xFF, 0xFF));
+    }
     state.cb.render_background(&state, sur);
 }
 
+static void render_fsot(
+        surface *sur,
+        SDL_Rect *dst,
+        SDL_BlendMode blend_mode,
+        int pal_offset,
+        SDL_RendererFlip flip_mode,
+        uint8_t opacity,
+        color tint) {
+
+    if(capture != NULL) {
+        frame_capture_draw(capture, state.cur_palette, sur, dst, blend_mode, pal_offset, flip_mode, opacity, tint);
+    }
+    state.cb.render_fsot(&state, sur, dst, blend_mode, pal_offset, flip_mode, opacity, tint);
+}
+
 void video_render_sprite_tint(
         surface *sur,
         int sx,
@@ -380,8 +512,7 @@ void video_render_sprite_tint(
     dst.y = sy;
 
     // Render
-    state.cb.render_fsot(
-        &state,
+    render_fsot(
         sur,
         &dst,
         SDL_BLENDMODE_BLEND,
@@ -461,8 +592,7 @@ void video_render_sprite_size(
     dst.y = sy;
 
     // Render
-    state.cb.render_fsot(
-        &state,
+    render_fsot(
         sur,
         &dst,
         SDL_BLENDMODE_BLEND, // blendmode
@@ -501,18 +631,30 @@ void video_render_sprite_flip_scale_opacity_tint(
         blend_mode = SDL_BLENDMODE_ADD;
 
     // Render
-    state.cb.render_fsot(&state, sur, &dst, blend_mode, pal_offset, flip, opacity, tint);
+    render_fsot(sur, &dst, blend_mode, pal_offset, flip, opacity, tint);
 }
 
 // Called on every game tick
 void video_tick() {
-    tcache_tick();
+    // Texture cache eviction is driven by its memory budget rather than by ticks
 }
 
 // Called after frame has been rendered
 void video_render_finish() {
     // Tell software/hardware renderer to finish up whatever it was doing
     state.cb.render_finish(&state);
+    tcache_frame_end();
+
+    // The recording stops with the frame
+    if(capture != NULL) {
+        frame_capture_finish(capture, state.fade, state.target_move_x, state.target_move_y);
+        capture = NULL;
+    }
+
+    // The offscreen renderer has already finished the frame in memory
+    if(state.offscreen != NULL) {
+        return;
+    }
 
     // Set our rendertarget to screen buffer.
     SDL_SetRenderTarget(state.renderer, NULL);
@@ -547,9 +689,14 @@ void video_render_finish() {
 void video_close() {
     state.cb.render_close(&state);
     tcache_close();
-    SDL_DestroyTexture(state.target);
-    SDL_DestroyRenderer(state.renderer);
-    SDL_DestroyWindow(state.window);
+    if(state.renderer != NULL) {
+        SDL_DestroyTexture(state.target);
+        SDL_DestroyRenderer(state.renderer);
+    }
+    if(state.window != NULL) {
+        SDL_DestroyWindow(state.window);
+    }
+    free(state.offscreen);
     free(state.cur_palette);
     free(state.base_palette);
     INFO("Video deinit.");
@@ -0,0 +1,190 @@
+#include <stdlib.h>
+#include <string.h>
+#include "video/video.h"
+#include "video/video_cpu.h"
+#include "video/palette_lut.h"
+#include "utils/miscmath.h"
+
+// Stands in for the render target texture; the frame is finished from this
+typedef struct cpu_renderer_t {
+    uint8_t *target;
+    char *row; // one source row, converted to RGBA
+    int row_size;
+} cpu_renderer;
+
+static uint8_t cpu_mul(unsigned int a, unsigned int b) {
+    return (a * b + 127) / 255;
+}
+
+// The SDL blend modes, with color and alpha modulation applied to the source first
+static void cpu_blend(uint8_t *d, const uint8_t *s, SDL_BlendMode blend, SDL_Color mod, int modulate) {
+    uint8_t r = s[0], g = s[1], b = s[2], a = s[3];
+    if(modulate) {
+        r = cpu_mul(r, mod.r);
+        g = cpu_mul(g, mod.g);
+        b = cpu_mul(b, mod.b);
+        a = cpu_mul(a, mod.a);
+    }
+    switch(blend) {
+        case SDL_BLENDMODE_NONE:
+            d[0] = r;
+            d[1] = g;
+            d[2] = b;
+            d[3] = a;
+            break;
+        case SDL_BLENDMODE_ADD:
+            if(a == 0) {
+                break;
+            }
+            d[0] = min2(255, d[0] + cpu_mul(r, a));
+            d[1] = min2(255, d[1] + cpu_mul(g, a));
+            d[2] = min2(255, d[2] + cpu_mul(b, a));
+            break;
+        default:
+            if(a == 0) {
+                break;
+            }
+            if(a == 255) {
+                d[0] = r;
+                d[1] = g;
+                d[2] = b;
+                d[3] = 255;
+                break;
+            }
+            d[0] = (r * a + d[0] * (255 - a) + 127) / 255;
+            d[1] = (g * a + d[1] * (255 - a) + 127) / 255;
+            d[2] = (b * a + d[2] * (255 - a) + 127) / 255;
+            d[3] = a + cpu_mul(d[3], 255 - a);
+            break;
+    }
+}
+
+// Scaling and flipping sample the nearest source pixel, like SDL_RenderCopyEx does
+static void cpu_draw(video_state *state,
+                     surface *sur,
+                     const SDL_Rect *dst,
+                     SDL_BlendMode blend,
+                     int pal_offset,
+                     SDL_RendererFlip flip,
+                     SDL_Color mod) {
+
+    cpu_renderer *cr = state->userdata;
+    palette_lut lut;
+    int x0 = max2(dst->x, 0);
+    int y0 = max2(dst->y, 0);
+    int x1 = min2(dst->x + dst->w, NATIVE_W);
+    int y1 = min2(dst->y + dst->h, NATIVE_H);
+    if(x0 >= x1 || y0 >= y1 || sur->w <= 0 || sur->h <= 0) {
+        return;
+    }
+    int modulate = (mod.r & mod.g & mod.b & mod.a) != 0xFF;
+
+    if(sur->type == SURFACE_TYPE_PALETTE) {
+        palette_lut_build(&lut, state->cur_palette, NULL, pal_offset);
+    }
+    if(sur->w * 4 > cr->row_size) {
+        cr->row_size = sur->w * 4;
+        cr->row = realloc(cr->row, cr->row_size);
+    }
+
+    for(int y = y0; y < y1; y++) {
+        int sy = (y - dst->y) * sur->h / dst->h;
+        if(flip & SDL_FLIP_VERTICAL) {
+            sy = sur->h - 1 - sy;
+        }
+        const char *src;
+        if(sur->type == SURFACE_TYPE_PALETTE) {
+            int offset = sy * sur->w;
+            palette_lut_convert(&lut, cr->row, sur->data + offset, sur->stencil + offset, sur->w);
+            src = cr->row;
+        } else {
+            src = sur->data + sy * sur->w * 4;
+        }
+        uint8_t *d = cr->target + (y * NATIVE_W + x0) * 4;
+        for(int x = x0; x < x1; x++, d += 4) {
+            int sx = (x - dst->x) * sur->w / dst->w;
+            if(flip & SDL_FLIP_HORIZONTAL) {
+                sx = sur->w - 1 - sx;
+            }
+            cpu_blend(d, (const uint8_t*)src + sx * 4, blend, mod, modulate);
+        }
+    }
+}
+
+void cpu_render_close(video_state *state) {
+    cpu_renderer *cr = state->userdata;
+    free(cr->target);
+    free(cr->row);
+    free(cr);
+    state->userdata = NULL;
+}
+
+void cpu_render_reinit(video_state *state) {
+
+}
+
+void cpu_render_prepare(video_state *state) {
+
+}
+
+// Does what the end of video_render_finish() does with a window: fade, screen
+// shake and black borders. The screen has no alpha, so neither does the frame.
+void cpu_render_finish(video_state *state) {
+    cpu_renderer *cr = state->userdata;
+    uint8_t v = 255.0f * state->fade;
+    int mx = state->target_move_x;
+    int my = state->target_move_y;
+    uint8_t *out = state->offscreen;
+    for(int y = 0; y < NATIVE_H; y++) {
+        int sy = y - my;
+        for(int x = 0; x < NATIVE_W; x++) {
+            int sx = x - mx;
+            uint8_t *d = out + (y * NATIVE_W + x) * 4;
+            if(sx < 0 || sy < 0 || sx >= NATIVE_W || sy >= NATIVE_H) {
+                d[0] = d[1] = d[2] = 0;
+            } else {
+                const uint8_t *s = cr->target + (sy * NATIVE_W + sx) * 4;
+                d[0] = cpu_mul(s[0], v);
+                d[1] = cpu_mul(s[1], v);
+                d[2] = cpu_mul(s[2], v);
+            }
+            d[3] = 0xFF;
+        }
+    }
+    state->stat_draw_calls = 0;
+    state->stat_state_changes = 0;
+}
+
+void cpu_render_background(video_state *state, surface *sur) {
+    SDL_Rect dst = {0, 0, NATIVE_W, NATIVE_H};
+    SDL_Color mod = {0xFF, 0xFF, 0xFF, 0xFF};
+    state->stat_sprites++;
+    cpu_draw(state, sur, &dst, SDL_BLENDMODE_NONE, 0, SDL_FLIP_NONE, mod);
+}
+
+void cpu_render_sprite_fsot(
+                    video_state *state,
+                    surface *sur,
+                    SDL_Rect *dst,
+                    SDL_BlendMode blend_mode,
+                    int pal_offset,
+                    SDL_RendererFlip flip_mode,
+                    uint8_t opacity,
+                    color color_mod) {
+
+    SDL_Color mod = {color_mod.r, color_mod.g, color_mod.b, opacity};
+    state->stat_sprites++;
+    cpu_draw(state, sur, dst, blend_mode, pal_offset, flip_mode, mod);
+}
+
+void video_cpu_init(video_state *state) {
+    cpu_renderer *cr = calloc(1, sizeof(cpu_renderer));
+    cr->target = calloc(1, NATIVE_W * NATIVE_H * 4);
+    state->userdata = cr;
+    state->cb.render_close = cpu_render_close;
+    state->cb.render_reinit = cpu_render_reinit;
+    state->cb.render_prepare = cpu_render_prepare;
+    state->cb.render_finish = cpu_render_finish;
+    state->cb.render_fsot = cpu_render_sprite_fsot;
+    state->cb.render_background = cpu_render_background;
+}
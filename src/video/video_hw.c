@@ -1,21 +1,445 @@
+#include <stdlib.h>
+#include <string.h>
+#include "video/video.h"
 #include "video/video_hw.h"
 #include "video/tcache.h"
+#include "utils/miscmath.h"
 #include "utils/log.h"
 
-void hw_render_close(video_state *state) {
+// Batches a new sprite may be moved back into, as long as it overlaps nothing drawn in between
+#define HW_BATCH_LOOKBACK 8
+
+// Separate damaged areas kept per frame; more than this get merged together
+#define HW_MAX_DAMAGE 8
+
+// SDL_RenderGeometry draws a whole batch in one call; older SDL gets one copy per sprite
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+#define HW_USE_GEOMETRY
+#endif
+
+typedef struct hw_command_t {
+    SDL_Texture *tex;
+    SDL_Rect src;
+    SDL_Rect dst;
+    SDL_BlendMode blend;
+    SDL_RendererFlip flip;
+    SDL_Color mod; // tint, and opacity as alpha
+    int batch;
+} hw_command;
+
+typedef struct hw_batch_t {
+    SDL_Texture *tex;
+    SDL_BlendMode blend;
+    SDL_Rect bounds;
+    int first; // start of this batch in the sorted command list
+    int count;
+} hw_batch;
+
+// Last state set on a texture this frame, so unchanged state isn't set again
+typedef struct hw_tex_state_t {
+    SDL_Texture *tex;
+    SDL_BlendMode blend;
+    SDL_Color mod;
+} hw_tex_state;
 
+typedef struct hw_renderer_t {
+    hw_command *cmds;
+    hw_command *sorted;
+    int cmd_count;
+    int cmd_alloc;
+    hw_batch *batches;
+    int batch_count;
+    int batch_alloc;
+    hw_tex_state *tex_states;
+    int tex_state_count;
+    int tex_state_alloc;
+#ifdef HW_USE_GEOMETRY
+    SDL_Vertex *verts;
+    int *indices;
+    int geom_alloc; // in sprites
+#endif
+    unsigned int draw_calls;
+    unsigned int state_changes;
+
+    // What went into the render target last frame, to redraw only what changed since
+    hw_command *prev;
+    int prev_count; // -1 when the target has to be redrawn in full
+    int prev_alloc;
+    hw_command *clipped;
+    SDL_Rect damage[HW_MAX_DAMAGE];
+    int damage_count;
+    int flushed; // Commands were drawn before the end of the frame
+} hw_renderer;
+
+static void hw_set_texture_state(video_state *state, SDL_Texture *tex, SDL_BlendMode blend, SDL_Color mod) {
+    hw_renderer *hw = state->userdata;
+    hw_tex_state *ts = NULL;
+    for(int i = 0; i < hw->tex_state_count; i++) {
+        if(hw->tex_states[i].tex == tex) {
+            ts = &hw->tex_states[i];
+            break;
+        }
+    }
+    if(ts == NULL) {
+        if(hw->tex_state_count >= hw->tex_state_alloc) {
+            hw->tex_state_alloc = hw->tex_state_alloc ? hw->tex_state_alloc * 2 : 16;
+            hw->tex_states = realloc(hw->tex_states, hw->tex_state_alloc * sizeof(hw_tex_state));
+        }
+        ts = &hw->tex_states[hw->tex_state_count++];
+        ts->tex = tex;
+        SDL_SetTextureBlendMode(tex, blend);
+        SDL_SetTextureColorMod(tex, mod.r, mod.g, mod.b);
+        SDL_SetTextureAlphaMod(tex, mod.a);
+        hw->state_changes += 3;
+    } else {
+        if(ts->blend != blend) {
+            SDL_SetTextureBlendMode(tex, blend);
+            hw->state_changes++;
+        }
+        if(ts->mod.r != mod.r || ts->mod.g != mod.g || ts->mod.b != mod.b) {
+            SDL_SetTextureColorMod(tex, mod.r, mod.g, mod.b);
+            hw->state_changes++;
+        }
+        if(ts->mod.a != mod.a) {
+            SDL_SetTextureAlphaMod(tex, mod.a);
+            hw->state_changes++;
+        }
+    }
+    ts->blend = blend;
+    ts->mod = mod;
 }
 
-void hw_render_reinit(video_state *state) {
+#ifdef HW_USE_GEOMETRY
+static void hw_submit_batch(video_state *state, const hw_batch *b, const hw_command *cmds) {
+    hw_renderer *hw = state->userdata;
+    SDL_Color white = {0xFF, 0xFF, 0xFF, 0xFF};
+    int tw, th;
+    if(b->count > hw->geom_alloc) {
+        hw->geom_alloc = b->count * 2;
+        hw->verts = realloc(hw->verts, hw->geom_alloc * 4 * sizeof(SDL_Vertex));
+        hw->indices = realloc(hw->indices, hw->geom_alloc * 6 * sizeof(int));
+    }
+    SDL_QueryTexture(b->tex, NULL, NULL, &tw, &th);
 
+    // Modulation goes into the vertex colors, so the texture itself stays unmodulated
+    for(int i = 0; i < b->count; i++) {
+        const hw_command *c = &cmds[i];
+        SDL_Vertex *v = &hw->verts[i * 4];
+        float u0 = (float)c->src.x / tw;
+        float v0 = (float)c->src.y / th;
+        float u1 = (float)(c->src.x + c->src.w) / tw;
+        float v1 = (float)(c->src.y + c->src.h) / th;
+        if(c->flip & SDL_FLIP_HORIZONTAL) {
+            float t = u0; u0 = u1; u1 = t;
+        }
+        if(c->flip & SDL_FLIP_VERTICAL) {
+            float t = v0; v0 = v1; v1 = t;
+        }
+        float x0 = c->dst.x, y0 = c->dst.y;
+        float x1 = c->dst.x + c->dst.w, y1 = c->dst.y + c->dst.h;
+        v[0].position.x = x0; v[0].position.y = y0; v[0].tex_coord.x = u0; v[0].tex_coord.y = v0;
+        v[1].position.x = x1; v[1].position.y = y0; v[1].tex_coord.x = u1; v[1].tex_coord.y = v0;
+        v[2].position.x = x1; v[2].position.y = y1; v[2].tex_coord.x = u1; v[2].tex_coord.y = v1;
+        v[3].position.x = x0; v[3].position.y = y1; v[3].tex_coord.x = u0; v[3].tex_coord.y = v1;
+        for(int k = 0; k < 4; k++) {
+            v[k].color = c->mod;
+        }
+        int *idx = &hw->indices[i * 6];
+        idx[0] = i * 4; idx[1] = i * 4 + 1; idx[2] = i * 4 + 2;
+        idx[3] = i * 4; idx[4] = i * 4 + 2; idx[5] = i * 4 + 3;
+    }
+    hw_set_texture_state(state, b->tex, b->blend, white);
+    SDL_RenderGeometry(state->renderer, b->tex, hw->verts, b->count * 4, hw->indices, b->count * 6);
+    hw->draw_calls++;
 }
+#else
+static void hw_submit_batch(video_state *state, const hw_batch *b, const hw_command *cmds) {
+    hw_renderer *hw = state->userdata;
+    for(int i = 0; i < b->count; i++) {
+        const hw_command *c = &cmds[i];
+        hw_set_texture_state(state, c->tex, c->blend, c->mod);
+        SDL_RenderCopyEx(state->renderer, c->tex, &c->src, &c->dst, 0, NULL, c->flip);
+        hw->draw_calls++;
+    }
+}
+#endif
 
-void hw_render_prepare(video_state *state) {
+// Groups the commands by batch, keeping their order within each batch
+static void hw_sort(hw_renderer *hw) {
+    int pos = 0;
+    for(int b = 0; b < hw->batch_count; b++) {
+        hw->batches[b].first = pos;
+        pos += hw->batches[b].count;
+        hw->batches[b].count = 0;
+    }
+    for(int i = 0; i < hw->cmd_count; i++) {
+        hw_batch *b = &hw->batches[hw->cmds[i].batch];
+        hw->sorted[b->first + b->count++] = hw->cmds[i];
+    }
+}
+
+static void hw_flush(video_state *state) {
+    hw_renderer *hw = state->userdata;
+    if(hw->cmd_count == 0) {
+        return;
+    }
+    hw_sort(hw);
+    for(int b = 0; b < hw->batch_count; b++) {
+        hw_submit_batch(state, &hw->batches[b], &hw->sorted[hw->batches[b].first]);
+    }
+    hw->cmd_count = 0;
+    hw->batch_count = 0;
+    hw->flushed = 1;
+}
 
+// Draws only the sprites that touch the damaged areas, clipped to them. The
+// areas never overlap, so nothing gets blended twice.
+static void hw_flush_damage(video_state *state) {
+    hw_renderer *hw = state->userdata;
+    hw_sort(hw);
+    for(int d = 0; d < hw->damage_count; d++) {
+        const SDL_Rect *area = &hw->damage[d];
+        SDL_RenderSetClipRect(state->renderer, area);
+        for(int b = 0; b < hw->batch_count; b++) {
+            hw_batch batch = hw->batches[b];
+            if(!SDL_HasIntersection(&batch.bounds, area)) {
+                continue;
+            }
+            const hw_command *cmds = &hw->sorted[batch.first];
+            int count = 0;
+            for(int i = 0; i < hw->batches[b].count; i++) {
+                if(SDL_HasIntersection(&cmds[i].dst, area)) {
+                    hw->clipped[count++] = cmds[i];
+                }
+            }
+            if(count > 0) {
+                batch.count = count;
+                hw_submit_batch(state, &batch, hw->clipped);
+            }
+        }
+    }
+    SDL_RenderSetClipRect(state->renderer, NULL);
+    hw->cmd_count = 0;
+    hw->batch_count = 0;
+}
+
+// Adds an area to redraw, merging it with any it touches so none of them overlap
+static void hw_add_damage(video_state *state, const SDL_Rect *rect) {
+    hw_renderer *hw = state->userdata;
+    SDL_Rect screen = {0, 0, NATIVE_W * state->scale_factor, NATIVE_H * state->scale_factor};
+    SDL_Rect r;
+    if(!SDL_IntersectRect(rect, &screen, &r)) {
+        return;
+    }
+    int i = 0;
+    while(i < hw->damage_count) {
+        if(SDL_HasIntersection(&hw->damage[i], &r)) {
+            SDL_UnionRect(&hw->damage[i], &r, &r);
+            hw->damage[i] = hw->damage[--hw->damage_count];
+            i = 0;
+            continue;
+        }
+        i++;
+    }
+    if(hw->damage_count == HW_MAX_DAMAGE) {
+        SDL_UnionRect(&hw->damage[--hw->damage_count], &r, &r);
+        hw_add_damage(state, &r);
+        return;
+    }
+    hw->damage[hw->damage_count++] = r;
+}
+
+static int hw_command_equal(const hw_command *a, const hw_command *b) {
+    return a->tex == b->tex
+        && SDL_RectEquals(&a->src, &b->src)
+        && SDL_RectEquals(&a->dst, &b->dst)
+        && a->blend == b->blend
+        && a->flip == b->flip
+        && a->mod.r == b->mod.r
+        && a->mod.g == b->mod.g
+        && a->mod.b == b->mod.b
+        && a->mod.a == b->mod.a;
+}
+
+// A pixel can only look different if a sprite covering it now, or last frame,
+// is not the same as the one drawn at the same point of last frame's list.
+// Returns the number of pixels to redraw.
+static int hw_find_damage(video_state *state) {
+    hw_renderer *hw = state->userdata;
+    int limit = NATIVE_W * state->scale_factor * NATIVE_H * state->scale_factor / 2;
+    int count = max2(hw->cmd_count, hw->prev_count);
+    for(int i = 0; i < count; i++) {
+        int in_prev = (i < hw->prev_count);
+        int in_cur = (i < hw->cmd_count);
+        if(in_prev && in_cur && hw_command_equal(&hw->prev[i], &hw->cmds[i])) {
+            continue;
+        }
+        if(in_prev) {
+            hw_add_damage(state, &hw->prev[i].dst);
+        }
+        if(in_cur) {
+            hw_add_damage(state, &hw->cmds[i].dst);
+        }
+    }
+    int area = 0;
+    for(int d = 0; d < hw->damage_count; d++) {
+        area += hw->damage[d].w * hw->damage[d].h;
+    }
+    // Past this point drawing everything is simpler, and not much slower
+    return (area > limit) ? -1 : area;
+}
+
+static void hw_keep_commands(hw_renderer *hw, int count) {
+    if(count > hw->prev_alloc) {
+        hw->prev_alloc = hw->cmd_alloc;
+        hw->prev = realloc(hw->prev, hw->prev_alloc * sizeof(hw_command));
+    }
+    memcpy(hw->prev, hw->cmds, count * sizeof(hw_command));
+    hw->prev_count = count;
+}
+
+static void hw_queue(video_state *state, SDL_Texture *tex, const SDL_Rect *src, const SDL_Rect *dst,
+                     SDL_BlendMode blend, SDL_RendererFlip flip, SDL_Color mod) {
+    hw_renderer *hw = state->userdata;
+    state->stat_sprites++;
+
+    // Unbatched, like it used to be; kept for comparing draw call counts
+    if(!state->batching) {
+        SDL_SetTextureAlphaMod(tex, mod.a);
+        SDL_SetTextureColorMod(tex, mod.r, mod.g, mod.b);
+        SDL_SetTextureBlendMode(tex, blend);
+        SDL_RenderCopyEx(state->renderer, tex, src, dst, 0, NULL, flip);
+        hw->state_changes += 3;
+        hw->draw_calls++;
+        return;
+    }
+
+    if(hw->cmd_count >= hw->cmd_alloc) {
+        hw->cmd_alloc = hw->cmd_alloc ? hw->cmd_alloc * 2 : 256;
+        hw->cmds = realloc(hw->cmds, hw->cmd_alloc * sizeof(hw_command));
+        hw->sorted = realloc(hw->sorted, hw->cmd_alloc * sizeof(hw_command));
+        hw->clipped = realloc(hw->clipped, hw->cmd_alloc * sizeof(hw_command));
+    }
+    hw_command *c = &hw->cmds[hw->cmd_count++];
+    c->tex = tex;
+    c->src = *src;
+    c->dst = *dst;
+    c->blend = blend;
+    c->flip = flip;
+    c->mod = mod;
+
+    // Join an earlier batch with the same texture and blending, unless that would
+    // move the sprite under something it is supposed to be drawn on top of
+    c->batch = -1;
+    for(int b = hw->batch_count - 1; b >= 0 && b >= hw->batch_count - HW_BATCH_LOOKBACK; b--) {
+        hw_batch *batch = &hw->batches[b];
+        if(batch->tex == tex && batch->blend == blend) {
+            c->batch = b;
+            break;
+        }
+        if(SDL_HasIntersection(&batch->bounds, dst)) {
+            break;
+        }
+    }
+    if(c->batch < 0) {
+        if(hw->batch_count >= hw->batch_alloc) {
+            hw->batch_alloc = hw->batch_alloc ? hw->batch_alloc * 2 : 32;
+            hw->batches = realloc(hw->batches, hw->batch_alloc * sizeof(hw_batch));
+        }
+        c->batch = hw->batch_count++;
+        hw_batch *batch = &hw->batches[c->batch];
+        batch->tex = tex;
+        batch->blend = blend;
+        batch->bounds = *dst;
+        batch->count = 0;
+    }
+    hw_batch *batch = &hw->batches[c->batch];
+    SDL_UnionRect(&batch->bounds, dst, &batch->bounds);
+    batch->count++;
+}
+
+// A queued sprite must still see the old texture contents, so draw it before they change.
+// Sprites drawn from there last frame will look different now, even if nothing else changed.
+static void hw_before_upload(SDL_Texture *tex, const SDL_Rect *rect, void *userdata) {
+    video_state *state = userdata;
+    hw_renderer *hw = state->userdata;
+    for(int i = 0; i < hw->prev_count; i++) {
+        if(hw->prev[i].tex == tex && SDL_HasIntersection(&hw->prev[i].src, rect)) {
+            hw_add_damage(state, &hw->prev[i].dst);
+        }
+    }
+    for(int i = 0; i < hw->cmd_count; i++) {
+        if(hw->cmds[i].tex == tex && SDL_HasIntersection(&hw->cmds[i].src, rect)) {
+            hw_flush(state);
+            return;
+        }
+    }
+}
+
+void hw_render_close(video_state *state) {
+    hw_renderer *hw = state->userdata;
+    tcache_set_upload_cb(NULL, NULL);
+    free(hw->cmds);
+    free(hw->sorted);
+    free(hw->batches);
+    free(hw->tex_states);
+    free(hw->prev);
+    free(hw->clipped);
+#ifdef HW_USE_GEOMETRY
+    free(hw->verts);
+    free(hw->indices);
+#endif
+    free(hw);
+    state->userdata = NULL;
+}
+
+// The target no longer holds what the last frame's commands drew there: it was
+// lost, or the textures were scaled again. Draw the next frame in full.
+void hw_render_reinit(video_state *state) {
+    hw_renderer *hw = state->userdata;
+    hw->prev_count = -1;
+}
+
+void hw_render_prepare(video_state *state) {
+    hw_renderer *hw = state->userdata;
+    hw->cmd_count = 0;
+    hw->batch_count = 0;
+    hw->tex_state_count = 0;
+    hw->draw_calls = 0;
+    hw->state_changes = 0;
+    hw->damage_count = 0;
+    hw->flushed = 0;
 }
 
 void hw_render_finish(video_state *state) {
+    hw_renderer *hw = state->userdata;
+    int full = NATIVE_W * state->scale_factor * NATIVE_H * state->scale_factor;
+    int count = hw->cmd_count;
+    int keep = state->dirty_rects && state->batching && !hw->flushed;
+
+    // Anything drawn already went over the whole frame, and so does everything else
+    if(!keep || hw->prev_count < 0) {
+        hw_flush(state);
+        state->stat_redrawn = full;
+    } else {
+        int area = hw_find_damage(state);
+        if(area < 0) {
+            hw_flush(state);
+            state->stat_redrawn = full;
+        } else {
+            hw_flush_damage(state);
+            state->stat_redrawn = area;
+        }
+    }
 
+    // Unbatched sprites are never kept, so there is nothing to compare with
+    if(keep) {
+        hw_keep_commands(hw, count);
+    } else {
+        hw->prev_count = -1;
+    }
+    state->stat_draw_calls = hw->draw_calls;
+    state->stat_state_changes = hw->state_changes;
 }
 
 void hw_scale_rect(video_state *state, SDL_Rect *rct) {
@@ -29,13 +453,13 @@ void hw_render_background(
                     video_state *state,
                     surface *sur) {
 
-    SDL_Texture *tex = tcache_get(sur, state->cur_palette, NULL, 0);
+    SDL_Rect src;
+    SDL_Texture *tex = tcache_get(sur, state->cur_palette, NULL, 0, &src);
     if(tex == NULL)
         return;
-    SDL_SetTextureColorMod(tex, 0xFF, 0xFF, 0xFF);
-    SDL_SetTextureAlphaMod(tex, 0xFF);
-    SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_NONE);
-    SDL_RenderCopy(state->renderer, tex, NULL, NULL);
+    SDL_Rect dst = {0, 0, NATIVE_W * state->scale_factor, NATIVE_H * state->scale_factor};
+    SDL_Color mod = {0xFF, 0xFF, 0xFF, 0xFF};
+    hw_queue(state, tex, &src, &dst, SDL_BLENDMODE_NONE, SDL_FLIP_NONE, mod);
 }
 
 void hw_render_sprite_fsot(
@@ -49,17 +473,20 @@ void hw_render_sprite_fsot(
                     color color_mod) {
 
     hw_scale_rect(state, dst);
-    SDL_Texture *tex = tcache_get(sur, state->cur_palette, NULL, pal_offset);
+    SDL_Rect src;
+    SDL_Texture *tex = tcache_get(sur, state->cur_palette, NULL, pal_offset, &src);
     if(tex == NULL)
         return;
-    SDL_SetTextureAlphaMod(tex, opacity);
-    SDL_SetTextureColorMod(tex, color_mod.r, color_mod.g, color_mod.b);
-    SDL_SetTextureBlendMode(tex, blend_mode);
-    SDL_RenderCopyEx(state->renderer, tex, NULL, dst, 0, NULL, flip_mode);
+    SDL_Color mod = {color_mod.r, color_mod.g, color_mod.b, opacity};
+    hw_queue(state, tex, &src, dst, blend_mode, flip_mode, mod);
 }
 
 
 void video_hw_init(video_state *state) {
+    hw_renderer *hw = calloc(1, sizeof(hw_renderer));
+    hw->prev_count = -1;
+    state->userdata = hw;
+    tcache_set_upload_cb(hw_before_upload, state);
     state->cb.render_close = hw_render_close;
     state->cb.render_reinit = hw_render_reinit;
     state->cb.render_prepare = hw_render_prepare;
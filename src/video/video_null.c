@@ -0,0 +1,152 @@
+#ifdef STANDALONE_SERVER
+
+// Video backend for the dedicated server. Nothing is ever drawn; only the
+// palette state is kept, since the simulation reads it back in a few places.
+// Matches on different threads each get their own copy of it.
+
+#include <string.h>
+
+#include "video/video.h"
+#include "video/tcache.h"
+#include "utils/compat.h"
+
+static THREAD_LOCAL palette base_palette;
+static THREAD_LOCAL screen_palette cur_palette;
+
+int video_init(int window_w,
+               int window_h,
+               int fullscreen,
+               int vsync,
+               const char* scaler_name,
+               int scale_factor) {
+    return 0;
+}
+
+int video_reinit(int window_w,
+                 int window_h,
+                 int fullscreen,
+                 int vsync,
+                 const char* scaler_name,
+                 int scale_factor) {
+    return 0;
+}
+
+int video_init_offscreen() {
+    return 0;
+}
+
+void video_reinit_renderer() {}
+
+void video_render_reset(int device_lost) {}
+
+void video_get_state(int *w, int *h, int *fs, int *vsync) {
+    if(w != NULL) {
+        *w = NATIVE_W;
+    }
+    if(h != NULL) {
+        *h = NATIVE_H;
+    }
+    if(fs != NULL) {
+        *fs = 0;
+    }
+    if(vsync != NULL) {
+        *vsync = 0;
+    }
+}
+
+void video_move_target(int x, int y) {}
+
+void video_render_sprite(surface *sur, int x, int y, unsigned int render_mode, int pal_offset) {}
+
+void video_render_sprite_size(surface *sur, int sx, int sy, int sw, int sh) {}
+
+void video_render_sprite_flip_scale(surface *sur, int x, int y, unsigned int render_mode,
+                                    int pal_offset, unsigned int flip_mode, float y_percent) {}
+
+void video_render_sprite_tint(surface *sur, int x, int y, color c, int pal_offset) {}
+
+void video_render_sprite_flip_scale_opacity(surface *sur, int x, int y, unsigned int render_mode,
+                                            int pal_offset, unsigned int flip_mode, float y_percent,
+                                            uint8_t opacity) {}
+
+void video_render_sprite_flip_scale_opacity_tint(surface *sur, int x, int y, unsigned int render_mode,
+                                                 int pal_offset, unsigned int flip_mode, float y_percent,
+                                                 uint8_t opacity, color tint) {}
+
+void video_select_renderer(int renderer) {}
+void video_set_batching(int enabled) {}
+
+void video_set_dirty_rects(int enabled) {}
+
+float video_get_redrawn_percent() {
+    return 0.0f;
+}
+
+void video_get_render_stats(unsigned int *sprites, unsigned int *draw_calls, unsigned int *state_changes) {
+    *sprites = 0;
+    *draw_calls = 0;
+    *state_changes = 0;
+}
+
+void video_tick() {}
+void video_render_background(surface *sur) {}
+void video_render_prepare() {}
+void video_render_finish() {}
+void video_close() {}
+void video_set_fade(float fade) {}
+
+const char* video_get_frame() {
+    return NULL;
+}
+
+int video_screenshot(image *img) {
+    return 1;
+}
+
+int video_area_capture(surface *sur, int x, int y, int w, int h) {
+    // Hand back a blank surface so callers can treat it like a real capture
+    surface_create(sur, SURFACE_TYPE_RGBA, w, h);
+    surface_clear(sur);
+    return 0;
+}
+
+void video_force_pal_refresh() {
+    memcpy(cur_palette.data, base_palette.data, 768);
+    cur_palette.version++;
+}
+
+void video_set_base_palette(const palette *src) {
+    memcpy(&base_palette, src, sizeof(palette));
+    video_force_pal_refresh();
+}
+
+palette *video_get_base_palette() {
+    return &base_palette;
+}
+
+void video_copy_pal_range(const palette *src, int src_start, int dst_start, int amount) {
+    memcpy(cur_palette.data[dst_start], src->data[src_start], amount * 3);
+    cur_palette.version++;
+}
+
+screen_palette* video_get_pal_ref() {
+    return &cur_palette;
+}
+
+void tcache_init(SDL_Renderer *renderer, int scale_factor, scaler_plugin *scaler) {}
+void tcache_reinit(SDL_Renderer *renderer, int scale_factor, scaler_plugin *scaler) {}
+void tcache_close() {}
+void tcache_clear() {}
+void tcache_set_budget(size_t bytes) {}
+void tcache_get_stats(tcache_stats *stats) { memset(stats, 0, sizeof(tcache_stats)); }
+void tcache_set_scene(int scene_id) {}
+void tcache_frame_end() {}
+int tcache_get_history(tcache_frame_stats *frames, int max) { return 0; }
+int tcache_get_scene_stats(int scene_id, tcache_scene_stats *stats) { return 1; }
+void tcache_set_upload_cb(tcache_upload_cb cb, void *userdata) {}
+
+SDL_Texture* tcache_get(surface *sur, screen_palette *pal, char *remap_table, uint8_t pal_offset, SDL_Rect *rect) {
+    return NULL;
+}
+
+#endif // STANDALONE_SERVER
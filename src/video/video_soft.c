@@ -1,5 +1,8 @@
 #include <stdlib.h>
+#include <string.h>
 #include "video/video_soft.h"
+#include "video/palette_lut.h"
+#include "utils/thread_pool.h"
 #include "utils/log.h"
 
 /*
@@ -12,16 +15,38 @@
 * handled as one layer while sprite surfaces are blitted on another layer. These are then
 * blitted together and dumped on the screen. This creates all kinds of interesting trouble ...
 *
-* TODO: Rewrite and rethink
+* Both layers persist between frames. At the end of a frame the paletted layer is
+* converted, scaled and has the RGBA layer laid over it, in bands of rows on worker
+* threads, and the result goes to the screen through one streaming texture.
 */
 
+#define SOFT_W 320
+#define SOFT_H 200
+#define SOFT_MIN_BAND_ROWS 8
+
 typedef struct soft_renderer_t {
     char *tmp_normal;
     char *tmp_scaling;
+    char *tmp_sprite;
+    size_t tmp_sprite_size;
     surface lower;
     SDL_Surface *higher;
+    int higher_used; // Anything drawn on the RGBA layer this frame
+    SDL_Texture *frame;
+    int scale_factor;
+    thread_pool pool;
 } soft_renderer;
 
+// Everything the worker threads need to build one frame
+typedef struct soft_frame_t {
+    soft_renderer *sr;
+    palette_lut lut;
+    char *pixels;
+    int pitch;
+    int factor;
+    int scaled_in_place;
+} soft_frame;
+
 SDL_Surface* surface_from_pixels(char *pixels, int w, int h) {
     return SDL_CreateRGBSurfaceFrom(pixels,
                                     w, h,
@@ -33,14 +58,19 @@ SDL_Surface* surface_from_pixels(char *pixels, int w, int h) {
                                     0xFF000000);
 }
 
-
 void soft_render_close(video_state *state) {
     soft_renderer *sr = state->userdata;
+    thread_pool_free(&sr->pool);
+    if(sr->frame != NULL) {
+        SDL_DestroyTexture(sr->frame);
+    }
     SDL_FreeSurface(sr->higher);
     surface_free(&sr->lower);
     free(sr->tmp_normal);
     free(sr->tmp_scaling);
+    free(sr->tmp_sprite);
     free(sr);
+    state->userdata = NULL;
 }
 
 void soft_render_reinit(video_state *state) {
@@ -49,37 +79,119 @@ void soft_render_reinit(video_state *state) {
 
 void soft_render_prepare(video_state *state) {
     soft_renderer *sr = state->userdata;
-    SDL_FillRect(sr->higher, NULL, SDL_MapRGBA(sr->higher->format, 0, 0, 0, 0));
+    if(sr->higher_used) {
+        SDL_FillRect(sr->higher, NULL, SDL_MapRGBA(sr->higher->format, 0, 0, 0, 0));
+        sr->higher_used = 0;
+    }
+}
+
+// Lays the RGBA layer over one row of the frame, with SDL_BLENDMODE_BLEND rules.
+// The layer is stretched to the scaled frame like the texture it used to be.
+static void soft_overlay_row(const uint8_t *src, uint8_t *dst, int w, int factor) {
+    for(int x = 0; x < w; x++) {
+        const uint8_t *s = src + (x / factor) * 4;
+        uint8_t *d = dst + x * 4;
+        unsigned int a = s[3];
+        if(a == 0) {
+            continue;
+        }
+        if(a == 255 || d[3] == 0) {
+            memcpy(d, s, 4);
+            continue;
+        }
+        // The paletted layer is always either opaque or fully transparent
+        for(int c = 0; c < 3; c++) {
+            d[c] = (s[c] * a + d[c] * (255 - a) + 127) / 255;
+        }
+    }
+}
+
+static void soft_convert_band(void *userdata, int index, int count) {
+    soft_frame *f = userdata;
+    soft_renderer *sr = f->sr;
+    int y0 = SOFT_H * index / count;
+    int y1 = SOFT_H * (index + 1) / count;
+
+    // Without scaling the paletted layer is converted right into the texture
+    char *dst = (f->factor == 1) ? f->pixels : sr->tmp_normal;
+    int pitch = (f->factor == 1) ? f->pitch : SOFT_W * 4;
+    for(int y = y0; y < y1; y++) {
+        palette_lut_convert(&f->lut,
+                            dst + y * pitch,
+                            sr->lower.data + y * SOFT_W,
+                            sr->lower.stencil + y * SOFT_W,
+                            SOFT_W);
+    }
+}
+
+static void soft_overlay_band(void *userdata, int index, int count) {
+    soft_frame *f = userdata;
+    soft_renderer *sr = f->sr;
+    int w = SOFT_W * f->factor;
+    int h = SOFT_H * f->factor;
+    int row = w * 4;
+    int y0 = h * index / count;
+    int y1 = h * (index + 1) / count;
+    for(int y = y0; y < y1; y++) {
+        uint8_t *dst = (uint8_t*)f->pixels + y * f->pitch;
+        if(f->factor > 1 && !f->scaled_in_place) {
+            memcpy(dst, sr->tmp_scaling + y * row, row);
+        }
+        if(sr->higher_used) {
+            const uint8_t *src = (const uint8_t*)sr->higher->pixels + (y / f->factor) * sr->higher->pitch;
+            soft_overlay_row(src, dst, w, f->factor);
+        }
+    }
+}
+
+static int soft_bands(soft_renderer *sr, int rows) {
+    int bands = thread_pool_size(&sr->pool);
+    if(bands > rows / SOFT_MIN_BAND_ROWS) {
+        bands = rows / SOFT_MIN_BAND_ROWS;
+    }
+    return (bands > 0) ? bands : 1;
 }
 
 void soft_render_finish(video_state *state) {
     soft_renderer *sr = state->userdata;
-    SDL_Texture *tex;
-    SDL_Surface *low_s;
-
-    // Blit lower
-    surface_to_rgba(&sr->lower, sr->tmp_normal, state->cur_palette, NULL, 0);
-
-    // Scale if necessary
-    if(state->scale_factor > 1) {
-        int nw = 320 * state->scale_factor;
-        int nh = 200 * state->scale_factor;
-        scaler_scale(&state->scaler, sr->tmp_normal, sr->tmp_scaling, 320, 200, state->scale_factor);
-        low_s = surface_from_pixels(sr->tmp_scaling, nw, nh);
-    } else {
-        low_s = surface_from_pixels(sr->tmp_normal, 320, 200);
+    soft_frame f;
+    void *pixels;
+
+    if(sr->frame == NULL) {
+        return;
+    }
+    if(SDL_LockTexture(sr->frame, NULL, &pixels, &f.pitch) != 0) {
+        PERROR("Failed to lock software renderer frame: %s", SDL_GetError());
+        return;
     }
+    f.sr = sr;
+    f.pixels = pixels;
+    f.factor = sr->scale_factor;
+    f.scaled_in_place = 0;
+    palette_lut_build(&f.lut, state->cur_palette, NULL, 0);
 
-    // Make a texture
-    tex = SDL_CreateTextureFromSurface(state->renderer, low_s);
-    SDL_RenderCopy(state->renderer, tex, NULL, NULL);
-    SDL_DestroyTexture(tex);
-    SDL_FreeSurface(low_s);
+    // Palette is applied once for the whole frame
+    thread_pool_run(&sr->pool, soft_convert_band, &f, soft_bands(sr, SOFT_H));
 
-    // Blit upper
-    tex = SDL_CreateTextureFromSurface(state->renderer, sr->higher);
-    SDL_RenderCopy(state->renderer, tex, NULL, NULL);
-    SDL_DestroyTexture(tex);
+    // Scalers work on whole frames; they can write to the texture if its rows aren't padded
+    if(f.factor > 1) {
+        if(f.pitch == SOFT_W * f.factor * 4) {
+            scaler_scale(&state->scaler, sr->tmp_normal, pixels, SOFT_W, SOFT_H, f.factor);
+            f.scaled_in_place = 1;
+        } else {
+            scaler_scale(&state->scaler, sr->tmp_normal, sr->tmp_scaling, SOFT_W, SOFT_H, f.factor);
+        }
+    }
+
+    // Copy out of the scaling buffer and lay the RGBA layer on top, where needed
+    if(sr->higher_used || (f.factor > 1 && !f.scaled_in_place)) {
+        SDL_LockSurface(sr->higher);
+        thread_pool_run(&sr->pool, soft_overlay_band, &f, soft_bands(sr, SOFT_H * f.factor));
+        SDL_UnlockSurface(sr->higher);
+    }
+
+    SDL_UnlockTexture(sr->frame);
+    SDL_RenderCopy(state->renderer, sr->frame, NULL, NULL);
 }
 
 void soft_render_background(
@@ -112,33 +224,63 @@ void soft_render_sprite_fsot(
             surface_alpha_blit(&sr->lower, sur, dst->x, dst->y, flip_mode);
         }
     } else {
-        surface_to_rgba(sur, sr->tmp_normal, state->cur_palette, NULL, 0);
-        SDL_Surface *s = surface_from_pixels(sr->tmp_normal, sur->w, sur->h);
+        size_t need = (size_t)sur->w * sur->h * 4;
+        if(need > sr->tmp_sprite_size) {
+            free(sr->tmp_sprite);
+            sr->tmp_sprite = malloc(need);
+            sr->tmp_sprite_size = need;
+        }
+        surface_to_rgba(sur, sr->tmp_sprite, state->cur_palette, NULL, 0);
+        SDL_Surface *s = surface_from_pixels(sr->tmp_sprite, sur->w, sur->h);
         SDL_SetSurfaceAlphaMod(s, opacity);
         SDL_SetSurfaceColorMod(s, color_mod.r, color_mod.g, color_mod.b);
         SDL_SetSurfaceBlendMode(s, SDL_BLENDMODE_BLEND);
         SDL_BlitSurface(s, NULL, sr->higher, dst);
+        SDL_FreeSurface(s);
+        sr->higher_used = 1;
     }
 }
 
 void video_soft_init(video_state *state) {
     soft_renderer *sr = malloc(sizeof(soft_renderer));
     sr->higher = SDL_CreateRGBSurface(0,
-                                    320,
-                                    200,
+                                    SOFT_W,
+                                    SOFT_H,
                                     32,
                                     0x000000FF,
                                     0x0000FF00,
                                     0x00FF0000,
                                     0xFF000000);
     SDL_SetSurfaceRLE(sr->higher, 1);
-    surface_create(&sr->lower, SURFACE_TYPE_PALETTE, 320, 200);
+    SDL_FillRect(sr->higher, NULL, SDL_MapRGBA(sr->higher->format, 0, 0, 0, 0));
+    sr->higher_used = 0;
+    surface_create(&sr->lower, SURFACE_TYPE_PALETTE, SOFT_W, SOFT_H);
+    surface_clear(&sr->lower);
 
     // Preallocate memory for more efficient drawing
-    sr->tmp_normal = malloc(320 * 200 * 4);
+    sr->scale_factor = state->scale_factor;
+    sr->tmp_normal = malloc(SOFT_W * SOFT_H * 4);
     sr->tmp_scaling = NULL;
-    if(state->scale_factor > 1) {
-        sr->tmp_scaling = malloc(320 * 200 * 4 * state->scale_factor * state->scale_factor);
+    if(sr->scale_factor > 1) {
+        sr->tmp_scaling = malloc(SOFT_W * SOFT_H * 4 * sr->scale_factor * sr->scale_factor);
+    }
+    sr->tmp_sprite = NULL;
+    sr->tmp_sprite_size = 0;
+
+    // The whole frame goes to the screen through this one texture
+    sr->frame = SDL_CreateTexture(state->renderer,
+                                  SDL_PIXELFORMAT_ABGR8888,
+                                  SDL_TEXTUREACCESS_STREAMING,
+                                  SOFT_W * sr->scale_factor,
+                                  SOFT_H * sr->scale_factor);
+    if(sr->frame == NULL) {
+        PERROR("Could not create software renderer frame: %s", SDL_GetError());
+    } else {
+        SDL_SetTextureBlendMode(sr->frame, SDL_BLENDMODE_BLEND);
+    }
+    if(thread_pool_create(&sr->pool, -1)) {
+        PERROR("Could not start software renderer threads");
+        thread_pool_create(&sr->pool, 0);
     }
 
     // Set as userdata
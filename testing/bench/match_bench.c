@@ -0,0 +1,211 @@
+/** @file match_bench.c
+  * @brief Many concurrent matches in one process, for the dedicated server
+  * @license MIT
+  */
+
+#include <argtable2.h>
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "engine.h"
+#include "game/replay.h"
+
+// Exit code that tells ctest the test was skipped, eg. when the game data is missing
+#define BENCH_SKIPPED 77
+#define BENCH_MAX_TICKS 1000000
+
+typedef struct bench_rec_t {
+    char path[512];
+    replay_result expected; // from a replay that had the process to itself
+} bench_rec;
+
+typedef struct bench_worker_t {
+    const bench_rec *recs;
+    int rec_count;
+    int first; // index of the first match of this thread, over all threads
+    int matches;
+    unsigned int frames;
+    int errors;
+    int mismatches;
+    double secs;
+} bench_worker;
+
+static int collect_recs(const char *dir, bench_rec **recs) {
+    vector names;
+    if(replay_scan_dir(&names, dir)) {
+        vector_free(&names);
+        return -1;
+    }
+    int count = vector_size(&names);
+    *recs = calloc(count + 1, sizeof(bench_rec));
+    for(int i = 0; i < count; i++) {
+        snprintf((*recs)[i].path, sizeof((*recs)[0].path), "%s/%s", dir, (char*)vector_get(&names, i));
+    }
+    vector_free(&names);
+    return count;
+}
+
+// Steps every match of the thread by one frame in turn, the way a server hosting
+// several matches on one core would
+static int bench_worker_run(void *userdata) {
+    bench_worker *w = userdata;
+    replay *matches = calloc(w->matches, sizeof(replay));
+    const bench_rec **recs = calloc(w->matches, sizeof(bench_rec*));
+    int running = 0;
+
+    uint64_t start = SDL_GetPerformanceCounter();
+    for(int i = 0; i < w->matches; i++) {
+        recs[i] = &w->recs[(w->first + i) % w->rec_count];
+        if(replay_create(&matches[i], recs[i]->path)) {
+            w->errors++;
+            recs[i] = NULL;
+            continue;
+        }
+        running++;
+    }
+    while(running > 0) {
+        for(int i = 0; i < w->matches; i++) {
+            if(recs[i] == NULL) {
+                continue;
+            }
+            w->frames++;
+            if(replay_frame(&matches[i]) && matches[i].gs->tick - matches[i].start_tick <= BENCH_MAX_TICKS) {
+                continue;
+            }
+            replay_result res;
+            replay_get_result(&matches[i], &res);
+            if(res.ticks != recs[i]->expected.ticks
+                || res.score[0] != recs[i]->expected.score[0]
+                || res.score[1] != recs[i]->expected.score[1]
+                || res.hash != recs[i]->expected.hash) {
+                w->mismatches++;
+            }
+            replay_free(&matches[i]);
+            recs[i] = NULL;
+            running--;
+        }
+    }
+    w->secs = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+    free(recs);
+    free(matches);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    // Argument fetching and parsing stuff
+    struct arg_lit *help = arg_lit0("h", "help", "print this help and exit");
+    struct arg_file *dir = arg_file0("d", "dir", "<dir>", "Directory of .REC files (default: the bundled test recordings)");
+    struct arg_int *threads = arg_int0("j", "threads", "<number>", "Threads to run matches on (default: one per CPU)");
+    struct arg_int *matches = arg_int0("m", "matches", "<number>", "Concurrent matches per thread (default: 8)");
+    struct arg_end *end = arg_end(20);
+    void* argtable[] = {help,dir,threads,matches,end};
+    const char* progname = "openomf_match_bench";
+    int ret = 1;
+
+    // Make sure everything got allocated
+    if(arg_nullcheck(argtable) != 0) {
+        printf("%s: insufficient memory\n", progname);
+        goto exit_0;
+    }
+
+    // Parse arguments
+    int nerrors = arg_parse(argc, argv, argtable);
+
+    // Handle help
+    if(help->count > 0) {
+        printf("Usage: %s", progname);
+        arg_print_syntax(stdout, argtable, "\n");
+        printf("\nArguments:\n");
+        arg_print_glossary(stdout, argtable, "%-30s %s\n");
+        ret = 0;
+        goto exit_0;
+    }
+
+    // Handle errors
+    if(nerrors > 0) {
+        arg_print_errors(stdout, end, progname);
+        printf("Try '%s --help' for more information.\n", progname);
+        goto exit_0;
+    }
+
+    const char *rec_dir = (dir->count > 0) ? dir->filename[0] : TESTS_ROOT_DIR "/recs";
+    int nthreads = (threads->count > 0 && threads->ival[0] > 0) ? threads->ival[0] : SDL_GetCPUCount();
+    int nmatches = (matches->count > 0 && matches->ival[0] > 0) ? matches->ival[0] : 8;
+
+    bench_rec *recs = NULL;
+    int count = collect_recs(rec_dir, &recs);
+    if(count <= 0) {
+        fprintf(stderr, "No .REC files found in %s.\n", rec_dir);
+        goto exit_1;
+    }
+
+    // Replays need the game data; without it there is nothing to measure
+    if(engine_init_tool(0)) {
+        ret = BENCH_SKIPPED;
+        goto exit_1;
+    }
+
+    // Every match must come out the same as it does with the process to itself
+    for(int i = 0; i < count; i++) {
+        if(replay_run(recs[i].path, BENCH_MAX_TICKS, &recs[i].expected)) {
+            fprintf(stderr, "Unable to replay %s.\n", recs[i].path);
+            goto exit_2;
+        }
+    }
+
+    bench_worker *workers = calloc(nthreads, sizeof(bench_worker));
+    SDL_Thread **handles = calloc(nthreads, sizeof(SDL_Thread*));
+    uint64_t start = SDL_GetPerformanceCounter();
+    for(int i = 0; i < nthreads; i++) {
+        workers[i].recs = recs;
+        workers[i].rec_count = count;
+        workers[i].first = i * nmatches;
+        workers[i].matches = nmatches;
+        if(i > 0) {
+            handles[i] = SDL_CreateThread(bench_worker_run, "match_bench", &workers[i]);
+        }
+    }
+
+    // The calling thread hosts matches too. Threads that failed to start are run here afterwards.
+    bench_worker_run(&workers[0]);
+    for(int i = 1; i < nthreads; i++) {
+        if(handles[i] != NULL) {
+            SDL_WaitThread(handles[i], NULL);
+        } else {
+            bench_worker_run(&workers[i]);
+        }
+    }
+    double wall = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+    unsigned int frames = 0;
+    int errors = 0;
+    int mismatches = 0;
+    double busy = 0;
+    for(int i = 0; i < nthreads; i++) {
+        frames += workers[i].frames;
+        errors += workers[i].errors;
+        mismatches += workers[i].mismatches;
+        busy += workers[i].secs;
+    }
+
+    // A match runs in real time at one frame per REPLAY_FRAME_MS
+    double frames_per_core = (busy > 0) ? frames / busy : 0;
+    double per_core = frames_per_core * REPLAY_FRAME_MS / 1000.0;
+    printf("%d matches on %d threads (%d each), %u frames in %.2fs\n",
+           nthreads * nmatches, nthreads, nmatches, frames, wall);
+    printf("%.0f frames/s per core, %.1f real-time matches per core, %d errors, %d results differ\n",
+           frames_per_core, per_core, errors, mismatches);
+    ret = (errors + mismatches) > 0;
+
+    free(handles);
+    free(workers);
+exit_2:
+    engine_close_tool();
+exit_1:
+    free(recs);
+exit_0:
+    arg_freetable(argtable, sizeof(argtable)/sizeof(argtable[0]));
+    return ret;
+}
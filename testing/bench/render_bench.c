@@ -0,0 +1,172 @@
+/** @file render_bench.c
+  * @brief Frame composition cost of the offscreen renderer
+  * @license MIT
+  */
+
+#include <argtable2.h>
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "engine.h"
+#include "game/replay.h"
+#include "game/game_state.h"
+#include "game/common_defines.h"
+#include "video/video.h"
+
+// Exit code that tells ctest the test was skipped, eg. when the game data is missing
+#define BENCH_SKIPPED 77
+#define BENCH_MAX_SCENES 16
+
+typedef struct bench_result_t {
+    unsigned int frames;
+    double total_ms;
+    double worst_ms;
+    double sprites;
+} bench_result;
+
+// Only rendering is timed; the simulation in between is left out
+static void bench_frames(replay *rp, unsigned int max_frames, bench_result *res) {
+    unsigned int sprites, draw_calls, state_changes;
+    memset(res, 0, sizeof(bench_result));
+    while(res->frames < max_frames && replay_frame(rp)) {
+        video_tick();
+        uint64_t start = SDL_GetPerformanceCounter();
+        video_render_prepare();
+        game_state_render(rp->gs);
+        video_render_finish();
+        double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+        video_get_render_stats(&sprites, &draw_calls, &state_changes);
+        res->total_ms += ms;
+        res->sprites += sprites;
+        if(ms > res->worst_ms) {
+            res->worst_ms = ms;
+        }
+        res->frames++;
+    }
+}
+
+static void print_result(const char *name, const bench_result *res) {
+    if(res->frames == 0) {
+        printf("%-32s no frames\n", name);
+        return;
+    }
+    printf("%-32s %6u frames %8.3f ms/frame  worst %8.3f ms  %6.1f sprites/frame\n",
+           name, res->frames, res->total_ms / res->frames, res->worst_ms, res->sprites / res->frames);
+}
+
+static int bench_recordings(const char *dir, unsigned int max_frames) {
+    vector names;
+    iterator it;
+    char *name;
+    char path[512];
+    bench_result res;
+    replay rp;
+    int errors = 0;
+
+    if(replay_scan_dir(&names, dir)) {
+        fprintf(stderr, "Unable to read directory %s.\n", dir);
+        vector_free(&names);
+        return 1;
+    }
+    vector_iter_begin(&names, &it);
+    while((name = iter_next(&it)) != NULL) {
+        snprintf(path, sizeof(path), "%s/%s", dir, name);
+        if(replay_create(&rp, path)) {
+            printf("%-32s error\n", name);
+            errors++;
+            continue;
+        }
+        bench_frames(&rp, max_frames, &res);
+        replay_free(&rp);
+        print_result(name, &res);
+    }
+    vector_free(&names);
+    return errors;
+}
+
+static int bench_scene(int scene_id, unsigned int max_frames) {
+    char name[32];
+    bench_result res;
+    replay rp;
+
+    snprintf(name, sizeof(name), "scene %d", scene_id);
+    if(replay_create_scene(&rp, scene_id)) {
+        printf("%-32s error\n", name);
+        return 1;
+    }
+    bench_frames(&rp, max_frames, &res);
+    replay_free(&rp);
+    print_result(name, &res);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    // Argument fetching and parsing stuff
+    struct arg_lit *help = arg_lit0("h", "help", "print this help and exit");
+    struct arg_file *dir = arg_file0("d", "dir", "<dir>", "Directory of .REC files (default: the bundled test recordings)");
+    struct arg_int *scenes = arg_intn("s", "scene", "<id>", 0, BENCH_MAX_SCENES, "Scene to render as well (default: the main menu)");
+    struct arg_int *frames = arg_int0("f", "frames", "<number>", "Frames per recording or scene at most (default: 1000)");
+    struct arg_end *end = arg_end(20);
+    void* argtable[] = {help,dir,scenes,frames,end};
+    const char* progname = "openomf_render_bench";
+    int ret = 1;
+
+    // Make sure everything got allocated
+    if(arg_nullcheck(argtable) != 0) {
+        printf("%s: insufficient memory\n", progname);
+        goto exit_0;
+    }
+
+    // Parse arguments
+    int nerrors = arg_parse(argc, argv, argtable);
+
+    // Handle help
+    if(help->count > 0) {
+        printf("Usage: %s", progname);
+        arg_print_syntax(stdout, argtable, "\n");
+        printf("\nArguments:\n");
+        arg_print_glossary(stdout, argtable, "%-30s %s\n");
+        ret = 0;
+        goto exit_0;
+    }
+
+    // Handle errors
+    if(nerrors > 0) {
+        arg_print_errors(stdout, end, progname);
+        printf("Try '%s --help' for more information.\n", progname);
+        goto exit_0;
+    }
+
+    const char *rec_dir = (dir->count > 0) ? dir->filename[0] : TESTS_ROOT_DIR "/recs";
+    unsigned int max_frames = (frames->count > 0 && frames->ival[0] > 0) ? frames->ival[0] : 1000;
+
+    // Frames are composed on the CPU, so there is no need for a display
+    if(SDL_Init(SDL_INIT_TIMER)) {
+        fprintf(stderr, "SDL2 Initialization failed: %s\n", SDL_GetError());
+        goto exit_0;
+    }
+
+    // Scenes need the game data; without it there is nothing to measure
+    if(engine_init_tool(1)) {
+        ret = BENCH_SKIPPED;
+        goto exit_1;
+    }
+
+    int errors = bench_recordings(rec_dir, max_frames);
+    if(scenes->count > 0) {
+        for(int i = 0; i < scenes->count; i++) {
+            errors += bench_scene(scenes->ival[i], max_frames);
+        }
+    } else {
+        errors += bench_scene(SCENE_MENU, max_frames);
+    }
+    engine_close_tool();
+    ret = (errors > 0);
+
+exit_1:
+    SDL_Quit();
+exit_0:
+    arg_freetable(argtable, sizeof(argtable)/sizeof(argtable[0]));
+    return ret;
+}
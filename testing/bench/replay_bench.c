@@ -0,0 +1,241 @@
+/** @file replay_bench.c
+  * @brief Replay throughput regression test
+  * @license MIT
+  */
+
+#include <argtable2.h>
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "engine.h"
+#include "game/replay.h"
+
+// Exit code that tells ctest the test was skipped, eg. when the game data is missing
+#define BENCH_SKIPPED 77
+#define BENCH_MAX_TICKS 1000000
+
+typedef struct bench_entry_t {
+    char name[256];
+    unsigned int ticks;
+    double tps; // best of all rounds
+    double baseline; // 0 when there is none
+} bench_entry;
+
+static int collect_recs(const char *dir, bench_entry **entries) {
+    vector names;
+    if(replay_scan_dir(&names, dir)) {
+        vector_free(&names);
+        return -1;
+    }
+    int count = vector_size(&names);
+    *entries = calloc(count + 1, sizeof(bench_entry));
+    for(int i = 0; i < count; i++) {
+        snprintf((*entries)[i].name, sizeof((*entries)[0].name), "%s", (char*)vector_get(&names, i));
+    }
+    vector_free(&names);
+    return count;
+}
+
+// Baseline files have one "<rec name> <ticks per second>" pair per line
+static void read_baseline(const char *file, bench_entry *entries, int count) {
+    char name[256];
+    double tps;
+    FILE *f = fopen(file, "r");
+    if(f == NULL) {
+        return;
+    }
+    while(fscanf(f, "%255s %lf", name, &tps) == 2) {
+        for(int i = 0; i < count; i++) {
+            if(strcmp(entries[i].name, name) == 0) {
+                entries[i].baseline = tps;
+            }
+        }
+    }
+    fclose(f);
+}
+
+static int write_baseline(const char *file, const bench_entry *entries, int count) {
+    FILE *f = fopen(file, "w");
+    if(f == NULL) {
+        return 1;
+    }
+    for(int i = 0; i < count; i++) {
+        fprintf(f, "%s %.0f\n", entries[i].name, entries[i].tps);
+    }
+    fclose(f);
+    return 0;
+}
+
+// One CSV row per recording and run. The file is only ever appended to, so it
+// doubles as the history to chart.
+static int write_history(const char *file, const bench_entry *entries, int count) {
+    FILE *f = fopen(file, "a");
+    if(f == NULL) {
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    if(ftell(f) == 0) {
+        fprintf(f, "timestamp,recording,ticks,ticks_per_sec,baseline,change_pct\n");
+    }
+    long now = (long)time(NULL);
+    for(int i = 0; i < count; i++) {
+        const bench_entry *e = &entries[i];
+        double change = (e->baseline > 0) ? (e->tps / e->baseline - 1.0) * 100.0 : 0.0;
+        fprintf(f, "%ld,%s,%u,%.0f,%.0f,%.2f\n", now, e->name, e->ticks, e->tps, e->baseline, change);
+    }
+    fclose(f);
+    return 0;
+}
+
+// Returns 1 if a replay fails, 2 if the rounds did not all play out the same
+static int bench_one(const char *dir, bench_entry *e, int rounds) {
+    char path[512];
+    replay_result res, first;
+    snprintf(path, sizeof(path), "%s/%s", dir, e->name);
+
+    // Keep the best round; slower ones are mostly scheduler noise
+    for(int r = 0; r < rounds; r++) {
+        uint64_t start = SDL_GetPerformanceCounter();
+        if(replay_run(path, BENCH_MAX_TICKS, &res)) {
+            return 1;
+        }
+        double secs = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+        double tps = (secs > 0) ? res.ticks / secs : 0;
+
+        // Replays are seeded the same every time, so rounds only compare if they
+        // simulated exactly the same match
+        if(r == 0) {
+            first = res;
+        } else if(res.ticks != first.ticks
+                  || res.score[0] != first.score[0]
+                  || res.score[1] != first.score[1]
+                  || res.hash != first.hash) {
+            return 2;
+        }
+        e->ticks = res.ticks;
+        if(tps > e->tps) {
+            e->tps = tps;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    // Argument fetching and parsing stuff
+    struct arg_lit *help = arg_lit0("h", "help", "print this help and exit");
+    struct arg_file *dir = arg_file0("d", "dir", "<dir>", "Directory of .REC files (default: the bundled test recordings)");
+    struct arg_file *baseline = arg_file0("b", "baseline", "<file>", "Baseline ticks per second to compare against");
+    struct arg_dbl *threshold = arg_dbl0("t", "threshold", "<percent>", "Fail if throughput drops more than this (default: 10)");
+    struct arg_int *rounds = arg_int0("r", "rounds", "<number>", "Replays per recording, the best one counts (default: 3)");
+    struct arg_file *history = arg_file0(NULL, "history", "<file>", "Append results as CSV to this file");
+    struct arg_lit *update = arg_lit0(NULL, "write-baseline", "Store the results as the new baseline");
+    struct arg_end *end = arg_end(20);
+    void* argtable[] = {help,dir,baseline,threshold,rounds,history,update,end};
+    const char* progname = "openomf_replay_bench";
+    int ret = 1;
+
+    // Make sure everything got allocated
+    if(arg_nullcheck(argtable) != 0) {
+        printf("%s: insufficient memory\n", progname);
+        goto exit_0;
+    }
+
+    // Parse arguments
+    int nerrors = arg_parse(argc, argv, argtable);
+
+    // Handle help
+    if(help->count > 0) {
+        printf("Usage: %s", progname);
+        arg_print_syntax(stdout, argtable, "\n");
+        printf("\nArguments:\n");
+        arg_print_glossary(stdout, argtable, "%-30s %s\n");
+        ret = 0;
+        goto exit_0;
+    }
+
+    // Handle errors
+    if(nerrors > 0) {
+        arg_print_errors(stdout, end, progname);
+        printf("Try '%s --help' for more information.\n", progname);
+        goto exit_0;
+    }
+
+    const char *rec_dir = (dir->count > 0) ? dir->filename[0] : TESTS_ROOT_DIR "/recs";
+    double max_drop = (threshold->count > 0) ? threshold->dval[0] : 10.0;
+    int nrounds = (rounds->count > 0 && rounds->ival[0] > 0) ? rounds->ival[0] : 3;
+
+    bench_entry *entries = NULL;
+    int count = collect_recs(rec_dir, &entries);
+    if(count <= 0) {
+        fprintf(stderr, "No .REC files found in %s.\n", rec_dir);
+        goto exit_1;
+    }
+    if(baseline->count > 0) {
+        read_baseline(baseline->filename[0], entries, count);
+    }
+
+    // Replays need the game data; without it there is nothing to measure
+    if(engine_init_tool(0)) {
+        ret = BENCH_SKIPPED;
+        goto exit_1;
+    }
+
+    int regressions = 0;
+    int errors = 0;
+    int compared = 0;
+    for(int i = 0; i < count; i++) {
+        bench_entry *e = &entries[i];
+        int err = bench_one(rec_dir, e, nrounds);
+        if(err) {
+            printf("%-32s %s\n", e->name, (err == 2) ? "differs between rounds" : "error");
+            errors++;
+            continue;
+        }
+        if(e->baseline > 0) {
+            compared++;
+            double change = (e->tps / e->baseline - 1.0) * 100.0;
+            int slow = (change < -max_drop);
+            regressions += slow;
+            printf("%-32s %8u ticks %10.0f ticks/s  baseline %10.0f  %+6.1f%%%s\n",
+                   e->name, e->ticks, e->tps, e->baseline, change, slow ? "  REGRESSION" : "");
+        } else {
+            printf("%-32s %8u ticks %10.0f ticks/s  no baseline\n", e->name, e->ticks, e->tps);
+        }
+    }
+    engine_close_tool();
+
+    if(history->count > 0 && write_history(history->filename[0], entries, count)) {
+        fprintf(stderr, "Unable to write history %s.\n", history->filename[0]);
+    }
+    if(update->count > 0) {
+        if(baseline->count <= 0) {
+            fprintf(stderr, "--write-baseline needs --baseline.\n");
+            goto exit_1;
+        }
+        if(write_baseline(baseline->filename[0], entries, count)) {
+            fprintf(stderr, "Unable to write baseline %s.\n", baseline->filename[0]);
+            goto exit_1;
+        }
+        regressions = 0;
+    }
+
+    printf("%d recordings, %d more than %.1f%% below baseline, %d errors\n",
+           count, regressions, max_drop, errors);
+    ret = (regressions + errors) > 0;
+
+    // Baselines are machine specific, so none ships with the source. Without one the
+    // run measured nothing, and must not count as passed.
+    if(ret == 0 && baseline->count > 0 && update->count == 0 && compared == 0) {
+        fprintf(stderr, "Skipping: no baseline in %s. Run with --write-baseline to store one.\n",
+                baseline->filename[0]);
+        ret = BENCH_SKIPPED;
+    }
+
+exit_1:
+    free(entries);
+exit_0:
+    arg_freetable(argtable, sizeof(argtable)/sizeof(argtable[0]));
+    return ret;
+}
@@ -0,0 +1,129 @@
+/** @file scaler_bench.c
+  * @brief Per-frame cost of the built-in scalers
+  * @license MIT
+  */
+
+#include <argtable2.h>
+#include <SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "plugins/builtin_scalers.h"
+
+#define FRAME_W 320
+#define FRAME_H 200
+
+// Something that looks a bit like pixel art: flat rectangles of a few colors
+static void make_frame(uint32_t *frame) {
+    static const uint32_t colors[] = {0xFF000000, 0xFF2040A0, 0xFF40A020, 0xFFA02040, 0xFFE0E0E0, 0xFF808080};
+    srand(1);
+    for(int i = 0; i < FRAME_W * FRAME_H; i++) {
+        frame[i] = colors[0];
+    }
+    for(int n = 0; n < 400; n++) {
+        int x0 = rand() % FRAME_W;
+        int y0 = rand() % FRAME_H;
+        int x1 = x0 + 1 + rand() % 24;
+        int y1 = y0 + 1 + rand() % 24;
+        uint32_t c = colors[rand() % 6];
+        for(int y = y0; y < y1 && y < FRAME_H; y++) {
+            for(int x = x0; x < x1 && x < FRAME_W; x++) {
+                frame[y * FRAME_W + x] = c;
+            }
+        }
+    }
+}
+
+static double run(scaler_plugin *scaler, const uint32_t *in, uint32_t *out, int factor, int frames) {
+    uint64_t start = SDL_GetPerformanceCounter();
+    for(int i = 0; i < frames; i++) {
+        scaler_scale(scaler, (const char*)in, (char*)out, FRAME_W, FRAME_H, factor);
+    }
+    uint64_t end = SDL_GetPerformanceCounter();
+    return (end - start) * 1000.0 / SDL_GetPerformanceFrequency() / frames;
+}
+
+int main(int argc, char *argv[]) {
+    // Argument fetching and parsing stuff
+    struct arg_lit *help = arg_lit0("h", "help", "print this help and exit");
+    struct arg_int *frames = arg_int0("f", "frames", "<number>", "Frames to scale per measurement (default: 200)");
+    struct arg_int *threads = arg_int0("j", "threads", "<number>", "Helper threads (default: one less than the CPU count)");
+    struct arg_end *end = arg_end(20);
+    void* argtable[] = {help,frames,threads,end};
+    const char* progname = "openomf_scaler_bench";
+    int ret = 1;
+
+    // Make sure everything got allocated
+    if(arg_nullcheck(argtable) != 0) {
+        printf("%s: insufficient memory\n", progname);
+        goto exit_0;
+    }
+
+    // Parse arguments
+    int nerrors = arg_parse(argc, argv, argtable);
+
+    // Handle help
+    if(help->count > 0) {
+        printf("Usage: %s", progname);
+        arg_print_syntax(stdout, argtable, "\n");
+        printf("\nArguments:\n");
+        arg_print_glossary(stdout, argtable, "%-30s %s\n");
+        ret = 0;
+        goto exit_0;
+    }
+
+    // Handle errors
+    if(nerrors > 0) {
+        arg_print_errors(stdout, end, progname);
+        printf("Try '%s --help' for more information.\n", progname);
+        goto exit_0;
+    }
+
+    int nframes = (frames->count > 0 && frames->ival[0] > 0) ? frames->ival[0] : 200;
+    int nthreads = (threads->count > 0) ? threads->ival[0] : SDL_GetCPUCount() - 1;
+
+    uint32_t *in = malloc(FRAME_W * FRAME_H * 4);
+    uint32_t *single = malloc(FRAME_W * FRAME_H * 4 * 16);
+    uint32_t *banded = malloc(FRAME_W * FRAME_H * 4 * 16);
+    make_frame(in);
+
+    // Every scaler runs on the calling thread only, then banded over the workers.
+    // Both have to give the same pixels.
+    int mismatches = 0;
+    printf("%dx%d frame, %d frames per run, %d helper threads\n", FRAME_W, FRAME_H, nframes, nthreads);
+    for(int i = 0; i < builtin_scalers_count(); i++) {
+        const char *name = builtin_scalers_get_base(i)->get_name();
+        scaler_plugin scaler;
+        scaler_init(&scaler);
+        builtin_scalers_get(&scaler, name);
+        for(int factor = 2; factor <= 4; factor++) {
+            if(!scaler_is_factor_available(&scaler, factor)) {
+                continue;
+            }
+            size_t len = (size_t)FRAME_W * FRAME_H * factor * factor * 4;
+            memset(single, 0, len);
+            memset(banded, 0xFF, len);
+
+            builtin_scalers_set_threads(0);
+            double single_ms = run(&scaler, in, single, factor, nframes);
+            builtin_scalers_set_threads(nthreads);
+            double banded_ms = run(&scaler, in, banded, factor, nframes);
+
+            int same = (memcmp(single, banded, len) == 0);
+            mismatches += !same;
+            printf("%-6s %dx: %7.3f ms/frame on 1 thread, %7.3f ms/frame on %d (%.1fx)%s\n",
+                   name, factor, single_ms, banded_ms, nthreads + 1,
+                   single_ms / banded_ms, same ? "" : "  OUTPUT DIFFERS");
+        }
+    }
+    builtin_scalers_close();
+    ret = (mismatches > 0);
+
+    free(in);
+    free(single);
+    free(banded);
+exit_0:
+    arg_freetable(argtable, sizeof(argtable)/sizeof(argtable[0]));
+    return ret;
+}
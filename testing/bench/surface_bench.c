@@ -0,0 +1,163 @@
+/** @file surface_bench.c
+  * @brief Throughput of the paletted surface blitters, against the old per-pixel loops
+  * @license MIT
+  */
+
+#include <argtable2.h>
+#include <SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "video/surface.h"
+#include "misc/ref_blitters.h"
+
+#define FRAME_W 320
+#define FRAME_H 200
+#define SPRITE_COUNT 64
+
+typedef struct blit_t {
+    surface *sprite;
+    int x;
+    int y;
+    int flip;
+} blit;
+
+// A sprite shaped like a HAR or a piece of scrap: an opaque blob with a transparent border
+static void make_sprite(surface *sur, int w, int h) {
+    surface_create(sur, SURFACE_TYPE_PALETTE, w, h);
+    for(int y = 0; y < h; y++) {
+        for(int x = 0; x < w; x++) {
+            int dx = 2 * x - w;
+            int dy = 2 * y - h;
+            int inside = dx * dx * h * h + dy * dy * w * w < w * w * h * h;
+            sur->data[y * w + x] = inside ? rand() % 16 : 0;
+            sur->stencil[y * w + x] = inside;
+        }
+    }
+}
+
+static void make_background(surface *sur) {
+    surface_create(sur, SURFACE_TYPE_PALETTE, FRAME_W, FRAME_H);
+    for(int i = 0; i < FRAME_W * FRAME_H; i++) {
+        sur->data[i] = rand();
+        sur->stencil[i] = 1;
+    }
+}
+
+static void compose(surface *frame, const surface *bg, const blit *blits, palette *remap_pal, int old) {
+    surface_copy_ex(frame, (surface*)bg);
+    if(old) {
+        reference_sub(frame, frame, FRAME_W / 2, 0, 0, 0, FRAME_W / 2, FRAME_H, SUB_METHOD_MIRROR);
+    } else {
+        surface_sub(frame, frame, FRAME_W / 2, 0, 0, 0, FRAME_W / 2, FRAME_H, SUB_METHOD_MIRROR);
+    }
+    for(int i = 0; i < SPRITE_COUNT; i++) {
+        const blit *b = &blits[i];
+        // Every fourth sprite is a flash or a shadow
+        if(i % 4 == 3) {
+            if(old) {
+                reference_additive_blit(frame, b->sprite, b->x, b->y, remap_pal, b->flip);
+            } else {
+                surface_additive_blit(frame, b->sprite, b->x, b->y, remap_pal, b->flip);
+            }
+        } else {
+            if(old) {
+                reference_alpha_blit(frame, b->sprite, b->x, b->y, b->flip);
+            } else {
+                surface_alpha_blit(frame, b->sprite, b->x, b->y, b->flip);
+            }
+        }
+    }
+}
+
+static double run(surface *frame, const surface *bg, const blit *blits, palette *remap_pal, int old, int frames) {
+    uint64_t start = SDL_GetPerformanceCounter();
+    for(int i = 0; i < frames; i++) {
+        compose(frame, bg, blits, remap_pal, old);
+    }
+    uint64_t end = SDL_GetPerformanceCounter();
+    return (end - start) * 1000.0 / SDL_GetPerformanceFrequency() / frames;
+}
+
+int main(int argc, char *argv[]) {
+    // Argument fetching and parsing stuff
+    struct arg_lit *help = arg_lit0("h", "help", "print this help and exit");
+    struct arg_int *frames = arg_int0("f", "frames", "<number>", "Frames to compose per measurement (default: 500)");
+    struct arg_end *end = arg_end(20);
+    void* argtable[] = {help,frames,end};
+    const char* progname = "openomf_surface_bench";
+    int ret = 1;
+
+    // Make sure everything got allocated
+    if(arg_nullcheck(argtable) != 0) {
+        printf("%s: insufficient memory\n", progname);
+        goto exit_0;
+    }
+
+    // Parse arguments
+    int nerrors = arg_parse(argc, argv, argtable);
+
+    // Handle help
+    if(help->count > 0) {
+        printf("Usage: %s", progname);
+        arg_print_syntax(stdout, argtable, "\n");
+        printf("\nArguments:\n");
+        arg_print_glossary(stdout, argtable, "%-30s %s\n");
+        ret = 0;
+        goto exit_0;
+    }
+
+    // Handle errors
+    if(nerrors > 0) {
+        arg_print_errors(stdout, end, progname);
+        printf("Try '%s --help' for more information.\n", progname);
+        goto exit_0;
+    }
+
+    int nframes = (frames->count > 0 && frames->ival[0] > 0) ? frames->ival[0] : 500;
+
+    // Sprites of a few sizes all over the frame, some of them hanging over the edges
+    static const int sizes[][2] = {{8, 8}, {24, 16}, {60, 90}, {120, 100}};
+    surface sprites[4];
+    blit blits[SPRITE_COUNT];
+    palette remap_pal;
+    surface bg, old_frame, new_frame;
+    srand(1);
+    for(int i = 0; i < 19 * 256; i++) {
+        remap_pal.remaps[i / 256][i % 256] = rand();
+    }
+    for(int i = 0; i < 4; i++) {
+        make_sprite(&sprites[i], sizes[i][0], sizes[i][1]);
+    }
+    for(int i = 0; i < SPRITE_COUNT; i++) {
+        blits[i].sprite = &sprites[rand() % 4];
+        blits[i].x = rand() % (FRAME_W + 80) - 60;
+        blits[i].y = rand() % (FRAME_H + 60) - 40;
+        blits[i].flip = rand() % 4;
+    }
+    make_background(&bg);
+    surface_copy(&old_frame, &bg);
+    surface_copy(&new_frame, &bg);
+
+    double old_ms = run(&old_frame, &bg, blits, &remap_pal, 1, nframes);
+    double new_ms = run(&new_frame, &bg, blits, &remap_pal, 0, nframes);
+
+    // The new blitters have to give the very same pixels
+    int same = memcmp(old_frame.data, new_frame.data, FRAME_W * FRAME_H) == 0
+               && memcmp(old_frame.stencil, new_frame.stencil, FRAME_W * FRAME_H) == 0;
+    printf("%dx%d frame, %d sprites, %d frames per run\n", FRAME_W, FRAME_H, SPRITE_COUNT, nframes);
+    printf("per-pixel loops: %7.3f ms/frame\n", old_ms);
+    printf("clipped spans:   %7.3f ms/frame (%.1fx)%s\n", new_ms, old_ms / new_ms, same ? "" : "  OUTPUT DIFFERS");
+    ret = !same;
+
+    for(int i = 0; i < 4; i++) {
+        surface_free(&sprites[i]);
+    }
+    surface_free(&bg);
+    surface_free(&old_frame);
+    surface_free(&new_frame);
+exit_0:
+    arg_freetable(argtable, sizeof(argtable)/sizeof(argtable[0]));
+    return ret;
+}
@@ -0,0 +1,140 @@
+/** @file golden_check.c
+  * @brief Rendered frames against the golden images kept in testing/golden/images
+  * @license MIT
+  */
+
+#include <argtable2.h>
+#include <stdio.h>
+#include <string.h>
+#include "engine.h"
+#include "game/render_check.h"
+#include "game/common_defines.h"
+#include "utils/random.h"
+
+// Exit code that tells ctest the test was skipped, eg. when the game data is missing
+#define CHECK_SKIPPED 77
+#define GOLDEN_DIR TESTS_ROOT_DIR "/golden/images"
+
+typedef struct golden_case_t {
+    const char *rec_file; // NULL for a scene
+    int scene;
+    unsigned int ticks[3];
+} golden_case;
+
+// The VS screen places the scientist and the welder at random, so it also shows
+// whether frames depend on the seed of the process
+static const golden_case cases[] = {
+    {NULL, SCENE_VS, {1, 40, 120}},
+    {TESTS_ROOT_DIR "/recs/crystal-shirro.rec", 0, {1, 100, 300}},
+};
+#define CASE_COUNT (int)(sizeof(cases) / sizeof(cases[0]))
+#define CASE_TICKS 3
+
+static void make_opts(render_check_opts *opts, const golden_case *c, int update) {
+    memset(opts, 0, sizeof(render_check_opts));
+    opts->dir = GOLDEN_DIR;
+    opts->rec_file = c->rec_file;
+    opts->scene = c->scene;
+    opts->tick_count = CASE_TICKS;
+    memcpy(opts->ticks, c->ticks, sizeof(c->ticks));
+    opts->write = update;
+}
+
+// Golden images are named like render_check() names them
+static int have_goldens(const golden_case *c) {
+    char name[256];
+    char path[512];
+    if(c->rec_file != NULL) {
+        const char *base = strrchr(c->rec_file, '/');
+        snprintf(name, sizeof(name), "%s", (base != NULL) ? base + 1 : c->rec_file);
+        char *ext = strrchr(name, '.');
+        if(ext != NULL) {
+            *ext = 0;
+        }
+    } else {
+        snprintf(name, sizeof(name), "scene%d", c->scene);
+    }
+    for(int i = 0; i < CASE_TICKS; i++) {
+        snprintf(path, sizeof(path), "%s/%s-%u.png", GOLDEN_DIR, name, c->ticks[i]);
+        FILE *f = fopen(path, "rb");
+        if(f == NULL) {
+            fprintf(stderr, "Skipping: %s is missing. Run with --update to store the golden images.\n", path);
+            return 0;
+        }
+        fclose(f);
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    // Argument fetching and parsing stuff
+    struct arg_lit *help = arg_lit0("h", "help", "print this help and exit");
+    struct arg_lit *update = arg_lit0(NULL, "update", "Store the rendered frames as the new golden images");
+    struct arg_end *end = arg_end(20);
+    void* argtable[] = {help,update,end};
+    const char* progname = "openomf_golden_check";
+    render_check_opts opts;
+    int ret = 1;
+
+    // Make sure everything got allocated
+    if(arg_nullcheck(argtable) != 0) {
+        printf("%s: insufficient memory\n", progname);
+        goto exit_0;
+    }
+
+    // Parse arguments
+    int nerrors = arg_parse(argc, argv, argtable);
+
+    // Handle help
+    if(help->count > 0) {
+        printf("Usage: %s", progname);
+        arg_print_syntax(stdout, argtable, "\n");
+        printf("\nArguments:\n");
+        arg_print_glossary(stdout, argtable, "%-30s %s\n");
+        ret = 0;
+        goto exit_0;
+    }
+
+    // Handle errors
+    if(nerrors > 0) {
+        arg_print_errors(stdout, end, progname);
+        printf("Try '%s --help' for more information.\n", progname);
+        goto exit_0;
+    }
+
+    // Without the stored images there is nothing to compare against
+    if(update->count == 0) {
+        for(int i = 0; i < CASE_COUNT; i++) {
+            if(!have_goldens(&cases[i])) {
+                ret = CHECK_SKIPPED;
+                goto exit_0;
+            }
+        }
+    }
+    if(engine_init_tool(1)) {
+        ret = CHECK_SKIPPED;
+        goto exit_0;
+    }
+
+    int failed = 0;
+    for(int i = 0; i < CASE_COUNT; i++) {
+        make_opts(&opts, &cases[i], update->count > 0);
+        if(opts.write) {
+            rand_seed(1);
+            failed += render_check(&opts);
+            continue;
+        }
+        // Twice, with the global RNG left somewhere else, the way it would be in a
+        // run started at another time
+        rand_seed(1);
+        failed += render_check(&opts);
+        rand_seed(0xDEADBEEF);
+        failed += render_check(&opts);
+    }
+    ret = failed > 0;
+
+    engine_close_tool();
+exit_0:
+    arg_freetable(argtable, sizeof(argtable)/sizeof(argtable[0]));
+    return ret;
+}
@@ -0,0 +1,62 @@
+#ifndef _REF_BLITTERS_H
+#define _REF_BLITTERS_H
+
+#include <SDL.h>
+#include <stdint.h>
+#include "video/surface.h"
+
+// The blitters as they were written before clipping was moved out of the loops.
+// Surface tests check the new ones against these, and the surface bench times both.
+static void reference_sub(surface *dst, surface *src, int dst_x, int dst_y, int src_x, int src_y, int w, int h, int method) {
+    int bytes = (src->type == SURFACE_TYPE_RGBA) ? 4 : 1;
+    for(int y = 0; y < h; y++) {
+        for(int x = 0; x < w; x++) {
+            int src_offset = (src_x + x + (src_y + y) * src->w) * bytes;
+            int dst_offset = (method == SUB_METHOD_MIRROR)
+                             ? (dst_x + (w - x - 1) + (dst_y + y) * dst->w) * bytes
+                             : (dst_x + x + (dst_y + y) * dst->w) * bytes;
+            for(int m = 0; m < bytes; m++) {
+                dst->data[dst_offset + m] = src->data[src_offset + m];
+            }
+            if(bytes == 1) {
+                dst->stencil[dst_offset] = src->stencil[src_offset];
+            }
+        }
+    }
+}
+
+static void reference_additive_blit(surface *dst, surface *src, int dst_x, int dst_y, palette *remap_pal, int flip) {
+    for(int y = 0; y < src->h; y++) {
+        for(int x = 0; x < src->w; x++) {
+            if(dst_x + x >= dst->w || dst_y + y >= dst->h || dst_x + x < 0 || dst_y + y < 0) continue;
+            int src_offset = ((flip & SDL_FLIP_HORIZONTAL) ? src->w - x : x) +
+                             ((flip & SDL_FLIP_VERTICAL) ? src->h - y : y) * src->w;
+            int dst_offset = dst_x + x + (dst_y + y) * dst->w;
+            // This used to read past the end of the source
+            if(src_offset >= src->w * src->h) continue;
+            if(dst->stencil[dst_offset] == 1) {
+                if(src->data[src_offset] == 0) continue;
+                uint8_t src_index = src->data[src_offset] + 3;
+                uint8_t dst_index = dst->data[dst_offset];
+                dst->data[dst_offset] = remap_pal->remaps[src_index][dst_index];
+            }
+        }
+    }
+}
+
+static void reference_alpha_blit(surface *dst, surface *src, int dst_x, int dst_y, int flip) {
+    for(int y = 0; y < src->h; y++) {
+        for(int x = 0; x < src->w; x++) {
+            if(dst_x + x >= dst->w || dst_y + y >= dst->h || dst_x + x < 0 || dst_y + y < 0) continue;
+            int src_offset = ((flip & SDL_FLIP_HORIZONTAL) ? src->w - 1 - x : x) +
+                             ((flip & SDL_FLIP_VERTICAL) ? src->h - 1 - y : y) * src->w;
+            int dst_offset = dst_x + x + (dst_y + y) * dst->w;
+            if(src->stencil[src_offset] == 1) {
+                dst->data[dst_offset] = src->data[src_offset];
+                dst->stencil[dst_offset] = 1;
+            }
+        }
+    }
+}
+
+#endif // _REF_BLITTERS_H
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <string.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include "game/utils/keyframes.h"
+
+#define INDEX_FILE "test_keyframes.idx"
+#define REC_SIZE 1234
+
+static void make_index(keyframe_index *idx, int frames) {
+    keyframe_index_create(idx, REC_SIZE);
+    for(int i = 0; i < frames; i++) {
+        serial ser;
+        serial_create(&ser);
+        for(int k = 0; k < 64; k++) {
+            serial_write_int32(&ser, i * 1000 + k);
+        }
+        keyframe_index_add(idx, i * KEYFRAME_INTERVAL, &ser);
+        serial_free(&ser);
+    }
+}
+
+static long file_size(const char *filename) {
+    FILE *f = fopen(filename, "rb");
+    if(f == NULL) {
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+static void truncate_file(const char *filename, long size) {
+    char buf[4096];
+    FILE *f = fopen(filename, "rb");
+    size_t got = fread(buf, 1, size, f);
+    fclose(f);
+    f = fopen(filename, "wb");
+    fwrite(buf, 1, got, f);
+    fclose(f);
+}
+
+void test_keyframes_roundtrip(void) {
+    keyframe_index idx, loaded;
+    make_index(&idx, 3);
+    CU_ASSERT(keyframe_index_save(&idx, INDEX_FILE) == 0);
+    CU_ASSERT(idx.dirty == 0);
+
+    keyframe_index_create(&loaded, REC_SIZE);
+    CU_ASSERT(keyframe_index_load(&loaded, INDEX_FILE) == 0);
+    CU_ASSERT(vector_size(&loaded.frames) == 3);
+    const keyframe *kf = keyframe_index_find(&loaded, KEYFRAME_INTERVAL + 5);
+    CU_ASSERT_FATAL(kf != NULL);
+    CU_ASSERT(kf->tick == KEYFRAME_INTERVAL);
+    CU_ASSERT(memcmp(kf->state.data, ((keyframe*)vector_get(&idx.frames, 1))->state.data, 64 * 4) == 0);
+    keyframe_index_free(&loaded);
+
+    // An index of another recording is not used
+    keyframe_index_create(&loaded, REC_SIZE + 1);
+    CU_ASSERT(keyframe_index_load(&loaded, INDEX_FILE) == 1);
+    CU_ASSERT(vector_size(&loaded.frames) == 0);
+    keyframe_index_free(&loaded);
+
+    keyframe_index_free(&idx);
+    remove(INDEX_FILE);
+}
+
+void test_keyframes_truncated(void) {
+    keyframe_index idx, loaded;
+    make_index(&idx, 3);
+    CU_ASSERT(keyframe_index_save(&idx, INDEX_FILE) == 0);
+    keyframe_index_free(&idx);
+
+    // Cut the file in the middle of the last frame; the whole index must be dropped
+    long size = file_size(INDEX_FILE);
+    CU_ASSERT_FATAL(size > 0);
+    truncate_file(INDEX_FILE, size - 32);
+    keyframe_index_create(&loaded, REC_SIZE);
+    CU_ASSERT(keyframe_index_load(&loaded, INDEX_FILE) == 1);
+    CU_ASSERT(vector_size(&loaded.frames) == 0);
+    CU_ASSERT(keyframe_index_find(&loaded, 1000) == NULL);
+    CU_ASSERT(keyframe_index_wants(&loaded, 0) == 1);
+    keyframe_index_free(&loaded);
+    remove(INDEX_FILE);
+}
+
+void keyframes_test_suite(CU_pSuite suite) {
+    if(CU_add_test(suite, "Test for keyframe index round trip", test_keyframes_roundtrip) == NULL) { return; }
+    if(CU_add_test(suite, "Test for truncated keyframe index", test_keyframes_truncated) == NULL) { return; }
+}
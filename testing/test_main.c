@@ -13,6 +13,13 @@ void vector_test_suite(CU_pSuite suite);
 void list_test_suite(CU_pSuite suite);
 void array_test_suite(CU_pSuite suite);
 void text_render_test_suite(CU_pSuite suite);
+void surface_test_suite(CU_pSuite suite);
+void scalers_test_suite(CU_pSuite suite);
+void video_cpu_test_suite(CU_pSuite suite);
+void video_hw_test_suite(CU_pSuite suite);
+void screenshot_test_suite(CU_pSuite suite);
+void keyframes_test_suite(CU_pSuite suite);
+void sim_clock_test_suite(CU_pSuite suite);
 
 int main(int argc, char **argv) {
     CU_pSuite suite = NULL;
@@ -71,6 +78,34 @@ int main(int argc, char **argv) {
     if(text_render_suite == NULL) goto end;
     text_render_test_suite(text_render_suite);
 
+    CU_pSuite surface_suite = CU_add_suite("Surfaces", NULL, NULL);
+    if(surface_suite == NULL) goto end;
+    surface_test_suite(surface_suite);
+
+    CU_pSuite scalers_suite = CU_add_suite("Scalers", NULL, NULL);
+    if(scalers_suite == NULL) goto end;
+    scalers_test_suite(scalers_suite);
+
+    CU_pSuite video_cpu_suite = CU_add_suite("Offscreen renderer", NULL, NULL);
+    if(video_cpu_suite == NULL) goto end;
+    video_cpu_test_suite(video_cpu_suite);
+
+    CU_pSuite video_hw_suite = CU_add_suite("Hardware renderer", NULL, NULL);
+    if(video_hw_suite == NULL) goto end;
+    video_hw_test_suite(video_hw_suite);
+
+    CU_pSuite screenshot_suite = CU_add_suite("Screenshots", NULL, NULL);
+    if(screenshot_suite == NULL) goto end;
+    screenshot_test_suite(screenshot_suite);
+
+    CU_pSuite keyframes_suite = CU_add_suite("Keyframes", NULL, NULL);
+    if(keyframes_suite == NULL) goto end;
+    keyframes_test_suite(keyframes_suite);
+
+    CU_pSuite sim_clock_suite = CU_add_suite("Simulation clock", NULL, NULL);
+    if(sim_clock_suite == NULL) goto end;
+    sim_clock_test_suite(sim_clock_suite);
+
     // Run tests
     CU_basic_set_mode(CU_BRM_VERBOSE);
     CU_basic_run_tests();
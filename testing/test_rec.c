@@ -69,6 +69,111 @@ void test_rec_roundtrip(void) {
     sd_rec_free(&loaded);
 }
 
+void test_rec_journal(void) {
+    sd_rec_file loaded;
+    sd_rec_journal journal;
+
+    // Journal the same moves that were inserted to the REC
+    CU_ASSERT(sd_rec_journal_open(&journal, &rec, "test_journal.rec") == SD_SUCCESS);
+    for(int i = 0; i < rec.move_count; i++) {
+        CU_ASSERT(sd_rec_journal_append(&journal, &rec.moves[i]) == SD_SUCCESS);
+    }
+    CU_ASSERT(journal.move_count == rec.move_count);
+    CU_ASSERT(sd_rec_journal_close(&journal) == SD_SUCCESS);
+
+    // Should load just like a normally saved file
+    CU_ASSERT(sd_rec_create(&loaded) == SD_SUCCESS);
+    CU_ASSERT(sd_rec_load(&loaded, "test_journal.rec") == SD_SUCCESS);
+    CU_ASSERT(rec.move_count == loaded.move_count);
+    for(int i = 0; i < rec.move_count && i < loaded.move_count; i++) {
+        CU_ASSERT(rec.moves[i].tick == loaded.moves[i].tick);
+        CU_ASSERT(rec.moves[i].player_id == loaded.moves[i].player_id);
+        CU_ASSERT(rec.moves[i].action == loaded.moves[i].action);
+    }
+    sd_rec_free(&loaded);
+}
+
+void test_rec_truncated(void) {
+    sd_rec_file loaded;
+
+    // Cut the journal in the middle of the last move record
+    FILE *src = fopen("test_journal.rec", "rb");
+    FILE *dst = fopen("test_truncated.rec", "wb");
+    CU_ASSERT_FATAL(src != NULL && dst != NULL);
+    fseek(src, 0, SEEK_END);
+    long size = ftell(src) - 3;
+    fseek(src, 0, SEEK_SET);
+    for(long i = 0; i < size; i++) {
+        fputc(fgetc(src), dst);
+    }
+    fclose(src);
+    fclose(dst);
+
+    // Everything but the partial move should come back
+    CU_ASSERT(sd_rec_create(&loaded) == SD_SUCCESS);
+    CU_ASSERT(sd_rec_load(&loaded, "test_truncated.rec") == SD_SUCCESS);
+    CU_ASSERT(loaded.move_count == rec.move_count - 1);
+    sd_rec_free(&loaded);
+}
+
+static long file_size(const char *filename) {
+    FILE *f = fopen(filename, "rb");
+    if(f == NULL) {
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+void test_rec_compressed(void) {
+    const char *src = TESTS_ROOT_DIR "/recs/crystal-shirro.rec";
+    sd_rec_file plain, loaded;
+
+    CU_ASSERT(sd_rec_create(&plain) == SD_SUCCESS);
+    CU_ASSERT_FATAL(sd_rec_load(&plain, src) == SD_SUCCESS);
+    CU_ASSERT(sd_rec_save_compressed(&plain, "test_compressed.rec") == SD_SUCCESS);
+    CU_ASSERT(file_size("test_compressed.rec") < file_size(src) / 2);
+
+    // Loads back to the same moves
+    CU_ASSERT(sd_rec_create(&loaded) == SD_SUCCESS);
+    CU_ASSERT(sd_rec_load(&loaded, "test_compressed.rec") == SD_SUCCESS);
+    CU_ASSERT(plain.move_count == loaded.move_count);
+    CU_ASSERT(plain.arena_id == loaded.arena_id);
+    for(int i = 0; i < plain.move_count && i < loaded.move_count; i++) {
+        CU_ASSERT(plain.moves[i].tick == loaded.moves[i].tick);
+        CU_ASSERT(plain.moves[i].lookup_id == loaded.moves[i].lookup_id);
+        CU_ASSERT(plain.moves[i].player_id == loaded.moves[i].player_id);
+        CU_ASSERT(plain.moves[i].action == loaded.moves[i].action);
+        int extra = sd_rec_extra_len(plain.moves[i].lookup_id) - 1;
+        if(extra > 0) {
+            CU_ASSERT_NSTRING_EQUAL(plain.moves[i].extra_data, loaded.moves[i].extra_data, extra);
+        }
+    }
+
+    // Streaming gives the same moves one at a time
+    sd_rec_stream stream;
+    sd_rec_file header;
+    sd_rec_move move;
+    unsigned int count = 0;
+    CU_ASSERT(sd_rec_create(&header) == SD_SUCCESS);
+    CU_ASSERT_FATAL(sd_rec_stream_open(&stream, &header, "test_compressed.rec") == SD_SUCCESS);
+    while(sd_rec_stream_next(&stream, &move) == SD_SUCCESS) {
+        if(count < plain.move_count) {
+            CU_ASSERT(move.tick == plain.moves[count].tick);
+        }
+        free(move.extra_data);
+        count++;
+    }
+    sd_rec_stream_close(&stream);
+    CU_ASSERT(count == plain.move_count);
+
+    sd_rec_free(&header);
+    sd_rec_free(&loaded);
+    sd_rec_free(&plain);
+}
+
 void test_crystal_shirro_load(void) {
     CU_ASSERT(sd_rec_create(&rec) == SD_SUCCESS);
     CU_ASSERT(sd_rec_load(&rec, TESTS_ROOT_DIR
@@ -79,6 +184,9 @@ void test_crystal_shirro_load(void) {
 void rec_test_suite(CU_pSuite suite) {
     if(CU_add_test(suite, "test of sd_rec_create", test_sd_rec_create) == NULL) { return; }
     if(CU_add_test(suite, "test of REC roundtripping", test_rec_roundtrip) == NULL) { return; }
+    if(CU_add_test(suite, "test of REC journal", test_rec_journal) == NULL) { return; }
+    if(CU_add_test(suite, "test of truncated REC loading", test_rec_truncated) == NULL) { return; }
+    if(CU_add_test(suite, "test of compressed REC files", test_rec_compressed) == NULL) { return; }
     if(CU_add_test(suite, "test of sd_rec_free", test_sd_rec_free) == NULL) { return; }
     if(CU_add_test(suite, "test loading crystal-shirro.rec", test_crystal_shirro_load) == NULL) { return; }
 }
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include "plugins/builtin_scalers.h"
+
+#define IMG_W 133
+#define IMG_H 83
+
+static uint32_t px(const uint32_t *in, int w, int h, int x, int y) {
+    x = (x < 0) ? 0 : ((x >= w) ? w - 1 : x);
+    y = (y < 0) ? 0 : ((y >= h) ? h - 1 : y);
+    return in[y * w + x];
+}
+
+// Straight from the AdvanceMAME description of the effects
+static void reference_scale2x(const uint32_t *in, uint32_t *out, int w, int h) {
+    for(int y = 0; y < h; y++) {
+        for(int x = 0; x < w; x++) {
+            uint32_t B = px(in, w, h, x, y - 1), D = px(in, w, h, x - 1, y), E = px(in, w, h, x, y);
+            uint32_t F = px(in, w, h, x + 1, y), H = px(in, w, h, x, y + 1);
+            uint32_t *o = out + (y * 2) * (w * 2) + x * 2;
+            int c = (B != H && D != F);
+            o[0] = (c && D == B) ? D : E;
+            o[1] = (c && B == F) ? F : E;
+            o[w * 2] = (c && D == H) ? D : E;
+            o[w * 2 + 1] = (c && H == F) ? F : E;
+        }
+    }
+}
+
+static void reference_scale3x(const uint32_t *in, uint32_t *out, int w, int h) {
+    for(int y = 0; y < h; y++) {
+        for(int x = 0; x < w; x++) {
+            uint32_t A = px(in, w, h, x - 1, y - 1), B = px(in, w, h, x, y - 1), C = px(in, w, h, x + 1, y - 1);
+            uint32_t D = px(in, w, h, x - 1, y), E = px(in, w, h, x, y), F = px(in, w, h, x + 1, y);
+            uint32_t G = px(in, w, h, x - 1, y + 1), H = px(in, w, h, x, y + 1), I = px(in, w, h, x + 1, y + 1);
+            uint32_t e[9];
+            for(int i = 0; i < 9; i++) {
+                e[i] = E;
+            }
+            if(B != H && D != F) {
+                e[0] = (D == B) ? D : E;
+                e[1] = ((D == B && E != C) || (B == F && E != A)) ? B : E;
+                e[2] = (B == F) ? F : E;
+                e[3] = ((D == B && E != G) || (D == H && E != A)) ? D : E;
+                e[5] = ((B == F && E != I) || (H == F && E != C)) ? F : E;
+                e[6] = (D == H) ? D : E;
+                e[7] = ((D == H && E != I) || (H == F && E != G)) ? H : E;
+                e[8] = (H == F) ? F : E;
+            }
+            for(int i = 0; i < 9; i++) {
+                out[(y * 3 + i / 3) * (w * 3) + x * 3 + i % 3] = e[i];
+            }
+        }
+    }
+}
+
+static uint32_t *make_image() {
+    // Few colors, so that plenty of neighbours match
+    uint32_t *img = malloc(IMG_W * IMG_H * 4);
+    srand(3);
+    for(int i = 0; i < IMG_W * IMG_H; i++) {
+        img[i] = 0xFF000000 | (rand() % 3) * 0x404040;
+    }
+    return img;
+}
+
+static void check_scaler(const char *name, int factor, const uint32_t *expected, const uint32_t *in, int threads) {
+    scaler_plugin scaler;
+    scaler_init(&scaler);
+    CU_ASSERT_FATAL(builtin_scalers_get(&scaler, name) == 0);
+    size_t len = (size_t)IMG_W * IMG_H * factor * factor * 4;
+    uint32_t *out = malloc(len);
+    builtin_scalers_set_threads(threads);
+    CU_ASSERT(scaler_scale(&scaler, (const char*)in, (char*)out, IMG_W, IMG_H, factor) == 0);
+    CU_ASSERT(memcmp(out, expected, len) == 0);
+    free(out);
+}
+
+void test_scaler_pixel(void) {
+    uint32_t *in = make_image();
+    for(int f = 2; f <= 4; f++) {
+        uint32_t *expected = malloc(IMG_W * IMG_H * f * f * 4);
+        for(int y = 0; y < IMG_H * f; y++) {
+            for(int x = 0; x < IMG_W * f; x++) {
+                expected[y * IMG_W * f + x] = in[(y / f) * IMG_W + x / f];
+            }
+        }
+        check_scaler("Pixel", f, expected, in, 0);
+        check_scaler("Pixel", f, expected, in, 3);
+        free(expected);
+    }
+    free(in);
+}
+
+void test_scaler_scale(void) {
+    uint32_t *in = make_image();
+    uint32_t *x2 = malloc(IMG_W * IMG_H * 4 * 4);
+    uint32_t *x3 = malloc(IMG_W * IMG_H * 9 * 4);
+    uint32_t *x4 = malloc(IMG_W * IMG_H * 16 * 4);
+    reference_scale2x(in, x2, IMG_W, IMG_H);
+    reference_scale3x(in, x3, IMG_W, IMG_H);
+    reference_scale2x(x2, x4, IMG_W * 2, IMG_H * 2);
+    for(int threads = 0; threads <= 3; threads += 3) {
+        check_scaler("Scale", 2, x2, in, threads);
+        check_scaler("Scale", 3, x3, in, threads);
+        check_scaler("Scale", 4, x4, in, threads);
+    }
+    builtin_scalers_close();
+    free(in);
+    free(x2);
+    free(x3);
+    free(x4);
+}
+
+static uint32_t mix_14_2(uint32_t a, uint32_t b) {
+    uint32_t c = 0;
+    for(int shift = 0; shift < 32; shift += 8) {
+        c |= (((a >> shift & 0xFF) * 14 + (b >> shift & 0xFF) * 2) >> 4) << shift;
+    }
+    return c;
+}
+
+void test_scaler_hq2x(void) {
+    // A lone pixel, on the SSE2 path and next to the scalar tail of a row. In hq2x
+    // it only blends a little with what is around it, and nothing else changes.
+    const uint32_t bg = 0xFF204080, fg = 0xFFC0C020;
+    static const int spots[][2] = {{40, 30}, {131, 60}};
+    uint32_t *in = malloc(IMG_W * IMG_H * 4);
+    uint32_t *expected = malloc(IMG_W * IMG_H * 4 * 4);
+    for(int i = 0; i < IMG_W * IMG_H; i++) {
+        in[i] = bg;
+    }
+    for(int i = 0; i < IMG_W * IMG_H * 4; i++) {
+        expected[i] = bg;
+    }
+    for(int i = 0; i < 2; i++) {
+        int x = spots[i][0], y = spots[i][1];
+        in[y * IMG_W + x] = fg;
+        for(int k = 0; k < 4; k++) {
+            expected[(y * 2 + k / 2) * IMG_W * 2 + x * 2 + k % 2] = mix_14_2(fg, bg);
+        }
+    }
+    for(int threads = 0; threads <= 3; threads += 3) {
+        check_scaler("HQ2x", 2, expected, in, threads);
+    }
+    free(in);
+    free(expected);
+
+    // Banded output is the same as from a single thread
+    scaler_plugin scaler;
+    scaler_init(&scaler);
+    CU_ASSERT_FATAL(builtin_scalers_get(&scaler, "HQ2x") == 0);
+    CU_ASSERT(scaler_is_factor_available(&scaler, 3) == 0);
+    in = make_image();
+    uint32_t *single = malloc(IMG_W * IMG_H * 4 * 4);
+    builtin_scalers_set_threads(0);
+    CU_ASSERT(scaler_scale(&scaler, (const char*)in, (char*)single, IMG_W, IMG_H, 2) == 0);
+    check_scaler("HQ2x", 2, single, in, 3);
+    builtin_scalers_close();
+    free(single);
+    free(in);
+}
+
+void scalers_test_suite(CU_pSuite suite) {
+    if(CU_add_test(suite, "Test for nearest neighbour scaler", test_scaler_pixel) == NULL) { return; }
+    if(CU_add_test(suite, "Test for Scale2x/3x/4x scaler", test_scaler_scale) == NULL) { return; }
+    if(CU_add_test(suite, "Test for HQ2x scaler", test_scaler_hq2x) == NULL) { return; }
+}
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include "video/screenshot.h"
+#include "video/frame_capture.h"
+#include "video/video.h"
+#include "video/video_state.h"
+#include "video/video_cpu.h"
+
+#define SHOT_W 64
+#define SHOT_H 40
+
+static void make_shot(image *img, int seed) {
+    image_create(img, SHOT_W, SHOT_H);
+    for(int i = 0; i < SHOT_W * SHOT_H * 4; i++) {
+        img->data[i] = (i % 4 == 3) ? 0xFF : (i * 7 + seed * 31);
+    }
+}
+
+static int file_exists(const char *filename) {
+    FILE *f = fopen(filename, "rb");
+    if(f == NULL) {
+        return 0;
+    }
+    fclose(f);
+    return 1;
+}
+
+static int shot_matches(const char *filename, int seed) {
+    image expected, got;
+    if(image_read_png(&got, filename)) {
+        return 0;
+    }
+    make_shot(&expected, seed);
+    int ret = got.w == expected.w && got.h == expected.h
+              && memcmp(got.data, expected.data, SHOT_W * SHOT_H * 4) == 0;
+    image_free(&got);
+    image_free(&expected);
+    return ret;
+}
+
+void test_screenshot_write(void) {
+    char filename[64];
+    image img;
+    screenshot_init();
+    for(int i = 0; i < 3; i++) {
+        make_shot(&img, i);
+        snprintf(filename, sizeof(filename), "test_screenshot_%d.png", i);
+        CU_ASSERT(screenshot_save(&img, filename) == 0);
+        CU_ASSERT(img.data == NULL);
+    }
+    screenshot_flush();
+    for(int i = 0; i < 3; i++) {
+        snprintf(filename, sizeof(filename), "test_screenshot_%d.png", i);
+        CU_ASSERT(shot_matches(filename, i));
+        remove(filename);
+    }
+    screenshot_close();
+}
+
+void test_screenshot_burst(void) {
+    char filename[64];
+    int dropped[SCREENSHOT_QUEUE_SIZE * 4];
+    image img;
+    screenshot_init();
+
+    // Shots that don't fit are dropped; everything that was queued must still get written
+    for(int i = 0; i < SCREENSHOT_QUEUE_SIZE * 4; i++) {
+        make_shot(&img, i);
+        snprintf(filename, sizeof(filename), "test_burst_%d.png", i);
+        dropped[i] = screenshot_save(&img, filename);
+    }
+    screenshot_close();
+    for(int i = 0; i < SCREENSHOT_QUEUE_SIZE * 4; i++) {
+        snprintf(filename, sizeof(filename), "test_burst_%d.png", i);
+        if(dropped[i]) {
+            CU_ASSERT(!file_exists(filename));
+        } else {
+            CU_ASSERT(shot_matches(filename, i));
+            remove(filename);
+        }
+    }
+}
+
+static void make_palette(screen_palette *pal, int seed) {
+    for(int i = 0; i < 256; i++) {
+        pal->data[i][0] = i + seed;
+        pal->data[i][1] = i * 3 + seed;
+        pal->data[i][2] = 255 - i;
+    }
+}
+
+// A recorded frame must come out like the frame the offscreen renderer draws, even
+// after the surfaces and the palette have changed under it
+void test_screenshot_frame(void) {
+    surface bg, sprite;
+    screen_palette pal[2];
+    video_state state;
+    frame_capture *frame = malloc(sizeof(frame_capture));
+    SDL_Rect dst = {40, 30, 64, 48};
+    SDL_Rect full = {0, 0, NATIVE_W, NATIVE_H};
+    color tint = color_create(0xFF, 0x80, 0x40, 0xFF);
+    color white = color_create(0xFF, 0xFF, 0xFF, 0xFF);
+    image got;
+
+    surface_create(&bg, SURFACE_TYPE_PALETTE, NATIVE_W, NATIVE_H);
+    surface_create(&sprite, SURFACE_TYPE_PALETTE, 32, 24);
+    for(int i = 0; i < NATIVE_W * NATIVE_H; i++) {
+        bg.data[i] = i % 251;
+        bg.stencil[i] = 1;
+    }
+    for(int i = 0; i < 32 * 24; i++) {
+        sprite.data[i] = i % 13;
+        sprite.stencil[i] = (i % 5) != 0;
+    }
+    make_palette(&pal[0], 0);
+    make_palette(&pal[1], 77);
+
+    memset(&state, 0, sizeof(video_state));
+    state.fade = 0.75f;
+    state.target_move_x = 3;
+    state.target_move_y = -2;
+    state.offscreen = calloc(1, NATIVE_W * NATIVE_H * 4);
+    video_cpu_init(&state);
+    state.cb.render_prepare(&state);
+    frame_capture_create(frame);
+
+    state.cur_palette = &pal[0];
+    state.cb.render_fsot(&state, &bg, &full, SDL_BLENDMODE_NONE, 0, SDL_FLIP_NONE, 0xFF, white);
+    frame_capture_draw(frame, &pal[0], &bg, &full, SDL_BLENDMODE_NONE, 0, SDL_FLIP_NONE, 0xFF, white);
+    state.cur_palette = &pal[1];
+    state.cb.render_fsot(&state, &sprite, &dst, SDL_BLENDMODE_BLEND, 16, SDL_FLIP_HORIZONTAL, 0xC0, tint);
+    frame_capture_draw(frame, &pal[1], &sprite, &dst, SDL_BLENDMODE_BLEND, 16, SDL_FLIP_HORIZONTAL, 0xC0, tint);
+    state.cb.render_finish(&state);
+    frame_capture_finish(frame, state.fade, state.target_move_x, state.target_move_y);
+
+    // The next frame is already being drawn when the recording gets composed
+    memset(sprite.data, 0, 32 * 24);
+    make_palette(&pal[1], 5);
+
+    CU_ASSERT(frame_capture_compose(frame, &got, NATIVE_W, NATIVE_H) == 0);
+    CU_ASSERT(memcmp(got.data, state.offscreen, NATIVE_W * NATIVE_H * 4) == 0);
+    image_free(&got);
+
+    // Scaled up to the window on the screenshot workers
+    screenshot_init();
+    CU_ASSERT(screenshot_save_frame(frame, NATIVE_W * 2, NATIVE_H * 2, "test_screenshot_frame.png") == 0);
+    screenshot_flush();
+    CU_ASSERT(image_read_png(&got, "test_screenshot_frame.png") == 0);
+    CU_ASSERT(got.w == NATIVE_W * 2 && got.h == NATIVE_H * 2);
+    if(got.w == NATIVE_W * 2 && got.h == NATIVE_H * 2) {
+        int same = 1;
+        for(int y = 0; y < got.h; y++) {
+            for(int x = 0; x < got.w; x++) {
+                const uint8_t *src = state.offscreen + ((y / 2) * NATIVE_W + x / 2) * 4;
+                same &= memcmp(got.data + (y * got.w + x) * 4, src, 4) == 0;
+            }
+        }
+        CU_ASSERT(same);
+    }
+    image_free(&got);
+    remove("test_screenshot_frame.png");
+    screenshot_close();
+
+    state.cb.render_close(&state);
+    free(state.offscreen);
+    surface_free(&bg);
+    surface_free(&sprite);
+}
+
+void screenshot_test_suite(CU_pSuite suite) {
+    if(CU_add_test(suite, "Test for writing screenshots", test_screenshot_write) == NULL) { return; }
+    if(CU_add_test(suite, "Test for burst capture", test_screenshot_burst) == NULL) { return; }
+    if(CU_add_test(suite, "Test for composing recorded frames", test_screenshot_frame) == NULL) { return; }
+}
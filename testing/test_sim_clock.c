@@ -0,0 +1,56 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include "game/utils/sim_clock.h"
+
+// Game time one engine frame would simulate, with no frame budget
+static int run_frame(sim_clock *clock, int dt, float playback, int paused, int max_steps) {
+    int total = 0;
+    int step;
+    sim_clock_start(clock, paused ? 0 : dt, paused ? 1.0f : playback);
+    for(int i = 0; i < max_steps && (step = sim_clock_next(clock, playback, !paused)) > 0; i++) {
+        total += step;
+    }
+    return total;
+}
+
+void test_sim_clock_speeds(void) {
+    sim_clock clock;
+    sim_clock_init(&clock);
+
+    // 1x simulates the frame in one go
+    sim_clock_start(&clock, 17, 1.0f);
+    CU_ASSERT(sim_clock_next(&clock, 1.0f, 1) == 17);
+    CU_ASSERT(sim_clock_next(&clock, 1.0f, 1) == 0);
+
+    // Off speed goes in slices, and keeps what is left below a millisecond
+    CU_ASSERT(run_frame(&clock, 25, 4.0f, 0, 100) == 100);
+    CU_ASSERT(run_frame(&clock, 3, 0.25f, 0, 100) == 0);
+    CU_ASSERT(run_frame(&clock, 1, 0.25f, 0, 100) == 1);
+
+    // Full speed only stops when the frame budget does
+    CU_ASSERT(run_frame(&clock, 16, 0.0f, 0, 100) == 1000);
+}
+
+void test_sim_clock_debugger(void) {
+    sim_clock clock;
+    sim_clock_init(&clock);
+
+    // A paused visual debugger holds the game still, even at full speed
+    for(int frame = 0; frame < 10; frame++) {
+        CU_ASSERT(run_frame(&clock, 16, 0.0f, 1, 100) == 0);
+        CU_ASSERT(run_frame(&clock, 16, 1.0f, 1, 100) == 0);
+    }
+
+    // Stepping it runs exactly one step of game time
+    sim_clock_start(&clock, 20, 1.0f);
+    int total = 0, step;
+    while((step = sim_clock_next(&clock, 0.0f, 0)) > 0) {
+        total += step;
+    }
+    CU_ASSERT(total == 20);
+}
+
+void sim_clock_test_suite(CU_pSuite suite) {
+    if(CU_add_test(suite, "Test for simulation clock speeds", test_sim_clock_speeds) == NULL) { return; }
+    if(CU_add_test(suite, "Test for simulation clock with a paused debugger", test_sim_clock_debugger) == NULL) { return; }
+}
@@ -0,0 +1,204 @@
+#include <stdlib.h>
+#include <string.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include "video/surface.h"
+#include "video/palette_lut.h"
+#include "misc/ref_blitters.h"
+
+static screen_palette test_pal;
+static char test_remap[256];
+
+// The conversion as it was done per pixel before palette_lut
+static void reference_to_rgba(surface *sur, char *dst, char *remap_table, uint8_t pal_offset) {
+    for(int i = 0; i < sur->w * sur->h; i++) {
+        uint8_t idx = (uint8_t)sur->data[i];
+        if(remap_table != NULL) {
+            idx = (uint8_t)remap_table[idx];
+        }
+        if(idx < 48) {
+            idx += pal_offset;
+        }
+        dst[i * 4 + 0] = test_pal.data[idx][0];
+        dst[i * 4 + 1] = test_pal.data[idx][1];
+        dst[i * 4 + 2] = test_pal.data[idx][2];
+        dst[i * 4 + 3] = (sur->stencil[i] == 1) ? 0xFF : 0;
+    }
+}
+
+// Every test builds its own, so that none depends on another having run first
+static void make_palette(unsigned int seed) {
+    srand(seed);
+    for(int i = 0; i < 256; i++) {
+        test_pal.data[i][0] = rand();
+        test_pal.data[i][1] = rand();
+        test_pal.data[i][2] = rand();
+        test_remap[i] = rand();
+    }
+}
+
+static void fill_random(surface *sur) {
+    for(int i = 0; i < sur->w * sur->h; i++) {
+        sur->data[i] = rand();
+        sur->stencil[i] = rand() % 3; // Only 1 is opaque
+    }
+}
+
+void test_surface_to_rgba(void) {
+    // Odd widths leave tails after the vector loops
+    const int sizes[][2] = {{1, 1}, {7, 3}, {16, 1}, {33, 17}, {320, 200}};
+    make_palette(1);
+    for(unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        surface sur;
+        surface_create(&sur, SURFACE_TYPE_PALETTE, sizes[s][0], sizes[s][1]);
+        fill_random(&sur);
+        int len = sur.w * sur.h * 4;
+        char *expected = malloc(len);
+        char *got = malloc(len);
+        for(int remap = 0; remap < 2; remap++) {
+            for(int offset = 0; offset <= 48; offset += 48) {
+                char *table = remap ? test_remap : NULL;
+                reference_to_rgba(&sur, expected, table, offset);
+                surface_to_rgba(&sur, got, &test_pal, table, offset);
+                CU_ASSERT(memcmp(expected, got, len) == 0);
+            }
+        }
+        free(expected);
+        free(got);
+        surface_free(&sur);
+    }
+}
+
+void test_surface_to_rgba_pitch(void) {
+    surface sur;
+    make_palette(3);
+    surface_create(&sur, SURFACE_TYPE_PALETTE, 37, 11);
+    fill_random(&sur);
+    int row = sur.w * 4;
+    int pitch = row + 12;
+    char *expected = malloc(row * sur.h);
+    char *got = malloc(pitch * sur.h);
+    memset(got, 0xAB, pitch * sur.h);
+    reference_to_rgba(&sur, expected, test_remap, 0);
+    surface_to_rgba_pitch(&sur, got, pitch, &test_pal, test_remap, 0);
+    for(int y = 0; y < sur.h; y++) {
+        CU_ASSERT(memcmp(expected + y * row, got + y * pitch, row) == 0);
+        // Row padding is left alone
+        CU_ASSERT((uint8_t)got[y * pitch + row] == 0xAB);
+        CU_ASSERT((uint8_t)got[y * pitch + pitch - 1] == 0xAB);
+    }
+    free(expected);
+    free(got);
+    surface_free(&sur);
+}
+
+void test_palette_lut_scalar(void) {
+    const int count = 1001;
+    char *src = malloc(count);
+    char *stencil = malloc(count);
+    char *simd = malloc(count * 4);
+    char *scalar = malloc(count * 4);
+    make_palette(4);
+    for(int i = 0; i < count; i++) {
+        src[i] = rand();
+        stencil[i] = rand() % 3;
+    }
+    palette_lut lut;
+    palette_lut_build(&lut, &test_pal, test_remap, 48);
+    palette_lut_convert(&lut, simd, src, stencil, count);
+    palette_lut_convert_scalar(&lut, scalar, src, stencil, count);
+    CU_ASSERT(memcmp(simd, scalar, count * 4) == 0);
+    free(src);
+    free(stencil);
+    free(simd);
+    free(scalar);
+}
+
+static int surface_equal(const surface *a, const surface *b) {
+    int bytes = (a->type == SURFACE_TYPE_RGBA) ? 4 : 1;
+    if(memcmp(a->data, b->data, a->w * a->h * bytes) != 0) {
+        return 0;
+    }
+    return a->stencil == NULL || memcmp(a->stencil, b->stencil, a->w * a->h) == 0;
+}
+
+void test_surface_blits(void) {
+    // Sprites inside the target, hanging over every edge, and bigger than it
+    const int sizes[][2] = {{1, 1}, {5, 3}, {17, 9}, {40, 31}, {90, 70}};
+    const int positions[][2] = {{0, 0}, {10, 7}, {-3, -2}, {70, 50}, {-20, 40}, {45, -15}, {-100, 0}, {80, 60}};
+    palette remap_pal;
+    surface dst, expected, got;
+    srand(2);
+    for(int i = 0; i < 19 * 256; i++) {
+        remap_pal.remaps[i / 256][i % 256] = rand();
+    }
+    surface_create(&dst, SURFACE_TYPE_PALETTE, 80, 60);
+    for(unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        surface src;
+        surface_create(&src, SURFACE_TYPE_PALETTE, sizes[s][0], sizes[s][1]);
+        fill_random(&src);
+        // Mostly small indexes, so that the additive blit stays inside the remap table
+        for(int i = 0; i < src.w * src.h; i++) {
+            src.data[i] = rand() % 16;
+        }
+        for(unsigned int p = 0; p < sizeof(positions) / sizeof(positions[0]); p++) {
+            for(int flip = 0; flip < 4; flip++) {
+                int x = positions[p][0];
+                int y = positions[p][1];
+                fill_random(&dst);
+                surface_copy(&expected, &dst);
+                surface_copy(&got, &dst);
+                reference_alpha_blit(&expected, &src, x, y, flip);
+                surface_alpha_blit(&got, &src, x, y, flip);
+                CU_ASSERT(surface_equal(&expected, &got));
+                reference_additive_blit(&expected, &src, x, y, &remap_pal, flip);
+                surface_additive_blit(&got, &src, x, y, &remap_pal, flip);
+                CU_ASSERT(surface_equal(&expected, &got));
+                surface_free(&expected);
+                surface_free(&got);
+            }
+        }
+        surface_free(&src);
+    }
+    surface_free(&dst);
+}
+
+void test_surface_sub(void) {
+    surface src, expected, got;
+    for(int type = SURFACE_TYPE_RGBA; type <= SURFACE_TYPE_PALETTE; type++) {
+        surface_create(&src, type, 64, 48);
+        if(type == SURFACE_TYPE_PALETTE) {
+            fill_random(&src);
+        } else {
+            for(int i = 0; i < 64 * 48 * 4; i++) {
+                src.data[i] = rand();
+            }
+        }
+        for(int method = SUB_METHOD_NONE; method <= SUB_METHOD_MIRROR; method++) {
+            surface_copy(&expected, &src);
+            surface_copy(&got, &src);
+            reference_sub(&expected, &src, 3, 5, 20, 10, 33, 21, method);
+            surface_sub(&got, &src, 3, 5, 20, 10, 33, 21, method);
+            CU_ASSERT(surface_equal(&expected, &got));
+
+            // Onto itself, like the VS screen does, and overlapping either way
+            const int moves[][4] = {{32, 0, 0, 0}, {5, 2, 0, 0}, {0, 0, 7, 3}, {1, 0, 0, 0}};
+            for(int m = 0; m < 4; m++) {
+                reference_sub(&expected, &expected, moves[m][0], moves[m][1], moves[m][2], moves[m][3], 32, 40, method);
+                surface_sub(&got, &got, moves[m][0], moves[m][1], moves[m][2], moves[m][3], 32, 40, method);
+                CU_ASSERT(surface_equal(&expected, &got));
+            }
+            surface_free(&expected);
+            surface_free(&got);
+        }
+        surface_free(&src);
+    }
+}
+
+void surface_test_suite(CU_pSuite suite) {
+    if(CU_add_test(suite, "Test for indexed to RGBA conversion", test_surface_to_rgba) == NULL) { return; }
+    if(CU_add_test(suite, "Test for RGBA conversion with row padding", test_surface_to_rgba_pitch) == NULL) { return; }
+    if(CU_add_test(suite, "Test for palette LUT scalar fallback", test_palette_lut_scalar) == NULL) { return; }
+    if(CU_add_test(suite, "Test for clipped alpha and additive blits", test_surface_blits) == NULL) { return; }
+    if(CU_add_test(suite, "Test for surface_sub", test_surface_sub) == NULL) { return; }
+}
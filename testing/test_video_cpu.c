@@ -0,0 +1,144 @@
+#include <stdlib.h>
+#include <string.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include "video/video.h"
+
+static palette test_pal;
+
+static void cpu_begin(void) {
+    for(int i = 0; i < 256; i++) {
+        test_pal.data[i][0] = i;
+        test_pal.data[i][1] = 255 - i;
+        test_pal.data[i][2] = i / 2;
+    }
+    CU_ASSERT_FATAL(video_init_offscreen() == 0);
+    video_set_base_palette(&test_pal);
+}
+
+static void make_sprite(surface *sur, int w, int h, int index) {
+    surface_create(sur, SURFACE_TYPE_PALETTE, w, h);
+    memset(sur->data, index, w * h);
+    memset(sur->stencil, 1, w * h);
+}
+
+static const uint8_t* pixel_at(int x, int y) {
+    return (const uint8_t*)video_get_frame() + (y * NATIVE_W + x) * 4;
+}
+
+static int pixel_is(int x, int y, int r, int g, int b) {
+    const uint8_t *p = pixel_at(x, y);
+    return p[0] == r && p[1] == g && p[2] == b && p[3] == 0xFF;
+}
+
+static void draw_frame(surface *bg, surface *sprite, int x, int y, unsigned int mode,
+                       int pal_offset, unsigned int flip, uint8_t opacity, color tint) {
+    video_render_prepare();
+    video_render_background(bg);
+    video_render_sprite_flip_scale_opacity_tint(sprite, x, y, mode, pal_offset, flip, 1.0f, opacity, tint);
+    video_render_finish();
+}
+
+void test_video_cpu_alpha(void) {
+    surface bg, sprite;
+    cpu_begin();
+    make_sprite(&bg, NATIVE_W, NATIVE_H, 10);
+    make_sprite(&sprite, 4, 4, 200);
+    sprite.stencil[0] = 0; // transparent corner
+
+    draw_frame(&bg, &sprite, 20, 30, BLEND_ALPHA, 0, FLIP_NONE, 0xFF, COLOR_WHITE);
+    CU_ASSERT(pixel_is(0, 0, 10, 245, 5));
+    CU_ASSERT(pixel_is(20, 30, 10, 245, 5));
+    CU_ASSERT(pixel_is(21, 30, 200, 55, 100));
+    CU_ASSERT(pixel_is(23, 33, 200, 55, 100));
+    CU_ASSERT(pixel_is(24, 33, 10, 245, 5));
+
+    // Half opacity and a tint; the tint goes on the sprite before it is blended
+    draw_frame(&bg, &sprite, 20, 30, BLEND_ALPHA, 0, FLIP_NONE, 128, color_create(0, 255, 255, 255));
+    CU_ASSERT(pixel_is(21, 30, (10 * 127 + 127) / 255, (55 * 128 + 245 * 127 + 127) / 255, (100 * 128 + 5 * 127 + 127) / 255));
+
+    surface_free(&sprite);
+    surface_free(&bg);
+    video_close();
+}
+
+void test_video_cpu_additive(void) {
+    surface bg, sprite;
+    cpu_begin();
+    make_sprite(&bg, NATIVE_W, NATIVE_H, 100);
+    make_sprite(&sprite, 2, 2, 200);
+
+    draw_frame(&bg, &sprite, 0, 0, BLEND_ADDITIVE, 0, FLIP_NONE, 0xFF, COLOR_WHITE);
+    CU_ASSERT(pixel_is(0, 0, 255, 155 + 55, 50 + 100));
+    CU_ASSERT(pixel_is(2, 0, 100, 155, 50));
+
+    surface_free(&sprite);
+    surface_free(&bg);
+    video_close();
+}
+
+void test_video_cpu_flip_clip(void) {
+    surface bg, sprite;
+    cpu_begin();
+    make_sprite(&bg, NATIVE_W, NATIVE_H, 0);
+    make_sprite(&sprite, 3, 2, 1);
+    sprite.data[0] = 7;
+
+    draw_frame(&bg, &sprite, 100, 100, BLEND_ALPHA, 0, FLIP_HORIZONTAL | FLIP_VERTICAL, 0xFF, COLOR_WHITE);
+    CU_ASSERT(pixel_is(102, 101, 7, 248, 3));
+    CU_ASSERT(pixel_is(100, 100, 1, 254, 0));
+
+    // Partly off screen at both corners
+    draw_frame(&bg, &sprite, -1, -1, BLEND_ALPHA, 0, FLIP_NONE, 0xFF, COLOR_WHITE);
+    CU_ASSERT(pixel_is(0, 0, 1, 254, 0));
+    CU_ASSERT(pixel_is(2, 0, 0, 255, 0));
+    draw_frame(&bg, &sprite, NATIVE_W - 1, NATIVE_H - 1, BLEND_ALPHA, 0, FLIP_NONE, 0xFF, COLOR_WHITE);
+    CU_ASSERT(pixel_is(NATIVE_W - 1, NATIVE_H - 1, 7, 248, 3));
+
+    surface_free(&sprite);
+    surface_free(&bg);
+    video_close();
+}
+
+void test_video_cpu_palette_offset(void) {
+    surface bg, sprite;
+    cpu_begin();
+    make_sprite(&bg, NATIVE_W, NATIVE_H, 0);
+    make_sprite(&sprite, 2, 1, 5);
+    sprite.data[1] = 60; // Offsets only apply to the first 48 colors
+
+    draw_frame(&bg, &sprite, 0, 0, BLEND_ALPHA, 48, FLIP_NONE, 0xFF, COLOR_WHITE);
+    CU_ASSERT(pixel_is(0, 0, 53, 202, 26));
+    CU_ASSERT(pixel_is(1, 0, 60, 195, 30));
+
+    surface_free(&sprite);
+    surface_free(&bg);
+    video_close();
+}
+
+void test_video_cpu_fade_shake(void) {
+    surface bg, sprite;
+    cpu_begin();
+    make_sprite(&bg, NATIVE_W, NATIVE_H, 200);
+    make_sprite(&sprite, 1, 1, 0);
+
+    video_set_fade(0.5f);
+    video_move_target(3, 0);
+    draw_frame(&bg, &sprite, 0, 0, BLEND_ALPHA, 0, FLIP_NONE, 0, COLOR_WHITE);
+    CU_ASSERT(pixel_is(2, 0, 0, 0, 0));
+    CU_ASSERT(pixel_is(3, 0, (200 * 127 + 127) / 255, (55 * 127 + 127) / 255, (100 * 127 + 127) / 255));
+    video_set_fade(1.0f);
+    video_move_target(0, 0);
+
+    surface_free(&sprite);
+    surface_free(&bg);
+    video_close();
+}
+
+void video_cpu_test_suite(CU_pSuite suite) {
+    if(CU_add_test(suite, "Test for alpha blending, opacity and tint", test_video_cpu_alpha) == NULL) { return; }
+    if(CU_add_test(suite, "Test for additive blending", test_video_cpu_additive) == NULL) { return; }
+    if(CU_add_test(suite, "Test for flipping and clipping", test_video_cpu_flip_clip) == NULL) { return; }
+    if(CU_add_test(suite, "Test for palette offsets", test_video_cpu_palette_offset) == NULL) { return; }
+    if(CU_add_test(suite, "Test for fading and screen shake", test_video_cpu_fade_shake) == NULL) { return; }
+}
@@ -0,0 +1,270 @@
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include "video/video.h"
+#include "video/video_hw.h"
+#include "video/tcache.h"
+
+#define SIM_SEED 1234
+#define SIM_FRAMES 400
+#define SIM_MAX_SPRITES 24
+#define SIM_SURFACES 4
+#define SIM_RESET_EVERY 53 // frames between lost render targets
+
+typedef struct sim_sprite_t {
+    surface *sur;
+    int x;
+    int y;
+    SDL_BlendMode blend;
+    int flip;
+    uint8_t opacity;
+    color tint;
+} sim_sprite;
+
+typedef struct sim_t {
+    SDL_Surface *screen;
+    SDL_Renderer *renderer;
+    video_state state;
+    screen_palette pal;
+    surface bg;
+    surface surfaces[SIM_SURFACES];
+    sim_sprite sprites[SIM_MAX_SPRITES];
+    int sprite_count;
+    uint64_t redrawn;
+} sim;
+
+static void sim_fill(surface *sur, int x, int y, int w, int h) {
+    for(int j = y; j < y + h && j < sur->h; j++) {
+        for(int i = x; i < x + w && i < sur->w; i++) {
+            sur->data[j * sur->w + i] = rand() % 256;
+            sur->stencil[j * sur->w + i] = (rand() % 8) != 0;
+        }
+    }
+}
+
+static void sim_random_sprite(sim *s, sim_sprite *sp) {
+    static const SDL_BlendMode blends[] = {SDL_BLENDMODE_BLEND, SDL_BLENDMODE_ADD};
+    sp->sur = &s->surfaces[rand() % SIM_SURFACES];
+    sp->x = rand() % (NATIVE_W + 40) - 20;
+    sp->y = rand() % (NATIVE_H + 40) - 20;
+    sp->blend = blends[rand() % 2];
+    sp->flip = rand() % 4;
+    sp->opacity = (rand() % 2) ? 255 : rand() % 256;
+    sp->tint = color_create(rand() % 256, rand() % 256, rand() % 256, 255);
+}
+
+static void sim_create(sim *s, int dirty_rects) {
+    static const int sizes[SIM_SURFACES][2] = {{8, 8}, {30, 20}, {64, 90}, {120, 40}};
+    memset(s, 0, sizeof(sim));
+    srand(SIM_SEED);
+
+    // A software renderer needs no window, and draws the same everywhere
+    s->screen = SDL_CreateRGBSurfaceWithFormat(0, NATIVE_W, NATIVE_H, 32, SDL_PIXELFORMAT_ABGR8888);
+    CU_ASSERT_FATAL(s->screen != NULL);
+    s->renderer = SDL_CreateSoftwareRenderer(s->screen);
+    CU_ASSERT_FATAL(s->renderer != NULL);
+
+    for(int i = 0; i < 256; i++) {
+        s->pal.data[i][0] = rand() % 256;
+        s->pal.data[i][1] = rand() % 256;
+        s->pal.data[i][2] = rand() % 256;
+    }
+    s->pal.version = 1;
+    surface_create(&s->bg, SURFACE_TYPE_PALETTE, NATIVE_W, NATIVE_H);
+    sim_fill(&s->bg, 0, 0, NATIVE_W, NATIVE_H);
+    for(int i = 0; i < SIM_SURFACES; i++) {
+        surface_create(&s->surfaces[i], SURFACE_TYPE_PALETTE, sizes[i][0], sizes[i][1]);
+        sim_fill(&s->surfaces[i], 0, 0, sizes[i][0], sizes[i][1]);
+    }
+    s->sprite_count = SIM_MAX_SPRITES / 2;
+    for(int i = 0; i < s->sprite_count; i++) {
+        sim_random_sprite(s, &s->sprites[i]);
+    }
+
+    scaler_init(&s->state.scaler);
+    tcache_init(s->renderer, 1, &s->state.scaler);
+    s->state.renderer = s->renderer;
+    s->state.target = SDL_CreateTexture(s->renderer, SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_TARGET,
+                                        NATIVE_W, NATIVE_H);
+    CU_ASSERT_FATAL(s->state.target != NULL);
+    s->state.scale_factor = 1;
+    s->state.batching = 1;
+    s->state.dirty_rects = dirty_rects;
+    s->state.cur_palette = &s->pal;
+    video_hw_init(&s->state);
+}
+
+static void sim_free(sim *s) {
+    s->state.cb.render_close(&s->state);
+    tcache_close();
+    SDL_DestroyTexture(s->state.target);
+    SDL_DestroyRenderer(s->renderer);
+    SDL_FreeSurface(s->screen);
+    for(int i = 0; i < SIM_SURFACES; i++) {
+        surface_free(&s->surfaces[i]);
+    }
+    surface_free(&s->bg);
+}
+
+// Changes the scene the way a game does from one frame to the next
+static void sim_step(sim *s) {
+    int changes = rand() % 4;
+    for(int c = 0; c < changes; c++) {
+        sim_sprite *sp = &s->sprites[rand() % s->sprite_count];
+        switch(rand() % 7) {
+            case 0: // moved
+                sp->x += rand() % 9 - 4;
+                sp->y += rand() % 9 - 4;
+                break;
+            case 1: // retinted or faded
+                sp->tint = color_create(rand() % 256, rand() % 256, rand() % 256, 255);
+                sp->opacity = rand() % 256;
+                break;
+            case 2: // flipped, or drawn another way
+                sp->flip = rand() % 4;
+                sp->blend = (sp->blend == SDL_BLENDMODE_ADD) ? SDL_BLENDMODE_BLEND : SDL_BLENDMODE_ADD;
+                break;
+            case 3: // added
+                if(s->sprite_count < SIM_MAX_SPRITES) {
+                    int at = rand() % (s->sprite_count + 1);
+                    memmove(&s->sprites[at + 1], &s->sprites[at], (s->sprite_count - at) * sizeof(sim_sprite));
+                    sim_random_sprite(s, &s->sprites[at]);
+                    s->sprite_count++;
+                }
+                break;
+            case 4: // removed
+                if(s->sprite_count > 1) {
+                    int at = sp - s->sprites;
+                    memmove(&s->sprites[at], &s->sprites[at + 1], (s->sprite_count - at - 1) * sizeof(sim_sprite));
+                    s->sprite_count--;
+                }
+                break;
+            case 5: { // reordered
+                sim_sprite tmp = *sp;
+                sim_sprite *other = &s->sprites[rand() % s->sprite_count];
+                *sp = *other;
+                *other = tmp;
+                break;
+            }
+            case 6: { // surface contents changed, so its texture gets uploaded again
+                surface *sur = sp->sur;
+                sim_fill(sur, rand() % sur->w, rand() % sur->h, 1 + rand() % 8, 1 + rand() % 8);
+                sur->force_refresh = 1;
+                break;
+            }
+        }
+    }
+}
+
+static uint32_t sim_frame(sim *s, int frame) {
+    video_state *state = &s->state;
+    SDL_SetRenderTarget(s->renderer, state->target);
+
+    // Whatever was in the target is gone, like after SDL_RENDER_TARGETS_RESET
+    if(frame % SIM_RESET_EVERY == SIM_RESET_EVERY - 1) {
+        SDL_SetRenderDrawColor(s->renderer, 0xFF, 0x00, 0xFF, 0xFF);
+        SDL_RenderClear(s->renderer);
+        state->cb.render_reinit(state);
+    }
+
+    state->cb.render_prepare(state);
+    state->cb.render_background(state, &s->bg);
+    for(int i = 0; i < s->sprite_count; i++) {
+        const sim_sprite *sp = &s->sprites[i];
+        SDL_Rect dst = {sp->x, sp->y, sp->sur->w, sp->sur->h};
+        state->cb.render_fsot(state, sp->sur, &dst, sp->blend, 0, sp->flip, sp->opacity, sp->tint);
+    }
+    state->cb.render_finish(state);
+    tcache_frame_end();
+    s->redrawn += state->stat_redrawn;
+
+    // FNV-1a over the whole target
+    static uint8_t pixels[NATIVE_W * NATIVE_H * 4];
+    uint32_t hash = 2166136261u;
+    CU_ASSERT(SDL_RenderReadPixels(s->renderer, NULL, SDL_PIXELFORMAT_ABGR8888, pixels, NATIVE_W * 4) == 0);
+    for(int i = 0; i < NATIVE_W * NATIVE_H * 4; i++) {
+        hash = (hash ^ pixels[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void sim_run(int dirty_rects, uint32_t *hashes, uint64_t *redrawn) {
+    sim s;
+    sim_create(&s, dirty_rects);
+    for(int f = 0; f < SIM_FRAMES; f++) {
+        sim_step(&s);
+        hashes[f] = sim_frame(&s, f);
+    }
+    *redrawn = s.redrawn;
+    sim_free(&s);
+}
+
+// Every frame drawn only where it changed must match the same frame drawn in full
+void test_video_hw_dirty_rects(void) {
+    static uint32_t full[SIM_FRAMES], dirty[SIM_FRAMES];
+    uint64_t full_redrawn, dirty_redrawn;
+    sim_run(0, full, &full_redrawn);
+    sim_run(1, dirty, &dirty_redrawn);
+
+    int differ = 0;
+    for(int f = 0; f < SIM_FRAMES; f++) {
+        if(full[f] != dirty[f]) {
+            differ++;
+        }
+    }
+    CU_ASSERT_EQUAL(differ, 0);
+
+    // The comparison is only worth something if parts of frames were actually skipped
+    CU_ASSERT(full_redrawn == (uint64_t)SIM_FRAMES * NATIVE_W * NATIVE_H);
+    CU_ASSERT(dirty_redrawn < full_redrawn);
+}
+
+// Surfaces that don't all fit in one atlas page, a few of them drawn per frame
+void test_video_hw_atlas_reuse(void) {
+    enum { COUNT = 300, SIZE = 120, PER_FRAME = 10 };
+    static surface surfaces[COUNT];
+    SDL_Surface *screen = SDL_CreateRGBSurfaceWithFormat(0, NATIVE_W, NATIVE_H, 32, SDL_PIXELFORMAT_ABGR8888);
+    SDL_Renderer *renderer = SDL_CreateSoftwareRenderer(screen);
+    CU_ASSERT_FATAL(renderer != NULL);
+    scaler_plugin scaler;
+    screen_palette pal;
+    memset(&pal, 0, sizeof(screen_palette));
+    scaler_init(&scaler);
+    tcache_init(renderer, 1, &scaler);
+    tcache_set_budget(32 * 1024 * 1024); // room for one page
+
+    int missing = 0;
+    for(int i = 0; i < COUNT; i++) {
+        surface_create(&surfaces[i], SURFACE_TYPE_PALETTE, SIZE, SIZE);
+    }
+    for(int f = 0; f < COUNT / PER_FRAME; f++) {
+        for(int i = f * PER_FRAME; i < (f + 1) * PER_FRAME; i++) {
+            SDL_Rect rect;
+            missing += (tcache_get(&surfaces[i], &pal, NULL, 0, &rect) == NULL);
+        }
+        tcache_frame_end();
+    }
+    CU_ASSERT(missing == 0);
+
+    // Slots of surfaces no longer drawn went to new ones, and every upload was counted
+    tcache_stats stats;
+    tcache_get_stats(&stats);
+    CU_ASSERT(stats.evictions > 0);
+    CU_ASSERT(stats.entries < COUNT);
+    CU_ASSERT(stats.used_bytes <= stats.budget_bytes);
+    CU_ASSERT(stats.upload_bytes == (uint64_t)COUNT * SIZE * SIZE * 4);
+
+    tcache_close();
+    for(int i = 0; i < COUNT; i++) {
+        surface_free(&surfaces[i]);
+    }
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(screen);
+}
+
+void video_hw_test_suite(CU_pSuite suite) {
+    if(CU_add_test(suite, "Test for dirty rectangles against full redraws", test_video_hw_dirty_rects) == NULL) { return; }
+    if(CU_add_test(suite, "Test for reuse of atlas slots", test_video_hw_atlas_reuse) == NULL) { return; }
+}
@@ -0,0 +1,404 @@
+/** @file main.c
+  * @brief Netplay load generator
+  * @license MIT
+  */
+
+#include <argtable2.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <SDL.h>
+#include <enet/enet.h>
+#include "controller/controller.h"
+#include "controller/net_controller.h"
+#include "game/game_state_type.h"
+#include "utils/log.h"
+#include "utils/random.h"
+
+// Simulated clients tick at the same rate as the game does at normal speed
+#define TICK_MS 10
+#define CONNECT_TIMEOUT_MS 5000
+#define HISTOGRAM_BUCKETS 12
+
+enum {
+    CLIENT_WAITING,
+    CLIENT_CONNECTING,
+    CLIENT_RUNNING,
+    CLIENT_TIMED_OUT,
+    CLIENT_REFUSED,
+    CLIENT_CLOSED,
+};
+
+static const int actions[] = {
+    ACT_STOP,
+    ACT_KICK,
+    ACT_PUNCH,
+    ACT_UP,
+    ACT_DOWN,
+    ACT_LEFT,
+    ACT_RIGHT,
+    ACT_UP|ACT_LEFT,
+    ACT_UP|ACT_RIGHT,
+    ACT_DOWN|ACT_LEFT,
+    ACT_DOWN|ACT_RIGHT,
+};
+#define ACTION_COUNT (sizeof(actions) / sizeof(int))
+
+typedef struct samples_t {
+    uint32_t *data;
+    unsigned len;
+    unsigned size;
+} samples;
+
+typedef struct load_client_t {
+    int state;
+    ENetHost *host;
+    ENetPeer *peer;
+    controller *ctrl;
+    uint32_t start_at;
+    uint32_t connect_started;
+    uint32_t connected_at;
+    uint32_t ready_at;
+    float action_budget;
+    unsigned actions_sent;
+} load_client;
+
+static void samples_add(samples *s, uint32_t value) {
+    if(s->len >= s->size) {
+        s->size = s->size ? s->size * 2 : 1024;
+        s->data = realloc(s->data, s->size * sizeof(uint32_t));
+    }
+    s->data[s->len++] = value;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Expects sorted samples
+static uint32_t samples_percentile(const samples *s, float pct) {
+    if(s->len == 0) {
+        return 0;
+    }
+    unsigned idx = (unsigned)(pct / 100.0f * (s->len - 1) + 0.5f);
+    return s->data[idx];
+}
+
+static void samples_print(const char *title, samples *s) {
+    printf("%s (ms): ", title);
+    if(s->len == 0) {
+        printf("no samples\n");
+        return;
+    }
+    qsort(s->data, s->len, sizeof(uint32_t), cmp_u32);
+    double sum = 0;
+    for(unsigned i = 0; i < s->len; i++) {
+        sum += s->data[i];
+    }
+    printf("n=%u min=%u mean=%.2f p50=%u p90=%u p99=%u p99.9=%u max=%u\n",
+           s->len,
+           s->data[0],
+           sum / s->len,
+           samples_percentile(s, 50.0f),
+           samples_percentile(s, 90.0f),
+           samples_percentile(s, 99.0f),
+           samples_percentile(s, 99.9f),
+           s->data[s->len - 1]);
+}
+
+static void samples_print_histogram(const samples *s) {
+    // Power of two buckets: <1, 1, 2-3, 4-7, ... ms; the last one catches the rest
+    unsigned buckets[HISTOGRAM_BUCKETS];
+    memset(buckets, 0, sizeof(buckets));
+    for(unsigned i = 0; i < s->len; i++) {
+        int b = 0;
+        uint32_t v = s->data[i];
+        while(v > 0 && b < HISTOGRAM_BUCKETS - 1) {
+            v >>= 1;
+            b++;
+        }
+        buckets[b]++;
+    }
+    for(int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+        if(buckets[b] == 0) {
+            continue;
+        }
+        unsigned lo = b ? 1u << (b - 1) : 0;
+        unsigned hi = b ? (1u << b) - 1 : 0;
+        int width = (int)(50.0 * buckets[b] / s->len + 0.5);
+        if(b == HISTOGRAM_BUCKETS - 1) {
+            printf("  %5u+      %8u ", lo, buckets[b]);
+        } else {
+            printf("  %5u-%-5u %8u ", lo, hi, buckets[b]);
+        }
+        for(int i = 0; i < width; i++) {
+            putchar('#');
+        }
+        putchar('\n');
+    }
+}
+
+static void client_close(load_client *c) {
+    if(c->ctrl) {
+        // Owns the host from here on
+        net_controller_free(c->ctrl);
+        free(c->ctrl);
+        c->ctrl = NULL;
+        c->host = NULL;
+    }
+    if(c->host) {
+        enet_host_destroy(c->host);
+        c->host = NULL;
+    }
+}
+
+static void client_connect(load_client *c, ENetAddress *address, uint32_t now) {
+    c->connect_started = now;
+    c->host = enet_host_create(NULL, 1, 2, 0, 0);
+    if(c->host == NULL) {
+        c->state = CLIENT_REFUSED;
+        return;
+    }
+    c->peer = enet_host_connect(c->host, address, 2, 0);
+    if(c->peer == NULL) {
+        client_close(c);
+        c->state = CLIENT_REFUSED;
+        return;
+    }
+    c->state = CLIENT_CONNECTING;
+}
+
+static void client_hb_answered(uint32_t rtt_ms, void *userdata) {
+    samples_add(userdata, rtt_ms);
+}
+
+static void client_handshake(load_client *c, uint32_t now, samples *connect_times, samples *latencies) {
+    ENetEvent event;
+    while(enet_host_service(c->host, &event, 0) > 0) {
+        if(event.type == ENET_EVENT_TYPE_DISCONNECT) {
+            client_close(c);
+            c->state = CLIENT_REFUSED;
+            return;
+        }
+        if(event.type != ENET_EVENT_TYPE_CONNECT) {
+            if(event.type == ENET_EVENT_TYPE_RECEIVE) {
+                enet_packet_destroy(event.packet);
+            }
+            continue;
+        }
+
+        // Same greeting the connect menu sends
+        ENetPacket *packet = enet_packet_create("0", 2, ENET_PACKET_FLAG_RELIABLE);
+        enet_peer_send(event.peer, 0, packet);
+        enet_host_flush(c->host);
+
+        c->ctrl = calloc(1, sizeof(controller));
+        controller_init(c->ctrl);
+        net_controller_create(c->ctrl, c->host, event.peer, ROLE_CLIENT);
+        net_controller_set_hb_cb(c->ctrl, client_hb_answered, latencies);
+        c->connected_at = now;
+        c->state = CLIENT_RUNNING;
+        samples_add(connect_times, now - c->connect_started);
+        return;
+    }
+    if(now - c->connect_started > CONNECT_TIMEOUT_MS) {
+        client_close(c);
+        c->state = CLIENT_TIMED_OUT;
+    }
+}
+
+static void client_run(load_client *c, int tick, uint32_t now, float actions_per_tick,
+                       samples *ready_times) {
+    ctrl_event *ev = NULL;
+    if(controller_tick(c->ctrl, tick, &ev)) {
+        controller_free_chain(ev);
+        client_close(c);
+        c->state = CLIENT_CLOSED;
+        return;
+    }
+    controller_free_chain(ev);
+
+    if(!c->ready_at && net_controller_ready(c->ctrl)) {
+        c->ready_at = now;
+        samples_add(ready_times, now - c->connected_at);
+    }
+
+    // Inputs go out through the same hook local controllers use to feed the peer
+    c->action_budget += actions_per_tick;
+    while(c->action_budget >= 1.0f) {
+        c->ctrl->controller_hook(c->ctrl, actions[rand_int(ACTION_COUNT)]);
+        c->action_budget -= 1.0f;
+        c->actions_sent++;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // commandline argument parser options
+    struct arg_lit *help = arg_lit0("h", "help", "print this help and exit");
+    struct arg_lit *vers = arg_lit0("v", "version", "print version information and exit");
+    struct arg_str *addr = arg_str0("a", "address", "<host>", "Host to connect to (default: 127.0.0.1)");
+    struct arg_int *port = arg_int0("p", "port", "<port>", "Port to connect to (default: 2097)");
+    struct arg_int *clients = arg_int0("c", "clients", "<n>", "Number of simulated clients (default: 8)");
+    struct arg_int *stagger = arg_int0("s", "stagger", "<ms>", "Delay between connection attempts (default: 0)");
+    struct arg_int *rate = arg_int0("r", "rate", "<n>", "Inputs per second per client (default: 10)");
+    struct arg_int *duration = arg_int0("d", "duration", "<s>", "Seconds to run for (default: 10)");
+    struct arg_int *seed = arg_int0(NULL, "seed", "<n>", "Seed for the input generator");
+    struct arg_lit *verbose = arg_lit0(NULL, "verbose", "Print the netcode log to stdout");
+    struct arg_end *end = arg_end(20);
+    void* argtable[] = {help,vers,addr,port,clients,stagger,rate,duration,seed,verbose,end};
+    const char* progname = "netload";
+    int ret = 1;
+
+    // Make sure everything got allocated
+    if(arg_nullcheck(argtable) != 0) {
+        printf("%s: insufficient memory\n", progname);
+        goto exit_0;
+    }
+
+    // Parse arguments
+    int nerrors = arg_parse(argc, argv, argtable);
+
+    // Handle help
+    if(help->count > 0) {
+        printf("Usage: %s", progname);
+        arg_print_syntax(stdout, argtable, "\n");
+        printf("\nArguments:\n");
+        arg_print_glossary(stdout, argtable, "%-25s %s\n");
+        ret = 0;
+        goto exit_0;
+    }
+
+    // Handle version
+    if(vers->count > 0) {
+        printf("%s v0.1\n", progname);
+        printf("Headless netplay load generator for OpenOMF hosts.\n");
+        printf("Source code is available at https://github.com/omf2097 under MIT license.\n");
+        ret = 0;
+        goto exit_0;
+    }
+
+    // Handle errors
+    if(nerrors > 0) {
+        arg_print_errors(stdout, end, progname);
+        printf("Try '%s --help' for more information.\n", progname);
+        goto exit_0;
+    }
+
+    const char *host_name = addr->count > 0 ? addr->sval[0] : "127.0.0.1";
+    int client_count = clients->count > 0 ? clients->ival[0] : 8;
+    int stagger_ms = stagger->count > 0 ? stagger->ival[0] : 0;
+    int input_rate = rate->count > 0 ? rate->ival[0] : 10;
+    int run_ms = (duration->count > 0 ? duration->ival[0] : 10) * 1000;
+    if(client_count <= 0 || stagger_ms < 0 || input_rate < 0 || run_ms <= 0) {
+        printf("Client count and duration must be positive; stagger and rate must not be negative.\n");
+        goto exit_0;
+    }
+    rand_seed(seed->count > 0 ? (uint32_t)seed->ival[0] : SDL_GetPerformanceCounter());
+
+    if(verbose->count > 0) {
+        log_init(0);
+    }
+    if(SDL_Init(SDL_INIT_TIMER)) {
+        printf("SDL2 Initialization failed: %s\n", SDL_GetError());
+        goto exit_1;
+    }
+    if(enet_initialize() != 0) {
+        printf("Failed to initialize enet\n");
+        goto exit_2;
+    }
+
+    ENetAddress address;
+    if(enet_address_set_host(&address, host_name) != 0) {
+        printf("Unable to resolve %s\n", host_name);
+        goto exit_3;
+    }
+    address.port = port->count > 0 ? (port->ival[0] & 0xFFFF) : 2097;
+
+    load_client *cl = calloc(client_count, sizeof(load_client));
+    samples latencies = {0};
+    samples connect_times = {0};
+    samples ready_times = {0};
+    float actions_per_tick = input_rate * TICK_MS / 1000.0f;
+
+    printf("Running %d clients against %s:%u for %d s, %d inputs/s each.\n",
+           client_count, host_name, address.port, run_ms / 1000, input_rate);
+
+    // Simulated clients all share one fixed step loop
+    uint32_t started = SDL_GetTicks();
+    for(int i = 0; i < client_count; i++) {
+        cl[i].state = CLIENT_WAITING;
+        cl[i].start_at = started + i * stagger_ms;
+    }
+    int tick = 0;
+    uint32_t next_tick = started;
+    uint32_t now = started;
+    while(now - started < (uint32_t)run_ms) {
+        for(int i = 0; i < client_count; i++) {
+            load_client *c = &cl[i];
+            switch(c->state) {
+                case CLIENT_WAITING:
+                    if((int32_t)(now - c->start_at) >= 0) {
+                        client_connect(c, &address, now);
+                    }
+                    break;
+                case CLIENT_CONNECTING:
+                    client_handshake(c, now, &connect_times, &latencies);
+                    break;
+                case CLIENT_RUNNING:
+                    client_run(c, tick, now, actions_per_tick, &ready_times);
+                    break;
+            }
+        }
+        tick++;
+        next_tick += TICK_MS;
+        now = SDL_GetTicks();
+        if((int32_t)(next_tick - now) > 0) {
+            SDL_Delay(next_tick - now);
+            now = SDL_GetTicks();
+        }
+    }
+
+    // Tally up before closing, closing changes the state
+    int counts[CLIENT_CLOSED + 1];
+    unsigned actions_total = 0;
+    memset(counts, 0, sizeof(counts));
+    for(int i = 0; i < client_count; i++) {
+        counts[cl[i].state]++;
+        actions_total += cl[i].actions_sent;
+    }
+    for(int i = 0; i < client_count; i++) {
+        client_close(&cl[i]);
+    }
+
+    printf("\nClients:\n");
+    printf("  - Running at end:  %d\n", counts[CLIENT_RUNNING]);
+    printf("  - Ready:           %u\n", ready_times.len);
+    printf("  - Disconnected:    %d\n", counts[CLIENT_CLOSED]);
+    printf("  - Refused:         %d\n", counts[CLIENT_REFUSED]);
+    printf("  - Timed out:       %d\n", counts[CLIENT_TIMED_OUT]);
+    printf("  - Still waiting:   %d\n", counts[CLIENT_WAITING] + counts[CLIENT_CONNECTING]);
+    printf("  - Inputs sent:     %u (%.1f/s)\n", actions_total, actions_total * 1000.0f / run_ms);
+    printf("\n");
+    samples_print("Connect time", &connect_times);
+    samples_print("Time to ready", &ready_times);
+    samples_print("Heartbeat round trip", &latencies);
+    samples_print_histogram(&latencies);
+    ret = 0;
+
+    free(latencies.data);
+    free(connect_times.data);
+    free(ready_times.data);
+    free(cl);
+exit_3:
+    enet_deinitialize();
+exit_2:
+    SDL_Quit();
+exit_1:
+    log_close();
+exit_0:
+    arg_freetable(argtable, sizeof(argtable)/sizeof(argtable[0]));
+    return ret;
+}
@@ -0,0 +1,238 @@
+/** @file batch.c
+  * @brief Headless batch replay of a directory of .REC files
+  * @license MIT
+  */
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "batch.h"
+#include "engine.h"
+#include "game/replay.h"
+
+enum {
+    BATCH_PASS = 0,
+    BATCH_FAIL,
+    BATCH_MISSING,
+    BATCH_ERROR,
+    BATCH_WRITTEN,
+    BATCH_STATUS_COUNT
+};
+
+static const char* status_names[] = {
+    "pass",
+    "fail",
+    "missing",
+    "error",
+    "written"
+};
+
+typedef struct batch_job_t {
+    char path[512];
+    char name[256];
+    int status;
+    double sim_ms;
+    replay_result res;
+    replay_result expected;
+} batch_job;
+
+typedef struct batch_state_t {
+    const rec_batch_opts *opts;
+    batch_job *jobs;
+    int count;
+    SDL_atomic_t next;
+} batch_state;
+
+static int read_expected(const batch_job *job, replay_result *exp) {
+    char path[520];
+    snprintf(path, sizeof(path), "%s.expect", job->path);
+    FILE *f = fopen(path, "r");
+    if(f == NULL) {
+        return 1;
+    }
+    int ret = (fscanf(f, "scores %d %d hash %x", &exp->score[0], &exp->score[1], &exp->hash) == 3) ? 0 : 1;
+    fclose(f);
+    return ret;
+}
+
+static int write_expected(const batch_job *job) {
+    char path[520];
+    snprintf(path, sizeof(path), "%s.expect", job->path);
+    FILE *f = fopen(path, "w");
+    if(f == NULL) {
+        return 1;
+    }
+    fprintf(f, "scores %d %d\nhash %08x\n", job->res.score[0], job->res.score[1], job->res.hash);
+    fclose(f);
+    return 0;
+}
+
+static void run_job(const rec_batch_opts *opts, batch_job *job) {
+    uint64_t start = SDL_GetPerformanceCounter();
+    int ret = replay_run(job->path, opts->max_ticks, &job->res);
+    job->sim_ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+
+    if(ret) {
+        job->status = BATCH_ERROR;
+    } else if(opts->write_expected) {
+        job->status = write_expected(job) ? BATCH_ERROR : BATCH_WRITTEN;
+    } else if(read_expected(job, &job->expected)) {
+        job->status = BATCH_MISSING;
+    } else if(job->res.score[0] != job->expected.score[0]
+           || job->res.score[1] != job->expected.score[1]
+           || job->res.hash != job->expected.hash) {
+        job->status = BATCH_FAIL;
+    } else {
+        job->status = BATCH_PASS;
+    }
+}
+
+static int batch_worker(void *userdata) {
+    batch_state *st = userdata;
+    int i;
+    while((i = SDL_AtomicAdd(&st->next, 1)) < st->count) {
+        run_job(st->opts, &st->jobs[i]);
+    }
+    return 0;
+}
+
+static void print_json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for(; *s; s++) {
+        unsigned char c = *s;
+        switch(c) {
+            case '"': fputs("\\\"", f); break;
+            case '\\': fputs("\\\\", f); break;
+            case '\b': fputs("\\b", f); break;
+            case '\f': fputs("\\f", f); break;
+            case '\n': fputs("\\n", f); break;
+            case '\r': fputs("\\r", f); break;
+            case '\t': fputs("\\t", f); break;
+            default:
+                // JSON allows no other control characters inside strings
+                if(c < 0x20) {
+                    fprintf(f, "\\u%04x", c);
+                } else {
+                    fputc(c, f);
+                }
+                break;
+        }
+    }
+    fputc('"', f);
+}
+
+static void write_report(FILE *f, const batch_state *st, const int *totals, int jobs, double wall_ms) {
+    fprintf(f, "{\n");
+    fprintf(f, "  \"directory\": ");
+    print_json_string(f, st->opts->dir);
+    fprintf(f, ",\n  \"jobs\": %d,\n  \"wall_ms\": %.1f,\n", jobs, wall_ms);
+    for(int s = 0; s < BATCH_STATUS_COUNT; s++) {
+        fprintf(f, "  \"%s\": %d,\n", status_names[s], totals[s]);
+    }
+    fprintf(f, "  \"results\": [\n");
+    for(int i = 0; i < st->count; i++) {
+        const batch_job *job = &st->jobs[i];
+        fprintf(f, "    {\"file\": ");
+        print_json_string(f, job->name);
+        fprintf(f, ", \"status\": \"%s\", \"sim_ms\": %.3f", status_names[job->status], job->sim_ms);
+        if(job->status != BATCH_ERROR) {
+            fprintf(f, ", \"ticks\": %u, \"scores\": [%d, %d], \"hash\": \"%08x\"",
+                    job->res.ticks, job->res.score[0], job->res.score[1], job->res.hash);
+        }
+        if(job->status == BATCH_FAIL) {
+            fprintf(f, ", \"expected\": {\"scores\": [%d, %d], \"hash\": \"%08x\"}",
+                    job->expected.score[0], job->expected.score[1], job->expected.hash);
+        }
+        fprintf(f, "}%s\n", (i < st->count - 1) ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+static int collect_jobs(batch_state *st, const char *dir) {
+    vector names;
+    if(replay_scan_dir(&names, dir)) {
+        vector_free(&names);
+        return 1;
+    }
+    st->count = vector_size(&names);
+    st->jobs = calloc(st->count + 1, sizeof(batch_job));
+    for(int i = 0; i < st->count; i++) {
+        batch_job *job = &st->jobs[i];
+        const char *name = vector_get(&names, i);
+        snprintf(job->path, sizeof(job->path), "%s/%s", dir, name);
+        snprintf(job->name, sizeof(job->name), "%s", name);
+    }
+    vector_free(&names);
+    return 0;
+}
+
+int rec_batch_run(const rec_batch_opts *opts) {
+    batch_state st;
+    int totals[BATCH_STATUS_COUNT] = {0};
+    int ret = 1;
+
+    memset(&st, 0, sizeof(batch_state));
+    st.opts = opts;
+    SDL_AtomicSet(&st.next, 0);
+    if(collect_jobs(&st, opts->dir)) {
+        fprintf(stderr, "Unable to read directory %s.\n", opts->dir);
+        goto exit_0;
+    }
+    if(st.count == 0) {
+        fprintf(stderr, "No .REC files found in %s.\n", opts->dir);
+        goto exit_1;
+    }
+    if(engine_init_tool(0)) {
+        goto exit_1;
+    }
+
+    int jobs = (opts->jobs > 0) ? opts->jobs : SDL_GetCPUCount();
+    if(jobs > st.count) {
+        jobs = st.count;
+    }
+
+    // The calling thread works the queue too, so only jobs-1 helpers are started
+    uint64_t start = SDL_GetPerformanceCounter();
+    SDL_Thread **threads = calloc(jobs, sizeof(SDL_Thread*));
+    for(int i = 1; i < jobs; i++) {
+        threads[i] = SDL_CreateThread(batch_worker, "rectool_batch", &st);
+    }
+    batch_worker(&st);
+    for(int i = 1; i < jobs; i++) {
+        if(threads[i] != NULL) {
+            SDL_WaitThread(threads[i], NULL);
+        }
+    }
+    free(threads);
+    double wall_ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+
+    for(int i = 0; i < st.count; i++) {
+        totals[st.jobs[i].status]++;
+    }
+
+    FILE *out = stdout;
+    if(opts->report != NULL) {
+        out = fopen(opts->report, "w");
+        if(out == NULL) {
+            fprintf(stderr, "Unable to write report %s.\n", opts->report);
+            goto exit_2;
+        }
+    }
+    write_report(out, &st, totals, jobs, wall_ms);
+    if(out != stdout) {
+        fclose(out);
+    }
+
+    fprintf(stderr, "%d recordings: %d passed, %d failed, %d missing expected values, %d errors, %d written (%.1fs on %d threads)\n",
+            st.count, totals[BATCH_PASS], totals[BATCH_FAIL], totals[BATCH_MISSING],
+            totals[BATCH_ERROR], totals[BATCH_WRITTEN], wall_ms / 1000.0, jobs);
+    ret = (totals[BATCH_FAIL] + totals[BATCH_MISSING] + totals[BATCH_ERROR]) > 0;
+
+exit_2:
+    engine_close_tool();
+exit_1:
+    free(st.jobs);
+exit_0:
+    return ret;
+}
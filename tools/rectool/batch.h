@@ -0,0 +1,16 @@
+#ifndef _REC_BATCH_H
+#define _REC_BATCH_H
+
+typedef struct rec_batch_opts_t {
+    const char *dir;
+    const char *report; // NULL for stdout
+    int jobs; // 0 picks one per CPU
+    unsigned int max_ticks;
+    int write_expected; // store the results as the new expected values
+} rec_batch_opts;
+
+// Replays every .REC in a directory and checks the results against
+// <file>.expect. Returns 0 if everything passed.
+int rec_batch_run(const rec_batch_opts *opts);
+
+#endif // _REC_BATCH_H
@@ -11,6 +11,7 @@
 #include "formats/rec.h"
 #include "formats/error.h"
 #include "../shared/pilot.h"
+#include "batch.h"
 
 const char* mstr[] = {
     "PUNCH",
@@ -262,15 +263,21 @@ int main(int argc, char* argv[]) {
     // commandline argument parser options
     struct arg_lit *help = arg_lit0("h", "help", "print this help and exit");
     struct arg_lit *vers = arg_lit0("v", "version", "print version information and exit");
-    struct arg_file *file = arg_file1("f", "file", "<file>", "Input .REC file");
+    struct arg_file *file = arg_file0("f", "file", "<file>", "Input .REC file");
     struct arg_file *output = arg_file0("o", "output", "<file>", "Output .REC file");
+    struct arg_lit *compress = arg_lit0("z", "compress", "Write the output file in the compressed format");
     struct arg_str *key = arg_strn("k", "key", "<key>", 0, 3, "Select key");
     struct arg_int *pilot = arg_int0(NULL, "pilot", "<int>", "Only print pilot information");
     struct arg_str *value = arg_str0("s", "set", "<value>", "Set value (requires --key)");
     struct arg_int *insert = arg_int0("i", "insert", "<number>", "Insert a new element");
     struct arg_int *delete = arg_intn("d", "delete", "<number>", 0, 10, "Delete an existing element");
+    struct arg_file *batch = arg_file0("b", "batch", "<dir>", "Replay all .REC files in a directory and check them against their .expect files");
+    struct arg_int *jobs = arg_int0("j", "jobs", "<number>", "Parallel replays in batch mode (default: one per CPU)");
+    struct arg_file *report = arg_file0(NULL, "report", "<file>", "Write the batch report here instead of stdout");
+    struct arg_int *max_ticks = arg_int0(NULL, "max-ticks", "<number>", "Give up on a replay after this many ticks (default: 1000000)");
+    struct arg_lit *write_exp = arg_lit0(NULL, "write-expected", "Store batch results as the new expected values");
     struct arg_end *end = arg_end(20);
-    void* argtable[] = {help,vers,file,output,pilot,key,value,delete,insert,end};
+    void* argtable[] = {help,vers,file,output,compress,pilot,key,value,delete,insert,batch,jobs,report,max_ticks,write_exp,end};
     const char* progname = "rectool";
 
     // Make sure everything got allocated
@@ -313,6 +320,24 @@ int main(int argc, char* argv[]) {
         goto exit_0;
     }
 
+    // Batch replay mode
+    if(batch->count > 0) {
+        rec_batch_opts opts;
+        opts.dir = batch->filename[0];
+        opts.report = (report->count > 0) ? report->filename[0] : NULL;
+        opts.jobs = (jobs->count > 0) ? jobs->ival[0] : 0;
+        opts.max_ticks = (max_ticks->count > 0) ? max_ticks->ival[0] : 1000000;
+        opts.write_expected = write_exp->count > 0;
+        int ret = rec_batch_run(&opts);
+        arg_freetable(argtable, sizeof(argtable)/sizeof(argtable[0]));
+        return ret;
+    }
+    if(file->count == 0) {
+        printf("Either --file or --batch is required.\n");
+        printf("Try '%s --help' for more information.\n", progname);
+        goto exit_0;
+    }
+
     // Make sure delete and insert aren't both selected
     if(delete->count > 0 && insert->count > 0) {
         printf("Select either --delete or --insert, not both!");
@@ -396,7 +421,10 @@ int main(int argc, char* argv[]) {
 
     // Write output file
     if(output->count > 0) {
-        if(sd_rec_save(&rec, output->filename[0]) != SD_SUCCESS) {
+        int ret = (compress->count > 0)
+            ? sd_rec_save_compressed(&rec, output->filename[0])
+            : sd_rec_save(&rec, output->filename[0]);
+        if(ret != SD_SUCCESS) {
             printf("Save didn't succeed!");
         }
     }